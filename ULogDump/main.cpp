@@ -0,0 +1,83 @@
+﻿/*! \file main.cpp
+    \brief 把ULog::BinaryFileAppender写的二进制分段文件转换成FileAppender的文本格式.
+
+    用法:
+    \code
+    ULogDump app.000000.ulb app.000001.ulb > app.log
+    ULogDump app > app.log
+    \endcode
+    参数不是已存在的文件时,当作分段文件名的前缀,按顺序转换app.000000.ulb,app.000001.ulb...
+*/
+#include <stdio.h>
+#include <iostream>
+#include <string>
+
+#include "../UniCore/ULogBinary.h"
+
+using namespace std;
+using namespace uni;
+
+//! 转换一个分段文件,成功返回true.
+bool dumpSegment(const wstring &fileName)
+{
+    ULogBinaryReader reader;
+    if(!reader.open(fileName.c_str()))
+    {
+        fwprintf(stderr,L"无法打开二进制日志文件 %s\n",fileName.c_str());
+        return false;
+    }
+    ULogBinaryReader::Entry entry;
+    while(reader.next(entry))
+    {
+        ULogBinaryReader::writeText(cout,entry);
+    }
+    if(reader.isCorrupted())
+    {
+        fwprintf(stderr,L"二进制日志文件 %s 已损坏,只转换了损坏位置之前的日志.\n",fileName.c_str());
+        return false;
+    }
+    return true;
+}
+
+int wmain(int argc,wchar_t *argv[])
+{
+    if(argc < 2)
+    {
+        fwprintf(stderr,L"用法: ULogDump <分段文件或分段文件名前缀>...\n");
+        return 1;
+    }
+    int result = 0;
+    for(int i = 1; i < argc; i++)
+    {
+        const wstring arg = argv[i];
+        if(GetFileAttributesW(arg.c_str()) != INVALID_FILE_ATTRIBUTES)
+        {
+            if(!dumpSegment(arg))
+            {
+                result = 1;
+            }
+            continue;
+        }
+        int segmentCount = 0;
+        for(;; segmentCount++)
+        {
+            wchar_t suffix[32] = L"";
+            swprintf_s(suffix,L".%06d.ulb",segmentCount);
+            const wstring fileName = arg + suffix;
+            if(GetFileAttributesW(fileName.c_str()) == INVALID_FILE_ATTRIBUTES)
+            {
+                break;
+            }
+            if(!dumpSegment(fileName))
+            {
+                result = 1;
+            }
+        }
+        if(!segmentCount)
+        {
+            fwprintf(stderr,L"找不到二进制日志文件 %s\n",arg.c_str());
+            result = 1;
+        }
+    }
+    return result;
+}
@@ -0,0 +1,542 @@
+﻿#include "UBinaryConfig.h"
+
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include "Windows.h"
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "UCast.h"
+#include "UMemoryIniConfig.h"
+#include "UTranscode.h"
+
+using namespace std;
+
+namespace uni
+{
+
+namespace
+{
+    const char UBinaryConfigMagic[8] = {'U','C','F','G','B','I','N','1'};
+    const unsigned int UBinaryConfigVersion = 1;
+    const unsigned int FreeSlot = 0xFFFFFFFF;
+
+    static_assert(sizeof(unsigned int) == 4 && sizeof(UBinaryConfigEntry) == 16,"二进制配置的格式要求unsigned int为32位.");
+
+    vector<UUtf16Unit> toUtf16(const wstring &text)
+    {
+        if(sizeof(wchar_t) == sizeof(UUtf16Unit) || text.empty())
+        {
+            return vector<UUtf16Unit>(text.begin(),text.end());
+        }
+        const vector<UUtf32Unit> codePoints(text.begin(),text.end());
+        vector<UUtf16Unit> units(codePoints.size() * 2);
+        units.resize(utf32ToUtf16(&codePoints[0],codePoints.size(),&units[0],units.size()));
+        return units;
+    }
+
+    wstring fromUtf16(const UUtf16Unit *units,size_t size)
+    {
+        if(sizeof(wchar_t) == sizeof(UUtf16Unit) || !size)
+        {
+            return wstring(units,units + size);
+        }
+        vector<UUtf32Unit> codePoints(size);
+        codePoints.resize(utf16ToUtf32(units,size,&codePoints[0],codePoints.size()));
+        return wstring(codePoints.begin(),codePoints.end());
+    }
+
+    UUtf16Unit foldAscii(UUtf16Unit c)
+    {
+        return c >= 'A' && c <= 'Z' ? static_cast<UUtf16Unit>(c + ('a' - 'A')) : c;
+    }
+
+    //! 忽略ASCII字母大小写的FNV-1a,最后再混合一次,取模时低位也足够分散.
+    unsigned int hashKey(unsigned int seed,const UUtf16Unit *units,size_t size)
+    {
+        unsigned int h = 2166136261u ^ (seed * 0x9E3779B9u);
+        for(size_t i = 0; i < size; i++)
+        {
+            h = (h ^ foldAscii(units[i])) * 16777619u;
+        }
+        h ^= h >> 15;
+        h *= 0x2C1B3C6Du;
+        h ^= h >> 12;
+        return h;
+    }
+
+    bool equalKeys(const UUtf16Unit *a,const UUtf16Unit *b,size_t size)
+    {
+        for(size_t i = 0; i < size; i++)
+        {
+            if(foldAscii(a[i]) != foldAscii(b[i]))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    //! 构造完美哈希时使用的键.
+    struct BuildKey
+    {
+        vector<UUtf16Unit> key;
+        vector<UUtf16Unit> value;
+    };
+
+    struct BucketLarger
+    {
+        explicit BucketLarger(const vector<vector<unsigned int> > &buckets):buckets_(buckets) {}
+        bool operator()(unsigned int a,unsigned int b) const
+        {
+            return buckets_[a].size() > buckets_[b].size();
+        }
+        const vector<vector<unsigned int> > &buckets_;
+    };
+
+    //! 计算位移表和槽位表,每个桶找一个种子使桶中的键都落在空的槽位上.
+    bool buildPerfectHash(const vector<BuildKey> &keys,vector<int> &seeds,vector<unsigned int> &slots)
+    {
+        const unsigned int count = static_cast<unsigned int>(keys.size());
+        const unsigned int bucketCount = (std::max)(count,1u);
+        vector<vector<unsigned int> > buckets(bucketCount);
+        for(unsigned int i = 0; i < count; i++)
+        {
+            buckets[hashKey(0,&keys[i].key[0],keys[i].key.size()) % bucketCount].push_back(i);
+        }
+        vector<unsigned int> order(bucketCount);
+        for(unsigned int i = 0; i < bucketCount; i++)
+        {
+            order[i] = i;
+        }
+        std::stable_sort(order.begin(),order.end(),BucketLarger(buckets));
+
+        seeds.assign(bucketCount,0);
+        slots.assign(count,FreeSlot);
+        size_t current = 0;
+        vector<unsigned int> positions;
+        for(; current < order.size() && buckets[order[current]].size() > 1; current++)
+        {
+            const vector<unsigned int> &bucket = buckets[order[current]];
+            unsigned int seed = 1;
+            for(; seed < 0x7FFFFFFF; seed++)
+            {
+                positions.clear();
+                size_t i = 0;
+                for(; i < bucket.size(); i++)
+                {
+                    const BuildKey &key = keys[bucket[i]];
+                    const unsigned int position = hashKey(seed,&key.key[0],key.key.size()) % count;
+                    if(slots[position] != FreeSlot || std::find(positions.begin(),positions.end(),position) != positions.end())
+                    {
+                        break;
+                    }
+                    positions.push_back(position);
+                }
+                if(i == bucket.size())
+                {
+                    break;
+                }
+            }
+            if(seed == 0x7FFFFFFF)
+            {
+                return false;
+            }
+            seeds[order[current]] = static_cast<int>(seed);
+            for(size_t i = 0; i < bucket.size(); i++)
+            {
+                slots[positions[i]] = bucket[i];
+            }
+        }
+        //只有一个键的桶直接指定槽位.
+        unsigned int freeSlot = 0;
+        for(; current < order.size() && buckets[order[current]].size() == 1; current++)
+        {
+            while(slots[freeSlot] != FreeSlot)
+            {
+                freeSlot++;
+            }
+            slots[freeSlot] = buckets[order[current]][0];
+            seeds[order[current]] = -static_cast<int>(freeSlot) - 1;
+        }
+        return true;
+    }
+
+    bool inRange(unsigned long long offset,unsigned long long size,unsigned long long limit)
+    {
+        return offset <= limit && size <= limit - offset;
+    }
+}
+
+UBinaryConfig::UBinaryConfig( const std::wstring &binaryPath )
+    :view_(0),viewSize_(0),mapping_(0),header_(0),seeds_(0),slots_(0),entries_(0),strings_(0)
+{
+#ifdef _WIN32
+    HANDLE file = CreateFileW(binaryPath.c_str(),GENERIC_READ,FILE_SHARE_READ | FILE_SHARE_DELETE,
+        NULL,OPEN_EXISTING,FILE_ATTRIBUTE_NORMAL,NULL);
+    if(file == INVALID_HANDLE_VALUE)
+    {
+        return;
+    }
+    LARGE_INTEGER size;
+    if(GetFileSizeEx(file,&size) && size.QuadPart > 0 && static_cast<unsigned long long>(size.QuadPart) <= 0xFFFFFFFF)
+    {
+        //映射存在时文件句柄可以关闭.
+        mapping_ = CreateFileMappingW(file,NULL,PAGE_READONLY,0,0,NULL);
+        if(mapping_)
+        {
+            view_ = static_cast<const char *>(MapViewOfFile(mapping_,FILE_MAP_READ,0,0,0));
+            viewSize_ = static_cast<size_t>(size.QuadPart);
+        }
+    }
+    CloseHandle(file);
+#else
+    const int file = open(wideToUtf8(binaryPath).c_str(),O_RDONLY | O_CLOEXEC);
+    if(file < 0)
+    {
+        return;
+    }
+    struct stat info;
+    if(fstat(file,&info) == 0 && info.st_size > 0 && static_cast<unsigned long long>(info.st_size) <= 0xFFFFFFFF)
+    {
+        void *view = mmap(0,info.st_size,PROT_READ,MAP_PRIVATE,file,0);
+        if(view != MAP_FAILED)
+        {
+            view_ = static_cast<const char *>(view);
+            viewSize_ = info.st_size;
+        }
+    }
+    ::close(file);
+#endif
+    if(!view_)
+    {
+        close();
+        return;
+    }
+    const UBinaryConfigHeader *header = reinterpret_cast<const UBinaryConfigHeader *>(view_);
+    if(viewSize_ < sizeof(UBinaryConfigHeader) || memcmp(header->magic_,UBinaryConfigMagic,sizeof(header->magic_)) != 0
+        || header->version_ != UBinaryConfigVersion)
+    {
+        close();
+        return;
+    }
+    header_ = header;
+    if(!validate())
+    {
+        close();
+        return;
+    }
+    seeds_ = reinterpret_cast<const int *>(view_ + header_->seedsOffset_);
+    slots_ = reinterpret_cast<const unsigned int *>(view_ + header_->slotsOffset_);
+    entries_ = reinterpret_cast<const UBinaryConfigEntry *>(view_ + header_->entriesOffset_);
+    strings_ = reinterpret_cast<const UUtf16Unit *>(view_ + header_->stringsOffset_);
+}
+
+UBinaryConfig::~UBinaryConfig()
+{
+    close();
+}
+
+void UBinaryConfig::close()
+{
+    header_ = 0;
+#ifdef _WIN32
+    if(view_)
+    {
+        UnmapViewOfFile(view_);
+    }
+    if(mapping_)
+    {
+        CloseHandle(mapping_);
+        mapping_ = 0;
+    }
+#else
+    if(view_)
+    {
+        munmap(const_cast<char *>(view_),viewSize_);
+    }
+#endif
+    view_ = 0;
+    viewSize_ = 0;
+}
+
+bool UBinaryConfig::validate() const
+{
+    const UBinaryConfigHeader &header = *header_;
+    if(header.entryCount_ && !header.bucketCount_)
+    {
+        return false;
+    }
+    if(header.seedsOffset_ % 4 || header.slotsOffset_ % 4 || header.entriesOffset_ % 4 || header.stringsOffset_ % 2)
+    {
+        return false;
+    }
+    return inRange(header.seedsOffset_,4ULL * header.bucketCount_,viewSize_)
+        && inRange(header.slotsOffset_,4ULL * header.entryCount_,viewSize_)
+        && inRange(header.entriesOffset_,1ULL * sizeof(UBinaryConfigEntry) * header.entryCount_,viewSize_)
+        && inRange(header.stringsOffset_,2ULL * header.stringsSize_,viewSize_);
+}
+
+size_t UBinaryConfig::size() const
+{
+    return header_ ? header_->entryCount_ : 0;
+}
+
+std::wstring UBinaryConfig::text( unsigned int offset,unsigned int length ) const
+{
+    if(!inRange(offset,length,header_->stringsSize_))
+    {
+        return wstring();
+    }
+    return fromUtf16(strings_ + offset,length);
+}
+
+const UBinaryConfigEntry * UBinaryConfig::find( const std::wstring &formattedKey ) const
+{
+    if(!header_ || !header_->entryCount_)
+    {
+        return 0;
+    }
+    const vector<UUtf16Unit> key = toUtf16(formattedKey);
+    const UUtf16Unit *units = key.empty() ? 0 : &key[0];
+    const int seed = seeds_[hashKey(0,units,key.size()) % header_->bucketCount_];
+    const unsigned int position = seed < 0 ? static_cast<unsigned int>(-(seed + 1))
+        : hashKey(static_cast<unsigned int>(seed),units,key.size()) % header_->entryCount_;
+    if(position >= header_->entryCount_ || slots_[position] >= header_->entryCount_)
+    {
+        return 0;
+    }
+    const UBinaryConfigEntry *entry = entries_ + slots_[position];
+    if(entry->keyLength_ != key.size() || !inRange(entry->keyOffset_,entry->keyLength_,header_->stringsSize_)
+        || !equalKeys(strings_ + entry->keyOffset_,units,key.size()))
+    {
+        return 0;
+    }
+    return entry;
+}
+
+std::wstring UBinaryConfig::getFormatted( const std::wstring &formattedKey )
+{
+    const UBinaryConfigEntry *entry = find(formattedKey);
+    return entry ? text(entry->valueOffset_,entry->valueLength_) : wstring();
+}
+
+std::wstring UBinaryConfig::get( std::wstring key,... )
+{
+    va_list ap;
+    va_start(ap,key);
+    const wstring formattedKey = formatKey(key,ap);
+    va_end(ap);
+    return getFormatted(formattedKey);
+}
+
+int UBinaryConfig::getInt( std::wstring key,... )
+{
+    va_list ap;
+    va_start(ap,key);
+    const wstring formattedKey = formatKey(key,ap);
+    va_end(ap);
+
+    //和UIniConfig一样只解析开头的数字.
+    int value = 0;
+    size_t parsed = 0;
+    parse_int(getFormatted(formattedKey),value,&parsed);
+    return value;
+}
+
+std::vector<std::wstring> UBinaryConfig::getArray( std::wstring key,... )
+{
+    va_list ap;
+    va_start(ap,key);
+    const wstring formattedKey = formatKey(key,ap);
+    va_end(ap);
+    return getArrayFormatted(formattedKey);
+}
+
+std::vector<std::wstring> UBinaryConfig::getArrayFormatted( const std::wstring &formattedKey )
+{
+    int count = 0;
+    parse_int(getFormatted(arrayCountKey(formattedKey)),count);
+    vector<wstring> result;
+    for(int i = 0; i < count; i++)
+    {
+        result.push_back(getFormatted(arrayElementKey(formattedKey,i)));
+    }
+    return result;
+}
+
+void UBinaryConfig::set( std::wstring,std::wstring,... )
+{
+    assert(!"UBinaryConfig是只读的.");
+}
+
+void UBinaryConfig::setInt( std::wstring,int,... )
+{
+    assert(!"UBinaryConfig是只读的.");
+}
+
+void UBinaryConfig::setArray( std::wstring,std::vector<std::wstring>,... )
+{
+    assert(!"UBinaryConfig是只读的.");
+}
+
+int UBinaryConfig::resolveSlot( const std::wstring &formattedKey )
+{
+    const UBinaryConfigEntry *entry = find(formattedKey);
+    return entry ? static_cast<int>(entry - entries_) : -1;
+}
+
+bool UBinaryConfig::getSlot( int slot,std::wstring &value )
+{
+    if(!header_ || slot < 0 || static_cast<unsigned int>(slot) >= header_->entryCount_)
+    {
+        return false;
+    }
+    value = text(entries_[slot].valueOffset_,entries_[slot].valueLength_);
+    return true;
+}
+
+std::vector<std::pair<std::wstring,std::wstring> > UBinaryConfig::entries() const
+{
+    vector<pair<wstring,wstring> > result;
+    for(size_t i = 0; i < size(); i++)
+    {
+        result.push_back(make_pair(text(entries_[i].keyOffset_,entries_[i].keyLength_),
+            text(entries_[i].valueOffset_,entries_[i].valueLength_)));
+    }
+    return result;
+}
+
+bool UBinaryConfig::write( const std::wstring &binaryPath,const std::vector<std::pair<std::wstring,std::wstring> > &entries )
+{
+    //去掉重复的键.
+    vector<BuildKey> keys;
+    {
+        vector<BuildKey> candidates(entries.size());
+        for(size_t i = 0; i < entries.size(); i++)
+        {
+            candidates[i].key = toUtf16(entries[i].first);
+            candidates[i].value = toUtf16(entries[i].second);
+        }
+        vector<pair<unsigned int,size_t> > hashes(candidates.size());
+        for(size_t i = 0; i < candidates.size(); i++)
+        {
+            const vector<UUtf16Unit> &key = candidates[i].key;
+            hashes[i] = make_pair(hashKey(0,key.empty() ? 0 : &key[0],key.size()),i);
+        }
+        std::sort(hashes.begin(),hashes.end());
+        vector<bool> duplicate(candidates.size(),false);
+        for(size_t i = 0; i < hashes.size(); i++)
+        {
+            for(size_t j = i + 1; j < hashes.size() && hashes[j].first == hashes[i].first; j++)
+            {
+                const vector<UUtf16Unit> &a = candidates[hashes[i].second].key;
+                const vector<UUtf16Unit> &b = candidates[hashes[j].second].key;
+                if(a.size() == b.size() && (a.empty() || equalKeys(&a[0],&b[0],a.size())))
+                {
+                    //排序后同一个哈希值中下标小的在前,保留先出现的.
+                    duplicate[hashes[j].second] = true;
+                }
+            }
+        }
+        for(size_t i = 0; i < candidates.size(); i++)
+        {
+            if(!duplicate[i] && !candidates[i].key.empty())
+            {
+                keys.push_back(candidates[i]);
+            }
+        }
+    }
+
+    vector<int> seeds;
+    vector<unsigned int> slots;
+    if(!buildPerfectHash(keys,seeds,slots))
+    {
+        return false;
+    }
+
+    UBinaryConfigHeader header;
+    memcpy(header.magic_,UBinaryConfigMagic,sizeof(header.magic_));
+    header.version_ = UBinaryConfigVersion;
+    header.entryCount_ = static_cast<unsigned int>(keys.size());
+    header.bucketCount_ = static_cast<unsigned int>(seeds.size());
+    header.seedsOffset_ = sizeof(UBinaryConfigHeader);
+    header.slotsOffset_ = header.seedsOffset_ + header.bucketCount_ * 4;
+    header.entriesOffset_ = header.slotsOffset_ + header.entryCount_ * 4;
+    header.stringsOffset_ = header.entriesOffset_ + header.entryCount_ * sizeof(UBinaryConfigEntry);
+
+    vector<UBinaryConfigEntry> entryTable(keys.size());
+    vector<UUtf16Unit> strings;
+    for(size_t i = 0; i < keys.size(); i++)
+    {
+        entryTable[i].keyOffset_ = static_cast<unsigned int>(strings.size());
+        entryTable[i].keyLength_ = static_cast<unsigned int>(keys[i].key.size());
+        strings.insert(strings.end(),keys[i].key.begin(),keys[i].key.end());
+        entryTable[i].valueOffset_ = static_cast<unsigned int>(strings.size());
+        entryTable[i].valueLength_ = static_cast<unsigned int>(keys[i].value.size());
+        strings.insert(strings.end(),keys[i].value.begin(),keys[i].value.end());
+    }
+    header.stringsSize_ = static_cast<unsigned int>(strings.size());
+
+    string content(reinterpret_cast<const char *>(&header),sizeof(header));
+    content.append(reinterpret_cast<const char *>(&seeds[0]),seeds.size() * 4);
+    if(!keys.empty())
+    {
+        content.append(reinterpret_cast<const char *>(&slots[0]),slots.size() * 4);
+        content.append(reinterpret_cast<const char *>(&entryTable[0]),entryTable.size() * sizeof(UBinaryConfigEntry));
+    }
+    if(!strings.empty())
+    {
+        content.append(reinterpret_cast<const char *>(&strings[0]),strings.size() * sizeof(UUtf16Unit));
+    }
+
+#ifdef _WIN32
+    FILE *file = 0;
+    if(_wfopen_s(&file,binaryPath.c_str(),L"wb") != 0)
+    {
+        file = 0;
+    }
+#else
+    FILE *file = fopen(wideToUtf8(binaryPath).c_str(),"wb");
+#endif
+    if(!file)
+    {
+        return false;
+    }
+    const bool ok = fwrite(content.data(),1,content.size(),file) == content.size();
+    return fclose(file) == 0 && ok;
+}
+
+bool UBinaryConfig::compileIni( const std::wstring &iniPath,const std::wstring &binaryPath )
+{
+    UMemoryIniConfig ini(iniPath);
+    return write(binaryPath,ini.entries());
+}
+
+bool UBinaryConfig::decompileToIni( const std::wstring &binaryPath,const std::wstring &iniPath )
+{
+    UBinaryConfig binary(binaryPath);
+    if(!binary.isOpen())
+    {
+        return false;
+    }
+    const vector<pair<wstring,wstring> > entries = binary.entries();
+    UMemoryIniConfig ini(iniPath);
+    ini.beginBatch();
+    for(size_t i = 0; i < entries.size(); i++)
+    {
+        ini.set(escapeKey(entries[i].first),entries[i].second);
+    }
+    ini.endBatch();
+    return ini.flush();
+}
+
+}//namespace uni
@@ -0,0 +1,142 @@
+﻿/*! \file UBinaryConfig.h
+    \brief 编译好的二进制配置文件.
+
+    程序启动时要读取大量配置时,可以先用UBinaryConfig::compileIni把ini文件编译成二进制文件.
+    UBinaryConfig把文件映射到内存中直接读取,打开时只检查文件头,读取时不需要解析文本.
+
+    文件格式(小端,偏移都从文件开头算起):
+    - UBinaryConfigHeader.
+    - 完美哈希的位移表,int[bucketCount_].
+    - 槽位表,unsigned int[entryCount_],每个槽位对应的条目下标.
+    - 条目表,UBinaryConfigEntry[entryCount_],按原来的顺序.
+    - 字符串表,UTF-16LE,键名和值都不以0结尾.
+
+    查找时先用种子0的哈希值选择位移表中的桶,桶中的值d不小于0时用种子d的哈希值对entryCount_取模
+    得到槽位,小于0时槽位为-d-1.每个键只计算两次哈希,比较一次.
+    文件可能在其它机器上生成,键名只忽略ASCII字母的大小写.
+
+    \author unigauldoth@gmail.com
+    \date       2026-10-18
+*/
+#ifndef UNICORE_UBINARYCONFIG_H
+#define UNICORE_UBINARYCONFIG_H
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "UConfig.h"
+
+namespace uni
+{
+
+//! 二进制配置文件头.
+struct UBinaryConfigHeader
+{
+    char magic_[8];             //!< 固定为"UCFGBIN1".
+    unsigned int version_;      //!< 格式版本,当前为1.
+    unsigned int entryCount_;   //!< 键的个数.
+    unsigned int bucketCount_;  //!< 位移表的大小.
+    unsigned int seedsOffset_;
+    unsigned int slotsOffset_;
+    unsigned int entriesOffset_;
+    unsigned int stringsOffset_;
+    unsigned int stringsSize_;  //!< 字符串表的大小,单位为UTF-16代码单元.
+};
+
+//! 二进制配置文件中的一个键.
+struct UBinaryConfigEntry
+{
+    unsigned int keyOffset_;    //!< 格式化后的键名在字符串表中的位置,单位为UTF-16代码单元.
+    unsigned int keyLength_;
+    unsigned int valueOffset_;
+    unsigned int valueLength_;
+};
+
+//! 只读的二进制配置.
+/*!
+    \code
+    UBinaryConfig::compileIni(L"./配置.ini",L"./配置.bin");
+    UConfig::create(new UBinaryConfig(L"./配置.bin"));
+    wstring account = theConfig.get(L"通用配置/账号/%d",4);
+    \endcode
+    set,setInt和setArray不支持,调用时断言失败.
+*/
+class UBinaryConfig : public UConfig
+{
+public:
+    //! 构造函数,把文件映射到内存中.
+    /*!
+        \param binaryPath 二进制配置文件,不存在或格式错误时为空配置.
+    */
+    explicit UBinaryConfig(const std::wstring &binaryPath);
+    virtual ~UBinaryConfig();
+
+    //! 文件是否成功打开.
+    bool isOpen() const {return header_ != 0;}
+
+    //! 键的个数.
+    size_t size() const;
+
+    virtual std::wstring get(std::wstring key,...);
+
+    virtual void set(std::wstring key,std::wstring value,...);
+
+    virtual std::vector<std::wstring> getArray(std::wstring key,...);
+
+    virtual void setArray(std::wstring key,std::vector<std::wstring> value,...);
+
+    virtual int getInt(std::wstring key,...);
+
+    virtual void setInt(std::wstring key,int value,...);
+
+    //! 所有的键和值,按原来的顺序.
+    std::vector<std::pair<std::wstring,std::wstring> > entries() const;
+
+    //! 把键和值编译为二进制配置文件.
+    /*!
+        \param entries 格式化后的键名和值,键名重复(不区分大小写)时使用第一个.
+        \return 是否成功写入.
+    */
+    static bool write(const std::wstring &binaryPath,const std::vector<std::pair<std::wstring,std::wstring> > &entries);
+
+    //! 把ini文件编译为二进制配置文件.
+    static bool compileIni(const std::wstring &iniPath,const std::wstring &binaryPath);
+
+    //! 把二进制配置文件转换回ini文件,ini文件中已有的键会被覆盖.
+    static bool decompileToIni(const std::wstring &binaryPath,const std::wstring &iniPath);
+
+protected:
+    virtual std::wstring getFormatted(const std::wstring &formattedKey);
+
+    virtual std::vector<std::wstring> getArrayFormatted(const std::wstring &formattedKey);
+
+    //! 槽位就是条目的下标,键不存在时返回-1.
+    virtual int resolveSlot(const std::wstring &formattedKey);
+
+    virtual bool getSlot(int slot,std::wstring &value);
+
+private:
+    UBinaryConfig(const UBinaryConfig &);
+    UBinaryConfig &operator=(const UBinaryConfig &);
+
+    //! 查找键,返回条目,没有时返回0.
+    const UBinaryConfigEntry *find(const std::wstring &formattedKey) const;
+    std::wstring text(unsigned int offset,unsigned int length) const;
+    //! 检查文件头和各个表是否在文件范围内.
+    bool validate() const;
+    void close();
+
+    const char *view_;
+    size_t viewSize_;
+    void *mapping_;                     //!< Windows下为文件映射的句柄.
+    const UBinaryConfigHeader *header_; //!< 文件有效时指向view_,否则为0.
+    const int *seeds_;
+    const unsigned int *slots_;
+    const UBinaryConfigEntry *entries_;
+    const unsigned short *strings_;
+};
+
+}//namespace uni
+
+#endif//UNICORE_UBINARYCONFIG_H
@@ -1,6 +1,17 @@
 ﻿#include "UBuffer.h"
 
 #include "assert.h"
+#include <stddef.h>
+#include <algorithm>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#endif
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define UNI_BUFFER_SSE2
+#include <emmintrin.h>
+#endif
 
 #include "UCast.h"
 #include "ULog.h"
@@ -8,41 +19,328 @@
 namespace uni
 {
 
-void UBuffer::appendHexPattern( const std::string &pattern )
+namespace
 {
-    std::string word;  //保存从pattern分离出来的单个16进制数据，如"00"，"A3"之类。 
-    for(int i = 0; i < pattern.size(); i++)
+    //! 字符对应的16进制数值,不是16进制字符时为-1.
+    struct HexValueTable
+    {
+        HexValueTable()
+        {
+            for(int i = 0; i < 256; i++)
+            {
+                values[i] = -1;
+            }
+            for(int i = 0; i < 10; i++)
+            {
+                values['0' + i] = static_cast<signed char>(i);
+            }
+            for(int i = 0; i < 6; i++)
+            {
+                values['a' + i] = static_cast<signed char>(10 + i);
+                values['A' + i] = static_cast<signed char>(10 + i);
+            }
+        }
+        signed char values[256];
+    };
+    const HexValueTable hexValueTable;
+
+    //! 每个字节对应的两个16进制字符.
+    struct HexDigitTable
     {
-        if(isxdigit(pattern[i]))
+        explicit HexDigitTable(const char *digits)
         {
-            assert(pattern[i] != ' ' && pattern[i] != '|');
-            assert(word.size() < 2);
-            word.push_back(pattern[i]);
-            
-            //向word加入字符后，word已经包含2个字符, 或者取到pattern中最后一个字符,将word代表的16进制数据存入缓冲区中。
-            if(word.size() == 2 || i == pattern.size() - 1)
+            for(int i = 0; i < 256; i++)
             {
-                char data = strtol(word.c_str(),0,16);
-                appendChar(data);
-                //准备下个数据的输入。
-                word.clear();
+                pairs[i * 2] = digits[i >> 4];
+                pairs[i * 2 + 1] = digits[i & 0x0F];
             }
         }
-        else
+        char pairs[512];
+    };
+    const HexDigitTable upperHexDigits("0123456789ABCDEF");
+    const HexDigitTable lowerHexDigits("0123456789abcdef");
+
+    //! 逐个接收字符的值,把16进制数字两两合并成字节.
+    struct HexDecoder
+    {
+        explicit HexDecoder(char *out):out_(out),begin_(out),pending_(-1) {}
+        //! value为-1表示分隔符,会输出之前单独的一个数字.
+        void put(int value)
         {
-            //不是字母或数字。
-            //假如word中已经有字符，那么将word代表的16进制数据存入缓冲区中。
-            assert(word.size() < 2);
-            if(!word.empty())
+            if(value < 0)
+            {
+                if(pending_ >= 0)
+                {
+                    *out_++ = static_cast<char>(pending_);
+                    pending_ = -1;
+                }
+            }
+            else if(pending_ < 0)
             {
-                char data = strtol(word.c_str(),0,16);
-                appendChar(data);
-                //准备下个数据的输入。
-                word.clear();
+                pending_ = value;
             }
+            else
+            {
+                *out_++ = static_cast<char>(pending_ << 4 | value);
+                pending_ = -1;
+            }
+        }
+        //! 结尾相当于一个分隔符.
+        size_t finish()
+        {
+            put(-1);
+            return out_ - begin_;
+        }
+        char *out_;
+        char *begin_;
+        int pending_;   //!< 还没有配对的数字,没有时为-1.
+    };
+
+#ifdef UNI_BUFFER_SSE2
+    //! 一次分类16个字符.
+    /*!
+        \param[out] values 每个字符对应的数值,不是16进制字符的位置为0.
+        \return 第i位为1表示第i个字符是16进制字符.
+    */
+    inline int classifyHex16(const char *p,__m128i &values)
+    {
+        const __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        const __m128i isDigit = _mm_and_si128(_mm_cmpgt_epi8(c,_mm_set1_epi8('0' - 1)),
+            _mm_cmplt_epi8(c,_mm_set1_epi8('9' + 1)));
+        //大写字母转成小写,数字不受影响.大于0x7F的字符是负数,两个比较都不会通过.
+        const __m128i lower = _mm_or_si128(c,_mm_set1_epi8(0x20));
+        const __m128i isLetter = _mm_and_si128(_mm_cmpgt_epi8(lower,_mm_set1_epi8('a' - 1)),
+            _mm_cmplt_epi8(lower,_mm_set1_epi8('f' + 1)));
+        values = _mm_or_si128(
+            _mm_and_si128(isDigit,_mm_sub_epi8(c,_mm_set1_epi8('0'))),
+            _mm_and_si128(isLetter,_mm_sub_epi8(lower,_mm_set1_epi8('a' - 10))));
+        return _mm_movemask_epi8(_mm_or_si128(isDigit,isLetter));
+    }
+
+    //! 把16个字节编码为32个16进制字符.
+    inline void encodeHex16(const char *in,char *out,bool upperCase)
+    {
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in));
+        const __m128i nibbleMask = _mm_set1_epi8(0x0F);
+        const __m128i high = _mm_and_si128(_mm_srli_epi16(bytes,4),nibbleMask);
+        const __m128i low = _mm_and_si128(bytes,nibbleMask);
+        //0-9加上'0',10-15再加上到字母的距离.
+        const __m128i nine = _mm_set1_epi8(9);
+        const __m128i zero = _mm_set1_epi8('0');
+        const __m128i letterOffset = _mm_set1_epi8(upperCase ? 'A' - '0' - 10 : 'a' - '0' - 10);
+        const __m128i highChars = _mm_add_epi8(_mm_add_epi8(high,zero),
+            _mm_and_si128(_mm_cmpgt_epi8(high,nine),letterOffset));
+        const __m128i lowChars = _mm_add_epi8(_mm_add_epi8(low,zero),
+            _mm_and_si128(_mm_cmpgt_epi8(low,nine),letterOffset));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out),_mm_unpacklo_epi8(highChars,lowChars));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + 16),_mm_unpackhi_epi8(highChars,lowChars));
+    }
+#endif
+}
+
+size_t decodeHexPattern( const char *pattern,size_t size,char *out )
+{
+    HexDecoder decoder(out);
+    size_t i = 0;
+#ifdef UNI_BUFFER_SSE2
+    for(; i + 16 <= size; i += 16)
+    {
+        __m128i values;
+        const int mask = classifyHex16(pattern + i,values);
+        if(mask == 0xFFFF && decoder.pending_ < 0)
+        {
+            //整块都是16进制数字,并且从一个字节的开头开始,直接两两合并成8个字节.
+            const __m128i high = _mm_slli_epi16(_mm_and_si128(values,_mm_set1_epi16(0x00FF)),4);
+            const __m128i low = _mm_srli_epi16(values,8);
+            _mm_storel_epi64(reinterpret_cast<__m128i *>(decoder.out_),
+                _mm_packus_epi16(_mm_or_si128(high,low),_mm_setzero_si128()));
+            decoder.out_ += 8;
+            continue;
         }
+        if(!mask)
+        {
+            decoder.put(-1);
+            continue;
+        }
+        unsigned char digits[16];
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(digits),values);
+        for(int j = 0; j < 16; j++)
+        {
+            decoder.put(mask & (1 << j) ? digits[j] : -1);
+        }
+    }
+#endif
+    for(; i < size; i++)
+    {
+        decoder.put(hexValueTable.values[static_cast<unsigned char>(pattern[i])]);
+    }
+    return decoder.finish();
+}
 
+std::string toHexPattern( const UBufferView &data,int groupSize /*= 1*/,char separator /*= ' '*/,
+    bool upperCase /*= true*/ )
+{
+    const size_t size = data.size();
+    if(!size)
+    {
+        return std::string();
+    }
+    const size_t separatorCount = groupSize > 0 ? (size - 1) / groupSize : 0;
+    std::string result(size * 2 + separatorCount,'\0');
+    const char *in = data.data();
+    char *out = &result[0];
+    size_t i = 0;
+    if(groupSize <= 0)
+    {
+#ifdef UNI_BUFFER_SSE2
+        for(; i + 16 <= size; i += 16,out += 32)
+        {
+            encodeHex16(in + i,out,upperCase);
+        }
+#endif
+        groupSize = 0;
+    }
+    const char *pairs = upperCase ? upperHexDigits.pairs : lowerHexDigits.pairs;
+    for(; i < size; i++)
+    {
+        if(groupSize && i && i % groupSize == 0)
+        {
+            *out++ = separator;
+        }
+        const unsigned char byte = static_cast<unsigned char>(in[i]);
+        *out++ = pairs[byte * 2];
+        *out++ = pairs[byte * 2 + 1];
+    }
+    return result;
+}
+
+#ifdef _WIN32
+static_assert(sizeof(UIoVec) == sizeof(WSABUF)
+    && offsetof(UIoVec,len) == offsetof(WSABUF,len)
+    && offsetof(UIoVec,buf) == offsetof(WSABUF,buf),"UIoVec必须和WSABUF的内存布局相同.");
+#endif
+
+UBuffer::UBuffer( const UBuffer &buffer )
+    :data_(inline_),capacity_(InlineCapacity),size_(0),readPosition_(0)
+{
+    inline_[0] = 0;
+    append(buffer.data_,buffer.size_);
+    readPosition_ = buffer.readPosition_;
+}
+
+UBuffer &UBuffer::operator=( const UBuffer &buffer )
+{
+    if(this != &buffer)
+    {
+        clear();
+        append(buffer.data_,buffer.size_);
+        readPosition_ = buffer.readPosition_;
+    }
+    return *this;
+}
+
+void UBuffer::swap( UBuffer &buffer )
+{
+    if(data_ != inline_ && buffer.data_ != buffer.inline_)
+    {
+        //都在堆上,只交换指针.
+        std::swap(data_,buffer.data_);
+    }
+    else
+    {
+        UBuffer temp(buffer);
+        buffer = *this;
+        *this = temp;
+        return;
+    }
+    std::swap(capacity_,buffer.capacity_);
+    std::swap(size_,buffer.size_);
+    std::swap(readPosition_,buffer.readPosition_);
+}
+
+void UBuffer::commit( size_t size )
+{
+    assert(size <= capacity_ - size_);
+    size_ += size;
+    data_[size_] = 0;
+}
+
+void UBuffer::discardRead()
+{
+    if(!readPosition_)
+    {
+        return;
+    }
+    //连同结尾的0一起移动.
+    memmove(data_,data_ + readPosition_,size_ - readPosition_ + 1);
+    size_ -= readPosition_;
+    readPosition_ = 0;
+}
+
+void UBuffer::grow( size_t capacity )
+{
+    //按倍数增长,连续追加时均摊复制次数是常数.
+    size_t newCapacity = capacity_ * 2;
+    if(newCapacity < capacity)
+    {
+        newCapacity = capacity;
+    }
+    char *data = new char[newCapacity + 1];
+    memcpy(data,data_,size_ + 1);
+    if(data_ != inline_)
+    {
+        delete[] data_;
+    }
+    data_ = data;
+    capacity_ = newCapacity;
+}
+
+void UBuffer::appendHexPattern( const std::string &pattern )
+{
+    char *out = prepare((pattern.size() + 1) / 2);
+    commit(decodeHexPattern(pattern.data(),pattern.size(),out));
+}
+
+size_t UBufferChain::exportTo( UIoVec *vectors,size_t count ) const
+{
+    const size_t exported = std::min(count,segments_.size());
+    for(size_t i = 0; i < exported; i++)
+    {
+#ifdef _WIN32
+        vectors[i].buf = const_cast<char *>(segments_[i].data());
+        vectors[i].len = static_cast<unsigned long>(segments_[i].size());
+#else
+        vectors[i].iov_base = const_cast<char *>(segments_[i].data());
+        vectors[i].iov_len = segments_[i].size();
+#endif
+    }
+    return exported;
+}
+
+void UBufferChain::consume( size_t size )
+{
+    size_t consumed = 0;
+    while(consumed < segments_.size() && size >= segments_[consumed].size())
+    {
+        size -= segments_[consumed].size();
+        size_ -= segments_[consumed].size();
+        consumed++;
+    }
+    segments_.erase(segments_.begin(),segments_.begin() + consumed);
+    if(!segments_.empty() && size)
+    {
+        segments_.front() = segments_.front().slice(size);
+        size_ -= size;
+    }
+}
+
+void UBufferChain::copyTo( UBuffer &buffer ) const
+{
+    buffer.reserve(buffer.size() + size_);
+    for(size_t i = 0; i < segments_.size(); i++)
+    {
+        buffer.append(segments_[i]);
     }
 }
 
-}//namespace uni
\ No newline at end of file
+}//namespace uni
@@ -1,5 +1,10 @@
 ﻿/*! \file UBuffer.h
-    \brief 简单的Buffer类。
+    \brief 字节缓冲区.
+
+    - UBuffer 拥有数据的缓冲区,可以控制容量,小数据直接保存在对象内部,不分配内存.
+      带有读位置,可以按指定的字节序写入和读取整数,浮点数.
+    - UBufferView 不拥有数据的只读片段,用来在不复制数据的情况下解析数据.
+    - UBufferChain 由多个片段组成的数据,可以导出为WSABUF/iovec数组,直接交给WSASend/writev发送.
 
     \author uni
     \date 2012-3-12
@@ -7,7 +12,14 @@
 #ifndef UNICORE_UBUFFER_H
 #define UNICORE_UBUFFER_H
 
+#include <string.h>
 #include <string>
+#include <type_traits>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/uio.h>
+#endif
 
 #define AUTO_LINK_LIB_NAME "UniCore"
 #include "AutoLink.h"
@@ -15,36 +27,183 @@
 namespace uni
 {
 
-//! 缓冲区简单抽象。
+//! 字节序.
+enum UByteOrder
+{
+    NativeByteOrder,    //!< 本机字节序.
+    LittleEndian,       //!< 小端,低位字节在前.
+    BigEndian           //!< 大端,高位字节在前,即网络字节序.
+};
+
+//! 本机字节序是否是小端.
+inline bool isLittleEndianHost()
+{
+    const unsigned short probe = 1;
+    return *reinterpret_cast<const unsigned char *>(&probe) == 1;
+}
+
+//! 在本机字节序和order之间转换value.
 /*!
-    
+    转换是对称的,写入前和读取后都用这个函数.T必须是整数或浮点数这样的简单类型.
+*/
+template<typename T>
+inline T convertByteOrder(T value,UByteOrder order)
+{
+    static_assert(std::tr1::is_arithmetic<T>::value,"只能转换整数和浮点数.");
+    if(order == NativeByteOrder || (order == LittleEndian) == isLittleEndianHost())
+    {
+        return value;
+    }
+    unsigned char bytes[sizeof(T)];
+    memcpy(bytes,&value,sizeof(T));
+    for(size_t i = 0; i < sizeof(T) / 2; i++)
+    {
+        const unsigned char temp = bytes[i];
+        bytes[i] = bytes[sizeof(T) - 1 - i];
+        bytes[sizeof(T) - 1 - i] = temp;
+    }
+    memcpy(&value,bytes,sizeof(T));
+    return value;
+}
+
+//! 不拥有数据的只读片段.
+/*!
+    只保存指针和长度,数据的生命周期由创建者保证.
+*/
+class UBufferView
+{
+public:
+    UBufferView():data_(0),size_(0) {}
+    UBufferView(const char *data,size_t size):data_(data),size_(size) {}
+    explicit UBufferView(const std::string &data):data_(data.data()),size_(data.size()) {}
+    const char *data() const {return data_;}
+    size_t size() const {return size_;}
+    bool empty() const {return !size_;}
+    //! 取子片段,超出范围的部分会被截掉.
+    UBufferView slice(size_t offset,size_t size = static_cast<size_t>(-1)) const
+    {
+        if(offset > size_)
+        {
+            offset = size_;
+        }
+        if(size > size_ - offset)
+        {
+            size = size_ - offset;
+        }
+        return UBufferView(data_ + offset,size);
+    }
+    //! 读取offset处的T,数据不够时返回false.
+    template<typename T>
+    bool read(size_t offset,T &value,UByteOrder order = NativeByteOrder) const
+    {
+        if(offset > size_ || size_ - offset < sizeof(T))
+        {
+            return false;
+        }
+        memcpy(&value,data_ + offset,sizeof(T));
+        value = convertByteOrder(value,order);
+        return true;
+    }
+    std::string toString() const {return std::string(data_,size_);}
+private:
+    const char *data_;
+    size_t size_;
+};
+
+//! 字节缓冲区.
+/*!
+    写入总是追加到末尾;读取从读位置开始,读取成功后读位置前进.
+    data()和size()返回的是全部数据,不受读位置影响.
 */
 class UBuffer
 {
 public:
-    UBuffer() {}
-    virtual ~UBuffer() {}
-    const char *data() const {return buf_.c_str();}
-    int size() const {return buf_.size();}
-    void appendChar(char data) {buf_.push_back(data);}
-    //! 保存short数据到缓冲区中.
-    void appendShort(short data)
+    //! 不超过这个大小的数据保存在对象内部.
+    enum {InlineCapacity = 64};
+
+    UBuffer()
+        :data_(inline_),capacity_(InlineCapacity),size_(0),readPosition_(0)
     {
-        buf_.append((char *)&data,sizeof(data));
+        inline_[0] = 0;
     }
-    //! 保存int数据到缓冲区中.
-    void appendInt(int data)
+    //! 预先分配capacity字节的空间.
+    explicit UBuffer(size_t capacity)
+        :data_(inline_),capacity_(InlineCapacity),size_(0),readPosition_(0)
+    {
+        inline_[0] = 0;
+        reserve(capacity);
+    }
+    UBuffer(const UBuffer &buffer);
+    UBuffer &operator=(const UBuffer &buffer);
+    virtual ~UBuffer()
+    {
+        if(data_ != inline_)
+        {
+            delete[] data_;
+        }
+    }
+    void swap(UBuffer &buffer);
+
+    //! 数据的起始地址.
+    /*!
+        和原来保存在std::string中时一样,数据后面总有一个0,不含0的文本可以直接当作C字符串使用.
+        只有prepare之后commit之前没有结尾的0.
+    */
+    const char *data() const {return data_;}
+    int size() const {return static_cast<int>(size_);}
+    size_t capacity() const {return capacity_;}
+    bool empty() const {return !size_;}
+    //! 清空数据和读位置,保留已分配的空间.
+    void clear() {size_ = 0; readPosition_ = 0; data_[0] = 0;}
+    //! 保证容量至少为capacity,不包括结尾的0.
+    void reserve(size_t capacity)
+    {
+        if(capacity > capacity_)
+        {
+            grow(capacity);
+        }
+    }
+
+    //! 在末尾预留size字节的可写空间并返回其地址.
+    /*!
+        数据写入后调用commit,例如直接recv到缓冲区中,不需要中间缓冲.
+        在commit之前再次修改缓冲区会使返回的指针失效.
+    */
+    char *prepare(size_t size)
     {
-        buf_.append((char *)&data,sizeof(data));
+        reserve(size_ + size);
+        return data_ + size_;
     }
+    //! 确认prepare之后写入了size字节.
+    void commit(size_t size);
+
+    void appendChar(char data) {append(data);}
+    //! 保存short数据到缓冲区中.
+    void appendShort(short data) {append(data);}
+    //! 保存int数据到缓冲区中.
+    void appendInt(int data) {append(data);}
     //! 追加string数据。
     /*!
         \param data 要添加到缓冲区的数据的起始地址,中间可以包含0.
         \param size 数据的长度.
     */
-    void appendString(const char *data, int size)
+    void appendString(const char *data, int size) {append(data,size);}
+    //! 追加size字节的数据.
+    void append(const char *data,size_t size)
+    {
+        memcpy(prepare(size),data,size);
+        size_ += size;
+        data_[size_] = 0;
+    }
+    void append(const UBufferView &view) {append(view.data(),view.size());}
+    //! 按字节序order追加T,T必须是整数或浮点数这样的简单类型.
+    template<typename T>
+    void append(T value,UByteOrder order = NativeByteOrder)
     {
-        buf_.append(data,size);
+        value = convertByteOrder(value,order);
+        memcpy(prepare(sizeof(T)),&value,sizeof(T));
+        size_ += sizeof(T);
+        data_[size_] = 0;
     }
     //! 从由16进制数字组成的字符串,追加16进制数据。
     /*!
@@ -57,10 +216,158 @@ public:
         遇到分隔符则把分隔符之前的16进制数字(无论是一个还是两个字符)保存到Buffer中.
     */
     void appendHexPattern(const std::string &pattern);
+
+    //! 读位置,即已经读过的字节数.
+    size_t readPosition() const {return readPosition_;}
+    //! 设置读位置,超过数据大小时返回false.
+    bool seek(size_t position)
+    {
+        if(position > size_)
+        {
+            return false;
+        }
+        readPosition_ = position;
+        return true;
+    }
+    //! 还没有读取的字节数.
+    size_t readableSize() const {return size_ - readPosition_;}
+    //! 按字节序order读取T,数据不够时返回false,读位置不变.
+    template<typename T>
+    bool read(T &value,UByteOrder order = NativeByteOrder)
+    {
+        if(!readableView().read(0,value,order))
+        {
+            return false;
+        }
+        readPosition_ += sizeof(T);
+        return true;
+    }
+    //! 读取size字节到data中.
+    bool read(char *data,size_t size)
+    {
+        if(readableSize() < size)
+        {
+            return false;
+        }
+        memcpy(data,data_ + readPosition_,size);
+        readPosition_ += size;
+        return true;
+    }
+    //! 不复制数据,把接下来的size字节作为片段返回.
+    /*!
+        片段在缓冲区下次被修改前有效.
+    */
+    bool read(size_t size,UBufferView &view)
+    {
+        if(readableSize() < size)
+        {
+            return false;
+        }
+        view = UBufferView(data_ + readPosition_,size);
+        readPosition_ += size;
+        return true;
+    }
+    //! 跳过size字节.
+    bool skip(size_t size)
+    {
+        if(readableSize() < size)
+        {
+            return false;
+        }
+        readPosition_ += size;
+        return true;
+    }
+    //! 丢弃已经读过的数据,剩余数据移动到开头.
+    void discardRead();
+
+    //! 全部数据的片段.
+    UBufferView view() const {return UBufferView(data_,size_);}
+    //! 还没有读取的数据的片段.
+    UBufferView readableView() const {return UBufferView(data_ + readPosition_,size_ - readPosition_);}
+private:
+    void grow(size_t capacity);
+
+    char *data_;            //!< 指向inline_或者堆上分配的空间,比capacity_多一个字节放结尾的0.
+    size_t capacity_;
+    size_t size_;
+    size_t readPosition_;
+    char inline_[InlineCapacity + 1];
+};
+
+//! 按UBuffer::appendHexPattern的规则解析16进制字符串.
+/*!
+    支持SSE2时一次分类16个字符,连续的16进制数字直接成块转换.
+    \param pattern 16进制字符串.
+    \param size pattern的长度.
+    \param[out] out 解析结果,至少要有(size + 1) / 2字节的空间.
+    \return 写入out的字节数.
+*/
+size_t decodeHexPattern(const char *pattern,size_t size,char *out);
+
+//! 把数据转换为16进制字符串,结果可以被appendHexPattern解析回原来的数据.
+/*!
+    \param data 要转换的数据.
+    \param groupSize 每组的字节数,组之间插入separator,小于等于0时不分组.
+    \param separator 组之间的分隔符,不能是16进制字符.
+    \param upperCase 是否使用大写字母.
+    \return 例如groupSize为2时,"\x0C\x0B\x25"转换为"0C0B 25".
+*/
+std::string toHexPattern(const UBufferView &data,int groupSize = 1,char separator = ' ',
+    bool upperCase = true);
+
+#ifdef _WIN32
+//! 和WSABUF的内存布局相同,可以直接转换为WSABUF *交给WSASend.
+struct UIoVec
+{
+    unsigned long len;
+    char *buf;
+};
+#else
+//! 即iovec,可以直接交给writev/sendmsg.
+typedef struct iovec UIoVec;
+#endif
+
+//! 由多个片段组成的数据.
+/*!
+    只保存片段,不复制数据.适合把包头和包体等分开构造的数据合在一起发送.
+*/
+class UBufferChain
+{
+public:
+    UBufferChain():size_(0) {}
+    //! 追加片段,空片段会被忽略.
+    void append(const UBufferView &segment)
+    {
+        if(!segment.empty())
+        {
+            segments_.push_back(segment);
+            size_ += segment.size();
+        }
+    }
+    //! 追加buffer中的全部数据,buffer在发送完成前不能被修改.
+    void append(const UBuffer &buffer) {append(buffer.view());}
+    size_t segmentCount() const {return segments_.size();}
+    const UBufferView &segment(size_t index) const {return segments_[index];}
+    //! 所有片段的总字节数.
+    size_t size() const {return size_;}
+    bool empty() const {return !size_;}
+    void clear() {segments_.clear(); size_ = 0;}
+    //! 导出片段到vectors中.
+    /*!
+        \param vectors 导出的目标.
+        \param count vectors的元素个数,片段更多时只导出前count个.
+        \return 导出的片段数.
+    */
+    size_t exportTo(UIoVec *vectors,size_t count) const;
+    //! 丢弃开头的size字节,用于部分发送之后继续发送剩余的数据.
+    void consume(size_t size);
+    //! 把所有片段复制到buffer的末尾.
+    void copyTo(UBuffer &buffer) const;
 private:
-    std::string buf_;
+    std::vector<UBufferView> segments_;
+    size_t size_;
 };
 
 }//namespace uni
 
-#endif//UNICORE_UBUFFER_H
\ No newline at end of file
+#endif//UNICORE_UBUFFER_H
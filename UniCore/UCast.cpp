@@ -1,52 +1,226 @@
 ﻿#include "UCast.h"
 
+#include <algorithm>
 #include <array>
 #include <assert.h>
 #include <errno.h>
+#include <limits>
+#include <limits.h>
+#include <map>
+#include <math.h>
 #include <sstream>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
 
+#ifdef _WIN32
 #define WIN32_LEAN_AND_MEAN
 #include "Windows.h"
 
 #include "UDebug.h"
+#else
+#include <langinfo.h>
+#include <locale.h>
+#endif
+
+#include "ULock.h"
+#include "UTranscode.h"
 
 using namespace std;
 
 namespace uni
 {
 
+namespace
+{
+    //! 只转换到第一个0为止,和CRT的转换函数一致.
+    template<typename Char>
+    size_t lengthUntilZero(const std::basic_string<Char> &s)
+    {
+        return std::char_traits<Char>::length(s.c_str());
+    }
+
+    //! 全部是ASCII字符时直接转换,不需要locale.
+    bool tryNarrowAscii(const wstring &ws,size_t size,string &result)
+    {
+        if(asciiPrefixLength(ws.data(),size) != size)
+        {
+            return false;
+        }
+        result.resize(size);
+        if(size)
+        {
+            narrowAscii(ws.data(),size,&result[0]);
+        }
+        return true;
+    }
+
+    bool tryWidenAscii(const string &s,size_t size,wstring &result)
+    {
+        if(asciiPrefixLength(s.data(),size) != size)
+        {
+            return false;
+        }
+        result.resize(size);
+        if(size)
+        {
+            widenAscii(s.data(),size,&result[0]);
+        }
+        return true;
+    }
+
+#ifdef _WIN32
+    typedef _locale_t LocaleHandle;
+
+    LocaleHandle createLocale(const char *name)
+    {
+        return _create_locale(LC_CTYPE,name);
+    }
+#else
+    typedef locale_t LocaleHandle;
+
+    LocaleHandle createLocale(const char *name)
+    {
+        return newlocale(LC_CTYPE_MASK,name,static_cast<locale_t>(0));
+    }
+#endif
+
+    //! 按名字缓存的locale,创建失败的名字也会被缓存.缓存的locale在进程结束前不会释放.
+    /*!
+        锁和指针都是静态初始化的,在其它全局对象的构造函数中使用也是安全的.
+    */
+    URWLock g_localeCacheLock;
+    std::map<std::string,LocaleHandle> *g_localeCache = 0;
+
+    LocaleHandle cachedLocale(const char *name)
+    {
+        {
+            UScopedReadLock<URWLock> lock(g_localeCacheLock);
+            if(g_localeCache)
+            {
+                std::map<std::string,LocaleHandle>::const_iterator it = g_localeCache->find(name);
+                if(it != g_localeCache->end())
+                {
+                    return it->second;
+                }
+            }
+        }
+        UScopedWriteLock<URWLock> lock(g_localeCacheLock);
+        if(!g_localeCache)
+        {
+            g_localeCache = new std::map<std::string,LocaleHandle>;
+        }
+        std::map<std::string,LocaleHandle>::iterator it = g_localeCache->find(name);
+        if(it == g_localeCache->end())
+        {
+            it = g_localeCache->insert(std::make_pair(std::string(name),createLocale(name))).first;
+        }
+        return it->second;
+    }
+
+#ifdef _WIN32
+    //! 代码页的信息.
+    struct CodePageInfo
+    {
+        bool valid;             //!< 是否是有效的代码页.
+        bool asciiCompatible;   //!< ASCII字符是否保持不变,是的话纯ASCII字符串可以直接转换.
+    };
+
+    CodePageInfo queryCodePage(int codepage)
+    {
+        char ascii[128];
+        wchar_t converted[128];
+        for(int i = 0; i < 128; i++)
+        {
+            ascii[i] = static_cast<char>(i);
+        }
+        CodePageInfo info = {false,false};
+        const int size = MultiByteToWideChar(codepage,0,ascii,128,converted,128);
+        info.valid = size != 0;
+        info.asciiCompatible = size == 128;
+        for(int i = 0; i < size && info.asciiCompatible; i++)
+        {
+            info.asciiCompatible = converted[i] == i;
+        }
+        return info;
+    }
+
+    URWLock g_codePageCacheLock;
+    std::map<int,CodePageInfo> *g_codePageCache = 0;
+
+    CodePageInfo codePageInfo(int codepage)
+    {
+        //CP_THREAD_ACP随线程的locale变化,不能缓存.
+        if(codepage == CP_THREAD_ACP)
+        {
+            return queryCodePage(codepage);
+        }
+        {
+            UScopedReadLock<URWLock> lock(g_codePageCacheLock);
+            if(g_codePageCache)
+            {
+                std::map<int,CodePageInfo>::const_iterator it = g_codePageCache->find(codepage);
+                if(it != g_codePageCache->end())
+                {
+                    return it->second;
+                }
+            }
+        }
+        const CodePageInfo info = queryCodePage(codepage);
+        UScopedWriteLock<URWLock> lock(g_codePageCacheLock);
+        if(!g_codePageCache)
+        {
+            g_codePageCache = new std::map<int,CodePageInfo>;
+        }
+        (*g_codePageCache)[codepage] = info;
+        return info;
+    }
+#else
+    const int Utf8CodePage = 65001;
+
+    bool isUtf8Locale(LocaleHandle locale)
+    {
+        const char *codeset = nl_langinfo_l(CODESET,locale);
+        return codeset && (strcmp(codeset,"UTF-8") == 0 || strcmp(codeset,"utf8") == 0);
+    }
+#endif
+}
+
 string ws2s(const wstring &ws,const char *locale /*= ""*/)
 {
+#ifdef _WIN32
+    return ws2s(ws,cachedLocale(locale));
+#else
     string result;
-    _locale_t loc = _create_locale(LC_CTYPE,locale);
+    LocaleHandle loc = cachedLocale(locale);
     if(!loc)
     {
         return result;
     }
-    const size_t len = ws.size()*4+1;
-    char *dest = new char[len];
-    size_t numOfCharConverted = 0;
-
-    errno_t err = _wcstombs_s_l(&numOfCharConverted,dest,len,ws.c_str(),_TRUNCATE,loc);
-    _free_locale(loc);
-    if(err == 0)
+    const size_t size = lengthUntilZero(ws);
+    if(tryNarrowAscii(ws,size,result))
     {
-        result = dest;
+        return result;
     }
-    else if(err == STRUNCATE)
+    if(isUtf8Locale(loc))
     {
-        OutputDebugStringA("UniCore ws2s 目标缓冲区不足，字符串被截断。");
-        result = dest;
+        return wideToUtf8(UWStringView(ws.data(),size));
     }
-    else
+    locale_t oldLocale = uselocale(loc);
+    const size_t required = wcstombs(0,ws.c_str(),0);
+    if(required != static_cast<size_t>(-1))
     {
-        OutputDebugStringA("UniCore ws2s 转换Unicode字符串到MBCS字符串时失败。");
+        result.resize(required + 1);
+        wcstombs(&result[0],ws.c_str(),required + 1);
+        result.resize(required);
     }
-    delete []dest;
+    uselocale(oldLocale);
     return result;
+#endif
 }
 
+#ifdef _WIN32
 string ws2s(const wstring &ws,_locale_t locale)
 {
     string result;
@@ -55,28 +229,35 @@ string ws2s(const wstring &ws,_locale_t locale)
     {
         return result;
     }
+    const size_t size = lengthUntilZero(ws);
+    if(tryNarrowAscii(ws,size,result))
+    {
+        return result;
+    }
 
-    const size_t len = ws.size()*4+1;
-    char *dest = new char[len];
-    size_t numOfCharConverted = 0; 
-
-    errno_t err = _wcstombs_s_l(&numOfCharConverted,dest,len,ws.c_str(),_TRUNCATE,locale);
-    if(err == 0)
+    //先计算需要的大小,再直接转换到result中.
+    size_t required = 0;
+    errno_t err = _wcstombs_s_l(&required,0,0,ws.c_str(),0,locale);
+    if(err != 0 || required == 0)
     {
-        result = dest;
+        OutputDebugStringA("UniCore ws2s 转换Unicode字符串到MBCS字符串时失败。");
+        return result;
     }
-    else if(err == STRUNCATE)
+    result.resize(required);
+    size_t numOfCharConverted = 0;
+    err = _wcstombs_s_l(&numOfCharConverted,&result[0],required,ws.c_str(),_TRUNCATE,locale);
+    if(err == 0 || err == STRUNCATE)
     {
-        OutputDebugStringA("UniCore ws2s 目标缓冲区不足，字符串被截断。");
-        result = dest;
+        result.resize(numOfCharConverted ? numOfCharConverted - 1 : 0);
     }
     else
     {
         OutputDebugStringA("UniCore ws2s 转换Unicode字符串到MBCS字符串时失败。");
+        result.clear();
     }
-    delete []dest;
     return result;
 }
+#endif
 
 std::string ws2s( const std::wstring &ws,int codepage )
 {
@@ -85,62 +266,70 @@ std::string ws2s( const std::wstring &ws,int codepage )
     {
         return result;
     }
+#ifdef _WIN32
+    if(codepage == CP_UTF8)
+    {
+        return wideToUtf8(ws);
+    }
+    if(codePageInfo(codepage).asciiCompatible && tryNarrowAscii(ws,ws.size(),result))
+    {
+        return result;
+    }
     int requiredSize = WideCharToMultiByte(codepage,0,ws.c_str(),ws.size(),0,0,0,0);
     if(requiredSize == 0)
     {
         DebugMessage("UniCore ws2s 转换字符串时发生错误.Last Error:%d",GetLastError());
         return result;
     }
-    char *dest = new char[requiredSize];
-    int numWritten = WideCharToMultiByte(codepage,0,ws.c_str(),ws.size(),dest,requiredSize,0,0);
+    result.resize(requiredSize);
+    int numWritten = WideCharToMultiByte(codepage,0,ws.c_str(),ws.size(),&result[0],requiredSize,0,0);
     if(numWritten == 0)
     {
-        delete []dest;
         DebugMessage("UniCore ws2s 转换字符串时发生错误.Last Error:%d",GetLastError());
-        return result;
+        result.clear();
     }
-
-    result.assign(dest,requiredSize);  //dest中保存的字符串不是以0结尾.
-    delete []dest;
-
     return result;
+#else
+    return codepage == Utf8CodePage ? wideToUtf8(ws) : result;
+#endif
 }
 
 wstring s2ws(const string &s,const char *locale /*= ""*/)
 {
 	assert(locale);
 
+#ifdef _WIN32
+    return s2ws(s,cachedLocale(locale));
+#else
     wstring result;
-
-    _locale_t loc = _create_locale(LC_CTYPE,locale);  //使用指定的locale。
-	//如果_create_locale返回空,返回空字符串。
+    LocaleHandle loc = cachedLocale(locale);
     if(!loc)
     {
         return result;
     }
-
-	const size_t len = s.size()+1;
-	wchar_t *dest = new wchar_t[len];
-	size_t numOfCharConverted = 0;
-    errno_t err = _mbstowcs_s_l(&numOfCharConverted,dest,len,s.c_str(),_TRUNCATE,loc);
-    _free_locale(loc);
-    if(err == 0)
+    const size_t size = lengthUntilZero(s);
+    if(tryWidenAscii(s,size,result))
     {
-        result = dest;
+        return result;
     }
-    else if(err == STRUNCATE)
+    if(isUtf8Locale(loc))
     {
-		assert(!"dest buffer should be adequate");
-        result = dest;
+        return utf8ToWide(UStringView(s.data(),size));
     }
-    else
+    locale_t oldLocale = uselocale(loc);
+    const size_t required = mbstowcs(0,s.c_str(),0);
+    if(required != static_cast<size_t>(-1))
     {
-		//转换失败。
+        result.resize(required + 1);
+        mbstowcs(&result[0],s.c_str(),required + 1);
+        result.resize(required);
     }
-    delete []dest;
+    uselocale(oldLocale);
     return result;
+#endif
 }
 
+#ifdef _WIN32
 wstring s2ws(const string &s,_locale_t locale)
 {
     wstring result;
@@ -148,78 +337,861 @@ wstring s2ws(const string &s,_locale_t locale)
     {
         return result;
     }
-    const size_t len = s.size()+1;
-    wchar_t *dest = new wchar_t[len];
-    size_t numOfCharConverted = 0;
-
-    errno_t err = _mbstowcs_s_l(&numOfCharConverted,dest,len,s.c_str(),_TRUNCATE,locale);
-
-    if(err == 0)
+    const size_t size = lengthUntilZero(s);
+    if(tryWidenAscii(s,size,result))
     {
-        result = dest;
+        return result;
     }
-    else if(err == STRUNCATE)
+
+    //MBCS字符串转换后的字符数不会超过字节数.
+    result.resize(size + 1);
+    size_t numOfCharConverted = 0;
+    errno_t err = _mbstowcs_s_l(&numOfCharConverted,&result[0],size + 1,s.c_str(),_TRUNCATE,locale);
+    if(err == 0 || err == STRUNCATE)
     {
-        OutputDebugStringA("UniCore s2ws 目标缓冲区不足，字符串被截断。");
-        result = dest;
+        result.resize(numOfCharConverted ? numOfCharConverted - 1 : 0);
     }
     else
     {
         OutputDebugStringA("UniCore s2ws 转换MBCS字符串到Unicode字符串时失败。");
+        result.clear();
     }
-    delete []dest;
     return result;
 }
+#endif
 
 std::wstring s2ws( const std::string &s,int codepage )
 {
     wstring result;
-
+#ifdef _WIN32
+    if(codepage == CP_UTF8)
+    {
+        return utf8ToWide(s);
+    }
+    const CodePageInfo info = codePageInfo(codepage);
+    if(!info.valid)
+    {
+        DebugMessage("UniCore s2ws 无效的代码页:%d",codepage);
+        return result;
+    }
+    if(info.asciiCompatible && tryWidenAscii(s,s.size(),result))
+    {
+        return result;
+    }
     int requiredSize = MultiByteToWideChar(codepage,0,s.c_str(),s.size(),0,0);
     if(requiredSize == 0)
     {
         DebugMessage("UniCore s2ws 转换字符串时发生错误.Last Error:%d",GetLastError());
         return result;
     }
-    wchar_t *dest = new wchar_t[requiredSize];
-    int numWritten = MultiByteToWideChar(codepage,0,s.c_str(),s.size(),dest,requiredSize);
+    result.resize(requiredSize);
+    int numWritten = MultiByteToWideChar(codepage,0,s.c_str(),s.size(),&result[0],requiredSize);
     if(numWritten == 0)
     {
-        delete []dest;
         DebugMessage("UniCore s2ws 转换字符串时发生错误.Last Error:%d",GetLastError());
-        return result;
+        result.clear();
     }
+    return result;
+#else
+    return codepage == Utf8CodePage ? utf8ToWide(s) : result;
+#endif
+}
 
-    result.assign(dest,requiredSize);  //dest中保存的字符串不是以0结尾.
-    delete []dest;
+namespace
+{
+    const char g_digitPairs[] =
+        "00010203040506070809"
+        "10111213141516171819"
+        "20212223242526272829"
+        "30313233343536373839"
+        "40414243444546474849"
+        "50515253545556575859"
+        "60616263646566676869"
+        "70717273747576777879"
+        "80818283848586878889"
+        "90919293949596979899";
 
-    return result;
+    template<typename Char>
+    void writeDigitPair(unsigned int pair,Char *buffer)
+    {
+        buffer[0] = g_digitPairs[pair * 2];
+        buffer[1] = g_digitPairs[pair * 2 + 1];
+    }
+
+    int countDigits(unsigned long long value)
+    {
+        int count = 1;
+        for(;;)
+        {
+            if(value < 10) return count;
+            if(value < 100) return count + 1;
+            if(value < 1000) return count + 2;
+            if(value < 10000) return count + 3;
+            value /= 10000;
+            count += 4;
+        }
+    }
+
+    //! 从end往前写入value的各位数字.
+    /*!
+        大于32位的部分每次用64位除法取出8位,其余用32位除法,32位程序中64位除法是函数调用.
+    */
+    template<typename Char>
+    void writeDigitsBackward(unsigned long long value,Char *end)
+    {
+        while(value > 0xFFFFFFFFULL)
+        {
+            unsigned int low = static_cast<unsigned int>(value % 100000000);
+            value /= 100000000;
+            for(int i = 0; i < 4; i++)
+            {
+                end -= 2;
+                writeDigitPair(low % 100,end);
+                low /= 100;
+            }
+        }
+        unsigned int rest = static_cast<unsigned int>(value);
+        while(rest >= 100)
+        {
+            end -= 2;
+            writeDigitPair(rest % 100,end);
+            rest /= 100;
+        }
+        if(rest >= 10)
+        {
+            writeDigitPair(rest,end - 2);
+        }
+        else
+        {
+            end[-1] = static_cast<Char>('0' + rest);
+        }
+    }
+
+    template<typename Char>
+    size_t formatUnsigned(unsigned long long value,Char *buffer)
+    {
+        const int count = countDigits(value);
+        writeDigitsBackward(value,buffer + count);
+        return count;
+    }
+
+    template<typename Char>
+    size_t formatSigned(long long value,Char *buffer)
+    {
+        if(value >= 0)
+        {
+            return formatUnsigned(static_cast<unsigned long long>(value),buffer);
+        }
+        //-LLONG_MIN会溢出,在无符号数上取反.
+        buffer[0] = '-';
+        return 1 + formatUnsigned(0 - static_cast<unsigned long long>(value),buffer + 1);
+    }
+
+    //! Grisu2使用的浮点数,值为f * 2^e.
+    struct DiyFp
+    {
+        DiyFp():f(0),e(0) {}
+        DiyFp(unsigned long long f,int e):f(f),e(e) {}
+
+        //! 乘积的高64位,四舍五入.
+        DiyFp operator*(const DiyFp &rhs) const
+        {
+            const unsigned long long mask = 0xFFFFFFFFULL;
+            const unsigned long long a = f >> 32,b = f & mask,c = rhs.f >> 32,d = rhs.f & mask;
+            const unsigned long long ac = a * c,bc = b * c,ad = a * d,bd = b * d;
+            unsigned long long middle = (bd >> 32) + (ad & mask) + (bc & mask);
+            middle += 1ULL << 31;
+            return DiyFp(ac + (ad >> 32) + (bc >> 32) + (middle >> 32),e + rhs.e + 64);
+        }
+
+        DiyFp normalized() const
+        {
+            DiyFp result = *this;
+            while(!(result.f & (1ULL << 63)))
+            {
+                result.f <<= 1;
+                result.e--;
+            }
+            return result;
+        }
+
+        unsigned long long f;
+        int e;
+    };
+
+    const int DoubleSignificandSize = 52;
+    const int DoubleExponentBias = 0x3FF + DoubleSignificandSize;
+    const unsigned long long DoubleHiddenBit = 1ULL << DoubleSignificandSize;
+
+    //! 10^-348,10^-340,...,10^340,规格化为64位的尾数和二进制指数.
+    const unsigned long long g_cachedPowersF[] =
+    {
+        0xfa8fd5a0081c0288ULL,0xbaaee17fa23ebf76ULL,0x8b16fb203055ac76ULL,0xcf42894a5dce35eaULL,
+        0x9a6bb0aa55653b2dULL,0xe61acf033d1a45dfULL,0xab70fe17c79ac6caULL,0xff77b1fcbebcdc4fULL,
+        0xbe5691ef416bd60cULL,0x8dd01fad907ffc3cULL,0xd3515c2831559a83ULL,0x9d71ac8fada6c9b5ULL,
+        0xea9c227723ee8bcbULL,0xaecc49914078536dULL,0x823c12795db6ce57ULL,0xc21094364dfb5637ULL,
+        0x9096ea6f3848984fULL,0xd77485cb25823ac7ULL,0xa086cfcd97bf97f4ULL,0xef340a98172aace5ULL,
+        0xb23867fb2a35b28eULL,0x84c8d4dfd2c63f3bULL,0xc5dd44271ad3cdbaULL,0x936b9fcebb25c996ULL,
+        0xdbac6c247d62a584ULL,0xa3ab66580d5fdaf6ULL,0xf3e2f893dec3f126ULL,0xb5b5ada8aaff80b8ULL,
+        0x87625f056c7c4a8bULL,0xc9bcff6034c13053ULL,0x964e858c91ba2655ULL,0xdff9772470297ebdULL,
+        0xa6dfbd9fb8e5b88fULL,0xf8a95fcf88747d94ULL,0xb94470938fa89bcfULL,0x8a08f0f8bf0f156bULL,
+        0xcdb02555653131b6ULL,0x993fe2c6d07b7facULL,0xe45c10c42a2b3b06ULL,0xaa242499697392d3ULL,
+        0xfd87b5f28300ca0eULL,0xbce5086492111aebULL,0x8cbccc096f5088ccULL,0xd1b71758e219652cULL,
+        0x9c40000000000000ULL,0xe8d4a51000000000ULL,0xad78ebc5ac620000ULL,0x813f3978f8940984ULL,
+        0xc097ce7bc90715b3ULL,0x8f7e32ce7bea5c70ULL,0xd5d238a4abe98068ULL,0x9f4f2726179a2245ULL,
+        0xed63a231d4c4fb27ULL,0xb0de65388cc8ada8ULL,0x83c7088e1aab65dbULL,0xc45d1df942711d9aULL,
+        0x924d692ca61be758ULL,0xda01ee641a708deaULL,0xa26da3999aef774aULL,0xf209787bb47d6b85ULL,
+        0xb454e4a179dd1877ULL,0x865b86925b9bc5c2ULL,0xc83553c5c8965d3dULL,0x952ab45cfa97a0b3ULL,
+        0xde469fbd99a05fe3ULL,0xa59bc234db398c25ULL,0xf6c69a72a3989f5cULL,0xb7dcbf5354e9beceULL,
+        0x88fcf317f22241e2ULL,0xcc20ce9bd35c78a5ULL,0x98165af37b2153dfULL,0xe2a0b5dc971f303aULL,
+        0xa8d9d1535ce3b396ULL,0xfb9b7cd9a4a7443cULL,0xbb764c4ca7a44410ULL,0x8bab8eefb6409c1aULL,
+        0xd01fef10a657842cULL,0x9b10a4e5e9913129ULL,0xe7109bfba19c0c9dULL,0xac2820d9623bf429ULL,
+        0x80444b5e7aa7cf85ULL,0xbf21e44003acdd2dULL,0x8e679c2f5e44ff8fULL,0xd433179d9c8cb841ULL,
+        0x9e19db92b4e31ba9ULL,0xeb96bf6ebadf77d9ULL,0xaf87023b9bf0ee6bULL,
+    };
+
+    const short g_cachedPowersE[] =
+    {
+        -1220,-1193,-1166,-1140,-1113,-1087,-1060,-1034,-1007,-980,-954,-927,-901,-874,-847,-821,
+        -794,-768,-741,-715,-688,-661,-635,-608,-582,-555,-529,-502,-475,-449,-422,-396,
+        -369,-343,-316,-289,-263,-236,-210,-183,-157,-130,-103,-77,-50,-24,3,30,
+        56,83,109,136,162,189,216,242,269,295,322,348,375,402,428,455,
+        481,508,534,561,588,614,641,667,694,720,747,774,800,827,853,880,
+        907,933,960,986,1013,1039,1066,
+    };
+
+    //! 找到10^-k,使value * 10^-k的二进制指数在[-60,-32]之间.
+    DiyFp cachedPower(int e,int &k)
+    {
+        //log10(2) = 0.30102999566398114.
+        const double dk = (-61 - e) * 0.30102999566398114 + 347;
+        int index = static_cast<int>(dk);
+        if(dk - index > 0.0)
+        {
+            index++;
+        }
+        index = (index >> 3) + 1;
+        k = -(-348 + index * 8);
+        return DiyFp(g_cachedPowersF[index],g_cachedPowersE[index]);
+    }
+
+    const unsigned long long g_powersOf10[] =
+    {
+        1ULL,10ULL,100ULL,1000ULL,10000ULL,100000ULL,1000000ULL,10000000ULL,100000000ULL,
+        1000000000ULL,10000000000ULL,100000000000ULL,1000000000000ULL,10000000000000ULL,
+        100000000000000ULL,1000000000000000ULL,10000000000000000ULL,100000000000000000ULL,
+        1000000000000000000ULL,10000000000000000000ULL
+    };
+
+    //! 在允许的范围内把最后一位调整到离真实值最近.
+    void grisuRound(char *buffer,int length,unsigned long long delta,unsigned long long rest,
+        unsigned long long tenKappa,unsigned long long distance)
+    {
+        while(rest < distance && delta - rest >= tenKappa
+            && (rest + tenKappa < distance || distance - rest > rest + tenKappa - distance))
+        {
+            buffer[length - 1]--;
+            rest += tenKappa;
+        }
+    }
+
+    //! 生成[low,high]区间中位数最少的数字串,high - delta为区间的下界.
+    void generateDigits(const DiyFp &w,const DiyFp &high,unsigned long long delta,char *buffer,int &length,int &k)
+    {
+        const DiyFp one(1ULL << -high.e,high.e);
+        const unsigned long long distance = high.f - w.f;
+        unsigned int integral = static_cast<unsigned int>(high.f >> -one.e);
+        unsigned long long fraction = high.f & (one.f - 1);
+        int kappa = countDigits(integral);
+        length = 0;
+        while(kappa > 0)
+        {
+            const unsigned int power = static_cast<unsigned int>(g_powersOf10[kappa - 1]);
+            const unsigned int digit = integral / power;
+            integral %= power;
+            if(digit || length)
+            {
+                buffer[length++] = static_cast<char>('0' + digit);
+            }
+            kappa--;
+            const unsigned long long rest = (static_cast<unsigned long long>(integral) << -one.e) + fraction;
+            if(rest <= delta)
+            {
+                k += kappa;
+                grisuRound(buffer,length,delta,rest,g_powersOf10[kappa] << -one.e,distance);
+                return;
+            }
+        }
+        for(;;)
+        {
+            fraction *= 10;
+            delta *= 10;
+            const char digit = static_cast<char>(fraction >> -one.e);
+            if(digit || length)
+            {
+                buffer[length++] = static_cast<char>('0' + digit);
+            }
+            fraction &= one.f - 1;
+            kappa--;
+            if(fraction < delta)
+            {
+                k += kappa;
+                const int index = -kappa;
+                grisuRound(buffer,length,delta,fraction,one.f,distance * (index < 20 ? g_powersOf10[index] : 0));
+                return;
+            }
+        }
+    }
+
+    //! 生成有限正数value的最短数字串,value = buffer * 10^k.
+    void grisu2(double value,char *buffer,int &length,int &k)
+    {
+        unsigned long long bits;
+        memcpy(&bits,&value,sizeof(bits));
+        const int biasedExponent = static_cast<int>(bits >> DoubleSignificandSize);
+        const unsigned long long significand = bits & (DoubleHiddenBit - 1);
+        const DiyFp v = biasedExponent
+            ? DiyFp(significand + DoubleHiddenBit,biasedExponent - DoubleExponentBias)
+            : DiyFp(significand,1 - DoubleExponentBias);
+
+        //value与相邻浮点数的中点,中点之间的数都会被解析为value.
+        DiyFp upper((v.f << 1) + 1,v.e - 1);
+        while(!(upper.f & (DoubleHiddenBit << 1)))
+        {
+            upper.f <<= 1;
+            upper.e--;
+        }
+        upper.f <<= 64 - DoubleSignificandSize - 2;
+        upper.e -= 64 - DoubleSignificandSize - 2;
+        DiyFp lower = v.f == DoubleHiddenBit ? DiyFp((v.f << 2) - 1,v.e - 2) : DiyFp((v.f << 1) - 1,v.e - 1);
+        lower.f <<= lower.e - upper.e;
+        lower.e = upper.e;
+
+        const DiyFp power = cachedPower(upper.e,k);
+        const DiyFp w = v.normalized() * power;
+        DiyFp high = upper * power;
+        DiyFp low = lower * power;
+        //乘法有误差,区间两端各缩小1.
+        low.f++;
+        high.f--;
+        generateDigits(w,high,high.f - low.f,buffer,length,k);
+    }
+
+    template<typename Char>
+    size_t writeExponent(int exponent,Char *buffer)
+    {
+        Char *p = buffer;
+        *p++ = exponent < 0 ? '-' : '+';
+        return 1 + formatUnsigned(static_cast<unsigned long long>(exponent < 0 ? -exponent : exponent),p);
+    }
+
+    //! 把数字串digits * 10^k按format_double的格式写入buffer.
+    template<typename Char>
+    size_t layoutDigits(const char *digits,int length,int k,Char *buffer)
+    {
+        //10^(point - 1) <= value < 10^point.
+        const int point = length + k;
+        Char *p = buffer;
+        if(k >= 0 && point <= 21)
+        {
+            //1234e7 -> 12340000000
+            p = std::copy(digits,digits + length,p);
+            p = std::fill_n(p,k,Char('0'));
+        }
+        else if(point > 0 && point <= 21)
+        {
+            //1234e-2 -> 12.34
+            p = std::copy(digits,digits + point,p);
+            *p++ = '.';
+            p = std::copy(digits + point,digits + length,p);
+        }
+        else if(point > -6 && point <= 0)
+        {
+            //1234e-6 -> 0.001234
+            *p++ = '0';
+            *p++ = '.';
+            p = std::fill_n(p,-point,Char('0'));
+            p = std::copy(digits,digits + length,p);
+        }
+        else
+        {
+            //1234e30 -> 1.234e+33
+            *p++ = digits[0];
+            if(length > 1)
+            {
+                *p++ = '.';
+                p = std::copy(digits + 1,digits + length,p);
+            }
+            *p++ = 'e';
+            p += writeExponent(point - 1,p);
+        }
+        return p - buffer;
+    }
+
+    template<typename Char>
+    size_t writeAscii(const char *s,Char *buffer)
+    {
+        size_t size = strlen(s);
+        std::copy(s,s + size,buffer);
+        return size;
+    }
+
+    template<typename Char>
+    size_t formatDouble(double value,Char *buffer)
+    {
+        unsigned long long bits;
+        memcpy(&bits,&value,sizeof(bits));
+        const bool negative = (bits >> 63) != 0;
+        Char *p = buffer;
+        if(negative)
+        {
+            *p++ = '-';
+            bits &= ~(1ULL << 63);
+        }
+        const unsigned long long exponentMask = 0x7FFULL << DoubleSignificandSize;
+        if((bits & exponentMask) == exponentMask)
+        {
+            if(bits & (DoubleHiddenBit - 1))
+            {
+                return writeAscii("nan",buffer);
+            }
+            return (p - buffer) + writeAscii("inf",p);
+        }
+        if(bits == 0)
+        {
+            *p++ = '0';
+            return p - buffer;
+        }
+        double magnitude;
+        memcpy(&magnitude,&bits,sizeof(bits));
+        char digits[18];
+        int length = 0;
+        int k = 0;
+        grisu2(magnitude,digits,length,k);
+        return (p - buffer) + layoutDigits(digits,length,k,p);
+    }
+
+    template<typename Char>
+    bool isDigit(Char c)
+    {
+        return static_cast<unsigned int>(c - '0') <= 9;
+    }
+
+    template<typename Char>
+    bool isSpace(Char c)
+    {
+        return c == ' ' || static_cast<unsigned int>(c - '\t') <= '\r' - '\t';
+    }
+
+    template<typename Char>
+    const Char *skipSpaces(const Char *p,const Char *end)
+    {
+        while(p != end && isSpace(*p))
+        {
+            p++;
+        }
+        return p;
+    }
+
+    //! 8个字节是否都是数字,第一个字符在最低字节.
+    bool isEightDigits(unsigned long long chunk)
+    {
+        return ((chunk & 0xF0F0F0F0F0F0F0F0ULL)
+            | (((chunk + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) >> 4)) == 0x3333333333333333ULL;
+    }
+
+    //! 把8个数字字符转换为整数,不需要逐位乘10.
+    unsigned int parseEightDigits(unsigned long long chunk)
+    {
+        chunk = ((chunk & 0x0F0F0F0F0F0F0F0FULL) * 2561) >> 8;
+        chunk = ((chunk & 0x00FF00FF00FF00FFULL) * 6553601) >> 16;
+        return static_cast<unsigned int>(((chunk & 0x0000FFFF0000FFFFULL) * 42949672960001ULL) >> 32);
+    }
+
+    bool isLittleEndian()
+    {
+        const unsigned short probe = 1;
+        return *reinterpret_cast<const unsigned char *>(&probe) == 1;
+    }
+
+    //! 一次取出8个数字,只用于char,且要求小端字节序.
+    bool tryEightDigits(const char *p,const char *end,unsigned long long &value)
+    {
+        if(end - p < 8 || !isLittleEndian())
+        {
+            return false;
+        }
+        unsigned long long chunk;
+        memcpy(&chunk,p,sizeof(chunk));
+        if(!isEightDigits(chunk))
+        {
+            return false;
+        }
+        value = value * 100000000 + parseEightDigits(chunk);
+        return true;
+    }
+
+    bool tryEightDigits(const wchar_t *,const wchar_t *,unsigned long long &)
+    {
+        return false;
+    }
+
+    //! 解析连续的数字,结果超过limit时返回false,数字仍会全部跳过.
+    template<typename Char>
+    bool parseDigits(const Char *&p,const Char *end,unsigned long long limit,unsigned long long &value)
+    {
+        value = 0;
+        //前19位数字不会超出64位,不需要检查溢出.
+        const Char *uncheckedEnd = p + (std::min)(end - p,static_cast<ptrdiff_t>(19));
+        while(tryEightDigits(p,uncheckedEnd,value))
+        {
+            p += 8;
+        }
+        while(p != uncheckedEnd && isDigit(*p))
+        {
+            value = value * 10 + (*p++ - '0');
+        }
+        bool inRange = value <= limit;
+        for(; p != end && isDigit(*p); p++)
+        {
+            const unsigned int digit = *p - '0';
+            if(inRange && (digit > limit || value > (limit - digit) / 10))
+            {
+                inRange = false;
+            }
+            value = value * 10 + digit;
+        }
+        return inRange;
+    }
+
+    //! 解析结束后检查剩余的字符.
+    template<typename Char>
+    UParseStatus finishParse(const Char *begin,const Char *p,const Char *end,size_t *parsed,UParseStatus status)
+    {
+        if(parsed)
+        {
+            *parsed = p - begin;
+        }
+        else if(skipSpaces(p,end) != end)
+        {
+            return ParseInvalid;
+        }
+        return status;
+    }
+
+    template<typename Char,typename Integer>
+    UParseStatus parseInteger(UBasicStringView<Char> text,Integer &value,size_t *parsed,
+        unsigned long long maxValue,unsigned long long minMagnitude)
+    {
+        const Char *begin = text.data();
+        const Char *end = begin + text.size();
+        const Char *p = skipSpaces(begin,end);
+        bool negative = false;
+        if(p != end && (*p == '+' || *p == '-'))
+        {
+            negative = *p++ == '-';
+        }
+        value = 0;
+        if(p == end || !isDigit(*p))
+        {
+            if(parsed)
+            {
+                *parsed = 0;
+            }
+            return ParseInvalid;
+        }
+        //无符号数的minMagnitude为0,只接受-0.
+        const unsigned long long limit = negative ? minMagnitude : maxValue;
+        unsigned long long magnitude;
+        UParseStatus status = ParseOk;
+        if(!parseDigits(p,end,limit,magnitude))
+        {
+            magnitude = limit;
+            status = ParseOutOfRange;
+        }
+        value = negative ? static_cast<Integer>(0 - magnitude) : static_cast<Integer>(magnitude);
+        return finishParse(begin,p,end,parsed,status);
+    }
+
+    const double g_exactPowersOf10[] =
+    {
+        1e0,1e1,1e2,1e3,1e4,1e5,1e6,1e7,1e8,1e9,1e10,1e11,
+        1e12,1e13,1e14,1e15,1e16,1e17,1e18,1e19,1e20,1e21,1e22
+    };
+
+    //! 只转换ASCII字母,不依赖locale.
+    template<typename Char>
+    Char asciiLower(Char c)
+    {
+        return c >= 'A' && c <= 'Z' ? static_cast<Char>(c - 'A' + 'a') : c;
+    }
+
+    //! 不区分大小写比较,word是小写的.
+    template<typename Char>
+    bool matchWord(const Char *p,const Char *end,const char *word,size_t length)
+    {
+        if(static_cast<size_t>(end - p) < length)
+        {
+            return false;
+        }
+        for(size_t i = 0; i < length; i++)
+        {
+            if(asciiLower(p[i]) != static_cast<Char>(word[i]))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    template<typename Char>
+    UParseStatus parseFloatingPoint(UBasicStringView<Char> text,double &value,size_t *parsed)
+    {
+        const Char *begin = text.data();
+        const Char *end = begin + text.size();
+        const Char *p = skipSpaces(begin,end);
+        const Char *numberBegin = p;
+        bool negative = false;
+        if(p != end && (*p == '+' || *p == '-'))
+        {
+            negative = *p++ == '-';
+        }
+        value = 0;
+        if(matchWord(p,end,"inf",3))
+        {
+            p += matchWord(p,end,"infinity",8) ? 8 : 3;
+            value = negative ? -HUGE_VAL : HUGE_VAL;
+            return finishParse(begin,p,end,parsed,ParseOk);
+        }
+        if(matchWord(p,end,"nan",3))
+        {
+            value = std::numeric_limits<double>::quiet_NaN();
+            return finishParse(begin,p + 3,end,parsed,ParseOk);
+        }
+
+        //最多收集19位有效数字,整数部分多出的数字计入指数,有多出的数字时交给strtod.
+        unsigned long long mantissa = 0;
+        int significantDigits = 0;
+        int exponent = 0;
+        bool hasDigits = false;
+        bool sawNonZeroDigit = false;
+        bool truncated = false;
+        for(; p != end && isDigit(*p); p++)
+        {
+            hasDigits = true;
+            if(significantDigits == 19)
+            {
+                truncated = true;
+                exponent++;
+            }
+            else if(sawNonZeroDigit || *p != '0')
+            {
+                sawNonZeroDigit = true;
+                mantissa = mantissa * 10 + (*p - '0');
+                significantDigits++;
+            }
+        }
+        if(p != end && *p == '.')
+        {
+            p++;
+            for(; p != end && isDigit(*p); p++)
+            {
+                hasDigits = true;
+                if(significantDigits == 19)
+                {
+                    truncated = true;
+                    continue;
+                }
+                if(sawNonZeroDigit || *p != '0')
+                {
+                    sawNonZeroDigit = true;
+                    mantissa = mantissa * 10 + (*p - '0');
+                    significantDigits++;
+                }
+                exponent--;
+            }
+        }
+        if(!hasDigits)
+        {
+            if(parsed)
+            {
+                *parsed = 0;
+            }
+            return ParseInvalid;
+        }
+        if(p != end && (*p == 'e' || *p == 'E'))
+        {
+            const Char *exponentBegin = p;
+            p++;
+            bool negativeExponent = false;
+            if(p != end && (*p == '+' || *p == '-'))
+            {
+                negativeExponent = *p++ == '-';
+            }
+            if(p == end || !isDigit(*p))
+            {
+                //"1e"只解析到1.
+                p = exponentBegin;
+            }
+            else
+            {
+                unsigned long long explicitExponent;
+                if(!parseDigits(p,end,100000,explicitExponent))
+                {
+                    explicitExponent = 100000;
+                }
+                exponent += negativeExponent ? -static_cast<int>(explicitExponent) : static_cast<int>(explicitExponent);
+            }
+        }
+
+        //尾数和10的幂都能精确表示时,一次乘除法的结果就是正确舍入的.
+        if(!truncated && mantissa <= (1ULL << 53) && exponent >= -22 && exponent <= 22)
+        {
+            value = static_cast<double>(static_cast<long long>(mantissa));
+            value = exponent < 0 ? value / g_exactPowersOf10[-exponent] : value * g_exactPowersOf10[exponent];
+            value = negative ? -value : value;
+            return finishParse(begin,p,end,parsed,ParseOk);
+        }
+        if(!sawNonZeroDigit)
+        {
+            value = negative ? -0.0 : 0.0;
+            return finishParse(begin,p,end,parsed,ParseOk);
+        }
+
+        std::string number(numberBegin,p);
+        //只有LC_CTYPE被指定,其余分类包括LC_NUMERIC都是C locale.
+#ifdef _WIN32
+        value = _strtod_l(number.c_str(),0,cachedLocale("C"));
+#else
+        value = strtod_l(number.c_str(),0,cachedLocale("C"));
+#endif
+        //不为0的数下溢成0和上溢一样超出范围,非规格化数还能表示,不算下溢.
+        const bool outOfRange = value == HUGE_VAL || value == -HUGE_VAL || value == 0;
+        return finishParse(begin,p,end,parsed,outOfRange ? ParseOutOfRange : ParseOk);
+    }
+}
+
+size_t format_int( long long value,char *buffer )
+{
+    return formatSigned(value,buffer);
+}
+
+size_t format_int( long long value,wchar_t *buffer )
+{
+    return formatSigned(value,buffer);
+}
+
+size_t format_uint( unsigned long long value,char *buffer )
+{
+    return formatUnsigned(value,buffer);
+}
+
+size_t format_uint( unsigned long long value,wchar_t *buffer )
+{
+    return formatUnsigned(value,buffer);
+}
+
+size_t format_double( double value,char *buffer )
+{
+    return formatDouble(value,buffer);
+}
+
+size_t format_double( double value,wchar_t *buffer )
+{
+    return formatDouble(value,buffer);
+}
+
+UParseStatus parse_int( UStringView text,long long &value,size_t *parsed /*= 0*/ )
+{
+    return parseInteger(text,value,parsed,LLONG_MAX,0 - static_cast<unsigned long long>(LLONG_MIN));
+}
+
+UParseStatus parse_int( UWStringView text,long long &value,size_t *parsed /*= 0*/ )
+{
+    return parseInteger(text,value,parsed,LLONG_MAX,0 - static_cast<unsigned long long>(LLONG_MIN));
+}
+
+UParseStatus parse_int( UStringView text,int &value,size_t *parsed /*= 0*/ )
+{
+    return parseInteger(text,value,parsed,INT_MAX,0 - static_cast<unsigned long long>(INT_MIN));
+}
+
+UParseStatus parse_int( UWStringView text,int &value,size_t *parsed /*= 0*/ )
+{
+    return parseInteger(text,value,parsed,INT_MAX,0 - static_cast<unsigned long long>(INT_MIN));
+}
+
+UParseStatus parse_uint( UStringView text,unsigned long long &value,size_t *parsed /*= 0*/ )
+{
+    return parseInteger(text,value,parsed,ULLONG_MAX,0);
+}
+
+UParseStatus parse_uint( UWStringView text,unsigned long long &value,size_t *parsed /*= 0*/ )
+{
+    return parseInteger(text,value,parsed,ULLONG_MAX,0);
+}
+
+UParseStatus parse_uint( UStringView text,unsigned int &value,size_t *parsed /*= 0*/ )
+{
+    return parseInteger(text,value,parsed,UINT_MAX,0);
+}
+
+UParseStatus parse_uint( UWStringView text,unsigned int &value,size_t *parsed /*= 0*/ )
+{
+    return parseInteger(text,value,parsed,UINT_MAX,0);
+}
+
+UParseStatus parse_double( UStringView text,double &value,size_t *parsed /*= 0*/ )
+{
+    return parseFloatingPoint(text,value,parsed);
+}
+
+UParseStatus parse_double( UWStringView text,double &value,size_t *parsed /*= 0*/ )
+{
+    return parseFloatingPoint(text,value,parsed);
 }
 
 std::string i2s(long long int i )
 {
-    char buf[100] = "";
-    _i64toa_s(i,buf,100,10);
-    return buf;
+    char buf[UIntegerMaxChars];
+    return std::string(buf,format_int(i,buf));
 }
 
 std::wstring i2ws( long long int i )
 {
-	wchar_t buf[100] = L"";
-	_i64tow_s(i,buf,100,10);
-	return buf;
+    wchar_t buf[UIntegerMaxChars];
+    return std::wstring(buf,format_int(i,buf));
+}
+
+std::string d2s( double d )
+{
+    char buf[UDoubleMaxChars];
+    return std::string(buf,format_double(d,buf));
+}
+
+std::wstring d2ws( double d )
+{
+    wchar_t buf[UDoubleMaxChars];
+    return std::wstring(buf,format_double(d,buf));
 }
 
 std::string operator+(const std::string &s,int i )
 {
-    return s + i2s(i);
+    char buf[UIntegerMaxChars];
+    const size_t size = format_int(i,buf);
+    std::string result;
+    result.reserve(s.size() + size);
+    result.append(s).append(buf,size);
+    return result;
 }
 
+#ifdef _WIN32
 std::string guid2s(GUID guid) 
 {
 	std::array<char,40> output;
 	sprintf_s(output.data(), output.size(), "{%08X-%04hX-%04hX-%02X%02X-%02X%02X%02X%02X%02X%02X}", guid.Data1, guid.Data2, guid.Data3, guid.Data4[0], guid.Data4[1], guid.Data4[2], guid.Data4[3], guid.Data4[4], guid.Data4[5], guid.Data4[6], guid.Data4[7]);
 	return std::string(output.data());
 }
+#endif
 
 }//namespace uni
\ No newline at end of file
@@ -1,6 +1,16 @@
 ﻿/*! \file UCast.h
     \brief 类型转换相关。
 
+    ws2s/s2ws按名字缓存locale,按编号缓存代码页的信息,纯ASCII字符串不经过locale直接转换,
+    UTF-8代码页使用UTranscode.h中的转换函数.
+    Linux下按locale转换时使用newlocale,按代码页转换时只支持CP_UTF8(65001).
+
+    整数和浮点数的格式化/解析不经过stringstream和CRT,不受locale影响:
+    - format_int用两位一组的查表法输出整数.
+    - format_double输出能原样解析回来的最短的十进制表示(Grisu2算法).
+    - parse_int,parse_double报告错误和溢出,整数一次检查8个数字,
+      浮点数在尾数和指数都较小时直接计算,其余情况交给C locale下的strtod.
+
     \date       2011-8-8
 */
 #ifndef UNICORE_UCAST_H
@@ -9,10 +19,14 @@
 #define AUTO_LINK_LIB_NAME "UniCore"
 #include "AutoLink.h"
 
+#ifdef _WIN32
 #define WIN32_LEAN_AND_MEAN
 #include "windows.h"
+#endif
 #include <string>
 
+#include "UStringView.h"
+
 namespace uni
 {
 
@@ -44,7 +58,7 @@ std::string ws2s(const std::wstring &ws,const char *locale = "");
 */
 std::string ws2s(const std::wstring &ws,int codepage);
 
-
+#ifdef _WIN32
 //! 将std::wstring转换为std::string。
 /*!
     ws2s使用指定的locale转换Unicode字符串到MBCS字符串。
@@ -64,6 +78,7 @@ std::string ws2s(const std::wstring &ws,int codepage);
     \endcode
 */
 std::string ws2s(const std::wstring &ws,_locale_t locale);
+#endif
 
 //! 将std::string转换为std::wstring。
 /*!
@@ -96,6 +111,7 @@ std::wstring s2ws(const std::string &s,const char *locale = "");
 */
 std::wstring s2ws(const std::string &s,int codepage);
 
+#ifdef _WIN32
 //! 将std::string转换为std::wstring。
 /*!
     ws2s使用指定的locale转换MBCS字符串到Unicode字符串。
@@ -118,7 +134,93 @@ std::wstring s2ws(const std::string &s,int codepage);
     \endcode
 */
 std::wstring s2ws(const std::string &s,_locale_t locale); 
+#endif
+
+
+enum
+{
+    UIntegerMaxChars = 20,  //!< format_int写入的最多字符数,如-9223372036854775808.
+    UDoubleMaxChars = 25    //!< format_double写入的最多字符数,如-0.0000022250738585072014.
+};
+
+//! 把整数的十进制表示写入buffer.
+/*!
+    \param value 要格式化的整数.
+    \param buffer 至少能容纳UIntegerMaxChars个字符.
+    \return 写入的字符数,不会写入结尾的0.
+*/
+size_t format_int(long long value,char *buffer);
+
+//! 把整数的十进制表示写入buffer,同format_int(long long,char *).
+size_t format_int(long long value,wchar_t *buffer);
+
+//! 把无符号整数的十进制表示写入buffer,同format_int(long long,char *).
+size_t format_uint(unsigned long long value,char *buffer);
 
+//! 把无符号整数的十进制表示写入buffer,同format_int(long long,char *).
+size_t format_uint(unsigned long long value,wchar_t *buffer);
+
+//! 把浮点数的最短十进制表示写入buffer.
+/*!
+    输出的字符串用parse_double或strtod解析后和value完全相同,位数在绝大多数情况下最短.
+    格式和JavaScript的Number.toString相同:1e-7 < |value| < 1e21时使用定点格式,
+    否则使用指数格式,整数值不输出小数点.
+    \code
+    0.1 -> "0.1",3.0 -> "3",1e21 -> "1e+21",1.5e-7 -> "1.5e-7"
+    \endcode
+    -0输出"-0",无穷大输出"inf"或"-inf",NaN输出"nan".
+    \param value 要格式化的浮点数.
+    \param buffer 至少能容纳UDoubleMaxChars个字符.
+    \return 写入的字符数,不会写入结尾的0.
+*/
+size_t format_double(double value,char *buffer);
+
+//! 把浮点数的最短十进制表示写入buffer,同format_double(double,char *).
+size_t format_double(double value,wchar_t *buffer);
+
+//! 解析的结果.
+enum UParseStatus
+{
+    ParseOk,            //!< 解析成功.
+    ParseInvalid,       //!< 没有数字,或者数字后有多余的字符.
+    ParseOutOfRange     //!< 超出了类型能表示的范围.
+};
+
+//! 解析十进制整数.
+/*!
+    前后可以有空白字符,数字前可以有+或-.
+    \param text 要解析的字符串.
+    \param value 解析的结果.ParseInvalid时为0,ParseOutOfRange时为最接近的可表示值.
+    \param parsed 为0时text必须全部是数字和空白字符.
+    不为0时只解析开头的数字,返回解析到的位置,和_wtoi一样忽略之后的字符.
+    \return 解析的结果.
+    \code
+    int port;
+    if(parse_int(L"8080",port) != ParseOk)
+    {
+        //...
+    }
+    \endcode
+*/
+UParseStatus parse_int(UStringView text,long long &value,size_t *parsed = 0);
+UParseStatus parse_int(UWStringView text,long long &value,size_t *parsed = 0);
+UParseStatus parse_int(UStringView text,int &value,size_t *parsed = 0);
+UParseStatus parse_int(UWStringView text,int &value,size_t *parsed = 0);
+
+//! 解析十进制无符号整数,不接受负号,参数同parse_int.
+UParseStatus parse_uint(UStringView text,unsigned long long &value,size_t *parsed = 0);
+UParseStatus parse_uint(UWStringView text,unsigned long long &value,size_t *parsed = 0);
+UParseStatus parse_uint(UStringView text,unsigned int &value,size_t *parsed = 0);
+UParseStatus parse_uint(UWStringView text,unsigned int &value,size_t *parsed = 0);
+
+//! 解析浮点数.
+/*!
+    接受strtod在C locale下接受的十进制格式(不接受十六进制),以及不区分大小写的inf,infinity和nan.
+    结果总是正确舍入的.其余同parse_int.上溢时返回ParseOutOfRange,value为正负无穷大;
+    不为0的数小到舍入成0时也返回ParseOutOfRange,value为带符号的0.
+*/
+UParseStatus parse_double(UStringView text,double &value,size_t *parsed = 0);
+UParseStatus parse_double(UWStringView text,double &value,size_t *parsed = 0);
 
 //! 整形转成字符串。
 /*!
@@ -134,15 +236,23 @@ std::string i2s(long long int i);
 */
 std::wstring i2ws(long long int i);
 
+//! 浮点数转成字符串,格式见format_double.
+std::string d2s(double d);
+
+//! 浮点数转成宽字符串,格式见format_double.
+std::wstring d2ws(double d);
+
 //! 在string右边添加整型值.
 std::string operator+ (const std::string &s,int i);
 
+#ifdef _WIN32
 //! guid转换成std::string
 /*!
 	\param guid 待转换的guid.
 	\return 字符串格式的guid,格式为{00000000-0000-0000-0000-000000000000}.
 */
 std::string guid2s(GUID guid);
+#endif
 
 
 }//namespace uni
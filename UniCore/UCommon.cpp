@@ -9,6 +9,15 @@
 #include <algorithm>
 #include <locale>
 #include <objbase.h>
+#include <wctype.h>
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define UNI_COMMON_SSE2
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
 
 #pragma comment(lib,"rpcrt4.lib")
 
@@ -95,214 +104,184 @@ std::string GetRandomRoleName(int minSize /*= 0*/,int maxSize /*= 0*/,int wordCo
     return result;
 }
 
-vector<string> split( const string &s,const string &delim /*= " "*/ )
+namespace
 {
+    template<typename Char>
+    UBasicStringView<Char> ltrimView(UBasicStringView<Char> s,UBasicStringView<Char> t)
+    {
+        if(t.empty())
+        {
+            return s;
+        }
+        while(s.starts_with(t))
+        {
+            s.remove_prefix(t.size());
+        }
+        return s;
+    }
 
-    vector<string> results;
-    if(s.empty() || delim.empty())
+    template<typename Char>
+    UBasicStringView<Char> rtrimView(UBasicStringView<Char> s,UBasicStringView<Char> t)
     {
-        //源字符串为空或者分隔符为空都无法进行分割.
-        return results;
+        if(t.empty())
+        {
+            return s;
+        }
+        while(s.ends_with(t))
+        {
+            s.remove_suffix(t.size());
+        }
+        return s;
     }
-    if(s.size() < delim.size())
+
+    template<typename Char>
+    void assignPiece(UBasicStringView<Char> &out,UBasicStringView<Char> piece)
     {
-		//源字符串长度小于分隔符长度时也无法分割.
-        return results;
+        out = piece;
     }
-    string::size_type currentPos = 0;
-    string::size_type delimPos = 0;
-    while(true)
+
+    template<typename Char>
+    void assignPiece(std::basic_string<Char> &out,UBasicStringView<Char> piece)
     {
-        delimPos = s.find(delim,currentPos);
-        if(delimPos == string::npos)
+        out.assign(piece.data(),piece.size());
+    }
+
+    template<typename Char,typename Piece>
+    size_t splitInto(UBasicStringView<Char> s,UBasicStringView<Char> delim,std::vector<Piece> &out)
+    {
+        size_t count = 0;
+        USplitRange<Char> range(s,delim);
+        for(typename USplitRange<Char>::iterator it = range.begin(); it != range.end(); ++it,count++)
+        {
+            if(count == out.size())
+            {
+                out.push_back(Piece());
+            }
+            assignPiece(out[count],*it);
+        }
+        out.resize(count);
+        return count;
+    }
+
+    template<typename Char,typename Piece>
+    std::basic_string<Char> joinPieces(const std::vector<Piece> &pieces,UBasicStringView<Char> delim)
+    {
+        std::basic_string<Char> result;
+        if(pieces.empty())
         {
-            //从当前位置开始找不到分隔符,将剩余的字符串加入结果数组.
-            results.push_back(s.substr(currentPos));
-            break;
+            return result;
         }
-        else
+        //先算好总长度,只分配一次.
+        size_t size = delim.size() * (pieces.size() - 1);
+        for(size_t i = 0; i < pieces.size(); i++)
         {
-            //找到分隔符
-            assert(delimPos >= currentPos);
-            if(delimPos >= currentPos)
+            size += pieces[i].size();
+        }
+        result.reserve(size);
+        for(size_t i = 0; i < pieces.size(); i++)
+        {
+            if(i)
             {
-                //分隔符位置如果等于当前位置,则保存一个空字符串.
-                results.push_back(s.substr(currentPos,delimPos-currentPos));
+                result.append(delim.data(),delim.size());
             }
-            currentPos = delimPos+delim.length();  //当前位置指向分隔符后面一个位置.
+            result.append(pieces[i].data(),pieces[i].size());
         }
-
+        return result;
     }
+}
+
+USplitRange<char> split_view( UStringView s,UStringView delim /*= " "*/ )
+{
+    return USplitRange<char>(s,delim);
+}
+
+USplitRange<wchar_t> split_view( UWStringView s,UWStringView delim /*= L" "*/ )
+{
+    return USplitRange<wchar_t>(s,delim);
+}
+
+size_t split_into( UStringView s,UStringView delim,std::vector<UStringView> &out )
+{
+    return splitInto(s,delim,out);
+}
+
+size_t split_into( UWStringView s,UWStringView delim,std::vector<UWStringView> &out )
+{
+    return splitInto(s,delim,out);
+}
+
+size_t split_into( UStringView s,UStringView delim,std::vector<std::string> &out )
+{
+    return splitInto(s,delim,out);
+}
+
+size_t split_into( UWStringView s,UWStringView delim,std::vector<std::wstring> &out )
+{
+    return splitInto(s,delim,out);
+}
+
+vector<string> split( const string &s,const string &delim /*= " "*/ )
+{
+    vector<string> results;
+    split_into(s,delim,results);
     return results;
 }
 
 std::vector<std::wstring> split( const std::wstring &s,const std::wstring &delim /*= L" "*/ )
 {
+    vector<wstring> results;
+    split_into(s,delim,results);
+    return results;
+}
 
-	vector<wstring> results;
-	if(s.empty() || delim.empty())
-	{
-		//源字符串为空或者分隔符为空都无法进行分割.
-		return results;
-	}
-	if(s.size() < delim.size())
-	{
-		//源字符串长度小于分隔符长度时也无法分割.
-		return results;
-	}
-	wstring::size_type currentPos = 0;
-	wstring::size_type delimPos = 0;
-	while(true)
-	{
-		delimPos = s.find(delim,currentPos);
-		if(delimPos == wstring::npos)
-		{
-			//从当前位置开始找不到分隔符,将剩余的字符串加入结果数组.
-			results.push_back(s.substr(currentPos));
-			break;
-		}
-		else
-		{
-			//找到分隔符
-			assert(delimPos >= currentPos);
-			if(delimPos >= currentPos)
-			{
-                //分隔符位置如果等于当前位置,则保存一个空字符串.
-				results.push_back(s.substr(currentPos,delimPos-currentPos));
-			}
-			currentPos = delimPos+delim.length();  //当前位置指向分隔符后面一个位置.
-		}
-
-	}
-	return results;
+UStringView trim_view( UStringView s,UStringView t /*= " "*/ )
+{
+    return rtrimView(ltrimView(s,t),t);
+}
 
+UWStringView trim_view( UWStringView s,UWStringView t /*= L" "*/ )
+{
+    return rtrimView(ltrimView(s,t),t);
 }
 
-std::string trim(const std::string &s,const std::string &t /*= " "*/)
+UStringView ltrim_view( UStringView s,UStringView t /*= " "*/ )
 {
-    std::string result = s;
-    if(t.empty())
-    {
-      return s;
-    }
-    // Remove from the beginning.
-    while(true)
-    {
-      size_t pos = result.find(t);
-      if(pos != std::string::npos 
-        && pos == 0)
-      {
-        result.erase(0,t.size());
-      }
-      else
-      {
-        break;
-      }
-    }
+    return ltrimView(s,t);
+}
 
-    // Remove from the end.
-    while(true)
-    {
-      size_t pos = result.rfind(t);
-      if(pos != std::string::npos
-        && pos + t.size() == result.size())
-      {
-        result.erase(pos,t.size());
-      }
-      else
-      {
-        break;
-      }
-    }
+UWStringView ltrim_view( UWStringView s,UWStringView t /*= L" "*/ )
+{
+    return ltrimView(s,t);
+}
 
-    return result;
+UStringView rtrim_view( UStringView s,UStringView t /*= " "*/ )
+{
+    return rtrimView(s,t);
 }
 
-std::wstring trim( const std::wstring &s,const std::wstring &t /*= L" "*/ )
+UWStringView rtrim_view( UWStringView s,UWStringView t /*= L" "*/ )
 {
-    std::wstring result = s;
-    if(t.empty())
-    {
-      return s;
-    }
-    // Remove from the beginning.
-    while(true)
-    {
-      size_t pos = result.find(t);
-      if(pos != std::wstring::npos 
-        && pos == 0)
-      {
-        result.erase(0,t.size());
-      }
-      else
-      {
-        break;
-      }
-    }
+    return rtrimView(s,t);
+}
 
-    // Remove from the end.
-    while(true)
-    {
-      size_t pos = result.rfind(t);
-      if(pos != std::wstring::npos
-        && pos + t.size() == result.size())
-      {
-        result.erase(pos,t.size());
-      }
-      else
-      {
-        break;
-      }
-    }
-    return result;
+std::string trim(const std::string &s,const std::string &t /*= " "*/)
+{
+    return trim_view(s,t).str();
+}
+
+std::wstring trim( const std::wstring &s,const std::wstring &t /*= L" "*/ )
+{
+    return trim_view(s,t).str();
 }
 
 std::wstring ltrim( const std::wstring &s,const std::wstring &t /*= L" "*/ )
 {
-  std::wstring result = s;
-  if(t.empty())
-  {
-    return s;
-  }
-  // Remove from the beginning.
-  while(true)
-  {
-    size_t pos = result.find(t);
-    if(pos != std::wstring::npos 
-      && pos == 0)
-    {
-      result.erase(0,t.size());
-    }
-    else
-    {
-      break;
-    }
-  }
-  return result;
+    return ltrim_view(s,t).str();
 }
 
 std::wstring rtrim( const std::wstring &s,const std::wstring &t /*= L" "*/ )
 {
-  std::wstring result = s;
-  if(t.empty())
-  {
-    return s;
-  }
-  // Remove from the end.
-  while(true)
-  {
-    size_t pos = result.rfind(t);
-    if(pos != std::wstring::npos
-      && pos + t.size() == result.size())
-    {
-      result.erase(pos,t.size());
-    }
-    else
-    {
-      break;
-    }
-  }
-  return result;
+    return rtrim_view(s,t).str();
 }
 
 std::wstring pad( const std::wstring &s,const std::wstring &p )
@@ -350,88 +329,267 @@ std::wstring rpad( const std::wstring &s,const std::wstring &p )
 
 std::string join( const std::vector<std::string> &stringsToJoin,const std::string &delim )
 {
-    std::string result;
-    for(int i = 0; i < stringsToJoin.size(); i++)
+    return joinPieces<char>(stringsToJoin,delim);
+}
+
+std::wstring join( const std::vector<std::wstring> &stringsToJoin,const std::wstring &delim )
+{
+    return joinPieces<wchar_t>(stringsToJoin,delim);
+}
+
+std::string join( const std::vector<UStringView> &stringsToJoin,UStringView delim )
+{
+    return joinPieces(stringsToJoin,delim);
+}
+
+std::wstring join( const std::vector<UWStringView> &stringsToJoin,UWStringView delim )
+{
+    return joinPieces(stringsToJoin,delim);
+}
+
+namespace
+{
+    inline char foldCase(char c)
+    {
+        return (c >= 'A' && c <= 'Z') ? static_cast<char>(c + ('a' - 'A')) : c;
+    }
+
+    inline wchar_t foldCase(wchar_t c)
     {
-        result += stringsToJoin[i];
-        if(i != stringsToJoin.size() - 1)
+        if(c < 0x80)
         {
-            result += delim;
+            return (c >= L'A' && c <= L'Z') ? static_cast<wchar_t>(c + (L'a' - L'A')) : c;
         }
+        return static_cast<wchar_t>(towlower(c));
     }
-    return result;
-}
 
-std::wstring join( const std::vector<std::wstring> &stringsToJoin,const std::wstring &delim )
-{
-    std::wstring result;
-    for(int i = 0; i < stringsToJoin.size(); i++)
+    template<bool PatternFolded,typename Char>
+    bool equalsCaseInsensitive(const Char *src,const Char *pattern,size_t size)
     {
-        result += stringsToJoin[i];
-        if(i != stringsToJoin.size() - 1)
+        for(size_t i = 0; i < size; i++)
         {
-            result += delim;
+            if(foldCase(src[i]) != (PatternFolded ? pattern[i] : foldCase(pattern[i])))
+            {
+                return false;
+            }
         }
+        return true;
     }
-    return result;
-}
 
-bool contains( const std::wstring &src, const std::wstring &pattern, CaseSensitivity caseSensitivity /*= CaseSensitive*/ )
-{
-    if(caseSensitivity == CaseSensitive)
+#ifdef UNI_COMMON_SSE2
+    //! 把[low,high]范围内的字节的0x20位翻转,即ASCII字母的大小写转换.
+    inline __m128i toggleCase(__m128i block,char low,char high)
     {
-        return src.find(pattern) != std::wstring::npos;
+        const __m128i inRange = _mm_and_si128(_mm_cmpgt_epi8(block,_mm_set1_epi8(low - 1)),
+            _mm_cmplt_epi8(block,_mm_set1_epi8(high + 1)));
+        return _mm_xor_si128(block,_mm_and_si128(inRange,_mm_set1_epi8(0x20)));
+    }
+
+    inline int lowestBit(unsigned int mask)
+    {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanForward(&index,mask);
+        return static_cast<int>(index);
+#else
+        return __builtin_ctz(mask);
+#endif
+    }
+#endif
+
+    void toggleAsciiCase(char *data,size_t size,char low,char high)
+    {
+        size_t i = 0;
+#ifdef UNI_COMMON_SSE2
+        for(; i + 16 <= size; i += 16)
+        {
+            __m128i *block = reinterpret_cast<__m128i *>(data + i);
+            _mm_storeu_si128(block,toggleCase(_mm_loadu_si128(block),low,high));
+        }
+#endif
+        for(; i < size; i++)
+        {
+            if(data[i] >= low && data[i] <= high)
+            {
+                data[i] ^= 0x20;
+            }
+        }
+    }
+
+    //! 按块筛选候选位置,默认没有向量实现,直接交给逐个比较的循环.
+    /*!
+        \param[out] next 还没有检查过的第一个位置.
+    */
+    template<bool PatternFolded,typename Char>
+    size_t findInBlocks(const Char *,size_t,const Char *,size_t,size_t pos,Char,Char,size_t &next)
+    {
+        next = pos;
+        return UBasicStringView<Char>::npos;
+    }
+
+    template<bool PatternFolded>
+    size_t findInBlocks(const char *src,size_t size,const char *pattern,size_t patternSize,
+        size_t pos,char first,char last,size_t &next)
+    {
+        size_t i = pos;
+#ifdef UNI_COMMON_SSE2
+        //每次检查16个起始位置,起始位置的字符等于first并且对应的结尾字符等于last的才需要完整比较.
+        const __m128i firstBlock = _mm_set1_epi8(first);
+        const __m128i lastBlock = _mm_set1_epi8(last);
+        for(; i + patternSize - 1 + 16 <= size; i += 16)
+        {
+            const __m128i head = toggleCase(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i)),'A','Z');
+            const __m128i tail = toggleCase(_mm_loadu_si128(
+                reinterpret_cast<const __m128i *>(src + i + patternSize - 1)),'A','Z');
+            unsigned int mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(head,firstBlock),
+                _mm_cmpeq_epi8(tail,lastBlock)));
+            while(mask)
+            {
+                const size_t candidate = i + lowestBit(mask);
+                if(equalsCaseInsensitive<PatternFolded>(src + candidate + 1,pattern + 1,patternSize - 1))
+                {
+                    next = candidate;
+                    return candidate;
+                }
+                mask &= mask - 1;
+            }
+        }
+#endif
+        next = i;
+        return UStringView::npos;
+    }
+
+    template<bool PatternFolded,typename Char>
+    size_t findCaseInsensitive(UBasicStringView<Char> src,UBasicStringView<Char> pattern,size_t pos)
+    {
+        const size_t npos = UBasicStringView<Char>::npos;
+        if(pos > src.size() || pattern.size() > src.size() - pos)
+        {
+            return npos;
+        }
+        if(pattern.empty())
+        {
+            return pos;
+        }
+        const Char first = PatternFolded ? pattern.front() : foldCase(pattern.front());
+        const Char last = PatternFolded ? pattern.back() : foldCase(pattern.back());
+        size_t i;
+        const size_t found = findInBlocks<PatternFolded>(src.data(),src.size(),pattern.data(),pattern.size(),
+            pos,first,last,i);
+        if(found != npos)
+        {
+            return found;
+        }
+        for(; i + pattern.size() <= src.size(); i++)
+        {
+            if(foldCase(src[i]) == first
+                && foldCase(src[i + pattern.size() - 1]) == last
+                && equalsCaseInsensitive<PatternFolded>(src.data() + i,pattern.data(),pattern.size()))
+            {
+                return i;
+            }
+        }
+        return npos;
+    }
+
+    template<typename Char>
+    bool startsWith(const std::basic_string<Char> &src,const std::basic_string<Char> &pattern,
+        CaseSensitivity caseSensitivity)
+    {
+        if(pattern.size() > src.size())
+        {
+            return false;
+        }
+        if(caseSensitivity == CaseSensitive)
+        {
+            return src.compare(0,pattern.size(),pattern) == 0;
+        }
+        return equalsCaseInsensitive<false>(src.data(),pattern.data(),pattern.size());
     }
-    std::wstring srcLowerCase = src;
-    std::transform(src.begin(), src.end(), srcLowerCase.begin(),tolower);
-    std::wstring patternLowerCase = pattern;
-    std::transform(pattern.begin(),pattern.end(),patternLowerCase.begin(),tolower);
+}
 
-    return srcLowerCase.find(patternLowerCase) != std::wstring::npos;
+char fold_case( char c )
+{
+    return foldCase(c);
 }
 
-bool contains( const std::string &src, const std::string &pattern, CaseSensitivity caseSensitivity /*= CaseSensitive*/ )
+wchar_t fold_case( wchar_t c )
 {
-    if(caseSensitivity == CaseSensitive)
+    return foldCase(c);
+}
+
+void ascii_to_lower( char *data,size_t size )
+{
+    toggleAsciiCase(data,size,'A','Z');
+}
+
+void ascii_to_upper( char *data,size_t size )
+{
+    toggleAsciiCase(data,size,'a','z');
+}
+
+size_t find_case_insensitive( UStringView src,UStringView pattern,size_t pos /*= 0*/ )
+{
+    return findCaseInsensitive<false>(src,pattern,pos);
+}
+
+size_t find_case_insensitive( UWStringView src,UWStringView pattern,size_t pos /*= 0*/ )
+{
+    return findCaseInsensitive<false>(src,pattern,pos);
+}
+
+template<typename Char>
+UBasicCaseInsensitiveMatcher<Char>::UBasicCaseInsensitiveMatcher( UBasicStringView<Char> pattern )
+    :pattern_(pattern.str())
+{
+    for(size_t i = 0; i < pattern_.size(); i++)
     {
-        return src.find(pattern) != std::string::npos;
+        pattern_[i] = foldCase(pattern_[i]);
     }
-    std::string srcLowerCase = src;
-    std::transform(src.begin(), src.end(), srcLowerCase.begin(), tolower);
-    std::string patternLowerCase = pattern;
-    std::transform(pattern.begin(),pattern.end(),patternLowerCase.begin(),tolower);
+}
 
-    return srcLowerCase.find(patternLowerCase) != std::string::npos;
+template<typename Char>
+size_t UBasicCaseInsensitiveMatcher<Char>::find( UBasicStringView<Char> src,size_t pos /*= 0*/ ) const
+{
+    return findCaseInsensitive<true>(src,UBasicStringView<Char>(pattern_),pos);
 }
 
-bool starts_with( const std::wstring &src, const std::wstring &pattern, CaseSensitivity caseSensitivity /*= CaseSensitive*/ )
+template<typename Char>
+bool UBasicCaseInsensitiveMatcher<Char>::isPrefixOf( UBasicStringView<Char> src ) const
+{
+    return pattern_.size() <= src.size()
+        && equalsCaseInsensitive<true>(src.data(),pattern_.data(),pattern_.size());
+}
+
+template class UBasicCaseInsensitiveMatcher<char>;
+template class UBasicCaseInsensitiveMatcher<wchar_t>;
+
+bool contains( const std::wstring &src, const std::wstring &pattern, CaseSensitivity caseSensitivity /*= CaseSensitive*/ )
 {
     if(caseSensitivity == CaseSensitive)
     {
-        return src.find(pattern) == 0;
+        return src.find(pattern) != std::wstring::npos;
     }
-    
-    std::wstring srcLowerCase = src;
-    std::transform(src.begin(), src.end(), srcLowerCase.begin(),tolower);
-    std::wstring patternLowerCase = pattern;
-    std::transform(pattern.begin(),pattern.end(),patternLowerCase.begin(),tolower);
-
-    return srcLowerCase.find(patternLowerCase) == 0;
+    return find_case_insensitive(src,pattern) != UWStringView::npos;
 }
 
-bool starts_with( const std::string &src, const std::string &pattern, CaseSensitivity caseSensitivity /*= CaseSensitive*/ )
+bool contains( const std::string &src, const std::string &pattern, CaseSensitivity caseSensitivity /*= CaseSensitive*/ )
 {
     if(caseSensitivity == CaseSensitive)
     {
-        return src.find(pattern) == 0;
+        return src.find(pattern) != std::string::npos;
     }
+    return find_case_insensitive(src,pattern) != UStringView::npos;
+}
 
-    std::string srcLowerCase = src;
-    std::transform(src.begin(), src.end(), srcLowerCase.begin(), tolower);
-    std::string patternLowerCase = pattern;
-    std::transform(pattern.begin(),pattern.end(),patternLowerCase.begin(),tolower);
+bool starts_with( const std::wstring &src, const std::wstring &pattern, CaseSensitivity caseSensitivity /*= CaseSensitive*/ )
+{
+    return startsWith(src,pattern,caseSensitivity);
+}
 
-    return srcLowerCase.find(patternLowerCase) == 0;
+bool starts_with( const std::string &src, const std::string &pattern, CaseSensitivity caseSensitivity /*= CaseSensitive*/ )
+{
+    return startsWith(src,pattern,caseSensitivity);
 }
 
 std::wstring GetRandomAlnumName( int length )
@@ -485,16 +643,20 @@ std::wstring GenerateUUID()
 
 std::wstring to_lower( const std::wstring &ws )
 {
-	std::wstring result = ws;
-	transform(result.begin(),result.end(),result.begin(),towlower);
-	return result;
+    std::wstring result = ws;
+    transform(result.begin(),result.end(),result.begin(),towlower);
+    return result;
 }
 
 std::string to_lower( const std::string &s )
 {
-	std::string result = s;
-	transform(result.begin(),result.end(),result.begin(),tolower);
-	return result;
+    std::string result = s;
+    for(size_t i = 0; i < result.size(); i++)
+    {
+        //tolower只接受unsigned char范围内的值.
+        result[i] = static_cast<char>(tolower(static_cast<unsigned char>(result[i])));
+    }
+    return result;
 }
 
 std::wstring to_upper( const std::wstring &ws )
@@ -506,11 +668,12 @@ std::wstring to_upper( const std::wstring &ws )
 
 std::string to_upper( const std::string &s )
 {
-	std::string result = s;
-	transform(result.begin(),result.end(),result.begin(),toupper);
-	return result;
+    std::string result = s;
+    for(size_t i = 0; i < result.size(); i++)
+    {
+        result[i] = static_cast<char>(toupper(static_cast<unsigned char>(result[i])));
+    }
+    return result;
 }
 
-
-
 }//namespace uni
\ No newline at end of file
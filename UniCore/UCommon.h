@@ -13,6 +13,8 @@
 #define AUTO_LINK_LIB_NAME "UniCore"
 #include "AutoLink.h"
 
+#include "UStringView.h"
+
 /*! \def DISALLOW_COPY_AND_ASSIGN
     该宏用于禁止类拷贝复制。
     \code
@@ -153,6 +155,34 @@ std::vector<std::string> split(const std::string &s,const std::string &delim = "
 */
 std::vector<std::wstring> split(const std::wstring &s,const std::wstring &delim = L" ");
 
+//! 惰性分割字符串.
+/*!
+    \param s 源字符串,在使用返回的范围期间必须有效.
+    \param delim 分隔符.
+    \return 由片段组成的范围,规则和split相同,迭代时才查找分隔符,不分配内存.
+*/
+USplitRange<char> split_view(UStringView s,UStringView delim = " ");
+
+//! 惰性分割字符串.
+USplitRange<wchar_t> split_view(UWStringView s,UWStringView delim = L" ");
+
+//! 分割字符串到out中.
+/*!
+    规则和split相同.out原有的元素会被覆盖,已分配的空间会被重复使用,
+    在循环中分割时传入同一个out可以避免反复分配内存.
+    \return 片段的个数,即out的新大小.
+*/
+size_t split_into(UStringView s,UStringView delim,std::vector<UStringView> &out);
+
+//! 分割字符串到out中.
+size_t split_into(UWStringView s,UWStringView delim,std::vector<UWStringView> &out);
+
+//! 分割字符串到out中,复用out中字符串已分配的空间.
+size_t split_into(UStringView s,UStringView delim,std::vector<std::string> &out);
+
+//! 分割字符串到out中,复用out中字符串已分配的空间.
+size_t split_into(UWStringView s,UWStringView delim,std::vector<std::wstring> &out);
+
 //! 拼接字符串.
 /*!
     \param stringsToJoin 要拼接的字符串数组.
@@ -161,6 +191,12 @@ std::vector<std::wstring> split(const std::wstring &s,const std::wstring &delim
 */
 std::string join(const std::vector<std::string> &stringsToJoin,const std::string &delim);
 
+//! 拼接字符串片段.
+std::string join(const std::vector<UStringView> &stringsToJoin,UStringView delim);
+
+//! 拼接字符串片段.
+std::wstring join(const std::vector<UWStringView> &stringsToJoin,UWStringView delim);
+
 //! 拼接字符串.
 /*!
     \param stringsToJoin 要拼接的字符串数组.
@@ -220,6 +256,24 @@ std::wstring rtrim(const std::wstring &s,const std::wstring &t = L" ");
 */
 std::wstring ltrim(const std::wstring &s,const std::wstring &t);
 
+//! 和trim相同,但返回s的片段,不复制字符串.
+UStringView trim_view(UStringView s,UStringView t = " ");
+
+//! 和trim相同,但返回s的片段,不复制字符串.
+UWStringView trim_view(UWStringView s,UWStringView t = L" ");
+
+//! 从左侧不断剔除t,返回s的片段.
+UStringView ltrim_view(UStringView s,UStringView t = " ");
+
+//! 从左侧不断剔除t,返回s的片段.
+UWStringView ltrim_view(UWStringView s,UWStringView t = L" ");
+
+//! 从右侧不断剔除t,返回s的片段.
+UStringView rtrim_view(UStringView s,UStringView t = " ");
+
+//! 从右侧不断剔除t,返回s的片段.
+UWStringView rtrim_view(UWStringView s,UWStringView t = L" ");
+
 
 
 //! 在字符串首尾添加padString(假如首尾不是padString)
@@ -323,18 +377,82 @@ bool starts_with(const std::wstring &src, const std::wstring &pattern, CaseSensi
 */
 bool starts_with(const std::string &src, const std::string &pattern, CaseSensitivity caseSensitivity = CaseSensitive);
 
-//! 将字符串转换成小写.
+//! 将字符串转换成小写,按CRT当前的locale转换.
 std::wstring to_lower(const std::wstring &ws);
 
-//! 将字符串转换成小写.
+//! 将字符串转换成小写,按CRT当前的locale转换.只需要转换ASCII字母时ascii_to_lower更快.
 std::string to_lower(const std::string &s);
 
-//! 将字符串转换为大写.
+//! 将字符串转换为大写,按CRT当前的locale转换.
 std::wstring to_upper(const std::wstring &ws);
 
-//! 将字符串转换为大写.
+//! 将字符串转换为大写,按CRT当前的locale转换.只需要转换ASCII字母时ascii_to_upper更快.
 std::string to_upper(const std::string &s);
 
+//! 把data中的ASCII字母就地转换成小写,其它字节不变.
+/*!
+    支持SSE2时一次转换16个字节.
+*/
+void ascii_to_lower(char *data,size_t size);
+
+//! 把data中的ASCII字母就地转换成大写,其它字节不变.
+void ascii_to_upper(char *data,size_t size);
+
+//! 忽略大小写比较时实际比较的字符,即ASCII字母转换成小写,其它字节不变.
+char fold_case(char c);
+
+//! 忽略大小写比较时实际比较的字符,ASCII字母转换成小写,其它字符用towlower转换.
+wchar_t fold_case(wchar_t c);
+
+//! 从pos开始忽略大小写查找pattern.
+/*!
+    不复制字符串,不分配内存.char版本只忽略ASCII字母的大小写,
+    支持SSE2时先用pattern的首尾字符一次筛选16个位置,再逐个比较候选位置.
+    \return pattern的位置,找不到时返回UStringView::npos.pattern为空时返回pos.
+*/
+size_t find_case_insensitive(UStringView src,UStringView pattern,size_t pos = 0);
+
+//! 从pos开始忽略大小写查找pattern.
+/*!
+    ASCII字符直接转换,其它字符用towlower转换,结果取决于CRT的locale.
+*/
+size_t find_case_insensitive(UWStringView src,UWStringView pattern,size_t pos = 0);
+
+//! 预先处理好的忽略大小写的查找.
+/*!
+    构造时把pattern转换成小写保存起来,之后每次查找只需要转换源字符串.
+    适合用同一个pattern查找大量字符串的场合,比如过滤日志.
+    \code
+    UCaseInsensitiveMatcher matcher("error");
+    for(size_t i = 0; i < lines.size(); i++)
+    {
+        if(matcher.matches(lines[i]))
+        {
+            ...
+        }
+    }
+    \endcode
+*/
+template<typename Char>
+class UBasicCaseInsensitiveMatcher
+{
+public:
+    explicit UBasicCaseInsensitiveMatcher(UBasicStringView<Char> pattern);
+    //! 从pos开始查找,返回pattern的位置,找不到时返回npos.
+    size_t find(UBasicStringView<Char> src,size_t pos = 0) const;
+    //! src中是否包含pattern.
+    bool matches(UBasicStringView<Char> src) const {return find(src) != UBasicStringView<Char>::npos;}
+    //! src是否以pattern开始.
+    bool isPrefixOf(UBasicStringView<Char> src) const;
+    //! 转换成小写之后的pattern.
+    const std::basic_string<Char> &pattern() const {return pattern_;}
+private:
+    std::basic_string<Char> pattern_;
+};
+
+typedef UBasicCaseInsensitiveMatcher<char> UCaseInsensitiveMatcher;
+typedef UBasicCaseInsensitiveMatcher<wchar_t> UWCaseInsensitiveMatcher;
+
 }//namespace uni
 
 #endif//UNICORE_UCOMMON_H
\ No newline at end of file
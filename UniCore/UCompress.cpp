@@ -0,0 +1,294 @@
+﻿#include "UCompress.h"
+
+#include <string.h>
+#include <fstream>
+#include <vector>
+
+using namespace std;
+
+namespace uni
+{
+
+namespace
+{
+    const int MinMatch = 4;
+    //! LZ4要求最后5个字节总是字面量,最后一个匹配至少在结尾前12字节开始.
+    const size_t LastLiterals = 5;
+    const size_t MatchFindLimit = 12;
+    const size_t MaxOffset = 65535;
+    const int HashBits = 12;
+    const char FileMagic[4] = {'U','L','Z','1'};
+    const size_t FileBlockSize = 1024 * 1024;
+
+    unsigned int read32(const char *p)
+    {
+        unsigned int value;
+        memcpy(&value,p,sizeof(value));
+        return value;
+    }
+
+    unsigned int hashSequence(unsigned int sequence)
+    {
+        return (sequence * 2654435761u) >> (32 - HashBits);
+    }
+
+    //! 写入超过15的长度的剩余部分.
+    void writeLength(string &out,size_t length)
+    {
+        while(length >= 255)
+        {
+            out += static_cast<char>(255);
+            length -= 255;
+        }
+        out += static_cast<char>(length);
+    }
+
+    //! 写入一个序列:字面量,以及之后的匹配.matchLength为0表示没有匹配(最后一个序列).
+    void writeSequence(string &out,const char *literals,size_t literalLength,
+        size_t offset,size_t matchLength)
+    {
+        const size_t matchCode = matchLength ? matchLength - MinMatch : 0;
+        unsigned char token = static_cast<unsigned char>(
+            ((literalLength < 15 ? literalLength : 15) << 4)
+            | (matchCode < 15 ? matchCode : 15));
+        out += static_cast<char>(token);
+        if(literalLength >= 15)
+        {
+            writeLength(out,literalLength - 15);
+        }
+        out.append(literals,literalLength);
+        if(!matchLength)
+        {
+            return;
+        }
+        out += static_cast<char>(offset & 0xFF);
+        out += static_cast<char>(offset >> 8);
+        if(matchCode >= 15)
+        {
+            writeLength(out,matchCode - 15);
+        }
+    }
+
+    //! 读取超过15的长度的剩余部分.
+    bool readLength(const unsigned char *data,size_t size,size_t &pos,size_t &length)
+    {
+        unsigned char byte = 0;
+        do
+        {
+            if(pos >= size)
+            {
+                return false;
+            }
+            byte = data[pos++];
+            length += byte;
+        }while(byte == 255);
+        return true;
+    }
+
+    bool writeBlockHeader(ofstream &file,unsigned int originalSize,unsigned int storedSize)
+    {
+        file.write(reinterpret_cast<const char *>(&originalSize),sizeof(originalSize));
+        file.write(reinterpret_cast<const char *>(&storedSize),sizeof(storedSize));
+        return !!file;
+    }
+}
+
+std::string lz4Compress( const char *data,size_t size )
+{
+    string out;
+    out.reserve(size + size / 255 + 16);
+    size_t anchor = 0;
+    if(size >= MatchFindLimit)
+    {
+        //表中保存的是位置加1,0表示空.
+        vector<size_t> table(1 << HashBits,0);
+        const size_t limit = size - MatchFindLimit;
+        const size_t matchLimit = size - LastLiterals;
+        size_t pos = 0;
+        while(pos <= limit)
+        {
+            const unsigned int sequence = read32(data + pos);
+            const unsigned int hash = hashSequence(sequence);
+            size_t candidate = table[hash];
+            table[hash] = pos + 1;
+            if(!candidate || pos - (candidate - 1) > MaxOffset
+                || read32(data + candidate - 1) != sequence)
+            {
+                pos++;
+                continue;
+            }
+            candidate--;
+            size_t matchEnd = pos + MinMatch;
+            while(matchEnd < matchLimit && data[matchEnd] == data[candidate + matchEnd - pos])
+            {
+                matchEnd++;
+            }
+            //向前扩展匹配.
+            while(pos > anchor && candidate > 0 && data[pos - 1] == data[candidate - 1])
+            {
+                pos--;
+                candidate--;
+            }
+            writeSequence(out,data + anchor,pos - anchor,pos - candidate,matchEnd - pos);
+            pos = matchEnd;
+            anchor = pos;
+        }
+    }
+    writeSequence(out,data + anchor,size - anchor,0,0);
+    return out;
+}
+
+bool lz4Decompress( const char *data,size_t size,size_t originalSize,std::string &result )
+{
+    result.resize(originalSize);
+    const unsigned char *in = reinterpret_cast<const unsigned char *>(data);
+    size_t inPos = 0;
+    size_t outPos = 0;
+    while(inPos < size)
+    {
+        const unsigned char token = in[inPos++];
+        size_t literalLength = token >> 4;
+        if(literalLength == 15 && !readLength(in,size,inPos,literalLength))
+        {
+            return false;
+        }
+        if(literalLength > size - inPos || literalLength > originalSize - outPos)
+        {
+            return false;
+        }
+        if(literalLength)
+        {
+            memcpy(&result[outPos],data + inPos,literalLength);
+        }
+        inPos += literalLength;
+        outPos += literalLength;
+        if(inPos == size)
+        {
+            //最后一个序列只有字面量.
+            break;
+        }
+        if(size - inPos < 2)
+        {
+            return false;
+        }
+        const size_t offset = in[inPos] | (in[inPos + 1] << 8);
+        inPos += 2;
+        if(!offset || offset > outPos)
+        {
+            return false;
+        }
+        size_t matchLength = token & 15;
+        if(matchLength == 15 && !readLength(in,size,inPos,matchLength))
+        {
+            return false;
+        }
+        matchLength += MinMatch;
+        if(matchLength > originalSize - outPos)
+        {
+            return false;
+        }
+        //匹配可能和输出重叠,只能逐字节复制.
+        for(size_t i = 0; i < matchLength; i++,outPos++)
+        {
+            result[outPos] = result[outPos - offset];
+        }
+    }
+    return outPos == originalSize;
+}
+
+bool compressFile( const wchar_t *source,const wchar_t *dest )
+{
+    ifstream in(source,ios_base::in|ios_base::binary);
+    ofstream out(dest,ios_base::out|ios_base::binary|ios_base::trunc);
+    if(!in || !out)
+    {
+        return false;
+    }
+    out.write(FileMagic,sizeof(FileMagic));
+    vector<char> block(FileBlockSize);
+    for(;;)
+    {
+        in.read(&block[0],block.size());
+        const size_t count = static_cast<size_t>(in.gcount());
+        if(!count)
+        {
+            break;
+        }
+        string compressed = lz4Compress(&block[0],count);
+        if(compressed.size() < count)
+        {
+            writeBlockHeader(out,count,compressed.size());
+            out.write(compressed.data(),compressed.size());
+        }
+        else
+        {
+            writeBlockHeader(out,count,count);
+            out.write(&block[0],count);
+        }
+        if(!out)
+        {
+            return false;
+        }
+    }
+    if(in.bad())
+    {
+        return false;
+    }
+    writeBlockHeader(out,0,0);
+    out.close();
+    return !out.fail();
+}
+
+bool decompressFile( const wchar_t *source,const wchar_t *dest )
+{
+    ifstream in(source,ios_base::in|ios_base::binary);
+    ofstream out(dest,ios_base::out|ios_base::binary|ios_base::trunc);
+    if(!in || !out)
+    {
+        return false;
+    }
+    char magic[sizeof(FileMagic)] = {0};
+    if(!in.read(magic,sizeof(magic)) || memcmp(magic,FileMagic,sizeof(magic)))
+    {
+        return false;
+    }
+    vector<char> block;
+    string result;
+    for(;;)
+    {
+        unsigned int originalSize = 0;
+        unsigned int storedSize = 0;
+        in.read(reinterpret_cast<char *>(&originalSize),sizeof(originalSize));
+        in.read(reinterpret_cast<char *>(&storedSize),sizeof(storedSize));
+        if(!in || originalSize > FileBlockSize || storedSize > originalSize
+            || (originalSize && !storedSize))
+        {
+            return false;
+        }
+        if(!originalSize)
+        {
+            break;
+        }
+        block.resize(storedSize);
+        if(!in.read(&block[0],storedSize))
+        {
+            return false;
+        }
+        if(storedSize == originalSize)
+        {
+            out.write(&block[0],storedSize);
+        }
+        else
+        {
+            if(!lz4Decompress(&block[0],storedSize,originalSize,result))
+            {
+                return false;
+            }
+            out.write(result.data(),result.size());
+        }
+    }
+    out.close();
+    return !out.fail();
+}
+
+}//namespace uni
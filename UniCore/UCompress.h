@@ -0,0 +1,63 @@
+﻿/*! \file UCompress.h
+    \brief 不依赖第三方库的简单压缩.
+
+    压缩数据使用LZ4的块格式,只实现了最简单的贪心匹配,压缩率不如zlib,
+    但速度很快,适合在后台压缩日志之类的文本.
+
+    压缩文件(.ulz)的格式:
+    - 4字节的文件头"ULZ1".
+    - 若干个数据块,每块前面是两个4字节整数:原始大小和压缩后的大小,之后是压缩后的数据.
+      压缩后的大小等于原始大小时,数据块没有被压缩.
+    - 原始大小为0的数据块表示文件结束.
+
+    \author unigauldoth@gmail.com
+    \date       2026-10-18
+*/
+#ifndef UNICORE_UCOMPRESS_H
+#define UNICORE_UCOMPRESS_H
+
+#define AUTO_LINK_LIB_NAME "UniCore"
+#include "AutoLink.h"
+
+#include <string>
+
+namespace uni
+{
+
+//! 以LZ4块格式压缩数据.
+/*!
+    \param data 要压缩的数据.
+    \param size 数据的字节数.
+    \return 压缩后的数据.数据不可压缩时,结果可能比原数据稍大.
+*/
+std::string lz4Compress(const char *data,size_t size);
+
+//! 解压lz4Compress压缩的数据.
+/*!
+    \param data 压缩后的数据.
+    \param size 压缩后数据的字节数.
+    \param originalSize 原始数据的字节数.
+    \param[out] result 解压后的数据.
+    \return 数据损坏时返回false.
+*/
+bool lz4Decompress(const char *data,size_t size,size_t originalSize,std::string &result);
+
+//! 压缩文件.
+/*!
+    \param source 要压缩的文件.
+    \param dest 压缩后的文件,已存在时会被覆盖.
+    \return 是否成功.失败时dest的内容不确定.
+*/
+bool compressFile(const wchar_t *source,const wchar_t *dest);
+
+//! 解压compressFile压缩的文件.
+/*!
+    \param source 压缩文件.
+    \param dest 解压后的文件,已存在时会被覆盖.
+    \return 是否成功.文件损坏时返回false.
+*/
+bool decompressFile(const wchar_t *source,const wchar_t *dest);
+
+}//namespace uni
+
+#endif//UNICORE_UCOMPRESS_H
@@ -1,7 +1,18 @@
 ﻿#include "UConfig.h"
 
+#include <algorithm>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <wchar.h>
+
+#ifdef _WIN32
 #define WIN32_LEAN_AND_MEAN
 #include "Windows.h"
+#endif
+
+#include "UCast.h"
+#include "ULock.h"
 
 using namespace std;
 
@@ -10,48 +21,155 @@ namespace uni
 
 UConfig *UConfig::instance_ = 0;
 
-std::wstring UIniConfig::get( std::wstring key,... )
+#ifdef _WIN32
+namespace
 {
-    va_list ap;
-    va_start(ap,key);
-    std::wstring result =  get(key,ap);
-    va_end(ap);
+    //! 格式化键名使用的locale,第一次使用时创建,之后不再释放.
+    _locale_t volatile g_keyLocale = 0;
 
-    return result;
+    _locale_t keyLocale()
+    {
+        _locale_t loc = g_keyLocale;
+        if(!loc)
+        {
+            _locale_t created = _create_locale(LC_ALL,"");
+            loc = static_cast<_locale_t>(InterlockedCompareExchangePointer(
+                reinterpret_cast<void * volatile *>(&g_keyLocale),created,0));
+            if(loc)
+            {
+                //其它线程已经创建了.
+                _free_locale(created);
+            }
+            else
+            {
+                loc = created;
+            }
+        }
+        return loc;
+    }
 }
+#else
+namespace
+{
+    //! 格式化后的键名最多的字符数,超过时认为格式化失败.
+    const size_t MaxFormattedKeyLength = 65536;
 
-std::wstring UIniConfig::get(std::wstring key,va_list ap)
+    //! 把Windows宽字符函数的格式转换为POSIX的格式.
+    /*!
+        Windows下宽字符函数的%s和%c对应wchar_t,%hs和%S对应char;
+        POSIX下%s和%c总是对应char,宽字符要写成%ls和%lc.
+    */
+    wstring toPosixFormat(const wstring &format)
+    {
+        wstring result;
+        result.reserve(format.size() + 8);
+        for(size_t i = 0; i < format.size(); )
+        {
+            result += format[i];
+            if(format[i++] != L'%')
+            {
+                continue;
+            }
+            //标志,位置,宽度和精度原样保留.
+            while(i < format.size() && wcschr(L"0123456789$#+- .*'",format[i]))
+            {
+                result += format[i++];
+            }
+            bool narrow = false;
+            bool wide = false;
+            size_t lengthBegin = i;
+            while(i < format.size() && wcschr(L"hlwLqjztI",format[i]))
+            {
+                narrow = narrow || format[i] == L'h';
+                wide = wide || format[i] == L'l' || format[i] == L'w';
+                i++;
+            }
+            if(i == format.size())
+            {
+                result.append(format,lengthBegin,wstring::npos);
+                break;
+            }
+            const wchar_t conversion = format[i++];
+            switch(conversion)
+            {
+            case L's':
+            case L'c':
+                result += narrow ? L"" : L"l";
+                result += conversion;
+                break;
+            case L'S':
+            case L'C':
+                result += wide ? L"l" : L"";
+                result += static_cast<wchar_t>(conversion - L'A' + L'a');
+                break;
+            default:
+                result.append(format,lengthBegin,i - lengthBegin);
+                break;
+            }
+        }
+        return result;
+    }
+}
+#endif
+
+std::wstring UConfig::formatKey( const std::wstring &key,va_list ap )
 {
-    std::wstring formattedKey = formatKey(key,ap);
-    wstring sectionName;  //写配置档时的section name。 
-    wstring keyName;
-    if(!splitSectionAndKey(formattedKey, sectionName, keyName))
+    if(key.find(L'%') == wstring::npos)
     {
-        return L"";
+        return key;
     }
-    const int maxResultSize = 512;
-    wchar_t result[maxResultSize] = L"";
-    GetPrivateProfileStringW(sectionName.c_str(),keyName.c_str(),L"",result,maxResultSize,iniPath_.c_str());
+#ifdef _WIN32
+    _locale_t loc = keyLocale();
+    //该函数返回格式化后的字符串长度，不包括0结束符。
+    const int len = _vscwprintf_p_l(key.c_str(),loc,ap)+1;
+    wstring result(len,L'\0');
+    _vswprintf_p_l(&result[0],len,key.c_str(),loc,ap);
+    result.resize(len - 1);
     return result;
+#else
+    const wstring format = toPosixFormat(key);
+    wstring result(key.size() + 64,L'\0');
+    for(;;)
+    {
+        va_list copy;
+        va_copy(copy,ap);
+        errno = 0;
+        const int len = vswprintf(&result[0],result.size(),format.c_str(),copy);
+        va_end(copy);
+        if(len >= 0 && static_cast<size_t>(len) < result.size())
+        {
+            result.resize(len);
+            return result;
+        }
+        //vswprintf在缓冲区不够和格式化出错时都返回-1,只有前者需要重试.
+        if(errno == EILSEQ || errno == EINVAL || result.size() >= MaxFormattedKeyLength)
+        {
+            return wstring();
+        }
+        result.resize(result.size() * 2);
+    }
+#endif
 }
 
-void UIniConfig::set(std::wstring key,std::wstring value,va_list ap)
+std::wstring UConfig::escapeKey( const std::wstring &formattedKey )
 {
-    std::wstring formattedKey = formatKey(key,ap);
-    wstring sectionName;  //写配置档时的section name。 
-    wstring keyName;
-    if(!splitSectionAndKey(formattedKey, sectionName, keyName))
+    if(formattedKey.find(L'%') == wstring::npos)
     {
-        return;
+        return formattedKey;
     }
-
-    if(!WritePrivateProfileStringW(sectionName.c_str(),keyName.c_str(),value.c_str(),iniPath_.c_str()))
+    wstring result;
+    for(size_t i = 0; i < formattedKey.size(); i++)
     {
-        assert(!"WritePrivateProfileStringW失败。");
+        if(formattedKey[i] == L'%')
+        {
+            result += L'%';
+        }
+        result += formattedKey[i];
     }
+    return result;
 }
 
-bool UIniConfig::splitSectionAndKey( std::wstring &formattedKey, wstring &sectionName, wstring &keyName )
+bool UConfig::splitSectionAndKey( const std::wstring &formattedKey,std::wstring &sectionName,std::wstring &keyName )
 {
     size_t slashIndex = formattedKey.find('/');
     if(slashIndex == wstring::npos)
@@ -75,22 +193,119 @@ bool UIniConfig::splitSectionAndKey( std::wstring &formattedKey, wstring &sectio
     return true;
 }
 
-std::wstring UIniConfig::formatKey( std::wstring &key, va_list ap )
+unsigned int UConfig::nextSerial()
 {
-    //该函数返回格式化后的字符串长度，不包括0结束符。
-    _locale_t loc = _create_locale(LC_ALL,"");
-    const int len = _vscwprintf_p_l(key.c_str(),loc,ap)+1;
-    wchar_t *buffer = new wchar_t[len];
+    static volatile ULock::Word serial = 0;
+#ifdef _WIN32
+    return InterlockedIncrement(&serial);
+#else
+    return __atomic_add_fetch(&serial,1,__ATOMIC_SEQ_CST);
+#endif
+}
+
+std::wstring UConfig::getFormatted( const std::wstring &formattedKey )
+{
+    return get(escapeKey(formattedKey));
+}
+
+void UConfig::setFormatted( const std::wstring &formattedKey,const std::wstring &value )
+{
+    set(escapeKey(formattedKey),value);
+}
+
+std::vector<std::wstring> UConfig::getArrayFormatted( const std::wstring &formattedKey )
+{
+    return getArray(escapeKey(formattedKey));
+}
+
+void UConfig::setArrayFormatted( const std::wstring &formattedKey,const std::vector<std::wstring> &value )
+{
+    setArray(escapeKey(formattedKey),value);
+}
+
+int UConfig::resolveSlot( const std::wstring & )
+{
+    return -1;
+}
 
-    _vswprintf_p_l(buffer,len,key.c_str(),loc,ap);
-    _free_locale(loc);
+bool UConfig::getSlot( int,std::wstring & )
+{
+    return false;
+}
 
-    wstring result = buffer;
+std::wstring UConfig::arrayCountKey( const std::wstring &formattedKey )
+{
+    return formattedKey + L"/count";
+}
+
+std::wstring UConfig::arrayElementKey( const std::wstring &formattedKey,size_t index )
+{
+    return formattedKey + L"/" + i2ws(index);
+}
+
+#ifdef _WIN32
+std::wstring UIniConfig::get( std::wstring key,... )
+{
+    va_list ap;
+    va_start(ap,key);
+    std::wstring result =  get(key,ap);
+    va_end(ap);
 
-    delete[] buffer;
     return result;
 }
 
+std::wstring UIniConfig::get(std::wstring key,va_list ap)
+{
+    return getFormatted(formatKey(key,ap));
+}
+
+std::wstring UIniConfig::getFormatted( const std::wstring &formattedKey )
+{
+    wstring sectionName;  //写配置档时的section name。 
+    wstring keyName;
+    if(!splitSectionAndKey(formattedKey, sectionName, keyName))
+    {
+        return L"";
+    }
+    //值被截断时返回值为缓冲区长度减1,加大缓冲区重新读取.
+    wstring result(512,L'\0');
+    for(;;)
+    {
+        const DWORD size = GetPrivateProfileStringW(sectionName.c_str(),keyName.c_str(),L"",&result[0],result.size(),iniPath_.c_str());
+        if(size + 1 < result.size())
+        {
+            result.resize(size);
+            return result;
+        }
+        result.resize(result.size() * 2);
+    }
+}
+
+void UIniConfig::set(std::wstring key,std::wstring value,va_list ap)
+{
+    setFormatted(formatKey(key,ap),value);
+}
+
+void UIniConfig::setFormatted( const std::wstring &formattedKey,const std::wstring &value )
+{
+    writeProfileString(formattedKey,value.c_str());
+}
+
+void UIniConfig::writeProfileString( const std::wstring &formattedKey,const wchar_t *value )
+{
+    wstring sectionName;  //写配置档时的section name。 
+    wstring keyName;
+    if(!splitSectionAndKey(formattedKey, sectionName, keyName))
+    {
+        return;
+    }
+
+    if(!WritePrivateProfileStringW(sectionName.c_str(),keyName.c_str(),value,iniPath_.c_str()))
+    {
+        assert(!"WritePrivateProfileStringW失败。");
+    }
+}
+
 void UIniConfig::set( std::wstring key, std::wstring value, ... )
 {
     va_list ap;
@@ -101,21 +316,57 @@ void UIniConfig::set( std::wstring key, std::wstring value, ... )
 
 std::vector<std::wstring> UIniConfig::getArray( std::wstring key, ... )
 {
-    throw std::exception("The method or operation is not implemented.");
-    return std::vector<std::wstring>();
+    va_list ap;
+    va_start(ap,key);
+    const wstring formattedKey = formatKey(key,ap);
+    va_end(ap);
+
+    return getArrayFormatted(formattedKey);
+}
+
+std::vector<std::wstring> UIniConfig::getArrayFormatted( const std::wstring &formattedKey )
+{
+    int count = 0;
+    parse_int(getFormatted(arrayCountKey(formattedKey)),count);
+    std::vector<std::wstring> result;
+    for(int i = 0; i < count; i++)
+    {
+        result.push_back(getFormatted(arrayElementKey(formattedKey,i)));
+    }
+    return result;
 }
 
 void UIniConfig::setArray( std::wstring key, std::vector<std::wstring> value, ... )
 {
-    throw std::exception("The method or operation is not implemented.");
+    va_list ap;
+    va_start(ap,value);
+    const wstring formattedKey = formatKey(key,ap);
+    va_end(ap);
+
+    setArrayFormatted(formattedKey,value);
+}
+
+void UIniConfig::setArrayFormatted( const std::wstring &formattedKey,const std::vector<std::wstring> &value )
+{
+    int oldCount = 0;
+    parse_int(getFormatted(arrayCountKey(formattedKey)),oldCount);
+    for(size_t i = 0; i < value.size(); i++)
+    {
+        writeProfileString(arrayElementKey(formattedKey,i),value[i].c_str());
+    }
+    for(size_t i = value.size(); i < static_cast<size_t>((std::max)(oldCount,0)); i++)
+    {
+        writeProfileString(arrayElementKey(formattedKey,i),0);
+    }
+    writeProfileString(arrayCountKey(formattedKey),i2ws(value.size()).c_str());
 }
 
 void UIniConfig::setInt( std::wstring key, int value, ... )
 {
     va_list ap;
     va_start(ap,value);
-    wchar_t buf[255] = L"";
-    _itow_s(value,buf,10);
+    wchar_t buf[UIntegerMaxChars + 1] = L"";
+    format_int(value,buf);
     set(key,buf,ap);
     va_end(ap);
 }
@@ -127,7 +378,13 @@ int UIniConfig::getInt( std::wstring key, ... )
     std::wstring result =  get(key,ap);
     va_end(ap);
 
-    return _wtoi(result.c_str());
+    //和_wtoi一样只解析开头的数字.
+    int value = 0;
+    size_t parsed = 0;
+    parse_int(result,value,&parsed);
+    return value;
 }
 
+#endif
+
 }//namespace uni
\ No newline at end of file
@@ -13,6 +13,7 @@
 #include <string>
 #include <vector>
 #include <cassert>
+#include <cstdarg>
 
 #define theConfig UConfig::instance()
 
@@ -37,9 +38,19 @@ string account = config.get("通用配置/账号/%d",index);
 //account中为"flower"。
 \endcode
 
-\todo Add a method: UConfig::setArray
-\todo Add a method: UConfig::getArray
-\todo Change UConfig to a abstract base class.
+数组保存为多个键:"键名/count"为元素个数,"键名/0"到"键名/count-1"为各个元素.
+\code
+vector<wstring> servers;
+servers.push_back(L"10.0.0.1");
+servers.push_back(L"10.0.0.2");
+config.setArray(L"网络/服务器",servers);
+//--------------------------
+//[网络]
+//服务器/count=2
+//服务器/0=10.0.0.1
+//服务器/1=10.0.0.2
+//--------------------------
+\endcode
 */
 class UConfig
 {
@@ -85,7 +96,19 @@ public:
     */
     virtual void set(std::wstring key,
         std::wstring value, ...) = 0;
+    //! 从配置档读取数组.
+    /*!
+    \param key 数组的键名,参考UConfig键名格式.
+    \param ... 可变参,用于key中的格式字符串.
+    \return 取出的数组,键不存在时为空.
+    */
     virtual std::vector<std::wstring> getArray(std::wstring key, ...) = 0;
+    //! 向配置档写入数组,原来多出的元素会被删除.
+    /*!
+    \param key 数组的键名.
+    \param value 要写入的数组.
+    \param ... 可变参,用于key中的格式字符串.
+    */
     virtual void setArray(std::wstring key,
         std::vector<std::wstring> value, ...) = 0;
     //! 从配置档读取整型数据.
@@ -103,13 +126,59 @@ public:
     */
     virtual void setInt(std::wstring key, int value, ...) = 0;
 protected:
-    UConfig() {}
+    friend class UConfigKeyBase;
+
+    UConfig():serial_(nextSerial()) {}
+    //! 读取已经格式化的键,键名中的'%'不再是格式字符.
+    /*!
+    默认实现把'%'转义为"%%"后调用get,子类可以直接读取.
+    */
+    virtual std::wstring getFormatted(const std::wstring &formattedKey);
+    //! 写入已经格式化的键,参考getFormatted.
+    virtual void setFormatted(const std::wstring &formattedKey,const std::wstring &value);
+    //! 读取已经格式化的键名的数组,参考getFormatted.
+    virtual std::vector<std::wstring> getArrayFormatted(const std::wstring &formattedKey);
+    //! 写入已经格式化的键名的数组,参考getFormatted.
+    virtual void setArrayFormatted(const std::wstring &formattedKey,const std::vector<std::wstring> &value);
+    //! 为键分配一个槽位,之后可以通过getSlot读取,不再需要格式化和查找键名.
+    /*!
+    同一个配置对象对同一个键总是返回相同的槽位.
+    \return 槽位,不支持时返回-1.默认不支持.
+    */
+    virtual int resolveSlot(const std::wstring &formattedKey);
+    //! 读取槽位中的值.
+    /*!
+    \return 槽位暂时不可用时返回false,调用者应该改用getFormatted.
+    */
+    virtual bool getSlot(int slot,std::wstring &value);
+    //! 按key中的格式字符串格式化,支持%1$d这样的位置参数.key中没有%时直接返回key,格式化失败时返回空字符串.
+    /*!
+        格式和Windows的宽字符函数一致,%s和%c对应wchar_t,%hs对应char,其它平台上会先转换.
+    */
+    static std::wstring formatKey(const std::wstring &key,va_list ap);
+    //! 把'%'转义为"%%",作为格式字符串格式化后得到原来的键名.
+    static std::wstring escapeKey(const std::wstring &formattedKey);
+    //! 把格式化后的键名拆成section和key,第一个'/'之前为section,没有'/'时section为空.
+    static bool splitSectionAndKey(const std::wstring &formattedKey,std::wstring &sectionName,std::wstring &keyName);
+    //! 数组元素个数所在的键名.
+    static std::wstring arrayCountKey(const std::wstring &formattedKey);
+    //! 数组第index个元素所在的键名.
+    static std::wstring arrayElementKey(const std::wstring &formattedKey,size_t index);
     static UConfig *instance_;
 private:
     UConfig(const UConfig &);
     UConfig &operator = (const UConfig &);
+    static unsigned int nextSerial();
+
+    //! 配置对象的序号,UConfigKey用它判断缓存的槽位是否属于当前的配置对象.
+    const unsigned int serial_;
 };
 
+#ifdef _WIN32
+//! 通过GetPrivateProfileString读写ini文件的配置.
+/*!
+每次读写都会打开并解析整个文件,读取频繁时使用UMemoryIniConfig.
+*/
 class UIniConfig : public UConfig
 {
 public:
@@ -134,16 +203,26 @@ public:
 
     virtual void setInt( std::wstring key, int value, ... );
 
+protected:
+    virtual std::wstring getFormatted(const std::wstring &formattedKey);
+
+    virtual void setFormatted(const std::wstring &formattedKey,const std::wstring &value);
+
+    virtual std::vector<std::wstring> getArrayFormatted(const std::wstring &formattedKey);
+
+    virtual void setArrayFormatted(const std::wstring &formattedKey,const std::vector<std::wstring> &value);
+
 private:
     UIniConfig(const UIniConfig &);
     UIniConfig &operator = (const UIniConfig &);
     std::wstring get(std::wstring key,va_list ap);
     void set(std::wstring key,std::wstring value,va_list ap);
-    bool splitSectionAndKey( std::wstring &formattedKey, std::wstring &sectionName, std::wstring &keyName );
-    std::wstring formatKey( std::wstring &key, va_list ap);
+    //! 写入已经格式化的键,value为0时删除键.
+    void writeProfileString(const std::wstring &formattedKey,const wchar_t *value);
 
     std::wstring iniPath_;
 };
+#endif
 
 }//namespace uni
 
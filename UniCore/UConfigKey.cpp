@@ -0,0 +1,109 @@
+﻿#include "UConfigKey.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include "Windows.h"
+#endif
+
+#include "UCommon.h"
+
+using namespace std;
+
+namespace uni
+{
+
+namespace
+{
+    long long loadBinding(const volatile long long *binding)
+    {
+#ifdef _WIN32
+        //32位系统上64位的读不是原子的,用比较交换读取.
+        return InterlockedCompareExchange64(const_cast<volatile long long *>(binding),0,0);
+#else
+        return __atomic_load_n(binding,__ATOMIC_ACQUIRE);
+#endif
+    }
+
+    void storeBinding(volatile long long *binding,long long value)
+    {
+#ifdef _WIN32
+        long long expected = *binding;
+        for(;;)
+        {
+            const long long previous = InterlockedCompareExchange64(binding,value,expected);
+            if(previous == expected)
+            {
+                break;
+            }
+            expected = previous;
+        }
+#else
+        __atomic_store_n(binding,value,__ATOMIC_RELEASE);
+#endif
+    }
+}
+
+void UConfigKeyBase::init( const std::wstring &format,va_list ap )
+{
+    path_ = UConfig::formatKey(format,ap);
+    UConfig::splitSectionAndKey(path_,sectionName_,keyName_);
+}
+
+std::wstring UConfigKeyBase::text( UConfig &config ) const
+{
+    const unsigned long long binding = loadBinding(&binding_);
+    int slot = static_cast<int>(static_cast<unsigned int>(binding));
+    if(static_cast<unsigned int>(binding >> 32) != config.serial_)
+    {
+        //同时分配的线程得到的槽位相同,谁最后写入都一样.
+        slot = config.resolveSlot(path_);
+        storeBinding(&binding_,static_cast<long long>(static_cast<unsigned long long>(config.serial_) << 32
+            | static_cast<unsigned int>(slot)));
+    }
+    wstring value;
+    if(slot >= 0 && config.getSlot(slot,value))
+    {
+        return value;
+    }
+    return config.getFormatted(path_);
+}
+
+void UConfigKeyBase::setText( UConfig &config,const std::wstring &value ) const
+{
+    config.setFormatted(path_,value);
+}
+
+std::vector<std::wstring> UConfigKeyBase::array( UConfig &config ) const
+{
+    return config.getArrayFormatted(path_);
+}
+
+void UConfigKeyBase::setArray( UConfig &config,const std::vector<std::wstring> &value ) const
+{
+    config.setArrayFormatted(path_,value);
+}
+
+bool UConfigValueTraits<bool>::parse( const std::wstring &text )
+{
+    const UWStringView trimmed = trim_view(text,L" \t");
+    const wchar_t *names[] = {L"true",L"yes",L"on"};
+    for(size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++)
+    {
+        const UWStringView name(names[i]);
+        size_t matched = 0;
+        while(matched < name.size() && matched < trimmed.size() && fold_case(trimmed[matched]) == name[matched])
+        {
+            matched++;
+        }
+        if(matched == name.size() && matched == trimmed.size())
+        {
+            return true;
+        }
+    }
+    long long value = 0;
+    size_t parsed = 0;
+    parse_int(trimmed,value,&parsed);
+    return value != 0;
+}
+
+}//namespace uni
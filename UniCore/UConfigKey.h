@@ -0,0 +1,213 @@
+﻿/*! \file UConfigKey.h
+    \brief 预先格式化的配置键.
+
+    UConfig::get每次调用都要格式化键名,再拆分section和键名查找.频繁读取同一个键时,
+    可以先构造UConfigKey,格式化和拆分只做一次,读取时:
+    - 配置对象支持槽位时(UMemoryIniConfig),第一次读取为键分配槽位,之后按下标直接读取.
+    - 否则使用格式化后的键名读取,不再格式化.
+
+    \code
+    UConfigKey<int> width(L"窗口/宽%d",index);
+    int w = width.get();        //从theConfig读取.
+    width.set(800);
+    UConfigKey<std::vector<std::wstring> > servers(L"网络/服务器");
+    \endcode
+
+    \author unigauldoth@gmail.com
+    \date       2026-10-18
+*/
+#ifndef UNICORE_UCONFIGKEY_H
+#define UNICORE_UCONFIGKEY_H
+
+#include <string>
+#include <vector>
+
+#include "UCast.h"
+#include "UConfig.h"
+
+namespace uni
+{
+
+//! 和类型无关的部分,保存格式化后的键名和缓存的槽位.
+/*!
+    同一个UConfigKey可以在多个线程中同时使用,同一个配置对象对同一个键的槽位总是相同的.
+    theConfig被替换后会重新分配槽位.
+*/
+class UConfigKeyBase
+{
+public:
+    //! 格式化后的键名.
+    const std::wstring &path() const {return path_;}
+    //! 键名中的section部分.
+    const std::wstring &sectionName() const {return sectionName_;}
+    //! 键名中section之后的部分.
+    const std::wstring &keyName() const {return keyName_;}
+
+    //! 从config读取字符串.
+    std::wstring text(UConfig &config) const;
+    //! 向config写入字符串.
+    void setText(UConfig &config,const std::wstring &value) const;
+    //! 从config读取数组.
+    std::vector<std::wstring> array(UConfig &config) const;
+    //! 向config写入数组.
+    void setArray(UConfig &config,const std::vector<std::wstring> &value) const;
+
+protected:
+    UConfigKeyBase():binding_(0) {}
+    //! 格式化键名并拆分,在子类的构造函数中调用.
+    void init(const std::wstring &format,va_list ap);
+
+private:
+    std::wstring path_;
+    std::wstring sectionName_;
+    std::wstring keyName_;
+    //! 高32位是槽位所属的配置对象的序号,为0表示还没有分配,低32位是槽位.
+    /*!
+        序号和槽位放在同一个字里一起读写,其它线程不会读到新的序号和旧的槽位.
+    */
+    mutable volatile long long binding_;
+};
+
+//! 配置值和字符串之间的转换,支持int,double,bool,std::wstring.
+template<typename T>
+struct UConfigValueTraits;
+
+template<>
+struct UConfigValueTraits<int>
+{
+    //! 和UConfig::getInt一样只解析开头的数字.
+    static int parse(const std::wstring &text)
+    {
+        int value = 0;
+        size_t parsed = 0;
+        parse_int(text,value,&parsed);
+        return value;
+    }
+    static std::wstring format(int value)
+    {
+        return i2ws(value);
+    }
+};
+
+template<>
+struct UConfigValueTraits<double>
+{
+    static double parse(const std::wstring &text)
+    {
+        double value = 0;
+        size_t parsed = 0;
+        parse_double(text,value,&parsed);
+        return value;
+    }
+    static std::wstring format(double value)
+    {
+        return d2ws(value);
+    }
+};
+
+template<>
+struct UConfigValueTraits<bool>
+{
+    //! "true","yes","on"(不区分大小写)和非0的整数为true.
+    static bool parse(const std::wstring &text);
+    //! 写入"1"或"0",getInt也能读取.
+    static std::wstring format(bool value)
+    {
+        return value ? L"1" : L"0";
+    }
+};
+
+template<>
+struct UConfigValueTraits<std::wstring>
+{
+    static const std::wstring &parse(const std::wstring &text)
+    {
+        return text;
+    }
+    static const std::wstring &format(const std::wstring &value)
+    {
+        return value;
+    }
+};
+
+//! 类型为T的配置键.
+/*!
+    T为int,double,bool,std::wstring或std::vector<std::wstring>.
+*/
+template<typename T>
+class UConfigKey : public UConfigKeyBase
+{
+public:
+    //! 构造函数.
+    /*!
+        \param format 键名,可以是格式字符串,参考UConfig::get.
+        \param ... 可变参,用于format中的格式字符串.
+    */
+    explicit UConfigKey(std::wstring format,...)
+    {
+        va_list ap;
+        va_start(ap,format);
+        init(format,ap);
+        va_end(ap);
+    }
+
+    //! 从theConfig读取.
+    T get() const
+    {
+        return get(UConfig::instance());
+    }
+
+    T get(UConfig &config) const
+    {
+        return UConfigValueTraits<T>::parse(text(config));
+    }
+
+    //! 向theConfig写入.
+    void set(const T &value) const
+    {
+        set(UConfig::instance(),value);
+    }
+
+    void set(UConfig &config,const T &value) const
+    {
+        setText(config,UConfigValueTraits<T>::format(value));
+    }
+};
+
+//! 数组类型的配置键,参考UConfig::getArray.
+template<>
+class UConfigKey<std::vector<std::wstring> > : public UConfigKeyBase
+{
+public:
+    explicit UConfigKey(std::wstring format,...)
+    {
+        va_list ap;
+        va_start(ap,format);
+        init(format,ap);
+        va_end(ap);
+    }
+
+    std::vector<std::wstring> get() const
+    {
+        return array(UConfig::instance());
+    }
+
+    std::vector<std::wstring> get(UConfig &config) const
+    {
+        return array(config);
+    }
+
+    void set(const std::vector<std::wstring> &value) const
+    {
+        setArray(UConfig::instance(),value);
+    }
+
+    void set(UConfig &config,const std::vector<std::wstring> &value) const
+    {
+        setArray(config,value);
+    }
+};
+
+}//namespace uni
+
+#endif//UNICORE_UCONFIGKEY_H
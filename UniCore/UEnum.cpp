@@ -0,0 +1,131 @@
+﻿#include "UEnum.h"
+
+#include <algorithm>
+
+namespace uni
+{
+
+namespace
+{
+    struct LessByValue
+    {
+        explicit LessByValue(const UEnumEntry *entries):entries_(entries) {}
+        bool operator()(unsigned int a,unsigned int b) const
+        {
+            return entries_[a].value < entries_[b].value;
+        }
+        const UEnumEntry *entries_;
+    };
+
+    struct LessByName
+    {
+        explicit LessByName(const UEnumEntry *entries):entries_(entries) {}
+        bool operator()(unsigned int a,unsigned int b) const
+        {
+            return entries_[a].name() < entries_[b].name();
+        }
+        bool operator()(unsigned int a,UWStringView b) const
+        {
+            return entries_[a].name() < b;
+        }
+        bool operator()(UWStringView a,unsigned int b) const
+        {
+            return a < entries_[b].name();
+        }
+        const UEnumEntry *entries_;
+    };
+
+    bool isReady(const volatile ULock::Word *ready)
+    {
+#ifdef _WIN32
+        //volatile的读在x86和x64上有获取语义.
+        return *ready != 0;
+#else
+        return __atomic_load_n(ready,__ATOMIC_ACQUIRE) != 0;
+#endif
+    }
+
+    void publishReady(volatile ULock::Word *ready)
+    {
+#ifdef _WIN32
+        InterlockedExchange(ready,1);
+#else
+        __atomic_store_n(ready,1,__ATOMIC_RELEASE);
+#endif
+    }
+}
+
+const UEnumEntry * UEnumTable::find( int value )
+{
+    prepare();
+    if(!count)
+    {
+        return 0;
+    }
+    if(dense)
+    {
+        const unsigned int offset = static_cast<unsigned int>(value) - static_cast<unsigned int>(minValue);
+        return offset < count ? entries + byValue[offset] : 0;
+    }
+    const unsigned int *first = byValue;
+    size_t size = count;
+    while(size)
+    {
+        const size_t half = size / 2;
+        if(entries[first[half]].value < value)
+        {
+            first += half + 1;
+            size -= half + 1;
+        }
+        else
+        {
+            size = half;
+        }
+    }
+    return first != byValue + count && entries[*first].value == value ? entries + *first : 0;
+}
+
+const UEnumEntry * UEnumTable::find( UWStringView name )
+{
+    prepare();
+    const unsigned int *it = std::lower_bound(byName,byName + count,name,LessByName(entries));
+    return it != byName + count && entries[*it].name() == name ? entries + *it : 0;
+}
+
+void UEnumTable::prepare()
+{
+    if(isReady(&ready))
+    {
+        return;
+    }
+    ULock::lockWord(&lock,false);
+    if(!ready)
+    {
+        buildIndex();
+        publishReady(&ready);
+    }
+    ULock::unlockWord(&lock,false);
+}
+
+void UEnumTable::buildIndex()
+{
+    for(size_t i = 0; i < count; i++)
+    {
+        byValue[i] = static_cast<unsigned int>(i);
+        byName[i] = static_cast<unsigned int>(i);
+    }
+    std::stable_sort(byValue,byValue + count,LessByValue(entries));
+    std::sort(byName,byName + count,LessByName(entries));
+    if(!count)
+    {
+        return;
+    }
+    minValue = entries[byValue[0]].value;
+    dense = true;
+    for(size_t i = 1; i < count && dense; i++)
+    {
+        dense = static_cast<unsigned int>(entries[byValue[i]].value) - static_cast<unsigned int>(minValue) == i;
+    }
+}
+
+}//namespace uni
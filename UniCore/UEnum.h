@@ -1,47 +1,162 @@
 ﻿/*! \file UEnum.h
     \brief 提供枚举值到字符串的映射。
 
+    UENUM宏为每个枚举生成一张静态的表,表中的数据都是常量,在程序加载时就已经初始化好,
+    所有翻译单元共用同一张表.第一次查找时建立按值和按名字排序的索引,之后:
+    - e2s:枚举值连续时直接用下标查找,否则二分查找.返回指向表中字符串的视图,不复制.
+    - s2e:按名字二分查找.
+    - uenum_entries:按声明的顺序遍历所有枚举值.
+
+    使用方法:
+    \code
+    enum Fruit
+    {
+        Apple,
+        Banana,
+    };
+
+    UENUM(Fruit)
+        UENUM_ENTRY(Apple)
+        UENUM_ENTRY_VALUE(Banana,香蕉)
+    UENUM_END
+
+    e2s(Apple);             //L"Apple"
+    Fruit fruit;
+    s2e(L"香蕉",fruit);     //true,fruit为Banana
+    const uni::UEnumTable &fruits = uenum_entries<Fruit>();
+    for(const uni::UEnumEntry *it = fruits.begin(); it != fruits.end(); ++it)
+    {
+        //it->value,it->name()
+    }
+    \endcode
+
+    UENUM必须在全局命名空间中使用.
+
     \author     uni
     \date       2013-10-25
 */
 #ifndef UNICORE_UENUM_H
 #define UNICORE_UENUM_H
 
-#include <map>
+#define AUTO_LINK_LIB_NAME "UniCore"
+#include "AutoLink.h"
 
-static std::map<std::string,std::map<int,std::wstring> > g_enum_string_datas;
+#include "ULock.h"
+#include "UStringView.h"
 
-template<typename T>
-inline void populate_enum_strings()
+namespace uni
+{
+
+//! 一个枚举值.
+struct UEnumEntry
 {
+    int value;
+    const wchar_t *text;    //!< 以0结尾.
+    size_t length;
+
+    UWStringView name() const {return UWStringView(text,length);}
+};
+
+//! 一个枚举的所有枚举值,由UENUM生成.
+/*!
+    只包含常量初始化的成员,作为函数内的静态变量也不需要运行时初始化,多线程同时访问是安全的.
+*/
+struct UEnumTable
+{
+    const UEnumEntry *entries;  //!< 按声明的顺序.
+    size_t count;
+    unsigned int *byValue;      //!< 按值排序后的下标,值相同的保持声明的顺序.
+    unsigned int *byName;       //!< 按名字排序后的下标.
+    ULock::Word lock;           //!< 建立索引时使用的锁字.
+    volatile ULock::Word ready; //!< 索引是否已经建立.
+    bool dense;                 //!< 值是否连续,连续时byValue[value - minValue]即为所求.
+    int minValue;
+
+    const UEnumEntry *begin() const {return entries;}
+    const UEnumEntry *end() const {return entries + count;}
+    size_t size() const {return count;}
+
+    //! 查找值为value的枚举值,有多个时返回最先声明的,没有时返回0.
+    const UEnumEntry *find(int value);
+
+    //! 查找名字为name的枚举值,区分大小写,没有时返回0.
+    const UEnumEntry *find(UWStringView name);
+
+private:
+    //! 第一次查找时建立索引.
+    void prepare();
+    void buildIndex();
+};
 
+}//namespace uni
+
+//! 枚举T的表,由UENUM特化.
+template<typename T>
+inline uni::UEnumTable &uenum_table()
+{
+    static_assert(sizeof(T) == 0,"枚举没有使用UENUM声明.");
+    static uni::UEnumTable empty = {0,0,0,0};
+    return empty;
 }
 
+#define UENUM_WIDEN_(s) L##s
+#define UENUM_TEXT_(token) UENUM_WIDEN_(#token)
+
 #define UENUM(enum_name) \
-    template<>\
-    inline void populate_enum_strings<enum_name>() \
+    template<> \
+    inline uni::UEnumTable &uenum_table<enum_name>() \
     { \
-    std::string name = "enum "; \
-    name += #enum_name; \
-    if(g_enum_string_datas.count(name)) \
-    { \
-        return; \
-    } 
+        static const uni::UEnumEntry entries[] = \
+        {
 
 #define UENUM_ENTRY(entry) \
-    g_enum_string_datas[name][entry] = L#entry; 
+    {static_cast<int>(entry),UENUM_TEXT_(entry),sizeof(UENUM_TEXT_(entry)) / sizeof(wchar_t) - 1},
 
 #define UENUM_ENTRY_VALUE(entry,value) \
-    g_enum_string_datas[name][entry] = L#value;
+    {static_cast<int>(entry),UENUM_TEXT_(value),sizeof(UENUM_TEXT_(value)) / sizeof(wchar_t) - 1},
 
 #define UENUM_END \
-    };
+        }; \
+        static unsigned int byValue[sizeof(entries) / sizeof(entries[0])]; \
+        static unsigned int byName[sizeof(entries) / sizeof(entries[0])]; \
+        static uni::UEnumTable table = {entries,sizeof(entries) / sizeof(entries[0]),byValue,byName}; \
+        return table; \
+    }
+
+//! 枚举值对应的字符串.
+/*!
+    \return 视图指向静态的字符串,一直有效.e不是UENUM中列出的值时返回空视图.
+*/
+template<typename enum_name>
+inline uni::UWStringView e2s(enum_name e)
+{
+    const uni::UEnumEntry *entry = uenum_table<enum_name>().find(static_cast<int>(e));
+    return entry ? entry->name() : uni::UWStringView();
+}
+
+//! 字符串对应的枚举值.
+/*!
+    \param name 枚举值的名字,UENUM_ENTRY_VALUE指定的是替代的名字.
+    \param e 找到时为对应的枚举值,否则不变.
+    \return 是否找到.
+*/
+template<typename enum_name>
+inline bool s2e(uni::UWStringView name,enum_name &e)
+{
+    const uni::UEnumEntry *entry = uenum_table<enum_name>().find(name);
+    if(!entry)
+    {
+        return false;
+    }
+    e = static_cast<enum_name>(entry->value);
+    return true;
+}
 
+//! 按声明的顺序遍历枚举的所有值.
 template<typename enum_name>
-inline const std::wstring e2s(enum_name e)
+inline const uni::UEnumTable &uenum_entries()
 {
-    populate_enum_strings<enum_name>();
-    return g_enum_string_datas[typeid(enum_name).name()][e].c_str();
+    return uenum_table<enum_name>();
 }
 
-#endif//UNICORE_UENUM_H
\ No newline at end of file
+#endif//UNICORE_UENUM_H
@@ -1,2 +1,307 @@
 ﻿#include "ULock.h"
 
+#ifdef _WIN32
+#include <intrin.h>
+#else
+#include <limits.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+namespace uni
+{
+
+namespace
+{
+    //! 挂起之前最多自旋的次数.
+    const int SpinCount = 100;
+
+    //! 告诉CPU正在自旋等待.
+    inline void cpuPause()
+    {
+#ifdef _WIN32
+        YieldProcessor();
+#elif defined(__i386__) || defined(__x86_64__)
+        __builtin_ia32_pause();
+#else
+        __asm__ __volatile__("" ::: "memory");
+#endif
+    }
+
+    inline ULock::Word loadWord(volatile ULock::Word *word)
+    {
+#ifdef _WIN32
+        return *word;   //VC下volatile读带有acquire语义.
+#else
+        return __atomic_load_n(word,__ATOMIC_RELAXED);
+#endif
+    }
+
+    inline ULock::Word exchangeWord(volatile ULock::Word *word,ULock::Word value)
+    {
+#ifdef _WIN32
+        return InterlockedExchange(word,value);
+#else
+        return __atomic_exchange_n(word,value,__ATOMIC_ACQUIRE);
+#endif
+    }
+
+    //! word等于comparand时置为value,返回是否成功.带完整的内存屏障.
+    inline bool compareExchangeWord(volatile ULock::Word *word,ULock::Word value,ULock::Word comparand)
+    {
+#ifdef _WIN32
+        return InterlockedCompareExchange(word,value,comparand) == comparand;
+#else
+        return __atomic_compare_exchange_n(word,&comparand,value,false,__ATOMIC_SEQ_CST,__ATOMIC_SEQ_CST);
+#endif
+    }
+
+    //! 原子地加上delta,返回相加后的值.带完整的内存屏障.
+    inline ULock::Word addWord(volatile ULock::Word *word,ULock::Word delta)
+    {
+#ifdef _WIN32
+        return InterlockedExchangeAdd(word,delta) + delta;
+#else
+        return __atomic_add_fetch(word,delta,__ATOMIC_SEQ_CST);
+#endif
+    }
+
+    //! 当前时间,单位为微秒.
+    long long nowMicroseconds()
+    {
+#ifdef _WIN32
+        LARGE_INTEGER frequency;
+        LARGE_INTEGER counter;
+        QueryPerformanceFrequency(&frequency);
+        QueryPerformanceCounter(&counter);
+        return counter.QuadPart / frequency.QuadPart * 1000000
+            + counter.QuadPart % frequency.QuadPart * 1000000 / frequency.QuadPart;
+#else
+        timespec now;
+        clock_gettime(CLOCK_MONOTONIC,&now);
+        return static_cast<long long>(now.tv_sec) * 1000000 + now.tv_nsec / 1000;
+#endif
+    }
+
+#ifdef _WIN32
+    typedef BOOL (WINAPI *WaitOnAddressFunction)(volatile VOID *,PVOID,SIZE_T,DWORD);
+    typedef VOID (WINAPI *WakeByAddressSingleFunction)(PVOID);
+    typedef VOID (WINAPI *WakeByAddressAllFunction)(PVOID);
+
+    //! Windows 8才有WaitOnAddress,只能动态加载.
+    struct AddressWaitApi
+    {
+        WaitOnAddressFunction waitOnAddress;
+        WakeByAddressSingleFunction wakeByAddressSingle;
+        WakeByAddressAllFunction wakeByAddressAll;
+    };
+
+    //! 第一次调用时加载WaitOnAddress.
+    /*!
+        不能用函数内的静态对象,VC在构造完成前就会标记为已初始化,
+        这里用零初始化的静态变量和原子操作保证所有线程看到同样的结果.
+    */
+    const AddressWaitApi &addressWaitApi()
+    {
+        static AddressWaitApi api;
+        static volatile long state;   //0:未加载,1:正在加载,2:已加载.
+        if(state != 2)
+        {
+            if(InterlockedCompareExchange(&state,1,0) == 0)
+            {
+                HMODULE module = GetModuleHandleW(L"KernelBase.dll");
+                if(module)
+                {
+                    api.waitOnAddress = reinterpret_cast<WaitOnAddressFunction>(
+                        GetProcAddress(module,"WaitOnAddress"));
+                    api.wakeByAddressSingle = reinterpret_cast<WakeByAddressSingleFunction>(
+                        GetProcAddress(module,"WakeByAddressSingle"));
+                    api.wakeByAddressAll = reinterpret_cast<WakeByAddressAllFunction>(
+                        GetProcAddress(module,"WakeByAddressAll"));
+                }
+                if(!api.waitOnAddress || !api.wakeByAddressSingle || !api.wakeByAddressAll)
+                {
+                    api.waitOnAddress = 0;
+                    api.wakeByAddressSingle = 0;
+                    api.wakeByAddressAll = 0;
+                }
+                InterlockedExchange(&state,2);
+            }
+            else
+            {
+                while(state != 2)
+                {
+                    cpuPause();
+                }
+            }
+        }
+        return api;
+    }
+#endif
+
+    //! 锁字仍然是value时挂起当前线程,可能会无故返回.
+    /*!
+        \param round 第几次挂起,没有可用的挂起方式时用来决定让出时间片还是睡眠.
+    */
+    void waitWord(volatile ULock::Word *word,ULock::Word value,bool processShared,int round)
+    {
+#ifdef _WIN32
+        const AddressWaitApi &api = addressWaitApi();
+        if(!processShared && api.waitOnAddress)
+        {
+            api.waitOnAddress(word,&value,sizeof(value),INFINITE);
+            return;
+        }
+        if(round < 4 && SwitchToThread())
+        {
+            return;
+        }
+        Sleep(round < 8 ? 0 : 1);
+#else
+        (void)round;
+        syscall(SYS_futex,word,processShared ? FUTEX_WAIT : FUTEX_WAIT_PRIVATE,value,0,0,0);
+#endif
+    }
+
+    //! 唤醒所有在word上挂起的线程(进程内).
+    void wakeAllWord(volatile ULock::Word *word)
+    {
+#ifdef _WIN32
+        const AddressWaitApi &api = addressWaitApi();
+        if(api.wakeByAddressAll)
+        {
+            api.wakeByAddressAll(const_cast<ULock::Word *>(word));
+        }
+#else
+        syscall(SYS_futex,word,FUTEX_WAKE_PRIVATE,INT_MAX,0,0,0);
+#endif
+    }
+}
+
+void ULock::lockContended()
+{
+    if(!statsEnabled_)
+    {
+        lockSlow(&state_,false);
+        return;
+    }
+    const long long start = nowMicroseconds();
+    lockSlow(&state_,false);
+    stats_.acquisitions++;
+    stats_.contentions++;
+    stats_.waitTime += nowMicroseconds() - start;
+}
+
+void ULock::lockSlow( volatile Word *word,bool processShared )
+{
+    //锁很快就会被释放时,自旋比挂起线程代价小得多.
+    for(int i = 0; i < SpinCount; i++)
+    {
+        cpuPause();
+        //挂起的线程被唤醒后总会把锁字置为2,所以这里直接置为1也不会漏掉唤醒.
+        if(loadWord(word) == 0 && tryLockWord(word))
+        {
+            return;
+        }
+    }
+    for(int round = 0; exchangeWord(word,2) != 0; round++)
+    {
+        waitWord(word,2,processShared,round);
+    }
+}
+
+void ULock::wake( volatile Word *word,bool processShared )
+{
+#ifdef _WIN32
+    const AddressWaitApi &api = addressWaitApi();
+    if(!processShared && api.wakeByAddressSingle)
+    {
+        api.wakeByAddressSingle(const_cast<Word *>(word));
+    }
+#else
+    syscall(SYS_futex,word,processShared ? FUTEX_WAKE : FUTEX_WAKE_PRIVATE,1,0,0,0);
+#endif
+}
+
+void URWLock::lockShared()
+{
+    for(int round = 0; ; round++)
+    {
+        const ULock::Word state = loadWord(&state_);
+        if(!(state & WriterBit) && !loadWord(&writersWaiting_))
+        {
+            if(compareExchangeWord(&state_,state + ReaderUnit,state))
+            {
+                return;
+            }
+            //只是和其他读者冲突,立即重试.
+            continue;
+        }
+        if(round < SpinCount)
+        {
+            cpuPause();
+            continue;
+        }
+        wait(state,round - SpinCount);
+    }
+}
+
+void URWLock::unlockShared()
+{
+    const ULock::Word state = addWord(&state_,-ReaderUnit);
+    if(state == 0 && loadWord(&waiters_))
+    {
+        wakeWaiters();
+    }
+}
+
+void URWLock::lock()
+{
+    if(compareExchangeWord(&state_,WriterBit,0))
+    {
+        return;
+    }
+    //在等待写锁期间阻止新的读者进入.
+    addWord(&writersWaiting_,1);
+    for(int round = 0; ; round++)
+    {
+        const ULock::Word state = loadWord(&state_);
+        if(!state && compareExchangeWord(&state_,WriterBit,0))
+        {
+            break;
+        }
+        if(round < SpinCount)
+        {
+            cpuPause();
+            continue;
+        }
+        wait(state,round - SpinCount);
+    }
+    addWord(&writersWaiting_,-1);
+}
+
+void URWLock::unlock()
+{
+    addWord(&state_,-WriterBit);
+    if(loadWord(&waiters_))
+    {
+        wakeWaiters();
+    }
+}
+
+void URWLock::wait( ULock::Word value,int round )
+{
+    //先登记再挂起,解锁的线程修改state_之后检查waiters_,两边都有完整的内存屏障,不会漏掉唤醒.
+    addWord(&waiters_,1);
+    waitWord(&state_,value,false,round);
+    addWord(&waiters_,-1);
+}
+
+void URWLock::wakeWaiters()
+{
+    wakeAllWord(&state_);
+}
+
+}//namespace uni
@@ -1,5 +1,10 @@
 ﻿/*! \file ULock.h
-    \brief Windows下简单的锁.
+    \brief 轻量的互斥锁和读写锁.
+
+    ULock先用带pause指令的有限自旋等待,仍然拿不到锁时把线程挂起,
+    Windows下使用WaitOnAddress(Windows 8以上,更早的系统退化为让出时间片),Linux下使用futex.
+    锁字只有三个状态:0表示未上锁,1表示上锁且没有等待者,2表示上锁且可能有等待者,
+    解锁时只有状态为2才需要唤醒等待的线程,所以没有竞争时加锁和解锁都只有一次原子操作.
 
     \author unigauldoth@gmail.com
     \date       2013-6-9
@@ -10,42 +15,125 @@
 #define AUTO_LINK_LIB_NAME "UniCore"
 #include "AutoLink.h"
 
+#ifdef _WIN32
 #define WIN32_LEAN_AND_MEAN
 #include "Windows.h"
+#else
+#include <pthread.h>
+#endif
 
 namespace uni
 {
-//! 简单的锁.
+
+//! 锁的竞争统计.
+struct ULockStats
+{
+    ULockStats():acquisitions(0),contentions(0),waitTime(0) {}
+    long long acquisitions; //!< 加锁的次数.
+    long long contentions;  //!< 其中没能立即拿到锁的次数.
+    long long waitTime;     //!< 没能立即拿到锁时,等待的总时间,单位为微秒.
+};
+
+//! 互斥锁.
+/*!
+    不可重入.默认不统计竞争情况,需要时调用enableStats打开.
+    统计数据在持有锁时更新,stats读取时不加锁,得到的是近似值.
+
+    lockWord/unlockWord可以对任意位置的锁字加锁,比如共享内存中的锁.
+    processShared为true时,Windows下不会使用只在进程内有效的WaitOnAddress,只自旋和让出时间片.
+*/
 class ULock
 {
 public:
-    ULock():atomic_(0) {}
+#ifdef _WIN32
+    typedef long Word;
+#else
+    typedef int Word;   //futex要求32位的锁字.
+#endif
+
+    ULock():state_(0),statsEnabled_(false) {}
     ~ULock() {}
     //! 上锁.
-    void lock() 
+    void lock()
+    {
+        if(!tryLockWord(&state_))
+        {
+            lockContended();
+        }
+        else if(statsEnabled_)
+        {
+            stats_.acquisitions++;
+        }
+    }
+    //! 尝试上锁,锁已被占用时立即返回false.
+    bool tryLock()
     {
-        do 
+        if(!tryLockWord(&state_))
         {
-            long prev = InterlockedCompareExchange(&atomic_,1,0);
-            if(atomic_ == 1 && prev == 0)
-            {
-                break;
-            }
-            if(!SwitchToThread())
-            {
-                Sleep(1);
-            }
-        } while (true);
+            return false;
+        }
+        if(statsEnabled_)
+        {
+            stats_.acquisitions++;
+        }
+        return true;
     }
     //! 解锁.
     void unlock()
     {
-        InterlockedCompareExchange(&atomic_,0,1);
+        unlockWord(&state_,false);
+    }
+
+    //! 打开或关闭竞争统计.
+    void enableStats(bool enable) {statsEnabled_ = enable;}
+    //! 读取竞争统计.
+    ULockStats stats() const {return stats_;}
+    //! 清空竞争统计.
+    void resetStats() {stats_ = ULockStats();}
+
+    //! 对word指向的锁字上锁.
+    static void lockWord(volatile Word *word,bool processShared)
+    {
+        if(!tryLockWord(word))
+        {
+            lockSlow(word,processShared);
+        }
     }
+    //! 尝试对word指向的锁字上锁.
+    static bool tryLockWord(volatile Word *word)
+    {
+#ifdef _WIN32
+        return InterlockedCompareExchange(word,1,0) == 0;
+#else
+        Word expected = 0;
+        return __atomic_compare_exchange_n(word,&expected,1,false,__ATOMIC_ACQUIRE,__ATOMIC_RELAXED);
+#endif
+    }
+    //! 对word指向的锁字解锁.
+    static void unlockWord(volatile Word *word,bool processShared)
+    {
+#ifdef _WIN32
+        if(InterlockedExchange(word,0) == 2)
+#else
+        if(__atomic_exchange_n(word,0,__ATOMIC_RELEASE) == 2)
+#endif
+        {
+            wake(word,processShared);
+        }
+    }
+
 private:
     ULock(const ULock&);
     ULock& operator=(const ULock&);
-    volatile long atomic_;
+    //! 没能立即拿到锁时的慢速路径,顺便统计等待时间.
+    void lockContended();
+    //! 自旋和挂起,直到拿到锁为止.返回时锁字的状态为2.
+    static void lockSlow(volatile Word *word,bool processShared);
+    static void wake(volatile Word *word,bool processShared);
+
+    volatile Word state_;
+    bool statsEnabled_;
+    ULockStats stats_;
 };
 
 //! 区域锁.
@@ -70,6 +158,148 @@ private:
     ULock &lock_;
 };
 
+//! 写优先的读写锁.
+/*!
+    适合读多写少的数据.有线程在等待写锁时,新的读者也会等待,所以写者不会饿死,
+    但这也意味着读锁不可重入:持有读锁时再加读锁,如果中间有写者开始等待就会死锁.
+    等待时先自旋,再像ULock一样挂起.
+*/
+class URWLock
+{
+public:
+    URWLock():state_(0),writersWaiting_(0),waiters_(0) {}
+    ~URWLock() {}
+    //! 加读锁.
+    void lockShared();
+    //! 解读锁.
+    void unlockShared();
+    //! 加写锁.
+    void lock();
+    //! 解写锁.
+    void unlock();
+private:
+    URWLock(const URWLock&);
+    URWLock& operator=(const URWLock&);
+    //! 在state_仍然是value时挂起.
+    void wait(ULock::Word value,int round);
+    //! 唤醒所有挂起的线程,让它们重新检查状态.
+    void wakeWaiters();
+
+    enum
+    {
+        WriterBit = 1,  //!< 有写者持有锁.
+        ReaderUnit = 2  //!< 读者的数量保存在其余的位中.
+    };
+    volatile ULock::Word state_;
+    volatile ULock::Word writersWaiting_;   //!< 正在等待写锁的线程数.
+    volatile ULock::Word waiters_;          //!< 已经挂起的线程数,为0时解锁不需要唤醒.
+};
+
+#ifdef _WIN32
+#define UNI_CACHE_LINE_ALIGN DECLSPEC_ALIGN(64)
+#else
+#define UNI_CACHE_LINE_ALIGN __attribute__((aligned(64)))
+#endif
+
+//! 分片的读写锁.
+/*!
+    每个线程只对自己所在的分片加读锁,不同线程的读者不会争用同一个缓存行;
+    写者要按顺序锁住所有分片,所以写锁的代价是URWLock的N倍,只适合极少修改的数据.
+    \param N 分片数.
+*/
+template<int N>
+class UShardedLock
+{
+public:
+    UShardedLock() {}
+    ~UShardedLock() {}
+    //! 加读锁.
+    void lockShared() {shards_[currentShard()].lock.lockShared();}
+    //! 解读锁,必须和lockShared在同一个线程中调用.
+    void unlockShared() {shards_[currentShard()].lock.unlockShared();}
+    //! 加写锁.
+    void lock()
+    {
+        for(int i = 0; i < N; i++)
+        {
+            shards_[i].lock.lock();
+        }
+    }
+    //! 解写锁.
+    void unlock()
+    {
+        for(int i = N - 1; i >= 0; i--)
+        {
+            shards_[i].lock.unlock();
+        }
+    }
+private:
+    UShardedLock(const UShardedLock&);
+    UShardedLock& operator=(const UShardedLock&);
+    static int currentShard()
+    {
+#ifdef _WIN32
+        //线程ID总是4的倍数.
+        return static_cast<int>((GetCurrentThreadId() >> 2) % N);
+#else
+        const size_t self = reinterpret_cast<size_t>(reinterpret_cast<void *>(pthread_self()));
+        return static_cast<int>(((self >> 12) * 2654435761u) % N);
+#endif
+    }
+    //! 每个分片独占一个缓存行.
+    struct UNI_CACHE_LINE_ALIGN Shard
+    {
+        URWLock lock;
+    };
+    Shard shards_[N];
+};
+
+//! 区域读锁.
+/*!
+    声明的时候加读锁,变量销毁时解锁.Lock可以是URWLock或UShardedLock.
+*/
+template<typename Lock>
+class UScopedReadLock
+{
+public:
+    explicit UScopedReadLock(Lock &lock)
+        :lock_(lock)
+    {
+        lock_.lockShared();
+    }
+    ~UScopedReadLock()
+    {
+        lock_.unlockShared();
+    }
+private:
+    UScopedReadLock(const UScopedReadLock&);
+    UScopedReadLock& operator=(const UScopedReadLock&);
+    Lock &lock_;
+};
+
+//! 区域写锁.
+/*!
+    声明的时候加写锁,变量销毁时解锁.Lock可以是URWLock或UShardedLock.
+*/
+template<typename Lock>
+class UScopedWriteLock
+{
+public:
+    explicit UScopedWriteLock(Lock &lock)
+        :lock_(lock)
+    {
+        lock_.lock();
+    }
+    ~UScopedWriteLock()
+    {
+        lock_.unlock();
+    }
+private:
+    UScopedWriteLock(const UScopedWriteLock&);
+    UScopedWriteLock& operator=(const UScopedWriteLock&);
+    Lock &lock_;
+};
+
 }//namespace uni
 
-#endif//UNICORE_ULOCK_H
\ No newline at end of file
+#endif//UNICORE_ULOCK_H
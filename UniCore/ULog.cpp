@@ -1,10 +1,15 @@
 ﻿#include "ULog.h"
 
+#include <algorithm>
+#include <deque>
 #include <map>
+#include <unordered_set>
+#include <process.h>
 #include <string>
 
 #include "UCast.h"
 #include "UCommon.h"
+#include "UCompress.h"
 #include "UDebug.h"
 #include "UMemory.h"
 
@@ -16,28 +21,668 @@ namespace uni
 
 std::map<std::string,std::tr1::shared_ptr<ULog::Appender> > ULog::appenders_;
 std::map<std::string,std::vector<std::string> > ULog::appendersForName_;
-ULock ULog::mutexForAppenders_;
+ULog::RegistryLock ULog::mutexForAppenders_;
 
-std::map<ULog::Type,bool> ULog::typeFilter_;
-std::map<std::string,bool> ULog::nameFilter_;
+volatile long ULog::typeFilterMask_ = 0;
+ULog::FilterSnapshot * volatile ULog::nameFilter_ = 0;
+volatile long ULog::filterGeneration_ = 1;
 ULock ULog::mutexForFilters_;
 
 std::set<std::string> ULog::names_;
-ULock ULog::mutexForNames_;
+ULog::RegistryLock ULog::mutexForNames_;
 
 _locale_t ULog::loc_ = _create_locale(LC_ALL,"");
 
 std::string ULog::projectName_;
 
+namespace
+{
+    //! 当前线程正在调用其append的输出源,这时线程持有输出源表的读锁和这个输出源的锁.
+    __declspec(thread) ULog::Appender *g_appendingAppender = 0;
+
+    //! 在作用域内记录当前线程正在调用的输出源,append抛出异常时也会恢复.
+    class AppendingScope
+    {
+    public:
+        explicit AppendingScope(ULog::Appender *appender)
+            :previous_(g_appendingAppender)
+        {
+            g_appendingAppender = appender;
+        }
+        ~AppendingScope()
+        {
+            g_appendingAppender = previous_;
+        }
+    private:
+        AppendingScope(const AppendingScope &);
+        AppendingScope &operator=(const AppendingScope &);
+
+        ULog::Appender *previous_;
+    };
+}
+
+//! 分组过滤设置的快照.
+/*!
+    快照创建后不再修改,读取时不需要加锁.修改设置时创建新的快照替换掉nameFilter_,
+    旧的快照通过previous_串起来,不会被释放.
+*/
+struct ULog::FilterSnapshot
+{
+    explicit FilterSnapshot(FilterSnapshot *previous)
+        :previous_(previous)
+    {
+        if(previous)
+        {
+            filteredNames_ = previous->filteredNames_;
+        }
+    }
+    std::tr1::unordered_set<std::string> filteredNames_;
+    FilterSnapshot *previous_;
+};
+
+//! Message的缓存.
+/*!
+    每个线程有一个只由自己访问的缓存链表,取出和放回都不需要同步.
+    线程缓存满时,Message被放入所有线程共享的无锁链表(SLIST),缓存空时也从共享链表中取.
+    异步输出时由后台线程回收的Message就是通过共享链表回到日志线程的.
+    线程结束时,其缓存中的Message被移到共享链表.
+*/
+class ULog::MessagePool
+{
+public:
+    static Message *acquire(Type type,const char *file,int line,const char *function)
+    {
+        ThreadCache *cache = threadCache();
+        Node *node = 0;
+        if(cache && cache->head)
+        {
+            node = cache->head;
+            cache->head = static_cast<Node *>(node->entry.Next);
+            cache->count--;
+        }
+        else
+        {
+            node = static_cast<Node *>(InterlockedPopEntrySList(&sharedList_));
+        }
+        if(node)
+        {
+            node->message.reset(type,file,line,function);
+            return &node->message;
+        }
+        node = new Node(type,file,line,function);
+        return &node->message;
+    }
+
+    static void release(Message *message)
+    {
+        Node *node = CONTAINING_RECORD(message,Node,message);
+        const long cacheSize = cacheSize_;
+        if(cacheSize <= 0)
+        {
+            delete node;
+            return;
+        }
+        ThreadCache *cache = threadCache();
+        if(cache && cache->count < cacheSize)
+        {
+            node->message.stm_.reset();
+            node->entry.Next = cache->head;
+            cache->head = node;
+            cache->count++;
+        }
+        else if(QueryDepthSList(&sharedList_) < SharedListCapacity)
+        {
+            node->message.stm_.reset();
+            InterlockedPushEntrySList(&sharedList_,&node->entry);
+        }
+        else
+        {
+            delete node;
+        }
+    }
+
+    static void setCacheSize(int count)
+    {
+        InterlockedExchange(&cacheSize_,count);
+    }
+private:
+    enum {SharedListCapacity = 1024};
+
+    //! SLIST要求链表节点按MEMORY_ALLOCATION_ALIGNMENT对齐.
+    struct DECLSPEC_ALIGN(MEMORY_ALLOCATION_ALIGNMENT) Node
+    {
+        Node(Type type,const char *file,int line,const char *function)
+            :message(type,file,line,function)
+        {
+            entry.Next = 0;
+        }
+        SLIST_ENTRY entry;
+        Message message;
+    };
+
+    struct ThreadCache
+    {
+        ThreadCache() :head(0),count(0) {}
+        Node *head;
+        long count;
+    };
+
+    typedef DWORD (WINAPI *FlsAllocFunc)(PFLS_CALLBACK_FUNCTION);
+    typedef PVOID (WINAPI *FlsGetValueFunc)(DWORD);
+    typedef BOOL (WINAPI *FlsSetValueFunc)(DWORD,PVOID);
+
+    //! 返回当前线程的缓存,不使用缓存或者无法分配时返回0.
+    static ThreadCache *threadCache()
+    {
+        if(cacheSize_ <= 0 || !initSlot())
+        {
+            return 0;
+        }
+        ThreadCache *cache = static_cast<ThreadCache *>(getSlot());
+        if(!cache)
+        {
+            cache = new ThreadCache;
+            setSlot(cache);
+        }
+        return cache;
+    }
+
+    //! 分配线程局部存储.优先使用FLS,以便在线程结束时回收缓存;没有FLS的系统上使用TLS.
+    static bool initSlot()
+    {
+        if(slotState_ == SlotReady)
+        {
+            return true;
+        }
+        if(InterlockedCompareExchange(&slotState_,SlotInitializing,SlotUninitialized) == SlotUninitialized)
+        {
+            HMODULE kernel32 = GetModuleHandleW(L"kernel32.dll");
+            FlsAllocFunc flsAlloc = (FlsAllocFunc)GetProcAddress(kernel32,"FlsAlloc");
+            flsGetValue_ = (FlsGetValueFunc)GetProcAddress(kernel32,"FlsGetValue");
+            flsSetValue_ = (FlsSetValueFunc)GetProcAddress(kernel32,"FlsSetValue");
+            if(flsAlloc && flsGetValue_ && flsSetValue_)
+            {
+                slot_ = flsAlloc(&MessagePool::onThreadExit);
+                useFls_ = slot_ != FLS_OUT_OF_INDEXES;
+            }
+            if(!useFls_)
+            {
+                slot_ = TlsAlloc();
+            }
+            InterlockedExchange(&slotState_,
+                slot_ == TLS_OUT_OF_INDEXES ? SlotFailed : SlotReady);
+        }
+        while(slotState_ == SlotInitializing)
+        {
+            SwitchToThread();
+        }
+        return slotState_ == SlotReady;
+    }
+
+    static void *getSlot()
+    {
+        return useFls_ ? flsGetValue_(slot_) : TlsGetValue(slot_);
+    }
+
+    static void setSlot(void *value)
+    {
+        if(useFls_)
+        {
+            flsSetValue_(slot_,value);
+        }
+        else
+        {
+            TlsSetValue(slot_,value);
+        }
+    }
+
+    static void WINAPI onThreadExit(void *data)
+    {
+        ThreadCache *cache = static_cast<ThreadCache *>(data);
+        if(!cache)
+        {
+            return;
+        }
+        while(cache->head)
+        {
+            Node *node = cache->head;
+            cache->head = static_cast<Node *>(node->entry.Next);
+            if(QueryDepthSList(&sharedList_) < SharedListCapacity)
+            {
+                InterlockedPushEntrySList(&sharedList_,&node->entry);
+            }
+            else
+            {
+                delete node;
+            }
+        }
+        delete cache;
+    }
+
+    enum {SlotUninitialized,SlotInitializing,SlotReady,SlotFailed};
+
+    static SLIST_HEADER sharedList_;
+    static volatile long cacheSize_;
+    static volatile long slotState_;
+    static DWORD slot_;
+    static bool useFls_;
+    static FlsGetValueFunc flsGetValue_;
+    static FlsSetValueFunc flsSetValue_;
+};
+
+//以下均为常量初始化,在其他编译单元的静态对象构造时就可以使用.
+//全0的SLIST_HEADER就是空链表.
+SLIST_HEADER ULog::MessagePool::sharedList_;
+volatile long ULog::MessagePool::cacheSize_ = 32;
+volatile long ULog::MessagePool::slotState_ = ULog::MessagePool::SlotUninitialized;
+DWORD ULog::MessagePool::slot_ = TLS_OUT_OF_INDEXES;
+bool ULog::MessagePool::useFls_ = false;
+ULog::MessagePool::FlsGetValueFunc ULog::MessagePool::flsGetValue_ = 0;
+ULog::MessagePool::FlsSetValueFunc ULog::MessagePool::flsSetValue_ = 0;
+
+void ULog::MessageBuffer::reserve(size_t capacity)
+{
+    const size_t currentSize = size();
+    const size_t currentCapacity = epptr() - pbase();
+    if(capacity <= currentCapacity)
+    {
+        return;
+    }
+    size_t newCapacity = currentCapacity * 2;
+    if(newCapacity < capacity)
+    {
+        newCapacity = capacity;
+    }
+    wchar_t *newHeap = new wchar_t[newCapacity];
+    wmemcpy(newHeap,pbase(),currentSize);
+    delete []heap_;
+    heap_ = newHeap;
+    setp(heap_,heap_ + newCapacity);
+    pbump(static_cast<int>(currentSize));
+}
+
+void ULog::MessageBuffer::truncate(size_t newSize)
+{
+    assert(newSize <= size());
+    wchar_t *base = pbase();
+    wchar_t *end = epptr();
+    setp(base,end);
+    pbump(static_cast<int>(newSize));
+}
+
+void ULog::MessageBuffer::reset()
+{
+    if(heap_ && epptr() - pbase() > MaxRetainedCapacity)
+    {
+        //一条特别长的日志不应该让缓存一直占用大块内存.
+        delete []heap_;
+        heap_ = 0;
+        setp(inline_,inline_ + InlineCapacity);
+    }
+    else
+    {
+        setp(pbase(),epptr());
+    }
+}
+
+ULog::MessageBuffer::int_type ULog::MessageBuffer::overflow(int_type c)
+{
+    if(traits_type::eq_int_type(c,traits_type::eof()))
+    {
+        return traits_type::not_eof(c);
+    }
+    reserve(size() + 1);
+    *pptr() = traits_type::to_char_type(c);
+    pbump(1);
+    return c;
+}
+
+std::streamsize ULog::MessageBuffer::xsputn(const wchar_t *s,std::streamsize count)
+{
+    if(count <= 0)
+    {
+        return 0;
+    }
+    reserve(size() + static_cast<size_t>(count));
+    wmemcpy(pptr(),s,static_cast<size_t>(count));
+    pbump(static_cast<int>(count));
+    return count;
+}
+
+void ULog::MessageStream::reset()
+{
+    MessageBuffer::reset();
+    clear();
+    flags(std::ios_base::skipws|std::ios_base::dec);
+    fill(L' ');
+    width(0);
+    precision(6);
+}
+
+//! 异步输出的后台线程及其使用的有界队列.
+/*!
+    队列是一个定长的环形数组,每个格子带有序号,多个线程可以无锁地放入和取出.
+    日志线程放入日志,后台线程取出日志并交给输出源.队列满时按照OverflowPolicy处理.
+*/
+class ULog::AsyncDispatcher
+{
+public:
+    AsyncDispatcher()
+        :cells_(0),mask_(0),policy_(BlockWhenFull),enqueuePos_(0),dequeuePos_(0)
+        ,accepting_(0),activeProducers_(0),stopRequested_(0),sleeping_(0)
+        ,blockedProducers_(0),processed_(0),dropped_(0)
+        ,hThread_(NULL),threadId_(0)
+    {
+        hWakeEvent_ = CreateEventW(NULL,FALSE,FALSE,NULL);
+        hNotFullEvent_ = CreateEventW(NULL,FALSE,FALSE,NULL);
+        hProgressEvent_ = CreateEventW(NULL,FALSE,FALSE,NULL);
+    }
+    ~AsyncDispatcher()
+    {
+        //程序退出时输出队列中剩余的日志.
+        stop();
+        CloseHandle(hWakeEvent_);
+        CloseHandle(hNotFullEvent_);
+        CloseHandle(hProgressEvent_);
+    }
+
+    //! 启动后台线程,调用前必须已经stop.
+    bool start(int capacity,OverflowPolicy policy)
+    {
+        long size = 2;
+        while(size < capacity && size < 0x1000000)
+        {
+            size <<= 1;
+        }
+        cells_ = new Cell[size];
+        for(long i = 0; i < size; i++)
+        {
+            cells_[i].sequence = i;
+            cells_[i].message = 0;
+        }
+        mask_ = size - 1;
+        policy_ = policy;
+        enqueuePos_ = 0;
+        dequeuePos_ = 0;
+        stopRequested_ = 0;
+        sleeping_ = 0;
+        processed_ = 0;
+        dropped_ = 0;
+        hThread_ = (HANDLE)_beginthreadex(NULL,0,&AsyncDispatcher::run,this,0,&threadId_);
+        if(!hThread_)
+        {
+            DebugMessage("UniCore ULog::enableAsyncOutput 无法创建后台线程.");
+            delete []cells_;
+            cells_ = 0;
+            return false;
+        }
+        InterlockedExchange(&accepting_,1);
+        return true;
+    }
+
+    //! 停止接收新的日志,输出队列中剩余的日志后结束后台线程.
+    void stop()
+    {
+        if(!hThread_ || GetCurrentThreadId() == threadId_)
+        {
+            //后台线程无法等待自己结束.
+            return;
+        }
+        InterlockedExchange(&accepting_,0);
+        //等待正在放入日志的线程完成.
+        while(activeProducers_)
+        {
+            SwitchToThread();
+        }
+        InterlockedExchange(&stopRequested_,1);
+        SetEvent(hWakeEvent_);
+        WaitForSingleObject(hThread_,INFINITE);
+        CloseHandle(hThread_);
+        hThread_ = NULL;
+        threadId_ = 0;
+        delete []cells_;
+        cells_ = 0;
+    }
+
+    bool isRunning() const
+    {
+        return accepting_ != 0;
+    }
+
+    //! 把日志放入队列.
+    /*!
+        \return 返回true则日志的所有权已经转交给dispatcher(已放入队列或已被丢弃),
+        返回false则表示未开启异步输出,调用者需要自己输出.
+    */
+    bool post(Message *message)
+    {
+        const bool onWorkerThread = GetCurrentThreadId() == threadId_;
+        if(!accepting_)
+        {
+            if(onWorkerThread)
+            {
+                //正在关闭时输出源又输出了日志,此时输出源的锁被后台线程持有,只能丢弃.
+                MessagePool::release(message);
+                InterlockedIncrement(&dropped_);
+                return true;
+            }
+            return false;
+        }
+        InterlockedIncrement(&activeProducers_);
+        if(!accepting_)
+        {
+            InterlockedDecrement(&activeProducers_);
+            return false;
+        }
+        time(&message->time_);
+        LARGE_INTEGER ticks;
+        QueryPerformanceCounter(&ticks);
+        message->ticks_ = ticks.QuadPart;
+        while(!tryPush(message))
+        {
+            if(policy_ == DropNewest || onWorkerThread)
+            {
+                //后台线程自己输出的日志不能阻塞,否则会死锁.
+                MessagePool::release(message);
+                InterlockedIncrement(&dropped_);
+                message = 0;
+                break;
+            }
+            else if(policy_ == DropOldest)
+            {
+                Message *oldest = 0;
+                if(tryPop(oldest))
+                {
+                    MessagePool::release(oldest);
+                    InterlockedIncrement(&dropped_);
+                    InterlockedIncrement(&processed_);
+                }
+            }
+            else
+            {
+                InterlockedIncrement(&blockedProducers_);
+                wakeWorker();
+                WaitForSingleObject(hNotFullEvent_,1);
+                InterlockedDecrement(&blockedProducers_);
+            }
+        }
+        if(message && sleeping_)
+        {
+            wakeWorker();
+        }
+        InterlockedDecrement(&activeProducers_);
+        return true;
+    }
+
+    //! 等待调用前放入队列的日志全部输出完毕(或被丢弃).
+    void waitUntilDrained()
+    {
+        if(!accepting_ || GetCurrentThreadId() == threadId_)
+        {
+            return;
+        }
+        //每个放入队列的日志都占用一个位置,取出时按相同顺序,
+        //所以处理过的日志数达到当前的放入位置时,之前的日志都已处理完.
+        const long target = enqueuePos_;
+        while(accepting_ && processed_ - target < 0)
+        {
+            wakeWorker();
+            WaitForSingleObject(hProgressEvent_,1);
+        }
+    }
+
+    long droppedCount() const
+    {
+        return dropped_;
+    }
+private:
+    struct Cell
+    {
+        volatile long sequence;
+        Message *message;
+    };
+
+    AsyncDispatcher(const AsyncDispatcher &);
+    AsyncDispatcher &operator=(const AsyncDispatcher &);
+
+    bool tryPush(Message *message)
+    {
+        Cell *cell = 0;
+        long pos = enqueuePos_;
+        for(;;)
+        {
+            cell = &cells_[pos & mask_];
+            const long diff = cell->sequence - pos;
+            if(diff == 0)
+            {
+                if(InterlockedCompareExchange(&enqueuePos_,pos + 1,pos) == pos)
+                {
+                    break;
+                }
+            }
+            else if(diff < 0)
+            {
+                //队列已满.
+                return false;
+            }
+            pos = enqueuePos_;
+        }
+        cell->message = message;
+        InterlockedExchange(&cell->sequence,pos + 1);
+        return true;
+    }
+
+    bool tryPop(Message *&message)
+    {
+        Cell *cell = 0;
+        long pos = dequeuePos_;
+        for(;;)
+        {
+            cell = &cells_[pos & mask_];
+            const long diff = cell->sequence - (pos + 1);
+            if(diff == 0)
+            {
+                if(InterlockedCompareExchange(&dequeuePos_,pos + 1,pos) == pos)
+                {
+                    break;
+                }
+            }
+            else if(diff < 0)
+            {
+                //队列为空.
+                return false;
+            }
+            pos = dequeuePos_;
+        }
+        message = cell->message;
+        InterlockedExchange(&cell->sequence,pos + mask_ + 1);
+        return true;
+    }
+
+    void wakeWorker()
+    {
+        if(InterlockedExchange(&sleeping_,0))
+        {
+            SetEvent(hWakeEvent_);
+        }
+    }
+
+    static unsigned __stdcall run(void *param)
+    {
+        static_cast<AsyncDispatcher *>(param)->drainLoop();
+        return 0;
+    }
+
+    void drainLoop()
+    {
+        for(;;)
+        {
+            Message *message = 0;
+            while(tryPop(message))
+            {
+                ULog::dispatch(message);
+                MessagePool::release(message);
+                InterlockedIncrement(&processed_);
+                if(blockedProducers_)
+                {
+                    SetEvent(hNotFullEvent_);
+                }
+            }
+            SetEvent(hProgressEvent_);
+            if(stopRequested_ && enqueuePos_ == dequeuePos_)
+            {
+                break;
+            }
+            //先声明要睡眠,再检查一次队列,防止错过唤醒.
+            InterlockedExchange(&sleeping_,1);
+            if(enqueuePos_ != dequeuePos_ || stopRequested_)
+            {
+                InterlockedExchange(&sleeping_,0);
+                continue;
+            }
+            WaitForSingleObject(hWakeEvent_,INFINITE);
+            InterlockedExchange(&sleeping_,0);
+        }
+    }
+
+    Cell *cells_;
+    long mask_;
+    OverflowPolicy policy_;
+    volatile long enqueuePos_;
+    volatile long dequeuePos_;
+    volatile long accepting_;
+    volatile long activeProducers_;
+    volatile long stopRequested_;
+    volatile long sleeping_;
+    volatile long blockedProducers_;
+    volatile long processed_;
+    volatile long dropped_;
+    HANDLE hWakeEvent_;
+    HANDLE hNotFullEvent_;
+    HANDLE hProgressEvent_;
+    HANDLE hThread_;
+    unsigned int threadId_;
+};
+
+//必须在输出源之后定义,保证程序退出时先输出队列中剩余的日志,再销毁输出源.
+ULog::AsyncDispatcher ULog::asyncDispatcher_;
+ULock ULog::mutexForAsync_;
+
 ULog uLog(ULog::Type type,const char *file,int line,const char *function)
 {
     return ULog(type,file,line,function);
 }
 
-ULog::ULog(Type type,const char *file,int line,const char *function)
+ULog uLog(ULog::Type type,const char *file,int line,const char *function,ULogSite &site)
+{
+    return ULog(type,file,line,function,&site);
+}
+
+ULog::ULog(Type type,const char *file,int line,const char *function,ULogSite *site /*= 0*/)
 :lastError_(GetLastError())
-,message_(new Message(type,file,line,function))
+,message_(MessagePool::acquire(type,file,line,function))
 {
+    message_->site_ = site;
 }
 
 ULog::ULog(const ULog &log)
@@ -62,55 +707,90 @@ ULog::~ULog()
 {
     if(!--message_->ref_)
     {
-        bool filtered = false;
-        {
-            UScopedLock lock(mutexForFilters_);
-            filtered = typeFilter_[message_->type_] || nameFilter_[message_->name_];
-        }
+        const bool filtered = message_->filtered_
+            || !isOutputEnabled(message_->type_)
+            || isNameFiltered(message_->name_);
         if(!filtered)
         {
             //允许输出。
             //检查是否有分隔符。
-            std::wstring message = message_->stm_.str();
-            if(!message_->delim_.empty())
+            const size_t delimSize = message_->delim_.size();
+            const size_t messageSize = message_->stm_.size();
+            if(delimSize && messageSize >= delimSize
+                && !wmemcmp(message_->stm_.data() + messageSize - delimSize,
+                    message_->delim_.c_str(),delimSize))
             {
                 //删除尾部多余的分隔符.
-                wstring::size_type pos = message.rfind(message_->delim_);
-                if(pos != string::npos
-                    && pos + message_->delim_.size() == message.size())
-                {
-                    message.erase(pos);
-                    message_->stm_.str(message);
-                }
+                message_->stm_.truncate(messageSize - delimSize);
             }
-            UScopedLock lock(mutexForAppenders_);
-            vector<string> appenderNames = appendersForName_[message_->name_];
-            if(appenderNames.empty())
+            if(asyncDispatcher_.post(message_))
             {
-                //当前分组没有输出源,使用无分组日志的输出源.
-                if(appendersForName_[""].empty())
-                {
-                    //无分组日志也没有输出源,添加一个默认输出源.
-                    if(!appenders_.count("default"))
-                    {
-                        appenders_["default"] = 
-                            std::tr1::shared_ptr<Appender>(new DebuggerAppender);
-                    }
-                    appendersForName_[""].push_back("default");
-                }
-                appenderNames = appendersForName_[""];
+                //日志已经交给后台线程.
+                message_ = 0;
+                return;
             }
-            for(int i = 0; i < appenderNames.size(); i++)
+            dispatch(message_);
+        }
+        MessagePool::release(message_);
+        message_ = 0;
+    }
+}
+
+void ULog::dispatch(Message *message)
+{
+    if(message->format_)
+    {
+        formatArgs(message);
+    }
+    {
+        UScopedReadLock<RegistryLock> lock(mutexForAppenders_);
+        if(appendLocked(message))
+        {
+            return;
+        }
+    }
+    {
+        //无分组日志也没有输出源,添加一个默认输出源.
+        UScopedWriteLock<RegistryLock> lock(mutexForAppenders_);
+        vector<string> &defaultAppenders = appendersForName_[""];
+        if(defaultAppenders.empty())
+        {
+            if(!appenders_.count("default"))
             {
-                if(appenders_.count(appenderNames[i]))
-                {
-                    appenders_[appenderNames[i]]->append(message_);
-                }
+                appenders_["default"] = 
+                    std::tr1::shared_ptr<Appender>(new DebuggerAppender);
             }
+            defaultAppenders.push_back("default");
         }
-        delete message_;
-        message_ = 0;
     }
+    UScopedReadLock<RegistryLock> lock(mutexForAppenders_);
+    appendLocked(message);
+}
+
+bool ULog::appendLocked(Message *message)
+{
+    map<string,vector<string> >::const_iterator group = appendersForName_.find(message->name_);
+    if(group == appendersForName_.end() || group->second.empty())
+    {
+        //当前分组没有输出源,使用无分组日志的输出源.
+        group = appendersForName_.find("");
+        if(group == appendersForName_.end() || group->second.empty())
+        {
+            return false;
+        }
+    }
+    const vector<string> &appenderNames = group->second;
+    for(size_t i = 0; i < appenderNames.size(); i++)
+    {
+        map<string,tr1::shared_ptr<Appender> >::const_iterator it = appenders_.find(appenderNames[i]);
+        if(it != appenders_.end())
+        {
+            UScopedLock lock(it->second->lock_);
+            AppendingScope scope(it->second.get());
+            it->second->append(message);
+        }
+    }
+    return true;
 }
 
 void ULog::swap(ULog &log)
@@ -123,14 +803,15 @@ void ULog::setAppenders(const std::string &name,const std::string &appenderList)
 {
     vector<string> appenderNames = split(appenderList);
 
-    UScopedLock lock(mutexForAppenders_);
+    UScopedWriteLock<RegistryLock> lock(mutexForAppenders_);
     appendersForName_[name] = appenderNames;
 }
 
 vector<std::string> ULog::getAppenders( const std::string &name )
 {
-    UScopedLock lock(mutexForAppenders_);
-    return appendersForName_[name];
+    UScopedReadLock<RegistryLock> lock(mutexForAppenders_);
+    map<string,vector<string> >::const_iterator it = appendersForName_.find(name);
+    return it != appendersForName_.end() ? it->second : vector<string>();
 }
 
 void ULog::registerAppender( const std::string &appenderName,Appender *appender )
@@ -139,8 +820,8 @@ void ULog::registerAppender( const std::string &appenderName,Appender *appender
     {
         return;
     }
-    UScopedLock lock(mutexForAppenders_);
     std::tr1::shared_ptr<Appender> p(appender);
+    UScopedWriteLock<RegistryLock> lock(mutexForAppenders_);
     appenders_[appenderName] = p;
 }
 
@@ -162,7 +843,7 @@ bool ULog::isAppenderNameValid(const std::string &appenderName)
 
 vector<string> ULog::getRegisteredAppenderNames()
 {
-    UScopedLock lock(mutexForAppenders_);
+    UScopedReadLock<RegistryLock> lock(mutexForAppenders_);
     vector<string> result;
     map<string,tr1::shared_ptr<Appender> >::const_iterator it;
     for(it = appenders_.begin(); it != appenders_.end(); ++it)
@@ -174,39 +855,72 @@ vector<string> ULog::getRegisteredAppenderNames()
 
 void ULog::unregisterAppender( const std::string &appenderName )
 {
-    UScopedLock lock(mutexForAppenders_);
-    appenders_.erase(appenderName);
+    //在锁外析构,输出源的析构函数可能比较慢,比如要等后台线程结束.
+    std::tr1::shared_ptr<Appender> appender;
+    {
+        UScopedWriteLock<RegistryLock> lock(mutexForAppenders_);
+        map<string,tr1::shared_ptr<Appender> >::iterator it = appenders_.find(appenderName);
+        if(it == appenders_.end())
+        {
+            return;
+        }
+        appender = it->second;
+        appenders_.erase(it);
+    }
 }
 
 void ULog::unregisterAllAppenders()
 {
-    UScopedLock lock(mutexForAppenders_);
-    map<std::string,std::tr1::shared_ptr<Appender> >::const_iterator it;
-    appenders_.erase(appenders_.begin(),appenders_.end());
+    map<std::string,std::tr1::shared_ptr<Appender> > appenders;
+    {
+        UScopedWriteLock<RegistryLock> lock(mutexForAppenders_);
+        appenders.swap(appenders_);
+    }
 }
 
-bool ULog::isOutputEnabled( Type type )
+void ULog::enableOutput( Type type,bool enable )
 {
     UScopedLock lock(mutexForFilters_);
-    return !typeFilter_[type];
+    const long bit = 1 << type;
+    InterlockedExchange(&typeFilterMask_,enable ? typeFilterMask_ & ~bit : typeFilterMask_ | bit);
 }
 
-void ULog::enableOutput( Type type,bool enable )
+bool ULog::isOutputEnabled( const std::string &name )
 {
-    UScopedLock lock(mutexForFilters_);
-    typeFilter_[type] = !enable;
+    return !isNameFiltered(name);
 }
 
-bool ULog::isOutputEnabled( const std::string &name )
+bool ULog::isNameFiltered( const std::string &name )
 {
-    UScopedLock lock(mutexForFilters_);
-    return !nameFilter_[name];
+    const FilterSnapshot *snapshot = nameFilter_;
+    return snapshot && !snapshot->filteredNames_.empty()
+        && snapshot->filteredNames_.count(name);
 }
 
 void ULog::enableOutput( const std::string &name,bool enable )
 {
     UScopedLock lock(mutexForFilters_);
-    nameFilter_[name] = !enable;
+    if(isNameFiltered(name) == !enable)
+    {
+        return;
+    }
+    FilterSnapshot *snapshot = new FilterSnapshot(nameFilter_);
+    if(enable)
+    {
+        snapshot->filteredNames_.erase(name);
+    }
+    else
+    {
+        snapshot->filteredNames_.insert(name);
+    }
+    InterlockedExchangePointer((PVOID volatile *)&nameFilter_,snapshot);
+    InterlockedIncrement(&filterGeneration_);
+}
+
+std::set<std::string> ULog::names()
+{
+    UScopedReadLock<RegistryLock> lock(mutexForNames_);
+    return names_;
 }
 
 _locale_t ULog::locale()
@@ -214,24 +928,132 @@ _locale_t ULog::locale()
     return loc_;
 }
 
+const char *ULog::typeName( Type type )
+{
+    switch(type)
+    {
+    case TraceType:
+        return "trace";
+    case DebugType:
+        return "debug";
+    case InfoType:
+        return "info";
+    case WarnType:
+        return "warn";
+    case ErrorType:
+        return "error";
+    case FatalType:
+        return "fatal";
+    default:
+        assert(!"未知的日志类型。");
+        return "";
+    }
+}
+
+void ULog::writeTextLine( std::ostream &stm,time_t t,const std::string &name,
+    Type type,const char *func,const std::string &message,int line )
+{
+    tm timeStruct;
+    localtime_s(&timeStruct,&t);
+    char currentTime[255] = "";
+    if(asctime_s(currentTime,&timeStruct) != 0)
+    {
+        DebugMessage("UniCore ULog::writeTextLine asctime_s失败.");
+    }
+    stm<<currentTime<<" "
+        <<"{"<<name<<"}"
+        <<"["<<typeName(type)<<"]"
+        <<"["<<func<<"]"
+        <<" "<<message<<" "
+        <<"<"<<line<<">"<<endl;
+}
+
 void ULog::restoreDefaultSettings()
 {
+    disableAsyncOutput();
     {
-        UScopedLock lock(mutexForAppenders_);
+        UScopedWriteLock<RegistryLock> lock(mutexForAppenders_);
         appenders_.erase(appenders_.begin(),appenders_.end());
         appendersForName_.erase(appendersForName_.begin(),appendersForName_.end());
     }
     {
         UScopedLock lock(mutexForFilters_);
-        typeFilter_.erase(typeFilter_.begin(),typeFilter_.end());
-        nameFilter_.erase(nameFilter_.begin(),nameFilter_.end());
+        InterlockedExchange(&typeFilterMask_,0);
+        if(nameFilter_ && !nameFilter_->filteredNames_.empty())
+        {
+            FilterSnapshot *snapshot = new FilterSnapshot(nameFilter_);
+            snapshot->filteredNames_.clear();
+            InterlockedExchangePointer((PVOID volatile *)&nameFilter_,snapshot);
+            InterlockedIncrement(&filterGeneration_);
+        }
     }
     {
-        UScopedLock lock(mutexForNames_);
+        UScopedWriteLock<RegistryLock> lock(mutexForNames_);
         names_.erase(names_.begin(),names_.end());
     }
     loc_ = _create_locale(LC_ALL,"");    
     projectName_ = "";
+    setMessageCacheSize(32);
+}
+
+void ULog::enableAsyncOutput(int queueCapacity /*= 8192*/,OverflowPolicy policy /*= BlockWhenFull*/)
+{
+    UScopedLock lock(mutexForAsync_);
+    asyncDispatcher_.stop();
+    asyncDispatcher_.start(queueCapacity,policy);
+}
+
+void ULog::disableAsyncOutput()
+{
+    UScopedLock lock(mutexForAsync_);
+    asyncDispatcher_.stop();
+}
+
+bool ULog::isAsyncOutputEnabled()
+{
+    return asyncDispatcher_.isRunning();
+}
+
+void ULog::flush()
+{
+    if(g_appendingAppender)
+    {
+        //在append中调用,已经持有的锁不能再加,其它输出源正被别的线程使用时不等待,以免互相等待.
+        map<string,tr1::shared_ptr<Appender> >::const_iterator it;
+        for(it = appenders_.begin(); it != appenders_.end(); ++it)
+        {
+            if(it->second.get() == g_appendingAppender)
+            {
+                it->second->flush();
+            }
+            else if(it->second->lock_.tryLock())
+            {
+                it->second->flush();
+                it->second->lock_.unlock();
+            }
+        }
+        return;
+    }
+
+    asyncDispatcher_.waitUntilDrained();
+
+    UScopedReadLock<RegistryLock> lock(mutexForAppenders_);
+    map<string,tr1::shared_ptr<Appender> >::const_iterator it;
+    for(it = appenders_.begin(); it != appenders_.end(); ++it)
+    {
+        UScopedLock appenderLock(it->second->lock_);
+        it->second->flush();
+    }
+}
+
+long ULog::droppedMessageCount()
+{
+    return asyncDispatcher_.droppedCount();
+}
+
+void ULog::setMessageCacheSize(int count)
+{
+    MessagePool::setCacheSize(count);
 }
 
 ULog &ULog::operator<<(std::wostream &(*ostreamManipulator)(std::wostream &))
@@ -271,6 +1093,10 @@ ULog &ULog::operator<<(wchar_t t)
 
 ULog &ULog::operator<<(const std::string &t)
 {
+    if(message_->filtered_)
+    {
+        return *this;
+    }
 	message_->stm_<<s2ws(t,loc_);
 	return mayHasDelim();
 }
@@ -284,6 +1110,10 @@ ULog &ULog::operator<<(const std::wstring &t)
 
 ULog & ULog::operator<<( const char *t )
 {
+    if(message_->filtered_)
+    {
+        return *this;
+    }
 	if(!t) 
 	{
 		message_->stm_<<"(null)";
@@ -310,13 +1140,182 @@ ULog &ULog::operator<<(const wchar_t *t)
     {
         message_->stm_<<t;
     }
-    return mayHasDelim();
-}
-#endif
-
-std::wstring ULog::message()
-{
-    return message_->stm_.str();
+    return mayHasDelim();
+}
+#endif
+
+std::wstring ULog::message()
+{
+    return message_->stm_.str();
+}
+
+bool ULog::beginFormat( const SManipulator<const char *> &group,const char *format )
+{
+    *this<<group;
+    if(message_->filtered_)
+    {
+        return false;
+    }
+    message_->format_ = format;
+    return true;
+}
+
+ULog &ULog::pushArg( FormatArgType type,const void *data,size_t size )
+{
+    std::string &args = message_->args_;
+    args += static_cast<char>(type);
+    if(type == StringArg || type == WStringArg)
+    {
+        const unsigned int length = static_cast<unsigned int>(size);
+        args.append(reinterpret_cast<const char *>(&length),sizeof(length));
+    }
+    args.append(static_cast<const char *>(data),size);
+    return *this;
+}
+
+ULog &ULog::arg( const char *t )
+{
+    if(!t)
+    {
+        t = "(null)";
+    }
+    return pushArg(StringArg,t,strlen(t));
+}
+
+#if _NATIVE_WCHAR_T_DEFINED
+ULog &ULog::arg( const wchar_t *t )
+{
+    if(!t)
+    {
+        t = L"(null)";
+    }
+    return pushArg(WStringArg,t,wcslen(t) * sizeof(wchar_t));
+}
+#endif
+
+void ULog::formatArgs( Message *message )
+{
+    MessageStream &stm = message->stm_;
+    const char *format = message->format_;
+    const char *arg = message->args_.data();
+    const char *argEnd = arg + message->args_.size();
+    std::string literal;
+    for(;;)
+    {
+        //找到下一个{},{{和}}转义为{和}.
+        const char *p = format;
+        while(*p && !(p[0] == '{' && p[1] == '}'))
+        {
+            if((p[0] == '{' && p[1] == '{') || (p[0] == '}' && p[1] == '}'))
+            {
+                literal.append(format,p + 1);
+                format = p + 2;
+                p = format;
+                continue;
+            }
+            p++;
+        }
+        literal.append(format,p);
+        if(!literal.empty())
+        {
+            stm<<s2ws(literal,loc_);
+            literal.clear();
+        }
+        if(!*p)
+        {
+            break;
+        }
+        format = p + 2;
+        if(arg >= argEnd)
+        {
+            assert(!"ULOGF的参数比格式字符串中的{}少.");
+            stm<<L"{}";
+            continue;
+        }
+        const FormatArgType type = static_cast<FormatArgType>(*arg++);
+        switch(type)
+        {
+        case BoolArg:
+            {
+                bool value;
+                memcpy(&value,arg,sizeof(value));
+                arg += sizeof(value);
+                stm<<value;
+                break;
+            }
+        case CharArg:
+            {
+                stm<<*arg++;
+                break;
+            }
+        case WCharArg:
+            {
+                wchar_t value;
+                memcpy(&value,arg,sizeof(value));
+                arg += sizeof(value);
+                stm<<value;
+                break;
+            }
+        case IntArg:
+            {
+                long long value;
+                memcpy(&value,arg,sizeof(value));
+                arg += sizeof(value);
+                wchar_t digits[UIntegerMaxChars];
+                stm.write(digits,format_int(value,digits));
+                break;
+            }
+        case UIntArg:
+            {
+                unsigned long long value;
+                memcpy(&value,arg,sizeof(value));
+                arg += sizeof(value);
+                wchar_t digits[UIntegerMaxChars];
+                stm.write(digits,format_uint(value,digits));
+                break;
+            }
+        case DoubleArg:
+            {
+                double value;
+                memcpy(&value,arg,sizeof(value));
+                arg += sizeof(value);
+                stm<<value;
+                break;
+            }
+        case PointerArg:
+            {
+                const void *value;
+                memcpy(&value,arg,sizeof(value));
+                arg += sizeof(value);
+                stm<<value;
+                break;
+            }
+        case StringArg:
+        case WStringArg:
+            {
+                unsigned int length;
+                memcpy(&length,arg,sizeof(length));
+                arg += sizeof(length);
+                if(type == StringArg)
+                {
+                    stm<<s2ws(std::string(arg,length),loc_);
+                }
+                else
+                {
+                    stm.write(reinterpret_cast<const wchar_t *>(arg),length / sizeof(wchar_t));
+                }
+                arg += length;
+                break;
+            }
+        default:
+            {
+                assert(!"未知的ULOGF参数类型.");
+                return;
+            }
+        }
+    }
+    assert(arg == argEnd || !"ULOGF的参数比格式字符串中的{}多.");
+    message->format_ = 0;
 }
 
 ULog &lasterr(ULog &log)
@@ -382,16 +1381,32 @@ ULog::SManipulator<const wchar_t *> delim(const wchar_t *delim)
 void ULogSetName(ULog &log,const char *name)
 {
     log.message_->name_ = name;
-    UScopedLock lock(ULog::mutexForNames_);
-    if(!log.names_.count(name))
+    if(ULog::isNameFiltered(log.message_->name_))
+    {
+        //分组被过滤,之后对流的输入都直接失败,不再格式化.
+        log.message_->filtered_ = true;
+        log.message_->stm_.setstate(std::ios_base::badbit);
+    }
     {
-        log.names_.insert(name);
+        UScopedReadLock<ULog::RegistryLock> lock(ULog::mutexForNames_);
+        if(ULog::names_.count(log.message_->name_))
+        {
+            return;
+        }
     }
+    UScopedWriteLock<ULog::RegistryLock> lock(ULog::mutexForNames_);
+    ULog::names_.insert(log.message_->name_);
 }
 
-ULog::SManipulator<const char *> ULogSetName(const char *name)
+void ULogSetConstantName(ULog &log,const char *name)
 {
-    return ULog::SManipulator<const char *>(&ULogSetName,name);
+    //先读版本再查找,查找时过滤设置被修改的话,记下的版本已经过期.
+    const long generation = ULog::filterGeneration_;
+    ULogSetName(log,name);
+    if(log.message_->filtered_ && log.message_->site_)
+    {
+        log.message_->site_->filteredGeneration = generation;
+    }
 }
 
 void ULogDumpMemory( ULog &log,const char *address,int len )
@@ -461,45 +1476,8 @@ void ULogHexDisp(ULog &log,int number)
 
 void ULog::DebuggerAppender::append( Message *message )
 {
-    string type;
-    switch(message->type_)
-    {
-    case TraceType:
-        {
-            type = "trace";
-            break;
-        }
-    case DebugType:
-        {
-            type = "debug";
-            break;
-        }
-    case InfoType:
-        {
-            type = "info";
-            break;
-        }
-    case WarnType:
-        {
-            type = "warn";
-            break;
-        }
-    case ErrorType:
-        {
-            type = "error";
-            break;
-        }
-    case FatalType:
-        {
-            type = "fatal";
-            break;
-        }
-    default:
-        {
-            assert(!"未知的日志类型。");
-        }
-    }
-    DebugMessage("(%s){%s}[%s][%s] %s <%d>",projectName_.c_str(),message->name_.c_str(),type.c_str(),message->func_.c_str(),ws2s(message->stm_.str(),loc_).c_str(),message->line_);
+    const char *type = typeName(message->type_);
+    DebugMessage("(%s){%s}[%s][%s] %s <%d>",projectName_.c_str(),message->name_.c_str(),type,message->func_,ws2s(message->stm_.str(),loc_).c_str(),message->line_);
 }
 
 ULog::LoggerAppender::LoggerAppender()
@@ -526,63 +1504,22 @@ ULog::LoggerAppender::~LoggerAppender()
     logFile_.close();
 }
 
+void ULog::LoggerAppender::flush()
+{
+    logFile_.flush();
+}
+
 void ULog::LoggerAppender::append( Message *message )
 {
     if(logFile_)
     {
-        string type;
-        switch(message->type_)
-        {
-        case TraceType:
-            {
-                type = "trace";
-                break;
-            }
-        case DebugType:
-            {
-                type = "debug";
-                break;
-            }
-        case InfoType:
-            {
-                type = "info";
-                break;
-            }
-        case WarnType:
-            {
-                type = "warn";
-                break;
-            }
-        case ErrorType:
-            {
-                type = "error";
-                break;
-            }
-        case FatalType:
-            {
-                type = "fatal";
-                break;
-            }
-        default:
-            {
-                assert(!"未知的日志类型。");
-            }
-        }
-        time_t t;
-        tm timeStruct;
-        time(&t);
-        localtime_s(&timeStruct,&t);
-        char currentTime[255] = "";
-        if(asctime_s(currentTime,&timeStruct) != 0)
+        time_t t = message->time_;
+        if(!t)
         {
-            DebugMessage("UniCore ULog::LoggerAppender::append( Message *message ) asctime_s失败.");
+            time(&t);
         }
-        logFile_<<currentTime<<" "
-            <<"{"<<message->name_<<"}"
-            <<"["<<type<<"]"
-            <<"["<<message->func_<<"]"
-            <<" "<<ws2s(message->stm_.str())<<" "
-            <<"<"<<message->line_<<">"<<endl;
+        writeTextLine(logFile_,t,message->name_,message->type_,message->func_,
+            ws2s(message->stm_.str()),message->line_);
     }
 }
 
@@ -601,112 +1538,392 @@ ULog::FileAppender::~FileAppender()
     file_.close();
 }
 
+void ULog::FileAppender::flush()
+{
+    file_.flush();
+}
+
 void ULog::FileAppender::append( Message *message )
 {
     if(file_)
     {
-        string type;
-        switch(message->type_)
+        time_t t = message->time_;
+        if(!t)
         {
-        case TraceType:
-            {
-                type = "trace";
-                break;
-            }
-        case DebugType:
-            {
-                type = "debug";
-                break;
-            }
-        case InfoType:
+            time(&t);
+        }
+        writeTextLine(file_,t,message->name_,message->type_,message->func_,
+            ws2s(message->stm_.str()),message->line_);
+    }
+}
+
+
+//! 压缩和清理滚动出来的文件的后台线程.
+class ULog::RollingFileAppender::Worker
+{
+public:
+    Worker(const std::wstring &fileName,int maxGenerations,bool compress)
+        :maxGenerations_(maxGenerations),compress_(compress),stop_(false),thread_(NULL)
+    {
+        //把"dir\app.log"分为"dir\app"和".log".
+        const wstring::size_type dot = fileName.rfind(L'.');
+        const wstring::size_type slash = fileName.find_last_of(L"\\/");
+        if(dot != wstring::npos && (slash == wstring::npos || dot > slash))
+        {
+            stem_ = fileName.substr(0,dot);
+            extension_ = fileName.substr(dot);
+        }
+        else
+        {
+            stem_ = fileName;
+        }
+        findGenerations();
+        event_ = CreateEventW(NULL,FALSE,FALSE,NULL);
+        if(event_)
+        {
+            thread_ = reinterpret_cast<HANDLE>(_beginthreadex(NULL,0,&Worker::threadProc,this,0,NULL));
+        }
+        if(!thread_)
+        {
+            DebugMessage("UniCore ULog::RollingFileAppender 无法创建后台线程,将在写日志的线程中压缩.");
+        }
+        else if(!pending_.empty())
+        {
+            SetEvent(event_);
+        }
+    }
+
+    ~Worker()
+    {
+        {
+            UScopedLock lock(mutex_);
+            stop_ = true;
+        }
+        if(thread_)
+        {
+            SetEvent(event_);
+            WaitForSingleObject(thread_,INFINITE);
+            CloseHandle(thread_);
+        }
+        else
+        {
+            process();
+        }
+        if(event_)
+        {
+            CloseHandle(event_);
+        }
+    }
+
+    //! 返回滚动后的文件名,保证文件不存在.
+    std::wstring rolledName(time_t t) const
+    {
+        tm timeStruct;
+        localtime_s(&timeStruct,&t);
+        wchar_t timeString[32] = L"";
+        wcsftime(timeString,32,L"%Y%m%d_%H%M%S",&timeStruct);
+        const wstring name = stem_ + L"." + timeString;
+        wstring result = name + extension_;
+        for(int i = 1; exists(result) || exists(result + L".ulz"); i++)
+        {
+            result = name + L"_" + i2ws(i) + extension_;
+        }
+        return result;
+    }
+
+    //! 把已经滚动出来的文件交给后台线程.
+    void add(const std::wstring &fileName)
+    {
+        {
+            UScopedLock lock(mutex_);
+            pending_.push_back(fileName);
+        }
+        if(thread_)
+        {
+            SetEvent(event_);
+        }
+        else
+        {
+            process();
+        }
+    }
+private:
+    Worker(const Worker &);
+    Worker &operator=(const Worker &);
+
+    static bool exists(const std::wstring &fileName)
+    {
+        return GetFileAttributesW(fileName.c_str()) != INVALID_FILE_ATTRIBUTES;
+    }
+
+    static unsigned __stdcall threadProc(void *param)
+    {
+        Worker *worker = static_cast<Worker *>(param);
+        for(;;)
+        {
+            WaitForSingleObject(worker->event_,INFINITE);
+            worker->process();
+            UScopedLock lock(worker->mutex_);
+            if(worker->stop_ && worker->pending_.empty())
             {
-                type = "info";
                 break;
             }
-        case WarnType:
+        }
+        return 0;
+    }
+
+    //! 找到之前滚动出来的文件.没有压缩完的文件重新压缩.
+    void findGenerations()
+    {
+        wstring directory;
+        wstring stemName = stem_;
+        const wstring::size_type slash = stem_.find_last_of(L"\\/");
+        if(slash != wstring::npos)
+        {
+            directory = stem_.substr(0,slash + 1);
+            stemName = stem_.substr(slash + 1);
+        }
+        vector<wstring> names;
+        WIN32_FIND_DATAW findData;
+        HANDLE find = FindFirstFileW((stem_ + L".*" + extension_ + L"*").c_str(),&findData);
+        if(find != INVALID_HANDLE_VALUE)
+        {
+            do
             {
-                type = "warn";
-                break;
-            }
-        case ErrorType:
+                //通配符也会匹配到别的文件,例如app.backup.log.old,这些文件不能被压缩或删除.
+                if(!(findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+                    && isRolledName(findData.cFileName,stemName))
+                {
+                    names.push_back(directory + findData.cFileName);
+                }
+            }while(FindNextFileW(find,&findData));
+            FindClose(find);
+        }
+        //文件名中的时间保证了按名字排序就是按滚动的先后排序.
+        sort(names.begin(),names.end());
+        for(vector<wstring>::const_iterator it = names.begin(); it != names.end(); ++it)
+        {
+            if(endsWith(*it,L".ulz.tmp"))
             {
-                type = "error";
-                break;
+                DeleteFileW(it->c_str());
             }
-        case FatalType:
+            else if(compress_ && !endsWith(*it,L".ulz"))
             {
-                type = "fatal";
-                break;
+                pending_.push_back(*it);
             }
-        default:
+            else
             {
-                assert(!"未知的日志类型。");
+                generations_.push_back(*it);
             }
         }
-        time_t t;
-        tm timeStruct;
-        time(&t);
-        localtime_s(&timeStruct,&t);
-        char currentTime[255] = "";
-        if(asctime_s(currentTime,&timeStruct) != 0)
-        {
-            DebugMessage("UniCore ULog::LoggerAppender::append( Message *message ) asctime_s失败.");
-        }
-        file_<<currentTime<<" "
-            <<"{"<<message->name_<<"}"
-            <<"["<<type<<"]"
-            <<"["<<message->func_<<"]"
-            <<" "<<ws2s(message->stm_.str())<<" "
-            <<"<"<<message->line_<<">"<<endl;
     }
-}
 
-
-void ULog::ConsoleAppender::append( Message *message )
-{
-    string type;
-    switch(message->type_)
+    //! name(不含路径)是否是rolledName产生的文件名,可以带有压缩产生的.ulz或.ulz.tmp后缀.
+    bool isRolledName(const std::wstring &name,const std::wstring &stemName) const
     {
-    case TraceType:
-        {
-            type = "trace";
-            break;
-        }
-    case DebugType:
+        size_t pos = stemName.size();
+        if(name.size() <= pos || _wcsnicmp(name.c_str(),stemName.c_str(),pos) || name[pos++] != L'.')
         {
-            type = "debug";
-            break;
+            return false;
         }
-    case InfoType:
+        //滚动的时间,格式为YYYYMMDD_HHMMSS.
+        for(const wchar_t *p = L"dddddddd_dddddd"; *p; p++,pos++)
         {
-            type = "info";
-            break;
+            if(pos >= name.size() || (*p == L'd' ? !isDigit(name[pos]) : name[pos] != *p))
+            {
+                return false;
+            }
         }
-    case WarnType:
+        //同一秒滚动多次时加上的序号.
+        if(pos < name.size() && name[pos] == L'_')
         {
-            type = "warn";
-            break;
+            const size_t begin = ++pos;
+            while(pos < name.size() && isDigit(name[pos]))
+            {
+                pos++;
+            }
+            if(pos == begin)
+            {
+                return false;
+            }
         }
-    case ErrorType:
+        if(name.size() - pos < extension_.size() || _wcsnicmp(name.c_str() + pos,extension_.c_str(),extension_.size()))
         {
-            type = "error";
-            break;
+            return false;
         }
-    case FatalType:
+        const wchar_t *suffix = name.c_str() + pos + extension_.size();
+        return !*suffix || !_wcsicmp(suffix,L".ulz") || !_wcsicmp(suffix,L".ulz.tmp");
+    }
+
+    static bool isDigit(wchar_t c)
+    {
+        return c >= L'0' && c <= L'9';
+    }
+
+    static bool endsWith(const std::wstring &s,const wchar_t *suffix)
+    {
+        const size_t length = wcslen(suffix);
+        return s.size() >= length && !s.compare(s.size() - length,length,suffix);
+    }
+
+    void process()
+    {
+        for(;;)
         {
-            type = "fatal";
-            break;
+            wstring fileName;
+            {
+                UScopedLock lock(mutex_);
+                if(pending_.empty())
+                {
+                    return;
+                }
+                fileName = pending_.front();
+                pending_.pop_front();
+            }
+            if(compress_)
+            {
+                //先压缩到临时文件,压缩成功才改名,保证.ulz文件总是完整的.
+                const wstring packed = fileName + L".ulz";
+                const wstring temp = packed + L".tmp";
+                if(compressFile(fileName.c_str(),temp.c_str())
+                    && MoveFileExW(temp.c_str(),packed.c_str(),MOVEFILE_REPLACE_EXISTING))
+                {
+                    DeleteFileW(fileName.c_str());
+                    fileName = packed;
+                }
+                else
+                {
+                    DeleteFileW(temp.c_str());
+                    DebugMessage("UniCore ULog::RollingFileAppender 压缩文件失败.");
+                }
+            }
+            generations_.push_back(fileName);
+            while(maxGenerations_ > 0 && generations_.size() > static_cast<size_t>(maxGenerations_))
+            {
+                DeleteFileW(generations_.front().c_str());
+                generations_.pop_front();
+            }
         }
-    default:
+    }
+
+    wstring stem_;
+    wstring extension_;
+    const int maxGenerations_;
+    const bool compress_;
+    std::deque<wstring> generations_;   //!< 只在后台线程中访问.
+    std::deque<wstring> pending_;       //!< 等待压缩的文件.
+    bool stop_;
+    ULock mutex_;
+    HANDLE event_;
+    HANDLE thread_;
+};
+
+ULog::RollingFileAppender::RollingFileAppender( const wchar_t *fileName,unsigned long long maxSize,
+    int interval,int maxGenerations,bool compress )
+:fileName_(fileName)
+,maxSize_(maxSize)
+,interval_(interval)
+,size_(0)
+,rollSize_(maxSize)
+,rollTime_(0)
+,worker_(new Worker(fileName,maxGenerations,compress))
+{
+    openFile();
+    if(interval_ > 0)
+    {
+        rollTime_ = nextRollTime(time(0));
+    }
+}
+
+ULog::RollingFileAppender::~RollingFileAppender()
+{
+    file_.close();
+    delete worker_;
+}
+
+void ULog::RollingFileAppender::openFile()
+{
+    file_.clear();
+    file_.open(fileName_.c_str(),ios_base::out|ios_base::app);
+    if(!file_.is_open())
+    {
+        DebugMessage("UniCore ULog::RollingFileAppender 无法打开文件.");
+        return;
+    }
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    size_ = 0;
+    if(GetFileAttributesExW(fileName_.c_str(),GetFileExInfoStandard,&data))
+    {
+        size_ = (static_cast<unsigned long long>(data.nFileSizeHigh) << 32) | data.nFileSizeLow;
+    }
+}
+
+time_t ULog::RollingFileAppender::nextRollTime( time_t now ) const
+{
+    return (now / interval_ + 1) * interval_;
+}
+
+void ULog::RollingFileAppender::roll( time_t now )
+{
+    file_.close();
+    //改名很快,压缩交给后台线程.
+    const wstring rolled = worker_->rolledName(now);
+    const bool moved = !!MoveFileW(fileName_.c_str(),rolled.c_str());
+    openFile();
+    if(moved)
+    {
+        worker_->add(rolled);
+        rollSize_ = maxSize_;
+    }
+    else
+    {
+        //文件被占用之类的原因无法改名,继续写当前文件,再写maxSize_字节后再尝试.
+        DebugMessage("UniCore ULog::RollingFileAppender 无法滚动文件.");
+        rollSize_ = size_ + maxSize_;
+    }
+    if(interval_ > 0)
+    {
+        rollTime_ = nextRollTime(now);
+    }
+}
+
+void ULog::RollingFileAppender::append( Message *message )
+{
+    time_t t = message->time_;
+    if(!t)
+    {
+        time(&t);
+    }
+    if((rollTime_ && t >= rollTime_) || (maxSize_ && size_ >= rollSize_))
+    {
+        roll(t);
+    }
+    if(file_)
+    {
+        writeTextLine(file_,t,message->name_,message->type_,message->func_,
+            ws2s(message->stm_.str()),message->line_);
+        //writeTextLine以endl结尾,已经刷新到文件,tellp就是文件大小.
+        const streamoff size = file_.tellp();
+        if(size >= 0)
         {
-            assert(!"未知的日志类型。");
+            size_ = static_cast<unsigned long long>(size);
         }
     }
+}
+
+void ULog::RollingFileAppender::flush()
+{
+    file_.flush();
+}
+
+void ULog::ConsoleAppender::append( Message *message )
+{
+    const char *type = typeName(message->type_);
 
     wstring messageString = message->stm_.str();
     printf("{%s}[%s][%s]%s<%d>\n",
-        message->name_.c_str(),type.c_str(),
-        message->func_.c_str(),ws2s(messageString).c_str(),
+        message->name_.c_str(),type,
+        message->func_,ws2s(messageString).c_str(),
         message->line_);
 
 }
@@ -25,6 +25,7 @@
 #include <stdio.h>
 #include <stdarg.h>
 #include <sstream>
+#include <time.h>
 #include <vector>
 
 #include "UDebug.h"
@@ -135,6 +136,9 @@ namespace uni
           ULog::enableOutput(ULog::TraceType,false);  //禁止Trace类型的日志信息输出.
           ULog::enableOutput(ULog::WarnType,true);  //允许Warn类型的日志信息输出.
           \endcode
+        - 被过滤类型的日志在构造ULog对象前就会被跳过,后面的<<表达式不会被求值,
+          所以不要在日志语句中写有副作用的表达式.
+          被过滤分组的日志在设置分组名之后不再格式化输入的内容.
 
     \section ulog_appender_sec 添加和设置输出源
     ULog可以输出到调试器，文件，控制台等不同的输出源. 你也可以自定义输出源输出到任意媒介.
@@ -149,6 +153,8 @@ namespace uni
           - DebuggerAppender 类，用于输出日志信息到调试器。
           - ConsoleAppender 类，用于输出日志信息到控制台。
           - FileAppender 类，用于输出日志信息到文件。
+          - RollingFileAppender 类,输出到文件,按大小或时间滚动并在后台压缩旧文件.
+          - BinaryFileAppender 类,以二进制格式输出日志信息到分段文件,用ULogDump工具转换成文本.
 		  - EditControlAppender 类,用于输出日志到Edit控件.
 		  - StaticControlAppender 类,用于输出日志到Static控件.
           .
@@ -164,6 +170,19 @@ namespace uni
           如果某分组的日志没有输出源,则使用无分组日志的输出源.\n
           若无分组日志也没有输出源,则为其初始化一个名为"default"的调试器输出源.
 
+    \section ulog_async_sec 异步输出
+    默认情况下,日志在ULog对象析构时由当前线程直接调用各个输出源输出.
+    如果输出源很慢(例如每行都会刷新的FileAppender),会拖慢输出日志的线程.
+    这时可以开启异步输出,日志会被放入一个有界队列,由后台线程交给输出源:
+    \code
+    //队列容量为4096条,队列满时丢弃最旧的日志.
+    ULog::enableAsyncOutput(4096,ULog::DropOldest);
+    UINFO<<"这条日志由后台线程输出.";
+    ULog::flush();  //等待之前的日志全部输出完毕.
+    ULog::disableAsyncOutput();  //输出队列中剩余的日志,并结束后台线程.
+    \endcode
+    队列满时的处理策略见 ULog::OverflowPolicy .程序退出时会自动输出队列中剩余的日志.
+
     \section manipulator_sec 操纵符
     ULog支持stringstream所支持的所有操纵符。此外，还支持以下操纵符。
     - \b lasterr 输出GetLastError返回的错误信息。
@@ -216,6 +235,17 @@ namespace uni
 */
 
 
+//! 日志宏所在位置的分组过滤缓存.
+/*!
+    每个UTRACE,UINFO等宏展开时有一个自己的ULogSite.分组名是字符串常量时,分组被过滤后记下当时的过滤设置版本,
+    之后这个位置的日志只比较一次版本就跳过,不构造ULog对象,<<后面的参数也不会被求值.
+    分组过滤设置改变时版本增加,缓存随之失效.
+*/
+struct ULogSite
+{
+    volatile long filteredGeneration;   //!< 分组被过滤时的过滤设置版本,为0时没有缓存.
+};
+
 //! 日志类。
 class ULog
 {
@@ -232,22 +262,117 @@ public:
         HideType,     //!< 这类信息期望在编译的时候被优化掉。
     };
 
+    //! 日志信息主体使用的缓冲区.
+    /*!
+        短的日志直接写在内部的数组中,长的日志才从堆上分配.
+        reset后容量保持不变,配合Message的复用,同一线程反复输出日志时不需要再分配内存.
+    */
+    class MessageBuffer : public std::wstreambuf
+    {
+    public:
+        enum
+        {
+            InlineCapacity = 128,        //!< 内部数组能容纳的字符数.
+            MaxRetainedCapacity = 16384, //!< reset时超过这个容量的堆内存会被释放.
+        };
+        MessageBuffer()
+            :heap_(0)
+        {
+            setp(inline_,inline_ + InlineCapacity);
+        }
+        virtual ~MessageBuffer()
+        {
+            delete []heap_;
+        }
+        const wchar_t *data() const {return pbase();}
+        size_t size() const {return pptr() - pbase();}
+        //! 截断到指定长度,newSize必须不大于size().
+        void truncate(size_t newSize);
+        //! 清空内容,保留容量.
+        void reset();
+    protected:
+        virtual int_type overflow(int_type c);
+        virtual std::streamsize xsputn(const wchar_t *s,std::streamsize count);
+    private:
+        MessageBuffer(const MessageBuffer &);
+        MessageBuffer &operator=(const MessageBuffer &);
+        void reserve(size_t capacity);
+        wchar_t inline_[InlineCapacity];
+        wchar_t *heap_;
+    };
+
+    //! 写入MessageBuffer的宽字符流,提供和std::wostringstream相同的str函数.
+    class MessageStream : private MessageBuffer,public std::wostream
+    {
+    public:
+        MessageStream()
+            :std::wostream(static_cast<MessageBuffer *>(this))
+        {
+        }
+        std::wstring str() const {return std::wstring(data(),size());}
+        void str(const std::wstring &s)
+        {
+            MessageBuffer::reset();
+            sputn(s.c_str(),s.size());
+        }
+        using MessageBuffer::data;
+        using MessageBuffer::size;
+        using MessageBuffer::truncate;
+        //! 清空内容并还原流的格式状态.
+        void reset();
+    private:
+        MessageStream(const MessageStream &);
+        MessageStream &operator=(const MessageStream &);
+    };
+
     //! 保存了一条日志信息的所有内容。
+    /*!
+        ULog内部使用的Message来自每个线程的缓存,用完后会回到缓存中复用,
+        见 ULog::setMessageCacheSize .
+    */
     struct Message
     {
         Message(Type type,const char *file,int line,const char *function)
-            :ref_(1),type_(type),file_(file),line_(line),func_(function),delimEnabled_(true)
+            :ref_(1),type_(type),file_(file),line_(line),func_(function),delimEnabled_(true),filtered_(false),site_(0),time_(0),ticks_(0),format_(0)
+        {
+        }
+        //! 复用前重新初始化,字符串和流的容量保持不变.
+        void reset(Type type,const char *file,int line,const char *function)
         {
+            ref_ = 1;
+            type_ = type;
+            name_.clear();
+            file_ = file;
+            func_ = function;
+            line_ = line;
+            delim_.clear();
+            delimEnabled_ = true;
+            filtered_ = false;
+            site_ = 0;
+            stm_.reset();
+            time_ = 0;
+            ticks_ = 0;
+            format_ = 0;
+            args_.clear();
         }
         int ref_;
         Type type_;
         std::string name_;  //!< 日志名.
-        std::string file_;  //!< 这条日志输出所在的源文件.
-        std::string func_;  //!< 这条日志输出所在的函数.
+        const char *file_;  //!< 这条日志输出所在的源文件,必须是字符串常量(__FILE__).
+        const char *func_;  //!< 这条日志输出所在的函数,必须是字符串常量(__FUNCTION__).
         int line_;          //!< 这条日志输出位置所在的行号.
         std::wstring delim_; //!< 流输出时所使用的分隔符.
         bool delimEnabled_; //!< 是否在两次插入间添加分隔符.
-        std::wostringstream stm_;  //!< 保存了日志信息主体的流.
+        bool filtered_;     //!< 所在分组被过滤,之后的输入不再格式化.
+        ULogSite *site_;    //!< 日志宏所在位置的缓存,不是由日志宏产生时为0.
+        MessageStream stm_;  //!< 保存了日志信息主体的流.
+        time_t time_;       //!< 异步输出时,日志产生的时间.同步输出时为0.
+        long long ticks_;   //!< 异步输出时,日志产生时的QueryPerformanceCounter计数.同步输出时为0.
+        const char *format_;    //!< ULOGF的格式字符串,为0则日志内容已经在stm_中.
+        std::string args_;  //!< ULOGF按值保存的参数,交给输出源之前才格式化到stm_中.
+    private:
+        Message(const Message &);
+        Message &operator=(const Message &);
     };
 
     //! 输出源的基类.
@@ -260,9 +385,13 @@ public:
         Appender() {}
         virtual ~Appender() {}
         virtual void append(Message *message) = 0;
+        //! 将缓存的内容写到输出媒介,由 ULog::flush 调用.
+        virtual void flush() {}
     private:
         Appender(const Appender &);
         Appender &operator=(const Appender &);
+        friend class ULog;
+        uni::ULock lock_;   //!< 同一个输出源同时只会被一个线程调用,不同输出源之间可以并行.
     };
 
     //! 调试器输出源.
@@ -286,6 +415,7 @@ public:
         LoggerAppender();
         virtual ~LoggerAppender();
         virtual void append(Message *message);
+        virtual void flush();
     private:
         LoggerAppender(const LoggerAppender &);
         LoggerAppender &operator=(const LoggerAppender &);
@@ -302,12 +432,123 @@ public:
         explicit FileAppender(const wchar_t *fileName);
         virtual ~FileAppender();
         virtual void append(Message *message);
+        virtual void flush();
     private:
         FileAppender(const FileAppender &);
         FileAppender &operator=(const FileAppender &);
         std::ofstream file_;
     };
 
+    //! 滚动文件输出源.
+    /*!
+        和FileAppender一样以文本格式写日志,但是文件超过指定大小,或者到了指定的时间间隔时,
+        当前文件会被改名为"文件名.年月日_时分秒.扩展名",然后重新开始写一个新文件.
+        改名后的文件交给后台线程压缩成.ulz文件(格式见UCompress.h),
+        并且只保留最新的若干个,更旧的被删除.写日志的线程只做改名,不会被压缩阻塞.
+
+        \code
+        //app.log超过16M或者每过一天就滚动一次,保留最新的10个.
+        ULog::registerAppender("rolling",
+            new ULog::RollingFileAppender(L"app.log",16 * 1024 * 1024,24 * 3600,10));
+        \endcode
+    */
+    class RollingFileAppender : public Appender
+    {
+    public:
+        /*!
+            \param fileName 当前写入的文件名,已存在时从尾部追加.
+            \param maxSize 文件超过这个字节数时滚动,为0则不按大小滚动.
+            \param interval 每隔多少秒滚动一次,按UTC时间对齐(例如24 * 3600为每天UTC零点),
+                为0则不按时间滚动.
+            \param maxGenerations 最多保留多少个滚动出来的文件,为0则全部保留.
+            \param compress 是否压缩滚动出来的文件.
+        */
+        RollingFileAppender(const wchar_t *fileName,unsigned long long maxSize,
+            int interval = 0,int maxGenerations = 7,bool compress = true);
+        //! 会等待后台线程压缩完已经滚动的文件.
+        virtual ~RollingFileAppender();
+        virtual void append(Message *message);
+        virtual void flush();
+    private:
+        RollingFileAppender(const RollingFileAppender &);
+        RollingFileAppender &operator=(const RollingFileAppender &);
+        class Worker;
+
+        void openFile();
+        void roll(time_t now);
+        time_t nextRollTime(time_t now) const;
+
+        std::wstring fileName_;
+        unsigned long long maxSize_;
+        int interval_;
+        std::ofstream file_;
+        unsigned long long size_;
+        unsigned long long rollSize_;   //!< 文件达到这个字节数时滚动,上次改名失败时比maxSize_大.
+        time_t rollTime_;   //!< 到了这个时间就滚动,不按时间滚动时为0.
+        Worker *worker_;
+    };
+
+    //! 二进制文件输出源.
+    /*!
+        不格式化时间和日志内容,以紧凑的二进制格式把日志写入内存映射的分段文件,
+        适合日志量很大的场合.分段文件预先分配好大小,写满后打开下一个分段,
+        文件名为baseName.000000.ulb,baseName.000001.ulb,...,已经存在的分段不会被覆盖.
+
+        日志分组名,源文件名和函数名在每个分段中第一次出现时写入一次,
+        之后的日志只记录它们的编号.时间戳是QueryPerformanceCounter的计数.
+
+        使用ULogDump工具或者ULogBinaryReader把分段文件转换回FileAppender的文本格式.
+        文件格式见ULogBinary.h.
+    */
+    class BinaryFileAppender : public Appender
+    {
+    public:
+        /*!
+            \param baseName 分段文件名的前缀,可以包含路径.
+            \param segmentSize 每个分段文件的大小.
+        */
+        explicit BinaryFileAppender(const wchar_t *baseName,
+            unsigned int segmentSize = 64 * 1024 * 1024);
+        virtual ~BinaryFileAppender();
+        virtual void append(Message *message);
+        //! 把映射的内存写回文件.
+        virtual void flush();
+    private:
+        BinaryFileAppender(const BinaryFileAppender &);
+        BinaryFileAppender &operator=(const BinaryFileAppender &);
+
+        //! 日志输出位置.file和func都是字符串常量,直接比较指针.
+        struct Site
+        {
+            const char *file_;
+            const char *func_;
+            int line_;
+            bool operator<(const Site &other) const
+            {
+                if(file_ != other.file_) return file_ < other.file_;
+                if(line_ != other.line_) return line_ < other.line_;
+                return func_ < other.func_;
+            }
+        };
+
+        bool openSegment();
+        void closeSegment();
+        //! 保证当前分段还有size字节的空间,不够时打开新的分段.
+        bool reserve(unsigned int size);
+        unsigned int internName(const std::string &name);
+        unsigned int internSite(const Message *message);
+
+        std::wstring baseName_;
+        unsigned int segmentSize_;
+        int segmentIndex_;
+        HANDLE file_;
+        HANDLE mapping_;
+        char *view_;
+        unsigned int used_;
+        std::map<std::string,unsigned int> names_;
+        std::map<Site,unsigned int> sites_;
+    };
+
     //! 输出到控制台的输出源.
     /*!
         使用printf输出.
@@ -384,6 +625,14 @@ public:
         HWND hWnd_;
     };
 
+    //! 异步输出时,队列已满的处理策略.
+    enum OverflowPolicy
+    {
+        BlockWhenFull,  //!< 阻塞输出日志的线程,直到队列有空位.不会丢失日志.
+        DropNewest,     //!< 丢弃当前要输出的日志.
+        DropOldest,     //!< 丢弃队列中最早的一条日志,再放入当前日志.
+    };
+
     //! 无参数的操纵符。
     typedef ULog &(__cdecl *NullaryManipulator)(ULog &);
 
@@ -416,7 +665,7 @@ public:
     /*!
         \param type 日志类型。
     */
-    explicit ULog(Type type,const char *file,int line,const char *function);
+    explicit ULog(Type type,const char *file,int line,const char *function,ULogSite *site = 0);
 
     //! 拷贝构造函数。
     ULog(const ULog &log);
@@ -500,8 +749,13 @@ public:
     /*!
         \param type 日志类型.
         \return 指定类型的日志是否输出.
+
+        不加锁,只读取一次过滤掩码,日志宏在构造ULog对象前就调用这个函数.
     */
-    static bool isOutputEnabled(Type type);
+    static bool isOutputEnabled(Type type)
+    {
+        return !(typeFilterMask_ & (1 << type));
+    }
 
     //! 设置指定类型的日志是否输出.
     /*!
@@ -514,18 +768,29 @@ public:
     /*!
         \param name 日志分组的名字.
         \return 该分组的日志是否输出.
+
+        不加锁,在当前的分组过滤快照中查找.
     */
     static bool isOutputEnabled(const std::string &name);
 
+    //! 日志宏所在的位置是否已知被分组过滤,不加锁,只比较一次过滤设置的版本.
+    static bool isSiteFiltered(const ULogSite &site)
+    {
+        return site.filteredGeneration == filterGeneration_;
+    }
+
     //! 设置指定分组的日志是否输出.
     /*!
         \param name 日志分组的名字.
         \param enable 该分组的日志是否输出.
+
+        复制当前的分组过滤快照,修改后替换掉原来的快照.旧快照可能还在被其他线程读取,
+        所以不会被释放,频繁调用这个函数会占用越来越多的内存.
     */
     static void enableOutput(const std::string &name,bool enable);
 
     //! 获得输出过的日志名字。
-    static std::set<std::string> names() {return names_;}
+    static std::set<std::string> names();
 
     //! 设置项目名。
     static void setProjectName(const std::string &projectName) {projectName_ = projectName;}
@@ -533,9 +798,68 @@ public:
     //! 返回当前ULog使用的locale，默认情况是使用本机区域设置。
     static _locale_t locale();
 
+    //! 返回日志类型的名字,如"trace","debug".
+    static const char *typeName(Type type);
+
+    //! 以FileAppender的文本格式输出一条日志.
+    /*!
+        \param stm 输出的流.
+        \param t 日志产生的时间.
+        \param name 日志分组名.
+        \param type 日志类型.
+        \param func 日志所在的函数.
+        \param message 日志内容,本地代码页编码.
+        \param line 日志所在的行号.
+    */
+    static void writeTextLine(std::ostream &stm,time_t t,const std::string &name,
+        Type type,const char *func,const std::string &message,int line);
+
     //! 还原回默认的设置.所有static状态将被恢复到初始值.
+    /*!
+        如果开启了异步输出,会先输出队列中剩余的日志并关闭异步输出.
+    */
     static void restoreDefaultSettings();
 
+    //! 开启异步输出.
+    /*!
+        \param queueCapacity 队列最多能容纳的日志条数,会被向上取整为2的幂.
+        \param policy 队列已满时的处理策略.
+
+        开启后,ULog对象析构时只把日志放入队列,由后台线程调用输出源输出.
+        若已经开启了异步输出,则先关闭再以新的参数重新开启.
+        \note 输出源的append函数将在后台线程中被调用.
+    */
+    static void enableAsyncOutput(int queueCapacity = 8192,OverflowPolicy policy = BlockWhenFull);
+
+    //! 关闭异步输出.
+    /*!
+        输出队列中剩余的所有日志,并结束后台线程.之后的日志恢复为同步输出.
+    */
+    static void disableAsyncOutput();
+
+    //! 是否开启了异步输出.
+    static bool isAsyncOutputEnabled();
+
+    //! 等待调用前产生的日志全部输出完毕,然后刷新所有输出源.
+    /*!
+        未开启异步输出时只刷新所有输出源.
+        在输出源的append函数中调用时不会等待,以免死锁,这时正被其它线程使用的输出源不会被刷新.
+    */
+    static void flush();
+
+    //! 异步输出时,因为队列已满而被丢弃的日志条数.
+    static long droppedMessageCount();
+
+    //! 设置每个线程最多缓存多少个用过的Message.
+    /*!
+        \param count 缓存的个数,为0时不缓存,每条日志都重新分配Message.默认为32.
+
+        ULog对象使用的Message来自当前线程的缓存,日志输出后回到缓存中,
+        以避免每条日志都分配内存.缓存满时多余的Message放入所有线程共享的无锁链表,
+        共享链表也满时才释放.
+    */
+    static void setMessageCacheSize(int count);
+
     //! 接受ostream的操纵符。
     /*!
         \param ostreamManipulator ostream操纵符，例如endl。
@@ -656,6 +980,8 @@ public:
 
     friend void ULogSetName(ULog &log,const char *name);
 
+    friend void ULogSetConstantName(ULog &log,const char *name);
+
     friend ULog &lasterr(ULog &log);
 
     friend void ULogSetDelim(ULog &log,const wchar_t *delim);
@@ -664,19 +990,91 @@ public:
 
     friend void ULogHexDisp(ULog &log,int number);
 
+    //! ULOGF使用,设置日志分组和格式字符串.
+    /*!
+        \param group ULogSetName返回的操纵符,分组名是字符串常量时过滤结果缓存在日志宏所在的位置.
+        \param format 格式字符串,必须是字符串常量.
+        \return 日志被过滤时返回false,这时不需要再添加参数.
+    */
+    bool beginFormat(const SManipulator<const char *> &group,const char *format);
+
+    //! ULOGF使用,按值保存一个参数,在交给输出源之前才格式化.
+    ULog &arg(bool t) {return pushArg(BoolArg,&t,sizeof(t));}
+    ULog &arg(char t) {return pushArg(CharArg,&t,sizeof(t));}
+#if _NATIVE_WCHAR_T_DEFINED
+    ULog &arg(wchar_t t) {return pushArg(WCharArg,&t,sizeof(t));}
+#endif
+    ULog &arg(short t) {return arg(static_cast<long long>(t));}
+    ULog &arg(unsigned short t) {return arg(static_cast<unsigned long long>(t));}
+    ULog &arg(int t) {return arg(static_cast<long long>(t));}
+    ULog &arg(unsigned int t) {return arg(static_cast<unsigned long long>(t));}
+    ULog &arg(long t) {return arg(static_cast<long long>(t));}
+    ULog &arg(unsigned long t) {return arg(static_cast<unsigned long long>(t));}
+    ULog &arg(long long t) {return pushArg(IntArg,&t,sizeof(t));}
+    ULog &arg(unsigned long long t) {return pushArg(UIntArg,&t,sizeof(t));}
+    ULog &arg(float t) {return arg(static_cast<double>(t));}
+    ULog &arg(double t) {return pushArg(DoubleArg,&t,sizeof(t));}
+    ULog &arg(const void *t) {return pushArg(PointerArg,&t,sizeof(t));}
+    //! 字符串的内容会被复制,t为0时输出(null).
+    ULog &arg(const char *t);
+#if _NATIVE_WCHAR_T_DEFINED
+    ULog &arg(const wchar_t *t);
+#endif
+    ULog &arg(const std::string &t) {return pushArg(StringArg,t.c_str(),t.size());}
+    ULog &arg(const std::wstring &t) {return pushArg(WStringArg,t.c_str(),t.size() * sizeof(wchar_t));}
+
 private:
+    //! ULOGF参数的类型,保存在Message::args_中每个参数的第一个字节.
+    enum FormatArgType
+    {
+        BoolArg,
+        CharArg,
+        WCharArg,
+        IntArg,     //!< 所有有符号整数都保存为long long.
+        UIntArg,    //!< 所有无符号整数都保存为unsigned long long.
+        DoubleArg,
+        PointerArg,
+        StringArg,  //!< 之后是4字节的长度和字符串的内容.
+        WStringArg,
+    };
+
+    //! 在Message::args_后追加一个参数.
+    ULog &pushArg(FormatArgType type,const void *data,size_t size);
+
+    //! 按Message::format_格式化ULOGF的参数到stm_中.
+    static void formatArgs(Message *message);
+
+    class AsyncDispatcher;
+    class MessagePool;
+    struct FilterSnapshot;
+
+    //! 指定分组的日志是否被过滤.
+    static bool isNameFiltered(const std::string &name);
+
+    //! 将日志交给其分组所使用的输出源.
+    static void dispatch(Message *message);
+
+    //! 在持有mutexForAppenders_读锁时调用,分组和无分组日志都没有输出源时返回false.
+    static bool appendLocked(Message *message);
+
+    //! 注册表每次输出日志都要读,几乎不会修改,使用分片读写锁.
+    typedef uni::UShardedLock<8> RegistryLock;
+
     unsigned long lastError_;
     Message *message_;
     static std::map<std::string,std::tr1::shared_ptr<Appender> > appenders_;
     static std::map<std::string,std::vector<std::string> > appendersForName_;
-    static uni::ULock mutexForAppenders_;
-    static std::map<Type,bool> typeFilter_;  //!< true则代表指定类型的日志将被过滤.
-    static std::map<std::string,bool> nameFilter_;  //!< true则指定分组的日志将被过滤.
-    static uni::ULock mutexForFilters_;
+    static RegistryLock mutexForAppenders_;
+    static volatile long typeFilterMask_;  //!< 第n位为1则代表类型为n的日志将被过滤.
+    static FilterSnapshot * volatile nameFilter_;  //!< 被过滤的分组,为0时不过滤任何分组.
+    static volatile long filterGeneration_;  //!< 分组过滤设置的版本,每次替换nameFilter_后增加,从1开始.
+    static uni::ULock mutexForFilters_;  //!< 只在修改过滤设置时使用,读取不需要加锁.
     static std::set<std::string> names_;  //!< 保存了输出过的日志的名字。
-    static uni::ULock mutexForNames_;
+    static RegistryLock mutexForNames_;
     static _locale_t loc_;
     static std::string projectName_;
+    static AsyncDispatcher asyncDispatcher_;
+    static uni::ULock mutexForAsync_;
 };
 
 inline ULog &ULogSetName(ULog &log)
@@ -684,7 +1082,27 @@ inline ULog &ULogSetName(ULog &log)
     return log;
 }
 
-ULog::SManipulator<const char *> ULogSetName(const char *name);
+void ULogSetName(ULog &log,const char *name);
+
+//! 和ULogSetName一样,分组被过滤时记在日志宏所在位置的缓存中.
+void ULogSetConstantName(ULog &log,const char *name);
+
+//! 设置分组名,name是字符串常量,日志宏所在的位置会缓存分组的过滤结果.
+/*!
+    字符数组也被当作字符串常量,内容会改变的分组名要以指针的形式传入.
+*/
+template<size_t N>
+inline ULog::SManipulator<const char *> ULogSetName(const char (&name)[N])
+{
+    return ULog::SManipulator<const char *>(&ULogSetConstantName,name);
+}
+
+//! 设置分组名,name是指针,每次都查找分组的过滤设置.
+template<typename Char>
+inline ULog::SManipulator<const char *> ULogSetName(Char *const &name)
+{
+    return ULog::SManipulator<const char *>(&ULogSetName,name);
+}
 
 ULog::SManipulator<const wchar_t *> delim(const wchar_t *delim);
 
@@ -717,6 +1135,159 @@ inline ULog &decdisp(ULog &log)
 
 ULog uLog(ULog::Type type,const char *file,int line,const char *function);
 
+//! 日志宏使用的版本,site为日志宏所在位置的缓存.
+ULog uLog(ULog::Type type,const char *file,int line,const char *function,ULogSite &site);
+
+//! ULOGF的实现,支持最多8个参数.
+inline void uLogf(ULog::Type type,const char *file,int line,const char *function,
+    ULogSite &site,const ULog::SManipulator<const char *> &group,const char *format)
+{
+    ULog log(type,file,line,function,&site);
+    log.beginFormat(group,format);
+}
+
+template<class A1>
+inline void uLogf(ULog::Type type,const char *file,int line,const char *function,
+    ULogSite &site,const ULog::SManipulator<const char *> &group,const char *format,const A1 &a1)
+{
+    ULog log(type,file,line,function,&site);
+    if(log.beginFormat(group,format))
+    {
+        log.arg(a1);
+    }
+}
+
+template<class A1,class A2>
+inline void uLogf(ULog::Type type,const char *file,int line,const char *function,
+    ULogSite &site,const ULog::SManipulator<const char *> &group,const char *format,const A1 &a1,const A2 &a2)
+{
+    ULog log(type,file,line,function,&site);
+    if(log.beginFormat(group,format))
+    {
+        log.arg(a1).arg(a2);
+    }
+}
+
+template<class A1,class A2,class A3>
+inline void uLogf(ULog::Type type,const char *file,int line,const char *function,
+    ULogSite &site,const ULog::SManipulator<const char *> &group,const char *format,const A1 &a1,const A2 &a2,const A3 &a3)
+{
+    ULog log(type,file,line,function,&site);
+    if(log.beginFormat(group,format))
+    {
+        log.arg(a1).arg(a2).arg(a3);
+    }
+}
+
+template<class A1,class A2,class A3,class A4>
+inline void uLogf(ULog::Type type,const char *file,int line,const char *function,
+    ULogSite &site,const ULog::SManipulator<const char *> &group,const char *format,const A1 &a1,const A2 &a2,const A3 &a3,const A4 &a4)
+{
+    ULog log(type,file,line,function,&site);
+    if(log.beginFormat(group,format))
+    {
+        log.arg(a1).arg(a2).arg(a3).arg(a4);
+    }
+}
+
+template<class A1,class A2,class A3,class A4,class A5>
+inline void uLogf(ULog::Type type,const char *file,int line,const char *function,
+    ULogSite &site,const ULog::SManipulator<const char *> &group,const char *format,const A1 &a1,const A2 &a2,const A3 &a3,const A4 &a4,const A5 &a5)
+{
+    ULog log(type,file,line,function,&site);
+    if(log.beginFormat(group,format))
+    {
+        log.arg(a1).arg(a2).arg(a3).arg(a4).arg(a5);
+    }
+}
+
+template<class A1,class A2,class A3,class A4,class A5,class A6>
+inline void uLogf(ULog::Type type,const char *file,int line,const char *function,
+    ULogSite &site,const ULog::SManipulator<const char *> &group,const char *format,const A1 &a1,const A2 &a2,const A3 &a3,const A4 &a4,const A5 &a5,const A6 &a6)
+{
+    ULog log(type,file,line,function,&site);
+    if(log.beginFormat(group,format))
+    {
+        log.arg(a1).arg(a2).arg(a3).arg(a4).arg(a5).arg(a6);
+    }
+}
+
+template<class A1,class A2,class A3,class A4,class A5,class A6,class A7>
+inline void uLogf(ULog::Type type,const char *file,int line,const char *function,
+    ULogSite &site,const ULog::SManipulator<const char *> &group,const char *format,const A1 &a1,const A2 &a2,const A3 &a3,const A4 &a4,const A5 &a5,const A6 &a6,const A7 &a7)
+{
+    ULog log(type,file,line,function,&site);
+    if(log.beginFormat(group,format))
+    {
+        log.arg(a1).arg(a2).arg(a3).arg(a4).arg(a5).arg(a6).arg(a7);
+    }
+}
+
+template<class A1,class A2,class A3,class A4,class A5,class A6,class A7,class A8>
+inline void uLogf(ULog::Type type,const char *file,int line,const char *function,
+    ULogSite &site,const ULog::SManipulator<const char *> &group,const char *format,const A1 &a1,const A2 &a2,const A3 &a3,const A4 &a4,const A5 &a5,const A6 &a6,const A7 &a7,const A8 &a8)
+{
+    ULog log(type,file,line,function,&site);
+    if(log.beginFormat(group,format))
+    {
+        log.arg(a1).arg(a2).arg(a3).arg(a4).arg(a5).arg(a6).arg(a7).arg(a8);
+    }
+}
+
+//! 让日志宏成为void类型的表达式.
+/*!
+    &的优先级低于<<,所以 ULogVoidify() & uLog(...)<<a<<b 会先完成所有的<<.
+*/
+class ULogVoidify
+{
+public:
+    void operator&(const ULog &) {}
+};
+
+namespace
+{
+    //! 每个日志宏用__COUNTER__实例化一个,在每个编译单元中都是独立的.
+    template<int Id>
+    struct ULogSiteHolder
+    {
+        static ULogSite site;
+    };
+
+    template<int Id>
+    ULogSite ULogSiteHolder<Id>::site;
+}
+
+//! 日志宏的实现,类型被过滤或者所在位置已知被分组过滤时不构造ULog对象,后面的<<表达式也不会被求值.
+#define UNI_LOG_IMPL(type) UNI_LOG_SITE_IMPL(type,__COUNTER__)
+
+//! id在UNI_LOG_IMPL中展开,这里的两处使用的是同一个ULogSite.
+#define UNI_LOG_SITE_IMPL(type,id) \
+    !ULog::isOutputEnabled(type) || ULog::isSiteFiltered(ULogSiteHolder<id>::site) ? (void)0 \
+    : ULogVoidify() & uLog(type,__FILE__,__LINE__,__FUNCTION__,ULogSiteHolder<id>::site)<<ULogSetName
+
+//! ULOGF格式化输出日志,格式化被推迟到交给输出源之前(开启异步输出时在后台线程中).
+/*!
+    \param type 日志类型,如ULog::InfoType.
+    \param group 日志分组名,没有分组时为"".
+    \param format 格式字符串,必须是字符串常量,每个{}被依次替换为后面的参数,
+        {{和}}分别输出{和}.
+
+    \code
+    ULOGF(ULog::InfoType,"网络","收到{}字节,来自{}:{}",size,ip,port);
+    UINFOF("网络","收到{}字节,来自{}:{}",size,ip,port);  //和上面相同.
+    \endcode
+    UTRACEF,UDEBUGF,UINFOF等宏和UTRACE等宏一样受UNI_LOG_DISABLE_XXX控制.
+    参数按值保存,字符串会被复制,所以可以传入临时对象.
+    只支持基本类型,指针,char/wchar_t字符串和std::string/std::wstring,其他类型的参数无法通过编译.
+    类型被过滤时参数不会被求值.分组名是字符串常量时和UINFO等宏一样,分组被过滤后这个位置不再求值参数,
+    但第一次执行时才知道分组被过滤,那一次参数仍会被求值.{}和参数的个数不一致时在Debug版中会断言失败.
+*/
+#define UNI_LOGF_IMPL(type,group,format,...) UNI_LOGF_SITE_IMPL(__COUNTER__,type,group,format,__VA_ARGS__)
+
+//! id在UNI_LOGF_IMPL中展开,这里的两处使用的是同一个ULogSite.
+#define UNI_LOGF_SITE_IMPL(id,type,group,format,...) \
+    (!ULog::isOutputEnabled(type) || ULog::isSiteFiltered(ULogSiteHolder<id>::site) ? (void)0 \
+    : uLogf(type,__FILE__,__LINE__,__FUNCTION__,ULogSiteHolder<id>::site,ULogSetName(group),"" format,__VA_ARGS__))
 
 #ifdef UNI_LOG_DISABLE_ALL
   #define UTRACE while(false) uLog(ULog::TraceType,__FILE__,__LINE__,__FUNCTION__)<<ULogSetName
@@ -726,44 +1297,68 @@ ULog uLog(ULog::Type type,const char *file,int line,const char *function);
   #define UERROR while(false) uLog(ULog::ErrorType,__FILE__,__LINE__,__FUNCTION__)<<ULogSetName
   #define UFATAL while(false) uLog(ULog::FatalType,__FILE__,__LINE__,__FUNCTION__)<<ULogSetName
   #define UHIDE while(false) uLog(ULog::HideType,__FILE__,__LINE__,__FUNCTION__)<<ULogSetName
+  #define ULOGF(type,group,format,...) while(false) UNI_LOGF_IMPL(type,group,format,__VA_ARGS__)
+  #define UTRACEF(group,format,...) while(false) UNI_LOGF_IMPL(ULog::TraceType,group,format,__VA_ARGS__)
+  #define UDEBUGF(group,format,...) while(false) UNI_LOGF_IMPL(ULog::DebugType,group,format,__VA_ARGS__)
+  #define UINFOF(group,format,...) while(false) UNI_LOGF_IMPL(ULog::InfoType,group,format,__VA_ARGS__)
+  #define UWARNF(group,format,...) while(false) UNI_LOGF_IMPL(ULog::WarnType,group,format,__VA_ARGS__)
+  #define UERRORF(group,format,...) while(false) UNI_LOGF_IMPL(ULog::ErrorType,group,format,__VA_ARGS__)
+  #define UFATALF(group,format,...) while(false) UNI_LOGF_IMPL(ULog::FatalType,group,format,__VA_ARGS__)
+  #define UHIDEF(group,format,...) while(false) UNI_LOGF_IMPL(ULog::HideType,group,format,__VA_ARGS__)
 #else
+  #define ULOGF(type,group,format,...) UNI_LOGF_IMPL(type,group,format,__VA_ARGS__)
   #ifdef UNI_LOG_DISABLE_TRACE
     #define UTRACE while(false) uLog(ULog::TraceType,__FILE__,__LINE__,__FUNCTION__)<<ULogSetName
+    #define UTRACEF(group,format,...) while(false) UNI_LOGF_IMPL(ULog::TraceType,group,format,__VA_ARGS__)
   #else
-    #define UTRACE uLog(ULog::TraceType,__FILE__,__LINE__,__FUNCTION__)<<ULogSetName
+    #define UTRACE UNI_LOG_IMPL(ULog::TraceType)
+    #define UTRACEF(group,format,...) UNI_LOGF_IMPL(ULog::TraceType,group,format,__VA_ARGS__)
   #endif
   #ifdef UNI_LOG_DISABLE_DEBUG
     #define UDEBUG while(false) uLog(ULog::DebugType,__FILE__,__LINE__,__FUNCTION__)<<ULogSetName
+    #define UDEBUGF(group,format,...) while(false) UNI_LOGF_IMPL(ULog::DebugType,group,format,__VA_ARGS__)
   #else
-    #define UDEBUG uLog(ULog::DebugType,__FILE__,__LINE__,__FUNCTION__)<<ULogSetName
+    #define UDEBUG UNI_LOG_IMPL(ULog::DebugType)
+    #define UDEBUGF(group,format,...) UNI_LOGF_IMPL(ULog::DebugType,group,format,__VA_ARGS__)
   #endif
   #ifdef UNI_LOG_DISABLE_INFO
     #define UINFO while(false) uLog(ULog::InfoType,__FILE__,__LINE__,__FUNCTION__)<<ULogSetName
+    #define UINFOF(group,format,...) while(false) UNI_LOGF_IMPL(ULog::InfoType,group,format,__VA_ARGS__)
   #else
-    #define UINFO uLog(ULog::InfoType,__FILE__,__LINE__,__FUNCTION__)<<ULogSetName
+    #define UINFO UNI_LOG_IMPL(ULog::InfoType)
+    #define UINFOF(group,format,...) UNI_LOGF_IMPL(ULog::InfoType,group,format,__VA_ARGS__)
   #endif
   #ifdef UNI_LOG_DISABLE_WARN
     #define UWARN while(false) uLog(ULog::WarnType,__FILE__,__LINE__,__FUNCTION__)<<ULogSetName
+    #define UWARNF(group,format,...) while(false) UNI_LOGF_IMPL(ULog::WarnType,group,format,__VA_ARGS__)
   #else
-    #define UWARN uLog(ULog::WarnType,__FILE__,__LINE__,__FUNCTION__)<<ULogSetName
+    #define UWARN UNI_LOG_IMPL(ULog::WarnType)
+    #define UWARNF(group,format,...) UNI_LOGF_IMPL(ULog::WarnType,group,format,__VA_ARGS__)
   #endif
   #ifdef UNI_LOG_DISABLE_ERROR
     #define UERROR while(false) uLog(ULog::ErrorType,__FILE__,__LINE__,__FUNCTION__)<<ULogSetName
+    #define UERRORF(group,format,...) while(false) UNI_LOGF_IMPL(ULog::ErrorType,group,format,__VA_ARGS__)
   #else
-    #define UERROR uLog(ULog::ErrorType,__FILE__,__LINE__,__FUNCTION__)<<ULogSetName
+    #define UERROR UNI_LOG_IMPL(ULog::ErrorType)
+    #define UERRORF(group,format,...) UNI_LOGF_IMPL(ULog::ErrorType,group,format,__VA_ARGS__)
   #endif
   #ifdef UNI_LOG_DISABLE_FATAL
     #define UFATAL while(false) uLog(ULog::FatalType,__FILE__,__LINE__,__FUNCTION__)<<ULogSetName
+    #define UFATALF(group,format,...) while(false) UNI_LOGF_IMPL(ULog::FatalType,group,format,__VA_ARGS__)
   #else
-    #define UFATAL uLog(ULog::FatalType,__FILE__,__LINE__,__FUNCTION__)<<ULogSetName
+    #define UFATAL UNI_LOG_IMPL(ULog::FatalType)
+    #define UFATALF(group,format,...) UNI_LOGF_IMPL(ULog::FatalType,group,format,__VA_ARGS__)
   #endif
   #ifdef UNI_LOG_DISABLE_HIDE
     #define UHIDE while(false) uLog(ULog::HideType,__FILE__,__LINE__,__FUNCTION__)<<ULogSetName
+    #define UHIDEF(group,format,...) while(false) UNI_LOGF_IMPL(ULog::HideType,group,format,__VA_ARGS__)
   #else
     #ifdef _DEBUG
-      #define UHIDE uLog(ULog::HideType,__FILE__,__LINE__,__FUNCTION__)<<ULogSetName
+      #define UHIDE UNI_LOG_IMPL(ULog::HideType)
+      #define UHIDEF(group,format,...) UNI_LOGF_IMPL(ULog::HideType,group,format,__VA_ARGS__)
     #else
       #define UHIDE while(false) uLog(ULog::HideType,__FILE__,__LINE__,__FUNCTION__)<<ULogSetName
+      #define UHIDEF(group,format,...) while(false) UNI_LOGF_IMPL(ULog::HideType,group,format,__VA_ARGS__)
     #endif
   #endif
 #endif
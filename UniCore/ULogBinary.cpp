@@ -0,0 +1,386 @@
+﻿#include "ULogBinary.h"
+
+#include <fstream>
+
+#include "UCast.h"
+#include "UDebug.h"
+
+using namespace std;
+
+namespace uni
+{
+
+namespace
+{
+    const char ULogBinaryMagic[8] = {'U','L','O','G','B','I','N','1'};
+    const unsigned int ULogBinaryVersion = 1;
+    //! FILETIME的起点1601年1月1日和time_t的起点1970年1月1日之间相差的100纳秒数.
+    const long long FileTimeToUnixEpoch = 116444736000000000LL;
+
+    //! 复制记录的固定部分,记录比它还小时返回false.
+    template<typename Record>
+    bool readRecord(const char *base,const ULogBinaryRecordHeader &header,Record &record)
+    {
+        if(header.size_ < sizeof(record))
+        {
+            return false;
+        }
+        memcpy(&record,base,sizeof(record));
+        return true;
+    }
+}
+
+ULog::BinaryFileAppender::BinaryFileAppender( const wchar_t *baseName,unsigned int segmentSize )
+:baseName_(baseName)
+,segmentSize_(segmentSize)
+,segmentIndex_(0)
+,file_(INVALID_HANDLE_VALUE)
+,mapping_(NULL)
+,view_(0)
+,used_(0)
+{
+    if(!openSegment())
+    {
+        DebugMessage("UniCore ULog::BinaryFileAppender::BinaryFileAppender 无法创建分段文件.");
+    }
+}
+
+ULog::BinaryFileAppender::~BinaryFileAppender()
+{
+    closeSegment();
+}
+
+bool ULog::BinaryFileAppender::openSegment()
+{
+    names_.clear();
+    sites_.clear();
+    if(segmentSize_ < sizeof(ULogBinaryFileHeader))
+    {
+        return false;
+    }
+    //跳过已经存在的分段,不覆盖之前的日志.
+    for(;;)
+    {
+        wchar_t suffix[32] = L"";
+        swprintf_s(suffix,L".%06d.ulb",segmentIndex_++);
+        wstring fileName = baseName_ + suffix;
+        file_ = CreateFileW(fileName.c_str(),GENERIC_READ|GENERIC_WRITE,FILE_SHARE_READ,
+            NULL,CREATE_NEW,FILE_ATTRIBUTE_NORMAL,NULL);
+        if(file_ != INVALID_HANDLE_VALUE)
+        {
+            break;
+        }
+        if(GetLastError() != ERROR_FILE_EXISTS)
+        {
+            return false;
+        }
+    }
+    //文件映射会把文件扩展到segmentSize_大小,扩展的部分全为0.
+    mapping_ = CreateFileMappingW(file_,NULL,PAGE_READWRITE,0,segmentSize_,NULL);
+    if(mapping_)
+    {
+        view_ = static_cast<char *>(MapViewOfFile(mapping_,FILE_MAP_WRITE,0,0,segmentSize_));
+    }
+    if(!view_)
+    {
+        closeSegment();
+        return false;
+    }
+
+    ULogBinaryFileHeader *header = reinterpret_cast<ULogBinaryFileHeader *>(view_);
+    memcpy(header->magic_,ULogBinaryMagic,sizeof(header->magic_));
+    header->version_ = ULogBinaryVersion;
+    header->headerSize_ = sizeof(ULogBinaryFileHeader);
+    LARGE_INTEGER frequency,ticks;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&ticks);
+    FILETIME fileTime;
+    GetSystemTimeAsFileTime(&fileTime);
+    header->frequency_ = frequency.QuadPart;
+    header->baseTicks_ = ticks.QuadPart;
+    header->baseFileTime_ = (static_cast<long long>(fileTime.dwHighDateTime) << 32)
+        | fileTime.dwLowDateTime;
+    used_ = sizeof(ULogBinaryFileHeader);
+    return true;
+}
+
+void ULog::BinaryFileAppender::closeSegment()
+{
+    if(view_)
+    {
+        UnmapViewOfFile(view_);
+        view_ = 0;
+    }
+    if(mapping_)
+    {
+        CloseHandle(mapping_);
+        mapping_ = NULL;
+    }
+    if(file_ != INVALID_HANDLE_VALUE)
+    {
+        //去掉预先分配但没有用到的部分.
+        LARGE_INTEGER size;
+        size.QuadPart = used_;
+        if(SetFilePointerEx(file_,size,NULL,FILE_BEGIN))
+        {
+            SetEndOfFile(file_);
+        }
+        CloseHandle(file_);
+        file_ = INVALID_HANDLE_VALUE;
+    }
+    used_ = 0;
+}
+
+bool ULog::BinaryFileAppender::reserve( unsigned int size )
+{
+    if(size > segmentSize_ - sizeof(ULogBinaryFileHeader))
+    {
+        return false;
+    }
+    if(!view_ || used_ + size > segmentSize_)
+    {
+        closeSegment();
+        return openSegment();
+    }
+    return true;
+}
+
+unsigned int ULog::BinaryFileAppender::internName( const std::string &name )
+{
+    map<string,unsigned int>::const_iterator it = names_.find(name);
+    if(it != names_.end())
+    {
+        return it->second;
+    }
+    const unsigned int id = static_cast<unsigned int>(names_.size());
+    const unsigned int length = static_cast<unsigned int>(name.size());
+    const unsigned int size = ULogBinaryAlign(sizeof(ULogBinaryNameRecord) + length);
+    ULogBinaryNameRecord *record = reinterpret_cast<ULogBinaryNameRecord *>(view_ + used_);
+    record->id_ = id;
+    record->length_ = length;
+    memcpy(record + 1,name.c_str(),length);
+    record->header_.kind_ = ULogBinaryNameKind;
+    record->header_.type_ = 0;
+    //最后写入记录大小,程序崩溃时读取方不会看到写了一半的记录.
+    record->header_.size_ = size;
+    used_ += size;
+    names_[name] = id;
+    return id;
+}
+
+unsigned int ULog::BinaryFileAppender::internSite( const Message *message )
+{
+    Site site = {message->file_,message->func_,message->line_};
+    map<Site,unsigned int>::const_iterator it = sites_.find(site);
+    if(it != sites_.end())
+    {
+        return it->second;
+    }
+    const unsigned int id = static_cast<unsigned int>(sites_.size());
+    const unsigned int fileLength = static_cast<unsigned int>(strlen(message->file_));
+    const unsigned int funcLength = static_cast<unsigned int>(strlen(message->func_));
+    const unsigned int size = ULogBinaryAlign(sizeof(ULogBinarySiteRecord) + fileLength + funcLength);
+    ULogBinarySiteRecord *record = reinterpret_cast<ULogBinarySiteRecord *>(view_ + used_);
+    record->id_ = id;
+    record->line_ = message->line_;
+    record->fileLength_ = fileLength;
+    record->funcLength_ = funcLength;
+    char *text = reinterpret_cast<char *>(record + 1);
+    memcpy(text,message->file_,fileLength);
+    memcpy(text + fileLength,message->func_,funcLength);
+    record->header_.kind_ = ULogBinarySiteKind;
+    record->header_.type_ = 0;
+    record->header_.size_ = size;
+    used_ += size;
+    sites_[site] = id;
+    return id;
+}
+
+void ULog::BinaryFileAppender::append( Message *message )
+{
+    const int messageLength = static_cast<int>(message->stm_.size());
+    //UTF-16的一个码元最多对应3个UTF-8字节.
+    const unsigned int maxPayload = messageLength * 3;
+    const unsigned int maxSize =
+        ULogBinaryAlign(sizeof(ULogBinaryNameRecord) + message->name_.size())
+        + ULogBinaryAlign(sizeof(ULogBinarySiteRecord) + strlen(message->file_) + strlen(message->func_))
+        + ULogBinaryAlign(sizeof(ULogBinaryMessageRecord) + maxPayload);
+    //一次分配好最坏情况需要的空间,保证分组名,输出位置和日志在同一个分段中.
+    if(!reserve(maxSize))
+    {
+        DebugMessage("UniCore ULog::BinaryFileAppender::append 日志太长或者无法创建分段文件.");
+        return;
+    }
+    const unsigned int nameId = internName(message->name_);
+    const unsigned int siteId = internSite(message);
+
+    ULogBinaryMessageRecord *record = reinterpret_cast<ULogBinaryMessageRecord *>(view_ + used_);
+    int payload = 0;
+    if(messageLength)
+    {
+        payload = WideCharToMultiByte(CP_UTF8,0,message->stm_.data(),messageLength,
+            reinterpret_cast<char *>(record + 1),maxPayload,NULL,NULL);
+    }
+    long long ticks = message->ticks_;
+    if(!ticks)
+    {
+        LARGE_INTEGER now;
+        QueryPerformanceCounter(&now);
+        ticks = now.QuadPart;
+    }
+    record->nameId_ = nameId;
+    record->siteId_ = siteId;
+    record->ticks_ = ticks;
+    record->length_ = payload;
+    record->reserved_ = 0;
+    record->header_.kind_ = ULogBinaryMessageKind;
+    record->header_.type_ = static_cast<unsigned short>(message->type_);
+    const unsigned int size = ULogBinaryAlign(sizeof(ULogBinaryMessageRecord) + payload);
+    record->header_.size_ = size;
+    used_ += size;
+}
+
+void ULog::BinaryFileAppender::flush()
+{
+    if(view_)
+    {
+        FlushViewOfFile(view_,used_);
+    }
+}
+
+ULogBinaryReader::ULogBinaryReader()
+:pos_(0)
+,corrupted_(false)
+{
+    memset(&header_,0,sizeof(header_));
+}
+
+bool ULogBinaryReader::open( const wchar_t *fileName )
+{
+    data_.clear();
+    names_.clear();
+    sites_.clear();
+    pos_ = 0;
+    corrupted_ = false;
+
+    ifstream file(fileName,ios_base::in|ios_base::binary);
+    if(!file)
+    {
+        return false;
+    }
+    file.seekg(0,ios_base::end);
+    const streamoff size = file.tellg();
+    file.seekg(0,ios_base::beg);
+    if(size < static_cast<streamoff>(sizeof(ULogBinaryFileHeader)))
+    {
+        return false;
+    }
+    data_.resize(static_cast<size_t>(size));
+    if(!file.read(&data_[0],size))
+    {
+        return false;
+    }
+    memcpy(&header_,&data_[0],sizeof(header_));
+    if(memcmp(header_.magic_,ULogBinaryMagic,sizeof(header_.magic_))
+        || header_.version_ != ULogBinaryVersion
+        || header_.headerSize_ < sizeof(ULogBinaryFileHeader)
+        || header_.headerSize_ > data_.size()
+        || header_.frequency_ <= 0)
+    {
+        return false;
+    }
+    pos_ = header_.headerSize_;
+    return true;
+}
+
+bool ULogBinaryReader::next( Entry &entry )
+{
+    while(!corrupted_ && pos_ + sizeof(ULogBinaryRecordHeader) <= data_.size())
+    {
+        const char *base = &data_[pos_];
+        ULogBinaryRecordHeader header;
+        memcpy(&header,base,sizeof(header));
+        if(!header.size_)
+        {
+            //预先分配的空间,之后没有数据了.
+            return false;
+        }
+        if(header.size_ % 8 || header.size_ > data_.size() - pos_)
+        {
+            corrupted_ = true;
+            return false;
+        }
+        pos_ += header.size_;
+        switch(header.kind_)
+        {
+        case ULogBinaryNameKind:
+            {
+                ULogBinaryNameRecord record;
+                if(!readRecord(base,header,record) || record.length_ > header.size_ - sizeof(record))
+                {
+                    corrupted_ = true;
+                    return false;
+                }
+                names_[record.id_].assign(base + sizeof(record),record.length_);
+                break;
+            }
+        case ULogBinarySiteKind:
+            {
+                ULogBinarySiteRecord record;
+                if(!readRecord(base,header,record) || record.fileLength_ > header.size_ - sizeof(record)
+                    || record.funcLength_ > header.size_ - sizeof(record) - record.fileLength_)
+                {
+                    corrupted_ = true;
+                    return false;
+                }
+                Site &site = sites_[record.id_];
+                site.file_.assign(base + sizeof(record),record.fileLength_);
+                site.func_.assign(base + sizeof(record) + record.fileLength_,record.funcLength_);
+                site.line_ = record.line_;
+                break;
+            }
+        case ULogBinaryMessageKind:
+            {
+                ULogBinaryMessageRecord record;
+                if(!readRecord(base,header,record) || record.length_ > header.size_ - sizeof(record))
+                {
+                    corrupted_ = true;
+                    return false;
+                }
+                map<unsigned int,string>::const_iterator name = names_.find(record.nameId_);
+                map<unsigned int,Site>::const_iterator site = sites_.find(record.siteId_);
+                if(name == names_.end() || site == sites_.end())
+                {
+                    corrupted_ = true;
+                    return false;
+                }
+                entry.type_ = static_cast<ULog::Type>(header.type_);
+                entry.ticks_ = record.ticks_;
+                //分开计算整数秒和余数,避免乘以10000000时溢出.
+                const long long elapsed = record.ticks_ - header_.baseTicks_;
+                const long long fileTime = header_.baseFileTime_
+                    + elapsed / header_.frequency_ * 10000000
+                    + elapsed % header_.frequency_ * 10000000 / header_.frequency_;
+                entry.time_ = static_cast<time_t>((fileTime - FileTimeToUnixEpoch) / 10000000);
+                entry.name_ = name->second;
+                entry.file_ = site->second.file_;
+                entry.func_ = site->second.func_;
+                entry.line_ = site->second.line_;
+                entry.message_.assign(base + sizeof(record),record.length_);
+                return true;
+            }
+        default:
+            //不认识的记录,跳过.
+            break;
+        }
+    }
+    return false;
+}
+
+void ULogBinaryReader::writeText( std::ostream &stm,const Entry &entry )
+{
+    ULog::writeTextLine(stm,entry.time_,entry.name_,entry.type_,entry.func_.c_str(),
+        ws2s(s2ws(entry.message_,CP_UTF8)),entry.line_);
+}
+
+}//namespace uni
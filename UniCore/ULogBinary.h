@@ -0,0 +1,169 @@
+﻿/*! \file ULogBinary.h
+    \brief ULog::BinaryFileAppender使用的二进制日志格式,以及读取二进制日志的ULogBinaryReader.
+
+    一个分段文件由ULogBinaryFileHeader开头,之后是一条接一条的记录.
+    每条记录以ULogBinaryRecordHeader开头,记录的大小按8字节对齐.
+    分段文件是预先分配好大小的,大小为0的记录头表示之后没有数据了.
+
+    记录分为3种:
+    - ULogBinaryNameRecord 定义一个日志分组名的编号,名字紧跟在结构之后.
+    - ULogBinarySiteRecord 定义一个日志输出位置(源文件,函数,行号)的编号,
+      源文件名和函数名紧跟在结构之后.
+    - ULogBinaryMessageRecord 一条日志,UTF-8编码的日志内容紧跟在结构之后.
+
+    编号只在同一个分段文件中有效,每个分段文件都可以单独解析.
+
+    \author unigauldoth@gmail.com
+    \date       2026-10-18
+*/
+#ifndef UNICORE_ULOGBINARY_H
+#define UNICORE_ULOGBINARY_H
+
+#define AUTO_LINK_LIB_NAME "UniCore"
+#include "AutoLink.h"
+
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "ULog.h"
+
+namespace uni
+{
+
+//! 分段文件头.
+struct ULogBinaryFileHeader
+{
+    char magic_[8];         //!< 固定为"ULOGBIN1".
+    unsigned int version_;  //!< 格式版本,当前为1.
+    unsigned int headerSize_;   //!< 文件头的大小,第一条记录从这里开始.
+    long long frequency_;   //!< QueryPerformanceFrequency的值.
+    long long baseTicks_;   //!< 创建文件时的QueryPerformanceCounter计数.
+    long long baseFileTime_;    //!< 创建文件时的UTC时间,单位和FILETIME相同.
+    long long reserved_;
+};
+
+//! 记录的种类.
+enum ULogBinaryRecordKind
+{
+    ULogBinaryNameKind = 1,     //!< ULogBinaryNameRecord.
+    ULogBinarySiteKind = 2,     //!< ULogBinarySiteRecord.
+    ULogBinaryMessageKind = 3,  //!< ULogBinaryMessageRecord.
+};
+
+//! 记录头.
+struct ULogBinaryRecordHeader
+{
+    unsigned int size_;     //!< 整条记录的大小,包括记录头和对齐填充.
+    unsigned short kind_;   //!< ULogBinaryRecordKind.
+    unsigned short type_;   //!< 日志记录中为ULog::Type,其他记录中为0.
+};
+
+//! 日志分组名记录.
+struct ULogBinaryNameRecord
+{
+    ULogBinaryRecordHeader header_;
+    unsigned int id_;
+    unsigned int length_;   //!< 分组名的字节数.
+};
+
+//! 日志输出位置记录.
+struct ULogBinarySiteRecord
+{
+    ULogBinaryRecordHeader header_;
+    unsigned int id_;
+    int line_;
+    unsigned int fileLength_;   //!< 源文件名的字节数.
+    unsigned int funcLength_;   //!< 函数名的字节数,函数名紧跟在源文件名之后.
+};
+
+//! 日志记录.
+struct ULogBinaryMessageRecord
+{
+    ULogBinaryRecordHeader header_;
+    unsigned int nameId_;
+    unsigned int siteId_;
+    long long ticks_;       //!< 日志产生时的QueryPerformanceCounter计数.
+    unsigned int length_;   //!< 日志内容的字节数.
+    unsigned int reserved_;
+};
+
+//! 返回size按记录对齐要求向上取整的结果.
+inline unsigned int ULogBinaryAlign(unsigned int size)
+{
+    return (size + 7) & ~7u;
+}
+
+//! 读取ULog::BinaryFileAppender写的分段文件.
+/*!
+    \code
+    ULogBinaryReader reader;
+    if(reader.open(L"app.000000.ulb"))
+    {
+        ULogBinaryReader::Entry entry;
+        while(reader.next(entry))
+        {
+            ULogBinaryReader::writeText(std::cout,entry);
+        }
+    }
+    \endcode
+*/
+class ULogBinaryReader
+{
+public:
+    //! 一条解析出来的日志.
+    struct Entry
+    {
+        ULog::Type type_;
+        time_t time_;           //!< 日志产生的时间.
+        long long ticks_;       //!< 日志产生时的QueryPerformanceCounter计数.
+        std::string name_;      //!< 日志分组名.
+        std::string file_;
+        std::string func_;
+        int line_;
+        std::string message_;   //!< UTF-8编码的日志内容.
+    };
+
+    ULogBinaryReader();
+
+    //! 读入一个分段文件.
+    /*!
+        \param fileName 分段文件名.
+        \return 文件不存在或者不是二进制日志文件时返回false.
+    */
+    bool open(const wchar_t *fileName);
+
+    //! 读取下一条日志.
+    /*!
+        \return 没有更多日志时返回false.
+    */
+    bool next(Entry &entry);
+
+    //! 是否遇到了无法解析的数据,next在这种情况下也会返回false.
+    bool isCorrupted() const {return corrupted_;}
+
+    //! 以FileAppender的文本格式输出一条日志,日志内容被转换为本地代码页.
+    static void writeText(std::ostream &stm,const Entry &entry);
+private:
+    ULogBinaryReader(const ULogBinaryReader &);
+    ULogBinaryReader &operator=(const ULogBinaryReader &);
+
+    struct Site
+    {
+        std::string file_;
+        std::string func_;
+        int line_;
+    };
+
+    std::vector<char> data_;
+    size_t pos_;
+    bool corrupted_;
+    ULogBinaryFileHeader header_;
+    std::map<unsigned int,std::string> names_;
+    std::map<unsigned int,Site> sites_;
+};
+
+}//namespace uni
+
+#endif//UNICORE_ULOGBINARY_H
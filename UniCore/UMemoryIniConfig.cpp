@@ -0,0 +1,1165 @@
+﻿#include "UMemoryIniConfig.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _MSC_VER
+#include <unordered_map>
+#else
+#include <tr1/unordered_map>
+#endif
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include "Windows.h"
+#include <io.h>
+#include <process.h>
+#else
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "UCast.h"
+#include "UCommon.h"
+#include "UTranscode.h"
+
+using namespace std;
+
+namespace uni
+{
+
+namespace
+{
+    ULock::Word atomicIncrement(volatile ULock::Word *value)
+    {
+#ifdef _WIN32
+        return InterlockedIncrement(value);
+#else
+        return __atomic_add_fetch(value,1,__ATOMIC_SEQ_CST);
+#endif
+    }
+
+    ULock::Word atomicDecrement(volatile ULock::Word *value)
+    {
+#ifdef _WIN32
+        return InterlockedDecrement(value);
+#else
+        return __atomic_sub_fetch(value,1,__ATOMIC_SEQ_CST);
+#endif
+    }
+
+    ULock::Word atomicLoad(const volatile ULock::Word *value)
+    {
+#ifdef _WIN32
+        //volatile的读在x86和x64上有获取语义.
+        return *value;
+#else
+        return __atomic_load_n(value,__ATOMIC_ACQUIRE);
+#endif
+    }
+
+    void atomicStore(volatile ULock::Word *value,ULock::Word newValue)
+    {
+#ifdef _WIN32
+        InterlockedExchange(value,newValue);
+#else
+        __atomic_store_n(value,newValue,__ATOMIC_SEQ_CST);
+#endif
+    }
+
+    template<typename T>
+    T *atomicLoadPointer(T * const volatile *pointer)
+    {
+#ifdef _WIN32
+        return *pointer;
+#else
+        return __atomic_load_n(pointer,__ATOMIC_ACQUIRE);
+#endif
+    }
+
+    template<typename T>
+    T *atomicExchangePointer(T * volatile *pointer,T *value)
+    {
+#ifdef _WIN32
+        return static_cast<T *>(InterlockedExchangePointer(reinterpret_cast<void * volatile *>(pointer),value));
+#else
+        return __atomic_exchange_n(pointer,value,__ATOMIC_SEQ_CST);
+#endif
+    }
+
+    void yieldThread()
+    {
+#ifdef _WIN32
+        if(!SwitchToThread())
+        {
+            Sleep(0);
+        }
+#else
+        sched_yield();
+#endif
+    }
+
+    //! 不区分大小写的索引使用的键.
+    wstring foldKey(const wstring &s)
+    {
+        wstring result(s);
+        for(size_t i = 0; i < result.size(); i++)
+        {
+            result[i] = fold_case(result[i]);
+        }
+        return result;
+    }
+
+    bool isBlank(wchar_t c)
+    {
+        return c == L' ' || c == L'\t';
+    }
+
+    wstring trimBlanks(const wstring &s)
+    {
+        size_t begin = 0;
+        size_t end = s.size();
+        while(begin < end && isBlank(s[begin]))
+        {
+            begin++;
+        }
+        while(end > begin && isBlank(s[end - 1]))
+        {
+            end--;
+        }
+        return s.substr(begin,end - begin);
+    }
+
+    //! 和GetPrivateProfileString一样去掉值两端成对的引号.
+    wstring unquote(const wstring &value)
+    {
+        if(value.size() >= 2 && (value[0] == L'"' || value[0] == L'\'') && value[value.size() - 1] == value[0])
+        {
+            return value.substr(1,value.size() - 2);
+        }
+        return value;
+    }
+
+    //! 值两端有空白或引号时加上引号,读取时才能得到原来的值.
+    wstring quoteIfNeeded(const wstring &value)
+    {
+        if(!value.empty() && (isBlank(value[0]) || isBlank(value[value.size() - 1])
+            || value[0] == L'"' || value[0] == L'\''))
+        {
+            return L"\"" + value + L"\"";
+        }
+        return value;
+    }
+
+    enum Encoding
+    {
+        AnsiEncoding,
+        Utf8Encoding,
+        Utf8BomEncoding,
+        Utf16LeEncoding
+    };
+
+    Encoding defaultEncoding()
+    {
+#ifdef _WIN32
+        return Utf16LeEncoding;
+#else
+        return Utf8Encoding;
+#endif
+    }
+
+    wstring fromUtf16(const vector<UUtf16Unit> &units)
+    {
+        if(units.empty())
+        {
+            return wstring();
+        }
+        if(sizeof(wchar_t) == sizeof(UUtf16Unit))
+        {
+            return wstring(units.begin(),units.end());
+        }
+        vector<UUtf32Unit> codePoints(units.size());
+        codePoints.resize(utf16ToUtf32(&units[0],units.size(),&codePoints[0],codePoints.size()));
+        return wstring(codePoints.begin(),codePoints.end());
+    }
+
+    vector<UUtf16Unit> toUtf16(const wstring &text)
+    {
+        if(sizeof(wchar_t) == sizeof(UUtf16Unit) || text.empty())
+        {
+            return vector<UUtf16Unit>(text.begin(),text.end());
+        }
+        const vector<UUtf32Unit> codePoints(text.begin(),text.end());
+        vector<UUtf16Unit> units(codePoints.size() * 2);
+        units.resize(utf32ToUtf16(&codePoints[0],codePoints.size(),&units[0],units.size()));
+        return units;
+    }
+
+    wstring decodeText(const string &content,Encoding &encoding)
+    {
+        if(content.size() >= 2 && content[0] == '\xFF' && content[1] == '\xFE')
+        {
+            encoding = Utf16LeEncoding;
+            vector<UUtf16Unit> units((content.size() - 2) / 2);
+            for(size_t i = 0; i < units.size(); i++)
+            {
+                units[i] = static_cast<UUtf16Unit>(static_cast<unsigned char>(content[2 + i * 2])
+                    | (static_cast<unsigned char>(content[3 + i * 2]) << 8));
+            }
+            return fromUtf16(units);
+        }
+        if(content.size() >= 3 && content.compare(0,3,"\xEF\xBB\xBF") == 0)
+        {
+            encoding = Utf8BomEncoding;
+            return utf8ToWide(UStringView(content).substr(3));
+        }
+#ifdef _WIN32
+        encoding = AnsiEncoding;
+        return s2ws(content,CP_ACP);
+#else
+        encoding = Utf8Encoding;
+        return utf8ToWide(content);
+#endif
+    }
+
+    string encodeText(const wstring &text,Encoding encoding)
+    {
+        switch(encoding)
+        {
+        case Utf16LeEncoding:
+            {
+                const vector<UUtf16Unit> units = toUtf16(text);
+                string result("\xFF\xFE");
+                result.reserve(2 + units.size() * 2);
+                for(size_t i = 0; i < units.size(); i++)
+                {
+                    result += static_cast<char>(units[i] & 0xFF);
+                    result += static_cast<char>(units[i] >> 8);
+                }
+                return result;
+            }
+        case Utf8BomEncoding:
+            return "\xEF\xBB\xBF" + wideToUtf8(text);
+#ifdef _WIN32
+        case AnsiEncoding:
+            return ws2s(text,CP_ACP);
+#endif
+        default:
+            return wideToUtf8(text);
+        }
+    }
+
+#ifdef _WIN32
+    FILE *openFile(const wstring &path,const wchar_t *mode)
+    {
+        FILE *file = 0;
+        return _wfopen_s(&file,path.c_str(),mode) == 0 ? file : 0;
+    }
+#else
+    FILE *openFile(const wstring &path,const wchar_t *mode)
+    {
+        return fopen(wideToUtf8(path).c_str(),wideToUtf8(mode).c_str());
+    }
+#endif
+
+    //! 读取整个文件.文件不存在时exists为false,返回true.
+    bool readFile(const wstring &path,string &content,bool &exists)
+    {
+        content.clear();
+        FILE *file = openFile(path,L"rb");
+        if(!file)
+        {
+            exists = errno != ENOENT;
+            return !exists;
+        }
+        exists = true;
+        char buffer[4096];
+        size_t size = 0;
+        while((size = fread(buffer,1,sizeof(buffer),file)) > 0)
+        {
+            content.append(buffer,size);
+        }
+        const bool ok = !ferror(file);
+        fclose(file);
+        return ok;
+    }
+
+    //! 先写到临时文件,再替换原文件.
+    bool writeFileAtomically(const wstring &path,const string &content)
+    {
+        const wstring tempPath = path + L".tmp";
+        FILE *file = openFile(tempPath,L"wb");
+        if(!file)
+        {
+            return false;
+        }
+        bool ok = fwrite(content.data(),1,content.size(),file) == content.size() && fflush(file) == 0;
+#ifdef _WIN32
+        ok = ok && _commit(_fileno(file)) == 0;
+#else
+        ok = ok && fsync(fileno(file)) == 0;
+#endif
+        ok = fclose(file) == 0 && ok;
+        if(ok)
+        {
+#ifdef _WIN32
+            ok = MoveFileExW(tempPath.c_str(),path.c_str(),MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != FALSE;
+#else
+            ok = rename(wideToUtf8(tempPath).c_str(),wideToUtf8(path).c_str()) == 0;
+#endif
+        }
+        if(!ok)
+        {
+#ifdef _WIN32
+            DeleteFileW(tempPath.c_str());
+#else
+            unlink(wideToUtf8(tempPath).c_str());
+#endif
+        }
+        return ok;
+    }
+
+    //! 读取文件的大小,修改时间和文件号,文件不存在时都为0.
+    void readFileStamp(const wstring &path,long long &size,long long &modifiedTime,unsigned long long &id)
+    {
+        size = 0;
+        modifiedTime = 0;
+        id = 0;
+#ifdef _WIN32
+        WIN32_FILE_ATTRIBUTE_DATA data;
+        if(GetFileAttributesExW(path.c_str(),GetFileExInfoStandard,&data))
+        {
+            size = (static_cast<long long>(data.nFileSizeHigh) << 32) | data.nFileSizeLow;
+            modifiedTime = (static_cast<long long>(data.ftLastWriteTime.dwHighDateTime) << 32) | data.ftLastWriteTime.dwLowDateTime;
+        }
+#else
+        struct stat info;
+        if(stat(wideToUtf8(path).c_str(),&info) == 0)
+        {
+            size = info.st_size;
+            modifiedTime = static_cast<long long>(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+            id = info.st_ino;
+        }
+#endif
+    }
+
+    //! 拆分出所在的目录和文件名.
+    void splitPath(const wstring &path,wstring &directory,wstring &fileName)
+    {
+        const size_t slash = path.find_last_of(L"/\\");
+        if(slash == wstring::npos)
+        {
+            directory = L".";
+            fileName = path;
+        }
+        else
+        {
+            directory = slash ? path.substr(0,slash) : path.substr(0,1);
+            fileName = path.substr(slash + 1);
+        }
+    }
+}
+
+//! 解析后的ini文件.
+struct UMemoryIniConfig::Document
+{
+    //! 文件中的一行,key为空时是注释,空行或无法识别的行.
+    struct Line
+    {
+        wstring key;
+        wstring value;
+        wstring text;   //!< 这一行原来的内容,修改过的键会重新生成.
+    };
+
+    struct Section
+    {
+        wstring name;
+        bool hasHeader;     //!< 第一个section之前的内容没有标题,其中的键不能被读取.
+        wstring header;
+        vector<Line> lines;
+    };
+
+    typedef std::tr1::unordered_map<wstring,pair<size_t,size_t> > KeyIndex;
+    typedef std::tr1::unordered_map<wstring,size_t> SectionIndex;
+
+    Document():encoding(defaultEncoding()),newline(L"\r\n"),generation(0),slotKeys(0)
+    {
+        Section prelude;
+        prelude.hasHeader = false;
+        sections.push_back(prelude);
+    }
+
+    void parse(const string &content)
+    {
+        const wstring text = decodeText(content,encoding);
+        newline = text.find(L"\r\n") != wstring::npos || text.find(L'\n') == wstring::npos ? L"\r\n" : L"\n";
+        size_t begin = 0;
+        while(begin < text.size())
+        {
+            size_t end = text.find(L'\n',begin);
+            if(end == wstring::npos)
+            {
+                end = text.size();
+            }
+            wstring lineText = text.substr(begin,end - begin);
+            if(!lineText.empty() && lineText[lineText.size() - 1] == L'\r')
+            {
+                lineText.resize(lineText.size() - 1);
+            }
+            parseLine(lineText);
+            begin = end + 1;
+        }
+        rebuildIndex();
+    }
+
+    void parseLine(const wstring &text)
+    {
+        const wstring trimmed = trimBlanks(text);
+        Line line;
+        line.text = text;
+        if(!trimmed.empty() && trimmed[0] == L'[')
+        {
+            const size_t close = trimmed.find(L']');
+            if(close != wstring::npos)
+            {
+                Section section;
+                section.name = trimBlanks(trimmed.substr(1,close - 1));
+                section.hasHeader = true;
+                section.header = text;
+                sections.push_back(section);
+                return;
+            }
+        }
+        const size_t equal = trimmed.find(L'=');
+        if(!trimmed.empty() && trimmed[0] != L';' && trimmed[0] != L'#' && equal != wstring::npos && equal)
+        {
+            line.key = trimBlanks(trimmed.substr(0,equal));
+            line.value = unquote(trimBlanks(trimmed.substr(equal + 1)));
+        }
+        sections.back().lines.push_back(line);
+    }
+
+    //! 和GetPrivateProfileString一样,同名的section和键只有第一个有效.
+    void rebuildIndex()
+    {
+        keys.clear();
+        sectionIndex.clear();
+        for(size_t i = 0; i < sections.size(); i++)
+        {
+            const Section &section = sections[i];
+            if(!section.hasHeader || !sectionIndex.insert(make_pair(foldKey(section.name),i)).second)
+            {
+                continue;
+            }
+            const wstring prefix = foldKey(section.name) + L'/';
+            for(size_t j = 0; j < section.lines.size(); j++)
+            {
+                if(!section.lines[j].key.empty())
+                {
+                    keys.insert(make_pair(prefix + foldKey(section.lines[j].key),make_pair(i,j)));
+                }
+            }
+        }
+        updateSlots();
+    }
+
+    //! 重新计算每个槽位对应的行.
+    void updateSlots()
+    {
+        slotPositions.assign(slotKeys ? slotKeys->size() : 0,make_pair(wstring::npos,wstring::npos));
+        for(size_t i = 0; i < slotPositions.size(); i++)
+        {
+            KeyIndex::const_iterator it = keys.find((*slotKeys)[i]);
+            if(it != keys.end())
+            {
+                slotPositions[i] = it->second;
+            }
+        }
+    }
+
+    //! 计算新增加的最后一个槽位对应的行.
+    void appendSlot()
+    {
+        KeyIndex::const_iterator it = keys.find(slotKeys->back());
+        slotPositions.push_back(it != keys.end() ? it->second : make_pair(wstring::npos,wstring::npos));
+    }
+
+    static wstring indexKey(const wstring &section,const wstring &key)
+    {
+        return foldKey(section) + L'/' + foldKey(key);
+    }
+
+    const wstring *find(const wstring &section,const wstring &key) const
+    {
+        KeyIndex::const_iterator it = keys.find(indexKey(section,key));
+        return it == keys.end() ? 0 : &sections[it->second.first].lines[it->second.second].value;
+    }
+
+    void setValue(const wstring &sectionName,const wstring &key,const wstring &value)
+    {
+        KeyIndex::const_iterator it = keys.find(indexKey(sectionName,key));
+        if(it != keys.end())
+        {
+            Line &line = sections[it->second.first].lines[it->second.second];
+            line.value = value;
+            line.text = line.key + L"=" + quoteIfNeeded(value);
+            return;
+        }
+        SectionIndex::const_iterator sectionIt = sectionIndex.find(foldKey(sectionName));
+        size_t sectionPosition = 0;
+        if(sectionIt == sectionIndex.end())
+        {
+            Section section;
+            section.name = sectionName;
+            section.hasHeader = true;
+            section.header = L"[" + sectionName + L"]";
+            sections.push_back(section);
+            sectionPosition = sections.size() - 1;
+        }
+        else
+        {
+            sectionPosition = sectionIt->second;
+        }
+        //新的键放在section最后一个非空行之后,保留section之间的空行.
+        vector<Line> &lines = sections[sectionPosition].lines;
+        size_t position = lines.size();
+        while(position > 0 && trimBlanks(lines[position - 1].text).empty())
+        {
+            position--;
+        }
+        Line line;
+        line.key = key;
+        line.value = value;
+        line.text = key + L"=" + quoteIfNeeded(value);
+        lines.insert(lines.begin() + position,line);
+        rebuildIndex();
+    }
+
+    void removeValue(const wstring &section,const wstring &key)
+    {
+        KeyIndex::const_iterator it = keys.find(indexKey(section,key));
+        if(it != keys.end())
+        {
+            vector<Line> &lines = sections[it->second.first].lines;
+            lines.erase(lines.begin() + it->second.second);
+            rebuildIndex();
+        }
+    }
+
+    string serialize() const
+    {
+        wstring text;
+        for(size_t i = 0; i < sections.size(); i++)
+        {
+            if(sections[i].hasHeader)
+            {
+                text += sections[i].header;
+                text += newline;
+            }
+            for(size_t j = 0; j < sections[i].lines.size(); j++)
+            {
+                text += sections[i].lines[j].text;
+                text += newline;
+            }
+        }
+        return encodeText(text,encoding);
+    }
+
+    vector<Section> sections;
+    KeyIndex keys;              //!< 转换为小写的"section/键名"到所在位置.
+    SectionIndex sectionIndex;  //!< 转换为小写的section名到所在位置.
+    Encoding encoding;
+    wstring newline;
+    unsigned int generation;
+    const vector<wstring> *slotKeys;            //!< 所有槽位的索引键,只有master_使用.
+    vector<pair<size_t,size_t> > slotPositions; //!< 槽位对应的位置,键不存在时为npos.
+};
+
+//! 在后台线程中等待文件被修改.
+/*!
+    监视的是文件所在的目录,这样文件被替换(包括UMemoryIniConfig::flush)后仍然有效.
+*/
+class UMemoryIniConfig::Watcher
+{
+public:
+    explicit Watcher(UMemoryIniConfig *config)
+        :config_(config)
+    {
+        splitPath(config->iniPath_,directory_,fileName_);
+#ifdef _WIN32
+        change_ = INVALID_HANDLE_VALUE;
+        stop_ = 0;
+        thread_ = 0;
+#else
+        inotify_ = -1;
+        stopPipe_[0] = stopPipe_[1] = -1;
+        started_ = false;
+#endif
+    }
+
+    ~Watcher()
+    {
+        stop();
+    }
+
+    bool start()
+    {
+#ifdef _WIN32
+        change_ = FindFirstChangeNotificationW(directory_.c_str(),FALSE,
+            FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_SIZE);
+        if(change_ == INVALID_HANDLE_VALUE)
+        {
+            return false;
+        }
+        stop_ = CreateEventW(NULL,TRUE,FALSE,NULL);
+        thread_ = reinterpret_cast<HANDLE>(_beginthreadex(NULL,0,&Watcher::threadProc,this,0,NULL));
+        return stop_ && thread_;
+#else
+        inotify_ = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+        if(inotify_ < 0 || pipe(stopPipe_) != 0)
+        {
+            return false;
+        }
+        if(inotify_add_watch(inotify_,wideToUtf8(directory_).c_str(),IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE) < 0)
+        {
+            return false;
+        }
+        started_ = pthread_create(&thread_,NULL,&Watcher::threadProc,this) == 0;
+        return started_;
+#endif
+    }
+
+    void stop()
+    {
+#ifdef _WIN32
+        if(thread_)
+        {
+            SetEvent(stop_);
+            WaitForSingleObject(thread_,INFINITE);
+            CloseHandle(thread_);
+            thread_ = 0;
+        }
+        if(stop_)
+        {
+            CloseHandle(stop_);
+            stop_ = 0;
+        }
+        if(change_ != INVALID_HANDLE_VALUE)
+        {
+            FindCloseChangeNotification(change_);
+            change_ = INVALID_HANDLE_VALUE;
+        }
+#else
+        if(started_)
+        {
+            const char byte = 0;
+            while(write(stopPipe_[1],&byte,1) < 0 && errno == EINTR)
+            {
+            }
+            pthread_join(thread_,NULL);
+            started_ = false;
+        }
+        for(int i = 0; i < 2; i++)
+        {
+            if(stopPipe_[i] >= 0)
+            {
+                close(stopPipe_[i]);
+                stopPipe_[i] = -1;
+            }
+        }
+        if(inotify_ >= 0)
+        {
+            close(inotify_);
+            inotify_ = -1;
+        }
+#endif
+    }
+
+private:
+    Watcher(const Watcher &);
+    Watcher &operator=(const Watcher &);
+
+#ifdef _WIN32
+    static unsigned __stdcall threadProc(void *param)
+    {
+        Watcher *watcher = static_cast<Watcher *>(param);
+        HANDLE handles[2] = {watcher->stop_,watcher->change_};
+        while(WaitForMultipleObjects(2,handles,FALSE,INFINITE) == WAIT_OBJECT_0 + 1)
+        {
+            //目录中任何文件的变化都会通知,由onFileChanged比较文件的状态.
+            watcher->config_->onFileChanged();
+            if(!FindNextChangeNotification(watcher->change_))
+            {
+                break;
+            }
+        }
+        return 0;
+    }
+
+    HANDLE change_;
+    HANDLE stop_;
+    HANDLE thread_;
+#else
+    static void *threadProc(void *param)
+    {
+        static_cast<Watcher *>(param)->run();
+        return NULL;
+    }
+
+    void run()
+    {
+        const string fileName = wideToUtf8(fileName_);
+        pollfd fds[2] = {{stopPipe_[0],POLLIN,0},{inotify_,POLLIN,0}};
+        for(;;)
+        {
+            if(poll(fds,2,-1) < 0)
+            {
+                if(errno == EINTR)
+                {
+                    continue;
+                }
+                return;
+            }
+            if(fds[0].revents)
+            {
+                return;
+            }
+            bool changed = false;
+            char buffer[4096] __attribute__((aligned(__alignof__(inotify_event))));
+            ssize_t size;
+            while((size = read(inotify_,buffer,sizeof(buffer))) > 0)
+            {
+                for(char *p = buffer; p < buffer + size; p += sizeof(inotify_event) + reinterpret_cast<inotify_event *>(p)->len)
+                {
+                    const inotify_event *event = reinterpret_cast<inotify_event *>(p);
+                    changed = changed || (event->len && fileName == event->name);
+                }
+            }
+            if(changed)
+            {
+                config_->onFileChanged();
+            }
+        }
+    }
+
+    int inotify_;
+    int stopPipe_[2];
+    pthread_t thread_;
+    bool started_;
+#endif
+
+    UMemoryIniConfig *config_;
+    wstring directory_;
+    wstring fileName_;
+};
+
+UMemoryIniConfig::UMemoryIniConfig( const std::wstring &iniPath )
+    :iniPath_(iniPath),snapshot_(new Document),epoch_(0),master_(new Document),batchDepth_(0),generation_(0),watcher_(0)
+{
+    readers_[0] = readers_[1] = 0;
+    master_->slotKeys = &slotKeys_;
+    FileStamp stamp = {0,0,0};
+    stamp_ = stamp;
+    reload();
+}
+
+UMemoryIniConfig::~UMemoryIniConfig()
+{
+    stopWatching();
+    flush();
+    delete snapshot_;
+    delete master_;
+}
+
+int UMemoryIniConfig::enterRead() const
+{
+    const int slot = atomicLoad(&epoch_) & 1;
+    atomicIncrement(&readers_[slot]);
+    return slot;
+}
+
+void UMemoryIniConfig::leaveRead( int slot ) const
+{
+    atomicDecrement(&readers_[slot]);
+}
+
+void UMemoryIniConfig::publishLocked()
+{
+    Document *next = new Document(*master_);
+    next->generation = ++generation_;
+    Document *old = atomicExchangePointer(&snapshot_,next);
+    //读者先增加计数再读取snapshot_.先切换新读者使用的计数器,再等旧计数器归零,
+    //两个计数器都等过一次后,不会再有读者持有old.
+    for(int i = 0; i < 2; i++)
+    {
+        const ULock::Word slot = epoch_ & 1;
+        atomicStore(&epoch_,epoch_ ^ 1);
+        while(atomicLoad(&readers_[slot]))
+        {
+            yieldThread();
+        }
+    }
+    delete old;
+}
+
+std::wstring UMemoryIniConfig::getFormatted( const std::wstring &formattedKey )
+{
+    wstring sectionName;
+    wstring keyName;
+    if(!splitSectionAndKey(formattedKey,sectionName,keyName))
+    {
+        return L"";
+    }
+    const int slot = enterRead();
+    const Document *document = atomicLoadPointer(&snapshot_);
+    const wstring *value = document->find(sectionName,keyName);
+    wstring result = value ? *value : wstring();
+    leaveRead(slot);
+    return result;
+}
+
+std::wstring UMemoryIniConfig::get( std::wstring key,... )
+{
+    va_list ap;
+    va_start(ap,key);
+    const wstring formattedKey = formatKey(key,ap);
+    va_end(ap);
+    return getFormatted(formattedKey);
+}
+
+int UMemoryIniConfig::getInt( std::wstring key,... )
+{
+    va_list ap;
+    va_start(ap,key);
+    const wstring formattedKey = formatKey(key,ap);
+    va_end(ap);
+
+    //和UIniConfig一样只解析开头的数字.
+    int value = 0;
+    size_t parsed = 0;
+    parse_int(getFormatted(formattedKey),value,&parsed);
+    return value;
+}
+
+std::vector<std::wstring> UMemoryIniConfig::getArray( std::wstring key,... )
+{
+    va_list ap;
+    va_start(ap,key);
+    const wstring formattedKey = formatKey(key,ap);
+    va_end(ap);
+    return getArrayFormatted(formattedKey);
+}
+
+std::vector<std::wstring> UMemoryIniConfig::getArrayFormatted( const std::wstring &formattedKey )
+{
+    vector<wstring> result;
+    wstring sectionName;
+    wstring keyName;
+    if(!splitSectionAndKey(arrayCountKey(formattedKey),sectionName,keyName))
+    {
+        return result;
+    }
+    //元素和个数从同一个快照中读取,不会读到修改了一半的数组.
+    const int slot = enterRead();
+    const Document *document = atomicLoadPointer(&snapshot_);
+    const wstring *countText = document->find(sectionName,keyName);
+    int count = 0;
+    if(countText)
+    {
+        parse_int(*countText,count);
+    }
+    for(int i = 0; i < count; i++)
+    {
+        splitSectionAndKey(arrayElementKey(formattedKey,i),sectionName,keyName);
+        const wstring *value = document->find(sectionName,keyName);
+        result.push_back(value ? *value : wstring());
+    }
+    leaveRead(slot);
+    return result;
+}
+
+void UMemoryIniConfig::applyLocked( const Change &change )
+{
+    wstring sectionName;
+    wstring keyName;
+    if(!splitSectionAndKey(change.key,sectionName,keyName))
+    {
+        return;
+    }
+    if(change.remove)
+    {
+        master_->removeValue(sectionName,keyName);
+    }
+    else
+    {
+        master_->setValue(sectionName,keyName,change.value);
+    }
+    pending_.push_back(change);
+}
+
+void UMemoryIniConfig::set( std::wstring key,std::wstring value,... )
+{
+    va_list ap;
+    va_start(ap,value);
+    const wstring formattedKey = formatKey(key,ap);
+    va_end(ap);
+    setFormatted(formattedKey,value);
+}
+
+void UMemoryIniConfig::setFormatted( const std::wstring &formattedKey,const std::wstring &value )
+{
+    Change change = {formattedKey,value,false};
+    UScopedLock lock(writeLock_);
+    applyLocked(change);
+    if(!batchDepth_)
+    {
+        publishLocked();
+    }
+}
+
+void UMemoryIniConfig::setInt( std::wstring key,int value,... )
+{
+    va_list ap;
+    va_start(ap,value);
+    const wstring formattedKey = formatKey(key,ap);
+    va_end(ap);
+    setFormatted(formattedKey,i2ws(value));
+}
+
+void UMemoryIniConfig::setArray( std::wstring key,std::vector<std::wstring> value,... )
+{
+    va_list ap;
+    va_start(ap,value);
+    const wstring formattedKey = formatKey(key,ap);
+    va_end(ap);
+    setArrayFormatted(formattedKey,value);
+}
+
+void UMemoryIniConfig::setArrayFormatted( const std::wstring &formattedKey,const std::vector<std::wstring> &value )
+{
+    UScopedLock lock(writeLock_);
+    wstring sectionName;
+    wstring keyName;
+    if(!splitSectionAndKey(arrayCountKey(formattedKey),sectionName,keyName))
+    {
+        return;
+    }
+    int oldCount = 0;
+    const wstring *countText = master_->find(sectionName,keyName);
+    if(countText)
+    {
+        parse_int(*countText,oldCount);
+    }
+    for(size_t i = 0; i < value.size(); i++)
+    {
+        Change change = {arrayElementKey(formattedKey,i),value[i],false};
+        applyLocked(change);
+    }
+    for(size_t i = value.size(); i < static_cast<size_t>((std::max)(oldCount,0)); i++)
+    {
+        Change change = {arrayElementKey(formattedKey,i),wstring(),true};
+        applyLocked(change);
+    }
+    Change change = {arrayCountKey(formattedKey),i2ws(value.size()),false};
+    applyLocked(change);
+    if(!batchDepth_)
+    {
+        publishLocked();
+    }
+}
+
+int UMemoryIniConfig::resolveSlot( const std::wstring &formattedKey )
+{
+    wstring sectionName;
+    wstring keyName;
+    if(!splitSectionAndKey(formattedKey,sectionName,keyName))
+    {
+        return -1;
+    }
+    const wstring indexKey = Document::indexKey(sectionName,keyName);
+    UScopedLock lock(writeLock_);
+    map<wstring,int>::const_iterator it = slotIds_.find(indexKey);
+    if(it != slotIds_.end())
+    {
+        return it->second;
+    }
+    const int slot = static_cast<int>(slotKeys_.size());
+    slotKeys_.push_back(indexKey);
+    slotIds_.insert(make_pair(indexKey,slot));
+    master_->appendSlot();
+    //新的槽位在下一个快照中才可用,在此之前getSlot返回false,调用者改用键名读取.
+    //每分配一个槽位都发布的话,N个键要复制N次整个配置,所以槽位数翻倍时才发布.
+    if(!batchDepth_ && slotKeys_.size() >= 2 * snapshot_->slotPositions.size())
+    {
+        publishLocked();
+    }
+    return slot;
+}
+
+bool UMemoryIniConfig::getSlot( int slot,std::wstring &value )
+{
+    const int readerSlot = enterRead();
+    const Document *document = atomicLoadPointer(&snapshot_);
+    const bool available = slot >= 0 && static_cast<size_t>(slot) < document->slotPositions.size();
+    if(available)
+    {
+        const pair<size_t,size_t> &position = document->slotPositions[slot];
+        if(position.first == wstring::npos)
+        {
+            value.clear();
+        }
+        else
+        {
+            value = document->sections[position.first].lines[position.second].value;
+        }
+    }
+    leaveRead(readerSlot);
+    return available;
+}
+
+void UMemoryIniConfig::beginBatch()
+{
+    UScopedLock lock(writeLock_);
+    batchDepth_++;
+}
+
+void UMemoryIniConfig::endBatch()
+{
+    UScopedLock lock(writeLock_);
+    assert(batchDepth_ > 0 && "endBatch和beginBatch不配对.");
+    if(batchDepth_ > 0 && --batchDepth_ == 0)
+    {
+        publishLocked();
+    }
+}
+
+bool UMemoryIniConfig::reload()
+{
+    UScopedLock lock(writeLock_);
+    string content;
+    bool exists = false;
+    if(!readFile(iniPath_,content,exists))
+    {
+        return false;
+    }
+    Document *document = new Document;
+    document->slotKeys = &slotKeys_;
+    if(exists)
+    {
+        document->parse(content);
+    }
+    readFileStamp(iniPath_,stamp_.size,stamp_.modifiedTime,stamp_.id);
+
+    //重新应用还没有写入文件的修改.
+    delete master_;
+    master_ = document;
+    vector<Change> pending;
+    pending.swap(pending_);
+    for(size_t i = 0; i < pending.size(); i++)
+    {
+        applyLocked(pending[i]);
+    }
+    if(!batchDepth_)
+    {
+        publishLocked();
+    }
+    return true;
+}
+
+bool UMemoryIniConfig::flush()
+{
+    UScopedLock lock(writeLock_);
+    if(pending_.empty())
+    {
+        return true;
+    }
+    if(!writeFileAtomically(iniPath_,master_->serialize()))
+    {
+        return false;
+    }
+    pending_.clear();
+    readFileStamp(iniPath_,stamp_.size,stamp_.modifiedTime,stamp_.id);
+    return true;
+}
+
+void UMemoryIniConfig::onFileChanged()
+{
+    {
+        UScopedLock lock(writeLock_);
+        FileStamp stamp;
+        readFileStamp(iniPath_,stamp.size,stamp.modifiedTime,stamp.id);
+        if(stamp.size == stamp_.size && stamp.modifiedTime == stamp_.modifiedTime && stamp.id == stamp_.id)
+        {
+            return;
+        }
+    }
+    reload();
+}
+
+bool UMemoryIniConfig::startWatching()
+{
+    UScopedLock lock(watcherLock_);
+    if(watcher_)
+    {
+        return true;
+    }
+    watcher_ = new Watcher(this);
+    if(!watcher_->start())
+    {
+        delete watcher_;
+        watcher_ = 0;
+        return false;
+    }
+    return true;
+}
+
+void UMemoryIniConfig::stopWatching()
+{
+    UScopedLock lock(watcherLock_);
+    delete watcher_;
+    watcher_ = 0;
+}
+
+unsigned int UMemoryIniConfig::generation() const
+{
+    const int slot = enterRead();
+    const unsigned int result = atomicLoadPointer(&snapshot_)->generation;
+    leaveRead(slot);
+    return result;
+}
+
+std::vector<std::pair<std::wstring,std::wstring> > UMemoryIniConfig::entries() const
+{
+    vector<pair<wstring,wstring> > result;
+    const int slot = enterRead();
+    const Document *document = atomicLoadPointer(&snapshot_);
+    for(size_t i = 0; i < document->sections.size(); i++)
+    {
+        const Document::Section &section = document->sections[i];
+        for(size_t j = 0; j < section.lines.size(); j++)
+        {
+            const Document::Line &line = section.lines[j];
+            if(line.key.empty())
+            {
+                continue;
+            }
+            Document::KeyIndex::const_iterator it = document->keys.find(Document::indexKey(section.name,line.key));
+            if(it != document->keys.end() && it->second == make_pair(i,j))
+            {
+                result.push_back(make_pair(section.name.empty() ? line.key : section.name + L"/" + line.key,line.value));
+            }
+        }
+    }
+    leaveRead(slot);
+    return result;
+}
+
+}//namespace uni
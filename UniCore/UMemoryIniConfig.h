@@ -0,0 +1,188 @@
+﻿/*! \file UMemoryIniConfig.h
+    \brief 在内存中读写ini文件的配置.
+
+    打开时把整个文件解析到内存中,之后的读取不再访问文件:
+    - 按section和键名建立哈希索引,和GetPrivateProfileString一样不区分大小写.
+    - 读取时不加锁,读的是不可修改的快照.修改时生成新的快照再替换,
+      旧快照等所有可能还在读它的线程结束后才释放.
+    - 生成快照要复制整个配置,批量修改之外的每次set都复制一次,
+      频繁修改或者一次修改很多键时应该放在beginBatch和endBatch之间.
+    - 修改先保存在内存中,flush时一次写入:先写临时文件,再替换原文件,
+      写入过程中程序崩溃也不会留下不完整的配置文件.
+    - startWatching后,文件被其它程序修改时自动重新读取,Windows下使用FindFirstChangeNotification,
+      Linux下使用inotify.
+
+    文件的编码保持不变:有UTF-16LE或UTF-8的BOM时按BOM,否则Windows下按ANSI代码页,Linux下按UTF-8.
+    新建的文件Windows下使用UTF-16LE,和WritePrivateProfileString兼容,Linux下使用UTF-8.
+    未修改的行原样写回,注释和空行都会保留.
+
+    \author unigauldoth@gmail.com
+    \date       2026-10-18
+*/
+#ifndef UNICORE_UMEMORYINICONFIG_H
+#define UNICORE_UMEMORYINICONFIG_H
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "UConfig.h"
+#include "ULock.h"
+
+namespace uni
+{
+
+//! 在内存中读写ini文件的配置,读取不加锁,可以在多个线程中同时使用.
+/*!
+    \code
+    UMemoryIniConfig *config = new UMemoryIniConfig(L"./配置.ini");
+    config->startWatching();
+    UConfig::create(config);
+    wstring account = theConfig.get(L"通用配置/账号/%d",4);
+
+    config->beginBatch();
+    config->set(L"窗口/宽",L"800");
+    config->set(L"窗口/高",L"600");
+    config->endBatch();     //两个修改同时生效.
+    config->flush();        //写入文件,析构时也会写入.
+    \endcode
+*/
+class UMemoryIniConfig : public UConfig
+{
+public:
+    //! 构造函数,立即读取文件.
+    /*!
+        \param iniPath 配置文件路径,文件不存在时为空配置,flush时创建.
+    */
+    explicit UMemoryIniConfig(const std::wstring &iniPath);
+    //! 停止监视,并把未写入的修改写入文件.
+    virtual ~UMemoryIniConfig();
+
+    virtual std::wstring get(std::wstring key,...);
+
+    virtual void set(std::wstring key,std::wstring value,...);
+
+    virtual std::vector<std::wstring> getArray(std::wstring key,...);
+
+    virtual void setArray(std::wstring key,std::vector<std::wstring> value,...);
+
+    virtual int getInt(std::wstring key,...);
+
+    virtual void setInt(std::wstring key,int value,...);
+
+    //! 重新读取文件.
+    /*!
+        还没有写入文件的修改会在新读取的内容上重新应用,不会丢失.
+        \return 文件不存在或读取成功时返回true,文件存在但无法读取时返回false,内容保持不变.
+    */
+    bool reload();
+
+    //! 把修改写入文件.
+    /*!
+        \return 没有修改或写入成功时返回true.
+    */
+    bool flush();
+
+    //! 开始批量修改.
+    /*!
+        beginBatch和endBatch之间的修改在endBatch时一次生效,之前读取到的仍然是修改前的内容.
+        可以嵌套,最外层的endBatch生效.整个批量修改只复制一次配置,而每次单独的set都要复制.
+    */
+    void beginBatch();
+
+    //! 结束批量修改,见beginBatch.
+    void endBatch();
+
+    //! 开始监视文件,被其它程序修改后自动重新读取.
+    /*!
+        \return 是否成功,已经在监视时也返回true.
+    */
+    bool startWatching();
+
+    //! 停止监视文件.
+    void stopWatching();
+
+    //! 内容的版本号,每次修改或重新读取后都会增加.
+    unsigned int generation() const;
+
+    //! 所有有效的键和值,按在文件中的顺序.
+    /*!
+        \return 格式化后的键名(section为空时只有键名)和值,重复的section和键只包含第一个.
+    */
+    std::vector<std::pair<std::wstring,std::wstring> > entries() const;
+
+protected:
+    virtual std::wstring getFormatted(const std::wstring &formattedKey);
+
+    virtual void setFormatted(const std::wstring &formattedKey,const std::wstring &value);
+
+    virtual std::vector<std::wstring> getArrayFormatted(const std::wstring &formattedKey);
+
+    virtual void setArrayFormatted(const std::wstring &formattedKey,const std::vector<std::wstring> &value);
+
+    //! 槽位在所有快照中保持不变,快照中保存每个槽位所在的行,读取时不需要查找哈希表.
+    /*!
+        新的槽位不会立即发布,槽位数翻倍或者下次修改时才进入快照,
+        所以初始化N个键只复制O(logN)次配置.
+    */
+    virtual int resolveSlot(const std::wstring &formattedKey);
+
+    virtual bool getSlot(int slot,std::wstring &value);
+
+private:
+    UMemoryIniConfig(const UMemoryIniConfig &);
+    UMemoryIniConfig &operator=(const UMemoryIniConfig &);
+
+    struct Document;
+    class Watcher;
+
+    //! 还没有写入文件的修改.
+    struct Change
+    {
+        std::wstring key;   //!< 格式化后的键名.
+        std::wstring value;
+        bool remove;        //!< 为true时删除这个键.
+    };
+
+    //! 文件的状态,用来判断文件是否被其它程序修改过.
+    struct FileStamp
+    {
+        long long size;
+        long long modifiedTime;
+        unsigned long long id;
+    };
+
+    //! 修改master_,不在批量修改中时立即生效.需要持有writeLock_.
+    void applyLocked(const Change &change);
+    //! 用master_的副本替换当前的快照,等没有线程在读旧快照后释放它.需要持有writeLock_.
+    void publishLocked();
+    //! 文件被修改后由Watcher调用,文件状态和上次读写时相同则忽略.
+    void onFileChanged();
+
+    //! 读者进入时所在的计数器下标.
+    int enterRead() const;
+    void leaveRead(int slot) const;
+
+    std::wstring iniPath_;
+    Document * volatile snapshot_;      //!< 读者看到的快照.
+    mutable volatile ULock::Word readers_[2];   //!< 两组读者的计数,写者交替等待它们归零.
+    volatile ULock::Word epoch_;        //!< 新读者使用readers_[epoch_].
+
+    ULock writeLock_;                   //!< 修改,重新读取和写入文件都要持有.
+    Document *master_;                  //!< 最新的内容,批量修改时领先于snapshot_.
+    std::vector<Change> pending_;       //!< 还没有写入文件的修改,重新读取后要重新应用.
+    int batchDepth_;
+    FileStamp stamp_;                   //!< 最近一次读取或写入后文件的状态.
+    unsigned int generation_;
+
+    std::map<std::wstring,int> slotIds_;    //!< 索引键到槽位,需要持有writeLock_.
+    std::vector<std::wstring> slotKeys_;    //!< 槽位到索引键,需要持有writeLock_.
+
+    ULock watcherLock_;
+    Watcher *watcher_;
+};
+
+}//namespace uni
+
+#endif//UNICORE_UMEMORYINICONFIG_H
@@ -24,42 +24,13 @@
 #include <regex>
 #include <string>
 
+#include "ULock.h"
 
 class UMiniLog
 {
 public:
-    class Lock
-    {
-    public:
-        Lock():atomic_(0) {}
-        ~Lock() {}
-        //! 上锁.
-        void lock() 
-        {
-            do 
-            {
-                long prev = InterlockedCompareExchange(&atomic_,1,0);
-                if(atomic_ == 1 && prev == 0)
-                {
-                    break;
-                }
-                if(!SwitchToThread())
-                {
-                    Sleep(1);
-                }
-            } while (true);
-        }
-        //! 解锁.
-        void unlock()
-        {
-            InterlockedCompareExchange(&atomic_,0,1);
-        }
-    private:
-        Lock(const Lock&);
-        Lock& operator=(const Lock&);
-        volatile long atomic_;
-
-    };
+    //! 输出日志时使用的锁.
+    typedef uni::ULock Lock;
 
     struct Message
     {
@@ -0,0 +1,234 @@
+﻿#include "UMultiPatternMatcher.h"
+
+#include <algorithm>
+#include <wctype.h>
+
+namespace uni
+{
+
+namespace
+{
+    //! 字符映射表至少要覆盖的大小.char总是覆盖全部256个字符.
+    size_t tableSizeFor(char,CaseSensitivity)
+    {
+        return 256;
+    }
+
+    size_t tableSizeFor(wchar_t c,CaseSensitivity caseSensitivity)
+    {
+        size_t size = static_cast<size_t>(c) + 1;
+        if(caseSensitivity == CaseInsensitive)
+        {
+            //文本中的大写字符也要能查到对应的列.
+            const wchar_t folded = fold_case(c);
+            size = (std::max)(size,static_cast<size_t>(folded) + 1);
+            size = (std::max)(size,static_cast<size_t>(towupper(folded)) + 1);
+        }
+        return size;
+    }
+
+    struct CollectMatches
+    {
+        explicit CollectMatches(std::vector<UPatternMatch> &matches):matches_(&matches) {}
+        bool operator()(const UPatternMatch &match)
+        {
+            matches_->push_back(match);
+            return true;
+        }
+        std::vector<UPatternMatch> *matches_;
+    };
+
+    struct StopAtFirstMatch
+    {
+        explicit StopAtFirstMatch(UPatternMatch &match):match_(&match) {}
+        bool operator()(const UPatternMatch &match)
+        {
+            *match_ = match;
+            return false;
+        }
+        UPatternMatch *match_;
+    };
+}
+
+template<typename Char>
+UBasicMultiPatternMatcher<Char>::UBasicMultiPatternMatcher( CaseSensitivity caseSensitivity /*= CaseSensitive*/ )
+    :caseSensitivity_(caseSensitivity),alphabetSize_(0)
+{
+}
+
+template<typename Char>
+size_t UBasicMultiPatternMatcher<Char>::addPattern( View pattern )
+{
+    patterns_.push_back(pattern.str());
+    return patterns_.size() - 1;
+}
+
+template<typename Char>
+void UBasicMultiPatternMatcher<Char>::clear()
+{
+    patterns_.clear();
+    symbols_.clear();
+    alphabetSize_ = 0;
+    transitions_.clear();
+    firstOutput_.clear();
+    nextOutput_.clear();
+    outputBegin_.clear();
+    outputs_.clear();
+}
+
+template<typename Char>
+void UBasicMultiPatternMatcher<Char>::build()
+{
+    //给pattern中出现的字符编列号,忽略大小写时按转换后的字符编号.
+    size_t tableSize = tableSizeFor(Char(),caseSensitivity_);
+    for(size_t i = 0; i < patterns_.size(); i++)
+    {
+        for(size_t j = 0; j < patterns_[i].size(); j++)
+        {
+            tableSize = (std::max)(tableSize,tableSizeFor(patterns_[i][j],caseSensitivity_));
+        }
+    }
+    symbols_.assign(tableSize,0);
+    alphabetSize_ = 1;
+    for(size_t i = 0; i < patterns_.size(); i++)
+    {
+        for(size_t j = 0; j < patterns_[i].size(); j++)
+        {
+            Char c = patterns_[i][j];
+            if(caseSensitivity_ == CaseInsensitive)
+            {
+                c = fold_case(c);
+            }
+            unsigned int &symbol = symbols_[codeOf(c)];
+            if(!symbol)
+            {
+                symbol = static_cast<unsigned int>(alphabetSize_++);
+            }
+        }
+    }
+    if(caseSensitivity_ == CaseInsensitive)
+    {
+        for(size_t code = 0; code < tableSize; code++)
+        {
+            const size_t folded = codeOf(fold_case(static_cast<Char>(code)));
+            if(!symbols_[code] && folded < tableSize)
+            {
+                symbols_[code] = symbols_[folded];
+            }
+        }
+    }
+
+    //构造字典树,-1表示还没有转移.
+    const size_t alphabetSize = alphabetSize_;
+    transitions_.assign(alphabetSize,-1);
+    std::vector<std::vector<int> > ownOutputs(1);
+    for(size_t i = 0; i < patterns_.size(); i++)
+    {
+        if(patterns_[i].empty())
+        {
+            continue;
+        }
+        size_t state = 0;
+        for(size_t j = 0; j < patterns_[i].size(); j++)
+        {
+            const size_t index = state * alphabetSize + symbols_[codeOf(patterns_[i][j])];
+            if(transitions_[index] < 0)
+            {
+                transitions_[index] = static_cast<int>(ownOutputs.size());
+                ownOutputs.resize(ownOutputs.size() + 1);
+                transitions_.resize(transitions_.size() + alphabetSize,-1);
+            }
+            state = transitions_[index];
+        }
+        ownOutputs[state].push_back(static_cast<int>(i));
+    }
+    const size_t stateCount = ownOutputs.size();
+
+    outputBegin_.assign(stateCount + 1,0);
+    outputs_.clear();
+    for(size_t state = 0; state < stateCount; state++)
+    {
+        outputBegin_[state] = static_cast<int>(outputs_.size());
+        outputs_.insert(outputs_.end(),ownOutputs[state].begin(),ownOutputs[state].end());
+    }
+    outputBegin_[stateCount] = static_cast<int>(outputs_.size());
+
+    //按广度优先的顺序计算失败转移,并把失败转移合并进转移表.
+    //处理一个状态时,它的失败状态更浅,已经处理完毕.
+    std::vector<int> fail(stateCount,0);
+    std::vector<int> order;
+    order.reserve(stateCount);
+    for(size_t symbol = 0; symbol < alphabetSize; symbol++)
+    {
+        int &next = transitions_[symbol];
+        if(next < 0)
+        {
+            next = 0;
+        }
+        else
+        {
+            order.push_back(next);
+        }
+    }
+    for(size_t i = 0; i < order.size(); i++)
+    {
+        const size_t state = order[i];
+        const size_t failRow = fail[state] * alphabetSize;
+        for(size_t symbol = 0; symbol < alphabetSize; symbol++)
+        {
+            int &next = transitions_[state * alphabetSize + symbol];
+            if(next < 0)
+            {
+                next = transitions_[failRow + symbol];
+            }
+            else
+            {
+                fail[next] = transitions_[failRow + symbol];
+                order.push_back(next);
+            }
+        }
+    }
+
+    firstOutput_.assign(stateCount,-1);
+    nextOutput_.assign(stateCount,-1);
+    for(size_t i = 0; i < order.size(); i++)
+    {
+        const int state = order[i];
+        const int suffixOutput = firstOutput_[fail[state]];
+        if(ownOutputs[state].empty())
+        {
+            firstOutput_[state] = suffixOutput;
+        }
+        else
+        {
+            firstOutput_[state] = state;
+            nextOutput_[state] = suffixOutput;
+        }
+    }
+}
+
+template<typename Char>
+size_t UBasicMultiPatternMatcher<Char>::findAll( View text,std::vector<UPatternMatch> &matches ) const
+{
+    const size_t oldSize = matches.size();
+    scan(text,CollectMatches(matches));
+    return matches.size() - oldSize;
+}
+
+template<typename Char>
+bool UBasicMultiPatternMatcher<Char>::findFirst( View text,UPatternMatch &match ) const
+{
+    return !scan(text,StopAtFirstMatch(match));
+}
+
+template<typename Char>
+bool UBasicMultiPatternMatcher<Char>::matchesAny( View text ) const
+{
+    UPatternMatch match;
+    return findFirst(text,match);
+}
+
+template class UBasicMultiPatternMatcher<char>;
+template class UBasicMultiPatternMatcher<wchar_t>;
+
+}//namespace uni
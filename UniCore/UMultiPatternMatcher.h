@@ -0,0 +1,141 @@
+﻿/*! \file UMultiPatternMatcher.h
+    \brief 同时查找多个字符串.
+
+    UMultiPatternMatcher实现了Aho-Corasick算法,把所有pattern构造成一个自动机,
+    扫描一遍文本就能找出所有pattern的所有出现位置,耗时和pattern的个数无关.
+
+    自动机的转移表是稠密的二维数组,每个状态一行,每个出现在pattern中的字符一列,
+    其它字符共用第0列.失败转移在构造时已经合并进转移表,扫描时每个字符只需要查一次表.
+
+    \author unigauldoth@gmail.com
+    \date       2026-10-18
+*/
+#ifndef UNICORE_UMULTIPATTERNMATCHER_H
+#define UNICORE_UMULTIPATTERNMATCHER_H
+
+#include <string>
+#include <vector>
+
+#define AUTO_LINK_LIB_NAME "UniCore"
+#include "AutoLink.h"
+
+#include "UCommon.h"
+#include "UStringView.h"
+
+namespace uni
+{
+
+//! 一次匹配.
+struct UPatternMatch
+{
+    size_t pattern;     //!< pattern的编号,即addPattern的返回值.
+    size_t offset;      //!< 匹配在文本中的起始位置.
+    size_t size;        //!< 匹配的长度,即pattern的长度.
+};
+
+//! 多个字符串的查找.
+/*!
+    先用addPattern添加所有pattern,调用build之后才能查找.build之后还可以继续添加,
+    但要再次调用build才会生效.构造完成后查找是只读的,可以在多个线程中同时进行.
+    \code
+    UMultiPatternMatcher matcher(CaseInsensitive);
+    matcher.addPattern("error");
+    matcher.addPattern("timeout");
+    matcher.build();
+    std::vector<UPatternMatch> matches;
+    matcher.findAll(line,matches);
+    \endcode
+*/
+template<typename Char>
+class UBasicMultiPatternMatcher
+{
+public:
+    typedef UBasicStringView<Char> View;
+
+    explicit UBasicMultiPatternMatcher(CaseSensitivity caseSensitivity = CaseSensitive);
+    //! 添加pattern,返回它的编号.
+    /*!
+        编号从0开始依次递增.空pattern不会匹配任何位置,重复的pattern各自报告匹配.
+    */
+    size_t addPattern(View pattern);
+    //! 构造自动机.
+    void build();
+    //! 清空所有pattern.
+    void clear();
+
+    size_t patternCount() const {return patterns_.size();}
+    const std::basic_string<Char> &pattern(size_t index) const {return patterns_[index];}
+    //! 自动机的状态数.
+    size_t stateCount() const {return alphabetSize_ ? transitions_.size() / alphabetSize_ : 0;}
+
+    //! 找出所有匹配,追加到matches中.
+    /*!
+        匹配按结束位置的先后排列,结束位置相同时长的在前.
+        \return 找到的匹配个数.
+    */
+    size_t findAll(View text,std::vector<UPatternMatch> &matches) const;
+    //! 找出结束位置最靠前的匹配.
+    bool findFirst(View text,UPatternMatch &match) const;
+    //! 是否至少有一个pattern出现在text中.
+    bool matchesAny(View text) const;
+
+    //! 扫描text,每找到一个匹配就调用一次callback.
+    /*!
+        \param callback 形如bool callback(const UPatternMatch &match)的函数或函数对象,
+        返回false时停止扫描.
+        \return callback返回false时返回false.
+    */
+    template<typename Callback>
+    bool scan(View text,Callback callback) const
+    {
+        if(transitions_.empty())
+        {
+            return true;
+        }
+        const int *transitions = &transitions_[0];
+        const size_t symbolCount = symbols_.size();
+        const unsigned int *symbols = &symbols_[0];
+        size_t state = 0;
+        for(size_t i = 0; i < text.size(); i++)
+        {
+            const size_t code = codeOf(text[i]);
+            const size_t symbol = code < symbolCount ? symbols[code] : 0;
+            state = transitions[state * alphabetSize_ + symbol];
+            for(int output = firstOutput_[state]; output >= 0; output = nextOutput_[output])
+            {
+                for(int j = outputBegin_[output]; j < outputBegin_[output + 1]; j++)
+                {
+                    UPatternMatch match;
+                    match.pattern = outputs_[j];
+                    match.size = patterns_[match.pattern].size();
+                    match.offset = i + 1 - match.size;
+                    if(!callback(match))
+                    {
+                        return false;
+                    }
+                }
+            }
+        }
+        return true;
+    }
+private:
+    static size_t codeOf(char c) {return static_cast<unsigned char>(c);}
+    static size_t codeOf(wchar_t c) {return static_cast<size_t>(c);}
+
+    CaseSensitivity caseSensitivity_;
+    std::vector<std::basic_string<Char> > patterns_;
+    std::vector<unsigned int> symbols_;     //!< 字符到列号的映射,超出范围的字符都是第0列.
+    size_t alphabetSize_;                   //!< 列数.
+    std::vector<int> transitions_;          //!< 状态数 * alphabetSize_的转移表.
+    std::vector<int> firstOutput_;          //!< 每个状态结束的匹配中,最长的那个所在的状态,没有时为-1.
+    std::vector<int> nextOutput_;           //!< 下一个更短的匹配所在的状态.
+    std::vector<int> outputBegin_;          //!< 每个状态自身结束的pattern在outputs_中的起始位置.
+    std::vector<int> outputs_;              //!< pattern的编号.
+};
+
+typedef UBasicMultiPatternMatcher<char> UMultiPatternMatcher;
+typedef UBasicMultiPatternMatcher<wchar_t> UWMultiPatternMatcher;
+
+}//namespace uni
+
+#endif//UNICORE_UMULTIPATTERNMATCHER_H
@@ -0,0 +1,346 @@
+﻿#include "USharedHeap.h"
+
+#include <string.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace uni
+{
+
+namespace
+{
+    const unsigned int UsedFlag = 1;        //!< 块已分配.
+    const unsigned int PrevUsedFlag = 2;    //!< 前一个块已分配,prevSize无效.
+    const unsigned int FlagMask = 7;
+    const unsigned int Alignment = 8;
+    const unsigned int HeaderSize = offsetof(UHeapBlock,nextFree);
+    const unsigned int MinBlockSize = sizeof(UHeapBlock);
+    const unsigned int SmallLimit = UHeapSmallClassCount * Alignment;
+    const unsigned int LevelShift = 3;      //!< UHeapClassesPerLevel为2的3次方.
+
+    static_assert(sizeof(UHeapBlock) == 16,"UHeapBlock的大小必须是Alignment的倍数.");
+    static_assert(1 << LevelShift == UHeapClassesPerLevel,"LevelShift和UHeapClassesPerLevel不一致.");
+
+    unsigned int lowestBit(unsigned int value)
+    {
+#ifdef _MSC_VER
+        unsigned long index = 0;
+        _BitScanForward(&index,value);
+        return index;
+#else
+        return __builtin_ctz(value);
+#endif
+    }
+
+    unsigned int highestBit(unsigned int value)
+    {
+#ifdef _MSC_VER
+        unsigned long index = 0;
+        _BitScanReverse(&index,value);
+        return index;
+#else
+        return 31 - __builtin_clz(value);
+#endif
+    }
+
+    unsigned int alignUp(size_t value)
+    {
+        return static_cast<unsigned int>((value + Alignment - 1) & ~static_cast<size_t>(Alignment - 1));
+    }
+
+    unsigned int blockSize(const UHeapBlock *block)
+    {
+        return block->sizeAndFlags & ~FlagMask;
+    }
+
+    //! 大小为size的块所在的类.
+    unsigned int classOf(unsigned int size)
+    {
+        if(size < SmallLimit)
+        {
+            return size / Alignment;
+        }
+        const unsigned int level = highestBit(size);
+        const unsigned int sub = (size >> (level - LevelShift)) - UHeapClassesPerLevel;
+        return UHeapSmallClassCount + (level - 8) * UHeapClassesPerLevel + sub;
+    }
+
+    //! 其中任何一个块都能放下size字节的最小的类.
+    unsigned int fittingClassOf(unsigned int size)
+    {
+        if(size >= SmallLimit)
+        {
+            size += (1u << (highestBit(size) - LevelShift)) - 1;
+        }
+        return classOf(size);
+    }
+
+    //! 在共享内存中加锁.
+    class HeapLock
+    {
+    public:
+        explicit HeapLock(volatile ULock::Word *word)
+            :word_(word)
+        {
+            ULock::lockWord(word_,true);
+        }
+        ~HeapLock()
+        {
+            ULock::unlockWord(word_,true);
+        }
+    private:
+        HeapLock(const HeapLock &);
+        HeapLock &operator=(const HeapLock &);
+        volatile ULock::Word *word_;
+    };
+}
+
+USharedHeap::USharedHeap()
+    :base_(0)
+    ,header_(0)
+{
+}
+
+USharedHeap::USharedHeap( void *base,unsigned int heapOffset )
+    :base_(0)
+    ,header_(0)
+{
+    attach(base,heapOffset);
+}
+
+void USharedHeap::attach( void *base,unsigned int heapOffset )
+{
+    base_ = static_cast<char *>(base);
+    header_ = reinterpret_cast<USharedHeapHeader *>(base_ + heapOffset);
+}
+
+bool USharedHeap::format( void *base,unsigned int heapOffset,size_t segmentSize )
+{
+    const unsigned int firstBlock = alignUp(heapOffset + sizeof(USharedHeapHeader));
+    if(segmentSize > 0x7FFFFFFF || segmentSize < firstBlock + MinBlockSize + HeaderSize)
+    {
+        return false;
+    }
+    //结尾留出哨兵块的块头.
+    const unsigned int endBlock = (static_cast<unsigned int>(segmentSize) - HeaderSize) & ~(Alignment - 1);
+    if(endBlock < firstBlock + MinBlockSize)
+    {
+        return false;
+    }
+    char *bytes = static_cast<char *>(base);
+    USharedHeapHeader *header = reinterpret_cast<USharedHeapHeader *>(bytes + heapOffset);
+    memset(header,0,sizeof(*header));
+    header->firstBlock = firstBlock;
+    header->endBlock = endBlock;
+
+    UHeapBlock *end = reinterpret_cast<UHeapBlock *>(bytes + endBlock);
+    end->prevSize = endBlock - firstBlock;
+    end->sizeAndFlags = UsedFlag;
+
+    USharedHeap heap(base,heapOffset);
+    UHeapBlock *first = heap.block(firstBlock);
+    first->prevSize = 0;
+    first->sizeAndFlags = (endBlock - firstBlock) | PrevUsedFlag;
+    heap.insertFree(first);
+    return true;
+}
+
+void *USharedHeap::alloc( size_t size )
+{
+    if(!header_ || size == 0 || size > MaxAllocation)
+    {
+        return 0;
+    }
+    unsigned int needed = alignUp(size + HeaderSize);
+    if(needed < MinBlockSize)
+    {
+        needed = MinBlockSize;
+    }
+    unsigned int classIndex = fittingClassOf(needed);
+
+    HeapLock lock(&header_->lock);
+    //从classIndex开始找第一个有空闲块的类.
+    unsigned int word = classIndex / 32;
+    unsigned int bits = word < UHeapClassWords ? header_->classMap[word] & (~0u << (classIndex % 32)) : 0;
+    while(!bits && ++word < UHeapClassWords)
+    {
+        bits = header_->classMap[word];
+    }
+    if(!bits)
+    {
+        header_->failedAllocations++;
+        return 0;
+    }
+    classIndex = word * 32 + lowestBit(bits);
+
+    UHeapBlock *found = block(header_->freeLists[classIndex]);
+    removeFree(found);
+    const unsigned int foundSize = blockSize(found);
+    UHeapBlock *next = block(offsetOf(found) + foundSize);
+    if(foundSize - needed >= MinBlockSize)
+    {
+        UHeapBlock *rest = block(offsetOf(found) + needed);
+        rest->sizeAndFlags = (foundSize - needed) | PrevUsedFlag;
+        next->prevSize = foundSize - needed;
+        insertFree(rest);
+        found->sizeAndFlags = needed | (found->sizeAndFlags & PrevUsedFlag) | UsedFlag;
+    }
+    else
+    {
+        next->sizeAndFlags |= PrevUsedFlag;
+        found->sizeAndFlags |= UsedFlag;
+    }
+    found->nextFree = 0;
+    found->prevFree = 0;
+    header_->usedBytes += blockSize(found);
+    header_->usedBlocks++;
+    return &found->nextFree;
+}
+
+bool USharedHeap::free( void *address )
+{
+    if(!header_)
+    {
+        return false;
+    }
+    HeapLock lock(&header_->lock);
+    UHeapBlock *freed = usedBlock(address);
+    if(!freed)
+    {
+        return false;
+    }
+    unsigned int size = blockSize(freed);
+    header_->usedBytes -= size;
+    header_->usedBlocks--;
+
+    UHeapBlock *next = block(offsetOf(freed) + size);
+    if(!(next->sizeAndFlags & UsedFlag))
+    {
+        removeFree(next);
+        size += blockSize(next);
+        next->sizeAndFlags = 0;
+    }
+    if(!(freed->sizeAndFlags & PrevUsedFlag))
+    {
+        UHeapBlock *prev = block(offsetOf(freed) - freed->prevSize);
+        removeFree(prev);
+        size += blockSize(prev);
+        //被合并的块头清零,再次释放时不会被当成已分配的块.
+        freed->sizeAndFlags = 0;
+        freed = prev;
+    }
+    //相邻的块不会都空闲,合并后前一个块一定已分配.
+    freed->sizeAndFlags = size | PrevUsedFlag;
+    UHeapBlock *after = block(offsetOf(freed) + size);
+    after->sizeAndFlags &= ~PrevUsedFlag;
+    after->prevSize = size;
+    insertFree(freed);
+    return true;
+}
+
+size_t USharedHeap::usableSize( const void *address ) const
+{
+    if(!header_)
+    {
+        return 0;
+    }
+    const UHeapBlock *used = usedBlock(address);
+    return used ? blockSize(used) - HeaderSize : 0;
+}
+
+USharedHeapStatistics USharedHeap::statistics()
+{
+    USharedHeapStatistics result;
+    memset(&result,0,sizeof(result));
+    if(!header_)
+    {
+        return result;
+    }
+    HeapLock lock(&header_->lock);
+    result.totalBytes = header_->endBlock - header_->firstBlock;
+    result.usedBytes = header_->usedBytes;
+    result.freeBytes = result.totalBytes - result.usedBytes;
+    result.usedBlocks = header_->usedBlocks;
+    result.freeBlocks = header_->freeBlocks;
+    result.failedAllocations = header_->failedAllocations;
+    //最大的块在最后一个非空的类中.
+    for(int word = UHeapClassWords - 1; word >= 0; word--)
+    {
+        if(header_->classMap[word])
+        {
+            const unsigned int classIndex = word * 32 + highestBit(header_->classMap[word]);
+            unsigned int largest = 0;
+            for(unsigned int offset = header_->freeLists[classIndex]; offset; offset = block(offset)->nextFree)
+            {
+                if(blockSize(block(offset)) > largest)
+                {
+                    largest = blockSize(block(offset));
+                }
+            }
+            result.largestFreeBlock = largest;
+            break;
+        }
+    }
+    return result;
+}
+
+UHeapBlock * USharedHeap::usedBlock( const void *address ) const
+{
+    const char *bytes = static_cast<const char *>(address);
+    if(bytes < base_ + header_->firstBlock + HeaderSize || bytes >= base_ + header_->endBlock
+        || (bytes - base_) % Alignment)
+    {
+        return 0;
+    }
+    UHeapBlock *used = block(static_cast<unsigned int>(bytes - base_) - HeaderSize);
+    const unsigned int size = blockSize(used);
+    if(!(used->sizeAndFlags & UsedFlag) || size < MinBlockSize
+        || size > header_->endBlock - offsetOf(used)
+        || !(block(offsetOf(used) + size)->sizeAndFlags & PrevUsedFlag))
+    {
+        return 0;
+    }
+    return used;
+}
+
+void USharedHeap::insertFree( UHeapBlock *freeBlock )
+{
+    const unsigned int classIndex = classOf(blockSize(freeBlock));
+    const unsigned int offset = offsetOf(freeBlock);
+    const unsigned int head = header_->freeLists[classIndex];
+    freeBlock->nextFree = head;
+    freeBlock->prevFree = 0;
+    if(head)
+    {
+        block(head)->prevFree = offset;
+    }
+    header_->freeLists[classIndex] = offset;
+    header_->classMap[classIndex / 32] |= 1u << (classIndex % 32);
+    header_->freeBlocks++;
+}
+
+void USharedHeap::removeFree( UHeapBlock *freeBlock )
+{
+    const unsigned int classIndex = classOf(blockSize(freeBlock));
+    if(freeBlock->prevFree)
+    {
+        block(freeBlock->prevFree)->nextFree = freeBlock->nextFree;
+    }
+    else
+    {
+        header_->freeLists[classIndex] = freeBlock->nextFree;
+        if(!freeBlock->nextFree)
+        {
+            header_->classMap[classIndex / 32] &= ~(1u << (classIndex % 32));
+        }
+    }
+    if(freeBlock->nextFree)
+    {
+        block(freeBlock->nextFree)->prevFree = freeBlock->prevFree;
+    }
+    header_->freeBlocks--;
+}
+
+}//namespace uni
@@ -0,0 +1,144 @@
+﻿/*! \file USharedHeap.h
+    \brief 共享内存中的堆.
+
+    堆的所有数据都在共享内存中,指针都保存为相对段开头的偏移,每个进程可以映射到不同的地址.
+
+    - 块的开头是UHeapBlock,大小按8字节对齐.相邻的空闲块总是合并,释放时通过边界标记
+      (前一个块的大小和是否使用)找到前后的块,不需要遍历.
+    - 空闲块按大小分类,每类一个双向链表,链表节点保存在空闲块中.
+      小于256字节的块每8字节一类,更大的块每个2的幂次再平分为8类.
+    - 分配时从能保证放下的最小类开始,用位图找到第一个非空的类,取链表头,多出的部分分割为新的空闲块.
+    - 分配和释放在进程间共享的锁中完成,锁内的操作都是O(1)的.
+
+    \author unigauldoth@gmail.com
+    \date       2026-10-18
+*/
+#ifndef UNICORE_USHAREDHEAP_H
+#define UNICORE_USHAREDHEAP_H
+
+#include <stddef.h>
+
+#include "ULock.h"
+
+namespace uni
+{
+
+//! 堆的统计信息.
+struct USharedHeapStatistics
+{
+    size_t totalBytes;          //!< 堆中所有块的大小.
+    size_t usedBytes;           //!< 已分配的块的大小,包括块头.
+    size_t freeBytes;           //!< 空闲块的大小,包括块头.
+    size_t usedBlocks;
+    size_t freeBlocks;
+    size_t largestFreeBlock;    //!< 最大的空闲块的大小,包括块头.
+    size_t failedAllocations;   //!< 分配失败的次数.
+
+    //! 碎片率,空闲的内存中不能一次分配出去的比例.
+    double fragmentation() const
+    {
+        return freeBytes ? 1.0 - static_cast<double>(largestFreeBlock) / freeBytes : 0.0;
+    }
+};
+
+//! 块头.
+struct UHeapBlock
+{
+    unsigned int prevSize;      //!< 前一个块的大小,前一个块空闲时有效.
+    unsigned int sizeAndFlags;  //!< 块的大小,包括块头,低3位为标志.
+    unsigned int nextFree;      //!< 空闲时为同一类中下一个空闲块的偏移,已分配时为数据的开头.
+    unsigned int prevFree;
+};
+
+enum
+{
+    UHeapSmallClassCount = 32,  //!< 小于256字节的类数.
+    UHeapClassesPerLevel = 8,
+    UHeapClassCount = UHeapSmallClassCount + (31 - 8) * UHeapClassesPerLevel,
+    UHeapClassWords = (UHeapClassCount + 31) / 32
+};
+
+//! 堆头,保存在共享内存中.
+struct USharedHeapHeader
+{
+    ULock::Word lock;
+    unsigned int firstBlock;    //!< 第一个块的偏移.
+    unsigned int endBlock;      //!< 结尾的哨兵块的偏移,哨兵块总是已分配的.
+    unsigned int classMap[UHeapClassWords];     //!< 每类是否有空闲块.
+    unsigned int freeLists[UHeapClassCount];    //!< 每类第一个空闲块的偏移,0表示没有.
+    unsigned int usedBytes;
+    unsigned int usedBlocks;
+    unsigned int freeBlocks;
+    unsigned int failedAllocations;
+};
+
+//! 访问共享内存中的堆.
+/*!
+    \code
+    USharedHeap::format(base,heapOffset,segmentSize);  //创建者.
+    USharedHeap heap(base,heapOffset);                 //每个进程.
+    void *p = heap.alloc(100);
+    heap.free(p);
+    \endcode
+*/
+class USharedHeap
+{
+public:
+    //! 每次分配的最大字节数.
+    enum {MaxAllocation = 0x7FFFFF00};
+
+    USharedHeap();
+    //! 访问已经初始化的堆.
+    /*!
+        \param base 段的开头,所有的偏移从这里算起.
+        \param heapOffset 堆头的偏移.
+    */
+    USharedHeap(void *base,unsigned int heapOffset);
+
+    void attach(void *base,unsigned int heapOffset);
+
+    //! 在[base + heapOffset,base + segmentSize)中初始化堆.
+    /*!
+        \return 失败(空间不够)时返回false.
+    */
+    static bool format(void *base,unsigned int heapOffset,size_t segmentSize);
+
+    //! 分配size字节,按8字节对齐,失败时返回0.
+    void *alloc(size_t size);
+
+    //! 释放.
+    /*!
+        \return 地址不是alloc返回的或者已经释放时返回false.
+    */
+    bool free(void *address);
+
+    //! 已分配的块可以使用的字节数,可能比申请的多.
+    size_t usableSize(const void *address) const;
+
+    //! 统计信息,需要遍历最大的一类空闲块.
+    USharedHeapStatistics statistics();
+
+private:
+    USharedHeap(const USharedHeap &);
+    USharedHeap &operator=(const USharedHeap &);
+
+    UHeapBlock *block(unsigned int offset) const
+    {
+        return reinterpret_cast<UHeapBlock *>(base_ + offset);
+    }
+    unsigned int offsetOf(const UHeapBlock *block) const
+    {
+        return static_cast<unsigned int>(reinterpret_cast<const char *>(block) - base_);
+    }
+    //! address是否是已分配的块的数据,返回块.
+    UHeapBlock *usedBlock(const void *address) const;
+    void insertFree(UHeapBlock *block);
+    void removeFree(UHeapBlock *block);
+
+    char *base_;
+    USharedHeapHeader *header_;
+};
+
+}//namespace uni
+
+#endif//UNICORE_USHAREDHEAP_H
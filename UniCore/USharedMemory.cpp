@@ -1 +1,1282 @@
-﻿#include "USharedMemory.h"
\ No newline at end of file
+﻿#include "USharedMemory.h"
+
+#include <stddef.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include "Windows.h"
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#include "UTranscode.h"
+
+using namespace std;
+
+namespace uni
+{
+
+namespace
+{
+    const unsigned int USharedSegmentMagic = 0x4D485355;   // "USHM"
+    //! 打开已有的段时最多等待创建者初始化的时间.
+    const unsigned int ReadyTimeout = 5000;
+    //! 段的大小保存在int中.
+    const size_t MaxSegmentSize = 0x7FFFFFFF;
+    //! 堆头的偏移,在Commu之后按8字节对齐.
+    const unsigned int HeapOffset = (sizeof(USharedSegmentHeader) + sizeof(Commu) + 7) & ~7;
+    const size_t MinSegmentSize = HeapOffset + sizeof(USharedHeapHeader) + 0x40;
+    //! 哈希表最初的大小.
+    const unsigned int InitialTableCapacity = 16;
+
+    size_t roundUp(size_t size,size_t alignment)
+    {
+        return (size + alignment - 1) / alignment * alignment;
+    }
+
+    ULock::Word atomicAdd(volatile ULock::Word *word,ULock::Word value)
+    {
+#ifdef _WIN32
+        return InterlockedExchangeAdd(word,value) + value;
+#else
+        return __atomic_add_fetch(word,value,__ATOMIC_SEQ_CST);
+#endif
+    }
+
+    unsigned int milliseconds()
+    {
+#ifdef _WIN32
+        return GetTickCount();
+#else
+        timespec now;
+        clock_gettime(CLOCK_MONOTONIC,&now);
+        return static_cast<unsigned int>(now.tv_sec * 1000 + now.tv_nsec / 1000000);
+#endif
+    }
+
+    void yieldThread()
+    {
+#ifdef _WIN32
+        if(!SwitchToThread())
+        {
+            Sleep(1);
+        }
+#else
+        sched_yield();
+#endif
+    }
+
+    ULock::Word exchangeWord(volatile ULock::Word *word,ULock::Word value)
+    {
+#ifdef _WIN32
+        return InterlockedExchange(word,value);
+#else
+        return __atomic_exchange_n(word,value,__ATOMIC_SEQ_CST);
+#endif
+    }
+
+    //! word等于comparand时置为value,返回是否成功.
+    bool compareExchangeWord(volatile ULock::Word *word,ULock::Word value,ULock::Word comparand)
+    {
+#ifdef _WIN32
+        return InterlockedCompareExchange(word,value,comparand) == comparand;
+#else
+        return __atomic_compare_exchange_n(word,&comparand,value,false,__ATOMIC_SEQ_CST,__ATOMIC_SEQ_CST);
+#endif
+    }
+
+    //! 单调的微秒计数,用于事件的超时.
+    long long microseconds()
+    {
+#ifdef _WIN32
+        LARGE_INTEGER frequency;
+        LARGE_INTEGER counter;
+        QueryPerformanceFrequency(&frequency);
+        QueryPerformanceCounter(&counter);
+        return counter.QuadPart / frequency.QuadPart * 1000000
+            + counter.QuadPart % frequency.QuadPart * 1000000 / frequency.QuadPart;
+#else
+        timespec now;
+        clock_gettime(CLOCK_MONOTONIC,&now);
+        return static_cast<long long>(now.tv_sec) * 1000000 + now.tv_nsec / 1000;
+#endif
+    }
+
+    //! 检查事件是否有信号,自动重置的事件同时清除信号.
+    bool consumeEvent(USharedEvent *event)
+    {
+        if(event->mode == USharedMemory::ManualReset)
+        {
+            return event->state != 0;
+        }
+        return event->state != 0 && compareExchangeWord(&event->state,0,1);
+    }
+
+    //! 距离deadline的微秒数,deadline小于0表示不限时间,返回-1.
+    long long remainingTime(long long deadline)
+    {
+        if(deadline < 0)
+        {
+            return -1;
+        }
+        const long long remaining = deadline - microseconds();
+        return remaining > 0 ? remaining : 0;
+    }
+
+    void memoryBarrier()
+    {
+#ifdef _WIN32
+        MemoryBarrier();
+#else
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+#endif
+    }
+
+    //! 读取表的偏移,32位系统下也是原子的.
+    long long loadOffset(const long long *offset)
+    {
+#if defined(_WIN64)
+        return *static_cast<const volatile long long *>(offset);
+#elif defined(_WIN32)
+        return InterlockedCompareExchange64(const_cast<volatile LONGLONG *>(offset),0,0);
+#else
+        return __atomic_load_n(offset,__ATOMIC_ACQUIRE);
+#endif
+    }
+
+    //! 发布新的表,之前对表的写入对读者可见.
+    void storeOffset(long long *offset,long long value)
+    {
+#ifdef _WIN32
+        InterlockedExchange64(offset,value);
+#else
+        __atomic_store_n(offset,value,__ATOMIC_RELEASE);
+#endif
+    }
+
+    //! 版本号加1,析构时再加1,期间版本号为奇数.
+    class WriteVersion
+    {
+    public:
+        explicit WriteVersion(volatile ULock::Word *version)
+            :version_(version)
+        {
+            *version_ = *version_ + 1;
+            memoryBarrier();
+        }
+        ~WriteVersion()
+        {
+            memoryBarrier();
+            *version_ = *version_ + 1;
+        }
+    private:
+        WriteVersion(const WriteVersion &);
+        WriteVersion &operator=(const WriteVersion &);
+        volatile ULock::Word *version_;
+    };
+
+    //! 不加锁读取失败这么多次后让出时间片.
+    const int SpinRounds = 64;
+    //! snapshot不加锁读取失败这么多次后加锁.
+    const int SnapshotRounds = 8;
+
+#ifdef _WIN32
+    //! 在信号量上一次最多挂起的毫秒数.
+    /*!
+        信号量的名字不带前缀,在会话的命名空间中.共享内存带"Global\\"前缀时,
+        其它会话的进程通知时唤醒不了,超时后重新检查状态字.
+    */
+    const DWORD MaxWaitObjectTime = 1000;
+#endif
+
+#ifndef _WIN32
+    //! 大页的大小,x86-64下为2MB.
+    const size_t HugePageSize = 2 * 1024 * 1024;
+
+    //! shm_open的名字以'/'开头,之后不能再有'/'.
+    string posixShmName(const wstring &name)
+    {
+        string result = "/" + wideToUtf8(name);
+        for(size_t i = 1; i < result.size(); i++)
+        {
+            if(result[i] == '/')
+            {
+                result[i] = '_';
+            }
+        }
+        return result;
+    }
+#endif
+}
+
+USharedMemoryManager::USharedMemoryManager()
+#ifdef _WIN32
+    :hFileMapping_(NULL)
+    ,baseAddress_(NULL)
+#else
+    :baseAddress_(NULL)
+#endif
+    ,size_(0)
+    ,created_(false)
+    ,hugePages_(false)
+{
+    createAnonymous(SharedMemorySize,0);
+}
+
+USharedMemoryManager::USharedMemoryManager( size_t size,unsigned int flags )
+#ifdef _WIN32
+    :hFileMapping_(NULL)
+    ,baseAddress_(NULL)
+#else
+    :baseAddress_(NULL)
+#endif
+    ,size_(0)
+    ,created_(false)
+    ,hugePages_(false)
+{
+    createAnonymous(size,flags);
+}
+
+#ifdef _WIN32
+
+USharedMemoryManager::USharedMemoryManager( const std::wstring &name,size_t size,OpenMode mode,unsigned int flags )
+    :hFileMapping_(NULL)
+    ,baseAddress_(NULL)
+    ,size_(0)
+    ,created_(false)
+    ,hugePages_(false)
+{
+    if(mode != OpenOnly)
+    {
+        if(size < MinSegmentSize || size > MaxSegmentSize)
+        {
+            return;
+        }
+        if(flags & UseHugePages)
+        {
+            //需要SeLockMemoryPrivilege权限,失败时使用普通的页.
+            const size_t largePage = GetLargePageMinimum();
+            const size_t largeSize = largePage ? roundUp(size,largePage) : 0;
+            if(largeSize && largeSize <= MaxSegmentSize)
+            {
+                hFileMapping_ = CreateFileMappingW(INVALID_HANDLE_VALUE,NULL,PAGE_READWRITE|SEC_COMMIT|SEC_LARGE_PAGES,
+                    0,static_cast<DWORD>(largeSize),name.c_str());
+                if(hFileMapping_)
+                {
+                    size = largeSize;
+                    hugePages_ = true;
+                }
+            }
+        }
+        if(!hFileMapping_)
+        {
+            hFileMapping_ = CreateFileMappingW(INVALID_HANDLE_VALUE,NULL,PAGE_READWRITE|SEC_COMMIT,
+                0,static_cast<DWORD>(size),name.c_str());
+        }
+        if(!hFileMapping_)
+        {
+            return;
+        }
+        created_ = GetLastError() != ERROR_ALREADY_EXISTS;
+        if(!created_)
+        {
+            hugePages_ = false;
+            if(mode == CreateOnly)
+            {
+                detach();
+                return;
+            }
+        }
+    }
+    else
+    {
+        hFileMapping_ = OpenFileMappingW(FILE_MAP_WRITE,FALSE,name.c_str());
+        if(!hFileMapping_)
+        {
+            return;
+        }
+    }
+    baseAddress_ = MapViewOfFile(hFileMapping_,FILE_MAP_WRITE,0,0,0);
+    if(!baseAddress_)
+    {
+        detach();
+        return;
+    }
+    if(created_)
+    {
+        size_ = size;
+        initialize();
+    }
+    else if(!waitReady())
+    {
+        detach();
+    }
+}
+
+USharedMemoryManager::USharedMemoryManager( HANDLE hFileMapping )
+    :hFileMapping_(hFileMapping)
+    ,baseAddress_(NULL)
+    ,size_(0)
+    ,created_(false)
+    ,hugePages_(false)
+{
+    assert(hFileMapping_ != NULL);
+    baseAddress_ = MapViewOfFile(hFileMapping_,FILE_MAP_WRITE,0,0,0);
+    assert(baseAddress_ != NULL);
+    if(baseAddress_ && !waitReady())
+    {
+        detach();
+    }
+}
+
+void USharedMemoryManager::createAnonymous( size_t size,unsigned int flags )
+{
+    if(size < MinSegmentSize || size > MaxSegmentSize)
+    {
+        return;
+    }
+    if(flags & UseHugePages)
+    {
+        const size_t largePage = GetLargePageMinimum();
+        const size_t largeSize = largePage ? roundUp(size,largePage) : 0;
+        if(largeSize && largeSize <= MaxSegmentSize)
+        {
+            hFileMapping_ = CreateFileMappingW(INVALID_HANDLE_VALUE,NULL,PAGE_READWRITE|SEC_COMMIT|SEC_LARGE_PAGES,
+                0,static_cast<DWORD>(largeSize),NULL);
+            if(hFileMapping_)
+            {
+                size = largeSize;
+                hugePages_ = true;
+            }
+        }
+    }
+    if(!hFileMapping_)
+    {
+        hFileMapping_ = CreateFileMappingW(INVALID_HANDLE_VALUE,NULL,PAGE_READWRITE|SEC_COMMIT,
+            0,static_cast<DWORD>(size),NULL);
+    }
+    if(!hFileMapping_)
+    {
+        return;
+    }
+    baseAddress_ = MapViewOfFile(hFileMapping_,FILE_MAP_WRITE,0,0,0);
+    if(!baseAddress_)
+    {
+        detach();
+        return;
+    }
+    size_ = size;
+    created_ = true;
+    initialize();
+}
+
+void USharedMemoryManager::detach()
+{
+    if(baseAddress_)
+    {
+        UnmapViewOfFile(baseAddress_);
+        baseAddress_ = NULL;
+    }
+    if(hFileMapping_)
+    {
+        CloseHandle(hFileMapping_);
+        hFileMapping_ = NULL;
+    }
+    size_ = 0;
+}
+
+bool USharedMemoryManager::remove( const std::wstring & )
+{
+    return true;
+}
+
+#else
+
+USharedMemoryManager::USharedMemoryManager( const std::wstring &name,size_t size,OpenMode mode,unsigned int flags )
+    :baseAddress_(NULL)
+    ,size_(0)
+    ,posixName_(posixShmName(name))
+    ,created_(false)
+    ,hugePages_(false)
+{
+    int fd = -1;
+    if(mode != OpenOnly)
+    {
+        if(size < MinSegmentSize || size > MaxSegmentSize)
+        {
+            posixName_.clear();
+            return;
+        }
+        fd = shm_open(posixName_.c_str(),O_RDWR|O_CREAT|O_EXCL,0600);
+        if(fd >= 0)
+        {
+            if(ftruncate(fd,size) != 0)
+            {
+                close(fd);
+                shm_unlink(posixName_.c_str());
+                posixName_.clear();
+                return;
+            }
+            created_ = true;
+            size_ = size;
+        }
+        else if(errno != EEXIST || mode == CreateOnly)
+        {
+            posixName_.clear();
+            return;
+        }
+    }
+    if(fd < 0)
+    {
+        fd = shm_open(posixName_.c_str(),O_RDWR,0600);
+        if(fd < 0)
+        {
+            posixName_.clear();
+            return;
+        }
+        //创建者可能还没有设置大小,ftruncate之后大小就是整个段的大小.
+        const unsigned int start = milliseconds();
+        struct stat status;
+        while(fstat(fd,&status) == 0 && status.st_size == 0 && milliseconds() - start < ReadyTimeout)
+        {
+            yieldThread();
+        }
+        if(fstat(fd,&status) != 0 || static_cast<size_t>(status.st_size) < MinSegmentSize)
+        {
+            close(fd);
+            posixName_.clear();
+            return;
+        }
+        size_ = static_cast<size_t>(status.st_size);
+    }
+    void *address = mmap(NULL,size_,PROT_READ|PROT_WRITE,MAP_SHARED,fd,0);
+    close(fd);
+    if(address == MAP_FAILED)
+    {
+        if(created_)
+        {
+            shm_unlink(posixName_.c_str());
+        }
+        posixName_.clear();
+        size_ = 0;
+        return;
+    }
+    baseAddress_ = address;
+#ifdef MADV_HUGEPAGE
+    //共享内存只有shmem_enabled为advise或always时才会使用透明大页.
+    if((flags & UseHugePages) && size_ >= HugePageSize)
+    {
+        hugePages_ = madvise(baseAddress_,size_,MADV_HUGEPAGE) == 0;
+    }
+#endif
+    if(created_)
+    {
+        initialize();
+    }
+    else if(!waitReady())
+    {
+        detach();
+    }
+}
+
+void USharedMemoryManager::createAnonymous( size_t size,unsigned int flags )
+{
+    if(size < MinSegmentSize || size > MaxSegmentSize)
+    {
+        return;
+    }
+    void *address = MAP_FAILED;
+#ifdef MAP_HUGETLB
+    if(flags & UseHugePages)
+    {
+        //需要预留大页(vm.nr_hugepages),失败时使用普通的页.
+        const size_t hugeSize = roundUp(size,HugePageSize);
+        if(hugeSize <= MaxSegmentSize)
+        {
+            address = mmap(NULL,hugeSize,PROT_READ|PROT_WRITE,MAP_SHARED|MAP_ANONYMOUS|MAP_HUGETLB,-1,0);
+            if(address != MAP_FAILED)
+            {
+                size = hugeSize;
+                hugePages_ = true;
+            }
+        }
+    }
+#endif
+    if(address == MAP_FAILED)
+    {
+        address = mmap(NULL,size,PROT_READ|PROT_WRITE,MAP_SHARED|MAP_ANONYMOUS,-1,0);
+    }
+    if(address == MAP_FAILED)
+    {
+        return;
+    }
+    baseAddress_ = address;
+    size_ = size;
+    created_ = true;
+    initialize();
+}
+
+void USharedMemoryManager::detach()
+{
+    if(baseAddress_)
+    {
+        munmap(baseAddress_,size_);
+        baseAddress_ = NULL;
+    }
+    posixName_.clear();
+    size_ = 0;
+}
+
+bool USharedMemoryManager::remove( const std::wstring &name )
+{
+    return shm_unlink(posixShmName(name).c_str()) == 0 || errno == ENOENT;
+}
+
+#endif
+
+USharedMemoryManager::~USharedMemoryManager()
+{
+    detach();
+}
+
+void USharedMemoryManager::initialize()
+{
+    USharedSegmentHeader *segment = header();
+    segment->magic = USharedSegmentMagic;
+    segment->size = static_cast<unsigned int>(size_);
+
+    USharedHeap::format(baseAddress_,HeapOffset,size_);
+    heap_.attach(baseAddress_,HeapOffset);
+
+    //其它进程看到ready时头部和堆已经初始化.
+    atomicAdd(&segment->ready,1);
+}
+
+bool USharedMemoryManager::waitReady()
+{
+    USharedSegmentHeader *segment = header();
+    const unsigned int start = milliseconds();
+    while(atomicAdd(&segment->ready,0) == 0)
+    {
+        if(milliseconds() - start >= ReadyTimeout)
+        {
+            return false;
+        }
+        yieldThread();
+    }
+    if(segment->magic != USharedSegmentMagic || segment->size < MinSegmentSize)
+    {
+        return false;
+    }
+#ifdef _WIN32
+    //MapViewOfFile映射了整个段,大小只能从头部读取.
+    size_ = segment->size;
+#else
+    if(segment->size != size_)
+    {
+        return false;
+    }
+#endif
+    heap_.attach(baseAddress_,HeapOffset);
+    return true;
+}
+
+bool USharedMemory::setData( const std::wstring &key, const std::wstring &data )
+{
+    return setValue(key,StringValue,data.c_str(),static_cast<int>(data.size() * sizeof(wchar_t)));
+}
+
+bool USharedMemory::setIntData( const std::wstring &key, int data )
+{
+    return setValue(key,IntValue,&data,sizeof(data));
+}
+
+bool USharedMemory::setDoubleData( const std::wstring &key, double data )
+{
+    return setValue(key,DoubleValue,&data,sizeof(data));
+}
+
+bool USharedMemory::setBinaryData( const std::wstring &key, const void *data, int size )
+{
+    if(size < 0)
+    {
+        return false;
+    }
+    return setValue(key,BinaryValue,data,size);
+}
+
+std::wstring USharedMemory::data( const std::wstring &key )
+{
+    string bytes;
+    const ValueType type = value(key,bytes);
+    return text(type,bytes);
+}
+
+std::wstring USharedMemory::text( ValueType type,const std::string &data )
+{
+    switch(type)
+    {
+    case StringValue:
+        return data.empty() ? wstring() : wstring(reinterpret_cast<const wchar_t *>(data.data()),data.size() / sizeof(wchar_t));
+    case IntValue:
+        {
+            int number = 0;
+            memcpy(&number,data.data(),sizeof(number));
+            wchar_t buf[UIntegerMaxChars + 1] = L"";
+            return wstring(buf,format_int(number,buf));
+        }
+    case DoubleValue:
+        {
+            double number = 0;
+            memcpy(&number,data.data(),sizeof(number));
+            wchar_t buf[UDoubleMaxChars + 1] = L"";
+            return wstring(buf,format_double(number,buf));
+        }
+    default:
+        return wstring();
+    }
+}
+
+int USharedMemory::intData( const std::wstring &key )
+{
+    string bytes;
+    int number = 0;
+    switch(value(key,bytes))
+    {
+    case StringValue:
+        {
+            size_t parsed = 0;
+            parse_int(UWStringView(reinterpret_cast<const wchar_t *>(bytes.data()),bytes.size() / sizeof(wchar_t)),number,&parsed);
+        }
+        break;
+    case IntValue:
+        memcpy(&number,bytes.data(),sizeof(number));
+        break;
+    case DoubleValue:
+        {
+            double real = 0;
+            memcpy(&real,bytes.data(),sizeof(real));
+            number = static_cast<int>(real);
+        }
+        break;
+    default:
+        break;
+    }
+    return number;
+}
+
+double USharedMemory::doubleData( const std::wstring &key )
+{
+    string bytes;
+    double number = 0;
+    switch(value(key,bytes))
+    {
+    case StringValue:
+        {
+            size_t parsed = 0;
+            parse_double(UWStringView(reinterpret_cast<const wchar_t *>(bytes.data()),bytes.size() / sizeof(wchar_t)),number,&parsed);
+        }
+        break;
+    case IntValue:
+        {
+            int integer = 0;
+            memcpy(&integer,bytes.data(),sizeof(integer));
+            number = integer;
+        }
+        break;
+    case DoubleValue:
+        memcpy(&number,bytes.data(),sizeof(number));
+        break;
+    default:
+        break;
+    }
+    return number;
+}
+
+bool USharedMemory::binaryData( const std::wstring &key, std::string &data )
+{
+    return value(key,data) != NoValue;
+}
+
+USharedMemory::ValueType USharedMemory::valueType( const std::wstring &key )
+{
+    string bytes;
+    return value(key,bytes);
+}
+
+size_t USharedMemory::size()
+{
+    PairTable *pairs = table(loadOffset(&commu_->pairOffset));
+    return pairs ? *static_cast<volatile unsigned int *>(&pairs->count) : 0;
+}
+
+std::vector<USharedMemory::Entry> USharedMemory::snapshot()
+{
+    vector<Entry> entries;
+    for(int round = 0; round < SnapshotRounds; round++)
+    {
+        const ULock::Word sequence = commu_->sequence;
+        memoryBarrier();
+        if(!(sequence & 1) && readAll(entries,sequence))
+        {
+            return entries;
+        }
+        yield();
+    }
+    //一直有写入,加锁后没有写入.
+    ScopedLock lock(&commu_->lock);
+    readAll(entries,commu_->sequence);
+    return entries;
+}
+
+volatile ULock::Word * USharedMemory::getEvent( const std::wstring &key )
+{
+    USharedEvent *event = findOrCreateEvent(key,AutoReset);
+    return event ? &event->state : 0;
+}
+
+bool USharedMemory::createEvent( const std::wstring &event,EventMode mode )
+{
+    const USharedEvent *created = findOrCreateEvent(event,mode);
+    return created && created->mode == mode;
+}
+
+USharedEvent * USharedMemory::findOrCreateEvent( const std::wstring &key,EventMode mode )
+{
+    //事件创建后地址不变,已经存在时不需要加锁.
+    Pair *pair = findPair(loadOffset(&commu_->eventOffset),key,hashKey(key));
+    if(pair && pair->type == EventValue)
+    {
+        memoryBarrier();
+        return reinterpret_cast<USharedEvent *>(address(pair->valueOffset));
+    }
+    ScopedLock lock(&commu_->lock);
+    pair = findOrInsertPair(commu_->eventOffset,key);
+    assert(pair);
+    if(!pair)
+    {
+        return 0;
+    }
+    if(pair->type == NoValue)
+    {
+        const long long event = memoryManager_.allocMemory(sizeof(USharedEvent));
+        assert(event);
+        if(!event)
+        {
+            return 0;
+        }
+        USharedEvent *created = reinterpret_cast<USharedEvent *>(event);
+        created->state = 0;
+        created->waiters = 0;
+        created->mode = mode;
+        created->reserved = 0;
+        pair->valueOffset = offset(event);
+        pair->valueSize = sizeof(USharedEvent);
+        pair->valueCapacity = sizeof(USharedEvent);
+        memoryBarrier();
+        pair->type = EventValue;
+    }
+    return reinterpret_cast<USharedEvent *>(address(pair->valueOffset));
+}
+
+void USharedMemory::WaitEvent( const std::wstring &event )
+{
+    USharedEvent *shared = findOrCreateEvent(event,AutoReset);
+    if(shared)
+    {
+        waitEvent(shared,-1,0);
+    }
+}
+
+bool USharedMemory::WaitEvent( const std::wstring &event,int waitTime )
+{
+    USharedEvent *shared = findOrCreateEvent(event,AutoReset);
+    return shared && waitEvent(shared,waitTime < 0 ? -1 : waitTime * 1000LL,0);
+}
+
+bool USharedMemory::WaitEvent( const std::wstring &event,bool(*canExit)() )
+{
+    USharedEvent *shared = findOrCreateEvent(event,AutoReset);
+    return shared && waitEvent(shared,-1,canExit);
+}
+
+void USharedMemory::NotifyEvent( const std::wstring &event )
+{
+    USharedEvent *shared = findOrCreateEvent(event,AutoReset);
+    if(shared)
+    {
+        notifyEvent(shared);
+    }
+}
+
+void USharedMemory::notifyEvent( USharedEvent *shared )
+{
+    exchangeWord(&shared->state,1);
+    //先置状态再检查等待者,等待者先登记再检查状态,不会漏掉唤醒.
+    const ULock::Word waiters = shared->waiters;
+    if(waiters)
+    {
+        wakeWord(&shared->state,waiters,shared->mode == ManualReset);
+    }
+    atomicAdd(&commu_->notifySequence,1);
+    const ULock::Word anyWaiters = commu_->anyWaiters;
+    if(anyWaiters)
+    {
+        wakeWord(&commu_->notifySequence,anyWaiters,true);
+    }
+}
+
+void USharedMemory::ClearEvent( const std::wstring &event )
+{
+    USharedEvent *shared = findOrCreateEvent(event,AutoReset);
+    if(shared)
+    {
+        exchangeWord(&shared->state,0);
+    }
+}
+
+int USharedMemory::WaitAnyEvent( const std::vector<std::wstring> &events,int waitTime )
+{
+    vector<USharedEvent *> shared(events.size());
+    for(size_t i = 0; i < events.size(); i++)
+    {
+        shared[i] = findOrCreateEvent(events[i],AutoReset);
+        if(!shared[i])
+        {
+            return -1;
+        }
+    }
+    const long long deadline = waitTime < 0 ? -1 : microseconds() + waitTime * 1000LL;
+    for(;;)
+    {
+        //先读序号再检查事件,之后的通知会改变序号,futex不会挂起.
+        const ULock::Word sequence = atomicAdd(&commu_->notifySequence,0);
+        for(size_t i = 0; i < shared.size(); i++)
+        {
+            if(consumeEvent(shared[i]))
+            {
+                return static_cast<int>(i);
+            }
+        }
+        const long long remaining = remainingTime(deadline);
+        if(remaining == 0)
+        {
+            return -1;
+        }
+        waitWord(&commu_->notifySequence,&commu_->anyWaiters,sequence,remaining);
+    }
+}
+
+bool USharedMemory::waitEvent( USharedEvent *event,long long timeout,bool(*canExit)() )
+{
+    const long long deadline = timeout < 0 ? -1 : microseconds() + timeout;
+    for(;;)
+    {
+        if(consumeEvent(event))
+        {
+            return true;
+        }
+        if(canExit && canExit())
+        {
+            return false;
+        }
+        long long remaining = remainingTime(deadline);
+        if(remaining == 0)
+        {
+            return false;
+        }
+        if(canExit && (remaining < 0 || remaining > PredicateInterval * 1000))
+        {
+            remaining = PredicateInterval * 1000;
+        }
+        waitWord(&event->state,&event->waiters,0,remaining);
+    }
+}
+
+void USharedMemory::waitWord( volatile ULock::Word *word,volatile ULock::Word *waiters,ULock::Word value,long long timeout )
+{
+#ifdef _WIN32
+    //WaitOnAddress不能唤醒其它进程,在命名信号量上挂起.先打开信号量再登记,
+    //通知者看到等待者时信号量一定存在,释放的计数不会随着最后一个句柄关闭而丢失.
+    const HANDLE semaphore = waitObject(word);
+    atomicAdd(waiters,1);
+    if(*word == value)
+    {
+        if(semaphore)
+        {
+            const DWORD waitTime = timeout < 0 || timeout > MaxWaitObjectTime * 1000LL
+                ? MaxWaitObjectTime : static_cast<DWORD>((timeout + 999) / 1000);
+            WaitForSingleObject(semaphore,waitTime);
+        }
+        else
+        {
+            Sleep(1);
+        }
+    }
+    atomicAdd(waiters,-1);
+#else
+    atomicAdd(waiters,1);
+    timespec relative;
+    relative.tv_sec = static_cast<time_t>(timeout / 1000000);
+    relative.tv_nsec = static_cast<long>(timeout % 1000000 * 1000);
+    syscall(SYS_futex,word,FUTEX_WAIT,value,timeout >= 0 ? &relative : 0,0,0);
+    atomicAdd(waiters,-1);
+#endif
+}
+
+void USharedMemory::wakeWord( volatile ULock::Word *word,ULock::Word waiters,bool all )
+{
+#ifdef _WIN32
+    //多释放的计数只会让之后的等待者无故返回一次,等待者会重新检查状态字.
+    const HANDLE semaphore = waitObject(word);
+    if(semaphore)
+    {
+        ReleaseSemaphore(semaphore,all ? waiters : 1,NULL);
+    }
+#else
+    (void)waiters;
+    syscall(SYS_futex,word,FUTEX_WAKE,all ? INT_MAX : 1,0,0,0);
+#endif
+}
+
+#ifdef _WIN32
+
+HANDLE USharedMemory::waitObject( volatile ULock::Word *word )
+{
+    const long long wordOffset = offset(reinterpret_cast<long long>(word));
+    UScopedLock lock(waitObjectsLock_);
+    map<long long,HANDLE>::const_iterator it = waitObjects_.find(wordOffset);
+    if(it != waitObjects_.end())
+    {
+        return it->second;
+    }
+    if(!commu_->waitId)
+    {
+        //只要各个段不同就行,偶尔重复也只会让等待者多醒几次.
+        const ULock::Word id = static_cast<ULock::Word>(
+            (GetCurrentProcessId() * 2654435761u) ^ GetTickCount() ^ static_cast<unsigned int>(reinterpret_cast<size_t>(commu_))) | 1;
+        compareExchangeWord(&commu_->waitId,id,0);
+    }
+    wchar_t name[64];
+    swprintf_s(name,L"UniCoreSharedWait_%08lX_%llX",static_cast<unsigned long>(commu_->waitId),wordOffset);
+    const HANDLE semaphore = CreateSemaphoreW(NULL,0,LONG_MAX,name);
+    if(semaphore)
+    {
+        waitObjects_[wordOffset] = semaphore;
+    }
+    return semaphore;
+}
+
+#endif
+
+USharedMemory::~USharedMemory()
+{
+#ifdef _WIN32
+    for(map<long long,HANDLE>::const_iterator it = waitObjects_.begin(); it != waitObjects_.end(); ++it)
+    {
+        CloseHandle(it->second);
+    }
+#endif
+}
+
+long long USharedMemory::newString( const std::wstring &key )
+{
+    int allocSize = static_cast<int>(key.length()*sizeof(wchar_t)+sizeof(int));
+    long long address = memoryManager_.allocMemory(allocSize);
+    if(!address)
+    {
+        return 0;
+    }
+    *(int *)address = static_cast<int>(key.length());
+    memcpy(reinterpret_cast<void *>(address+sizeof(int)),key.data(),key.length()*sizeof(wchar_t));
+    return address;
+}
+
+Pair * USharedMemory::findPair( const std::wstring &key )
+{
+    return findPair(loadOffset(&commu_->pairOffset),key,hashKey(key));
+}
+
+Pair * USharedMemory::findPair( long long tableOffset,const std::wstring &key,unsigned int hash ) const
+{
+    PairTable *pairs = table(tableOffset);
+    if(!pairs)
+    {
+        return 0;
+    }
+    //装载率不超过70%,一定能遇到空项.
+    const unsigned int mask = pairs->capacity - 1;
+    for(unsigned int i = hash & mask; ; i = (i + 1) & mask)
+    {
+        Pair &pair = pairs->pairs[i];
+        const unsigned int pairHash = pair.hash;
+        if(!pairHash)
+        {
+            return 0;
+        }
+        //hash写入时其它字段已经写好.
+        memoryBarrier();
+        if(pairHash == hash && keyEquals(pair,key))
+        {
+            return &pair;
+        }
+    }
+}
+
+Pair * USharedMemory::findOrInsertPair( long long &tableOffset,const std::wstring &key )
+{
+    const unsigned int hash = hashKey(key);
+    Pair *pair = findPair(tableOffset,key,hash);
+    if(pair)
+    {
+        return pair;
+    }
+    PairTable *pairs = table(tableOffset);
+    if(!pairs || (pairs->count + 1) * 10 > pairs->capacity * 7)
+    {
+        if(!growTable(tableOffset,pairs ? pairs->capacity * 2 : InitialTableCapacity))
+        {
+            return 0;
+        }
+        pairs = table(tableOffset);
+    }
+    const long long keyAddress = newString(key);
+    if(!keyAddress)
+    {
+        return 0;
+    }
+    const unsigned int mask = pairs->capacity - 1;
+    unsigned int i = hash & mask;
+    while(pairs->pairs[i].hash)
+    {
+        i = (i + 1) & mask;
+    }
+    pair = &pairs->pairs[i];
+    pair->version = 0;
+    pair->type = NoValue;
+    pair->keyOffset = offset(keyAddress);
+    pair->valueOffset = 0;
+    pair->valueSize = 0;
+    pair->valueCapacity = 0;
+    memoryBarrier();
+    pair->hash = hash;
+    pairs->count++;
+    return pair;
+}
+
+bool USharedMemory::growTable( long long &tableOffset,unsigned int capacity )
+{
+    const size_t bytes = offsetof(PairTable,pairs) + capacity * sizeof(Pair);
+    if(bytes > 0x7FFFFFFF)
+    {
+        return false;
+    }
+    const long long newAddress = memoryManager_.allocMemory(static_cast<int>(bytes));
+    if(!newAddress)
+    {
+        return false;
+    }
+    PairTable *newPairs = reinterpret_cast<PairTable *>(newAddress);
+    memset(newPairs,0,bytes);
+    newPairs->capacity = capacity;
+    //键的哈希值已经保存,复制时不需要重新计算.
+    PairTable *oldPairs = table(tableOffset);
+    if(oldPairs)
+    {
+        const unsigned int mask = capacity - 1;
+        for(unsigned int j = 0; j < oldPairs->capacity; j++)
+        {
+            const Pair &pair = oldPairs->pairs[j];
+            if(pair.hash)
+            {
+                unsigned int i = pair.hash & mask;
+                while(newPairs->pairs[i].hash)
+                {
+                    i = (i + 1) & mask;
+                }
+                Pair &copy = newPairs->pairs[i];
+                copy.version = pair.version;
+                copy.keyOffset = pair.keyOffset;
+                copy.valueOffset = pair.valueOffset;
+                copy.valueSize = pair.valueSize;
+                copy.valueCapacity = pair.valueCapacity;
+                copy.type = pair.type;
+                copy.hash = pair.hash;
+            }
+        }
+        newPairs->count = oldPairs->count;
+    }
+    newPairs->previousOffset = tableOffset;
+    storeOffset(&tableOffset,offset(newAddress));
+    return true;
+}
+
+bool USharedMemory::setValue( const std::wstring &key,ValueType type,const void *data,int size )
+{
+    ScopedLock lock(&commu_->lock);
+    WriteVersion sequence(&commu_->sequence);
+    Pair *pair = findOrInsertPair(commu_->pairOffset,key);
+    if(!pair)
+    {
+        return false;
+    }
+    if(size > pair->valueCapacity)
+    {
+        //先写好新的缓冲区,读者看到新的偏移时数据已经完整.
+        const int capacity = (size + 7) & ~7;
+        const long long buffer = memoryManager_.allocMemory(capacity);
+        if(!buffer)
+        {
+            return false;
+        }
+        memcpy(reinterpret_cast<void *>(buffer),data,size);
+        const long long oldBuffer = pair->valueOffset;
+        {
+            WriteVersion version(&pair->version);
+            pair->valueOffset = offset(buffer);
+            pair->valueCapacity = capacity;
+            pair->valueSize = size;
+            pair->type = type;
+        }
+        //正在读取旧缓冲区的读者会发现版本号变了.
+        if(oldBuffer)
+        {
+            memoryManager_.freeMemory(address(oldBuffer));
+        }
+        return true;
+    }
+    WriteVersion version(&pair->version);
+    if(size)
+    {
+        memcpy(reinterpret_cast<void *>(address(pair->valueOffset)),data,size);
+    }
+    pair->valueSize = size;
+    pair->type = type;
+    return true;
+}
+
+USharedMemory::ValueType USharedMemory::value( const std::wstring &key,std::string &data )
+{
+    const unsigned int hash = hashKey(key);
+    for(int round = 0; ; round++)
+    {
+        if(round >= SpinRounds)
+        {
+            yield();
+        }
+        const long long tableOffset = loadOffset(&commu_->pairOffset);
+        Pair *pair = findPair(tableOffset,key,hash);
+        if(!pair)
+        {
+            data.clear();
+            return NoValue;
+        }
+        ValueType type = NoValue;
+        //表被替换后旧表中的项不再更新.
+        if(readPair(*pair,type,data) && loadOffset(&commu_->pairOffset) == tableOffset)
+        {
+            return type;
+        }
+    }
+}
+
+bool USharedMemory::readPair( const Pair &pair,ValueType &type,std::string &data ) const
+{
+    const ULock::Word version = pair.version;
+    if(version & 1)
+    {
+        return false;
+    }
+    memoryBarrier();
+    const int pairType = pair.type;
+    const long long valueOffset = pair.valueOffset;
+    const int valueSize = pair.valueSize;
+    const int valueCapacity = pair.valueCapacity;
+    memoryBarrier();
+    //字段是一致的,缓冲区可能被释放,但仍在共享内存中.
+    if(pair.version != version || valueSize < 0 || valueSize > valueCapacity)
+    {
+        return false;
+    }
+    if(pairType == NoValue || !valueSize)
+    {
+        data.clear();
+    }
+    else
+    {
+        data.assign(reinterpret_cast<const char *>(address(valueOffset)),valueSize);
+    }
+    memoryBarrier();
+    if(pair.version != version)
+    {
+        return false;
+    }
+    type = static_cast<ValueType>(pairType);
+    return true;
+}
+
+bool USharedMemory::readAll( std::vector<Entry> &entries,ULock::Word sequence )
+{
+    entries.clear();
+    PairTable *pairs = table(loadOffset(&commu_->pairOffset));
+    if(pairs)
+    {
+        for(unsigned int i = 0; i < pairs->capacity; i++)
+        {
+            const Pair &pair = pairs->pairs[i];
+            if(!pair.hash)
+            {
+                continue;
+            }
+            memoryBarrier();
+            Entry entry;
+            if(!readPair(pair,entry.type,entry.data))
+            {
+                return false;
+            }
+            if(entry.type != NoValue)
+            {
+                entry.key = getStringByAddress(address(pair.keyOffset));
+                entries.push_back(entry);
+            }
+        }
+    }
+    memoryBarrier();
+    return commu_->sequence == sequence;
+}
+
+unsigned int USharedMemory::hashKey( const std::wstring &key )
+{
+    //FNV-1a,按wchar_t计算.
+    unsigned int hash = 2166136261u;
+    for(size_t i = 0; i < key.size(); i++)
+    {
+        hash = (hash ^ static_cast<unsigned int>(key[i])) * 16777619u;
+    }
+    hash ^= hash >> 15;
+    return hash ? hash : 1;
+}
+
+bool USharedMemory::keyEquals( const Pair &pair,const std::wstring &key ) const
+{
+    const long long keyAddress = address(pair.keyOffset);
+    const int length = *reinterpret_cast<const int *>(keyAddress);
+    return length == static_cast<int>(key.size())
+        && memcmp(reinterpret_cast<const void *>(keyAddress + sizeof(int)),key.data(),length * sizeof(wchar_t)) == 0;
+}
+
+void USharedMemory::yield()
+{
+    yieldThread();
+}
+
+}//namespace uni
@@ -1,437 +1,437 @@
 ﻿/*! \file USharedMemory.h
     \brief 简单的共享内存类.
+
+    USharedMemoryManager管理一段共享内存:
+    - 匿名的共享内存只能通过继承句柄(Windows)或fork(Linux)共享给子进程.
+    - 命名的共享内存可以被其它进程按名字打开.Windows下使用CreateFileMapping,
+      Linux下使用shm_open和mmap.
+    - 大小可以指定,可以请求使用大页,系统不支持或没有权限时使用普通的页.
+
+    段的开头是USharedSegmentHeader,记录段的大小,打开已有的段时不需要知道大小.
+
+    USharedMemory在共享内存中保存键值对和事件,各用一个开放定址的哈希表.
+    表中保存键的哈希值,查找时先比较哈希值,再直接比较共享内存中的键,不构造字符串.
+
+    写入时加锁,读取时不加锁(seqlock):
+    - 每一项有版本号,写入前后各加1,读者在版本号为偶数且读取前后相同时才使用读到的值.
+    - Commu::sequence在每次写入前后各加1,snapshot用它检查所有的项是否一致.
+    - 读者还检查表没有被替换,旧表中的项不再更新.
+    - 被替换的缓冲区释放后仍在段中,读者读到重用的内存时版本号已经变化,会重新读取.
+      旧的表不释放.
+
+    事件是共享内存中的USharedEvent,等待时在状态字上挂起,不占用CPU:
+    - Linux下使用不带FUTEX_PRIVATE_FLAG的futex,可以唤醒其它进程中的等待者.
+    - Windows下WaitOnAddress只在进程内有效,每个状态字对应一个命名信号量,等待者第一次挂起时创建,
+      通知时只在有等待者时释放.
+    - 自动重置的事件每次通知只让一个等待者返回,手动重置的事件在ClearEvent之前一直有信号.
+    - WaitAnyEvent在Commu::notifySequence上挂起,每次通知都会把它加1.
+
     \date   2013-8-29
     \author uni(unigauldoth@gmail.com)
 */
 #ifndef UNICORE_USHAREDMEMORY_H
 #define UNICORE_USHAREDMEMORY_H
 
+#include <map>
 #include <string>
+#include <vector>
 #include <cassert>
-#define WIN32_LEAN_AND_MEAN
-#include "windows.h"
+#include <string.h>
 
 #define AUTO_LINK_LIB_NAME "UniCore"
 #include "AutoLink.h"
 
+#include "UCast.h"
+#include "ULock.h"
+#include "USharedHeap.h"
+
 namespace uni
 {
 
+//! USharedMemory的根,放在UMemoryManager::fixedMemory中.
+/*!
+    USharedMemory中的偏移都是相对Commu的开头的,各个进程映射的地址可以不同.
+*/
 struct Commu
 {
-    long __int32 lock;
-    __int32 eventOffset;
-    __int32 pairOffset;
+    ULock::Word lock;           //!< 写入和创建事件时加锁.
+    volatile ULock::Word sequence;  //!< 写入键值对时加1,写入完成后再加1.
+    long long eventOffset;      //!< 事件的哈希表.
+    long long pairOffset;       //!< 键值对的哈希表.
+    volatile ULock::Word notifySequence;    //!< 每次通知事件时加1,WaitAnyEvent在这里挂起.
+    volatile ULock::Word anyWaiters;        //!< 在notifySequence上挂起的等待者数.
+    volatile ULock::Word waitId;            //!< Windows下等待用的信号量名字的一部分,第一次挂起时设置.
 };
 
 class UMemoryManager
 {
 public:
     virtual ~UMemoryManager() {}
-    virtual __int64 allocMemory(int size) = 0;
-    virtual bool freeMemory(__int64 address) = 0;
-    virtual __int64 fixedMemory() = 0;
-    virtual __int64 fixedMemorySize() = 0;
+    virtual long long allocMemory(int size) = 0;
+    virtual bool freeMemory(long long address) = 0;
+    virtual long long fixedMemory() = 0;
+    virtual long long fixedMemorySize() = 0;
     virtual bool isValid() {return true;}
 };
 
-struct Block
+//! 共享内存段的头部.
+struct USharedSegmentHeader
 {
-    __int32 size;  // available buf size, not including the "size" and "free" field.
-    __int32 free;
-    char buf[1];
+    unsigned int magic;             //!< 固定为'USHM'.
+    unsigned int size;              //!< 整个段的大小,包括头部.
+    volatile ULock::Word ready;     //!< 创建者初始化完成后为1.
+    unsigned int reserved;
 };
 
 class USharedMemoryManager : public UMemoryManager
 {
 public:
-    enum {SharedMemorySize = 0x1000};
-    USharedMemoryManager()
+    enum {SharedMemorySize = 0x1000};   //!< 默认的大小.
+
+    //! 打开命名共享内存的方式.
+    enum OpenMode
     {
-        hFileMapping_ = 
-            CreateFileMapping(INVALID_HANDLE_VALUE,NULL,PAGE_READWRITE|SEC_COMMIT,0,SharedMemorySize,NULL);
-        assert(hFileMapping_ != NULL);
-        baseAddress_ = MapViewOfFile(hFileMapping_,FILE_MAP_WRITE,0,0,0);
-        assert(baseAddress_ != NULL);
-        
-        Block *firstBlock = reinterpret_cast<Block *>((__int64)baseAddress_ + sizeof(Commu));
-        firstBlock->size = SharedMemorySize - sizeof(Commu);
-        firstBlock->free = true;
-    }
-    USharedMemoryManager(HANDLE hFileMapping)
-        :hFileMapping_(hFileMapping)
+        CreateOrOpen,   //!< 已经存在时打开,否则创建.
+        CreateOnly,     //!< 已经存在时失败.
+        OpenOnly        //!< 不存在时失败.
+    };
+
+    enum Flags
     {
-        assert(hFileMapping_ != NULL);
-        baseAddress_ = MapViewOfFile(hFileMapping,FILE_MAP_WRITE,0,0,0);
-        assert(baseAddress_ != NULL);
-    }
-    virtual __int64 allocMemory(int size)
+        UseHugePages = 1    //!< 尽量使用大页,减少TLB缺失.
+    };
+
+    //! 创建SharedMemorySize大小的匿名共享内存.
+    USharedMemoryManager();
+    //! 创建匿名共享内存.
+    /*!
+        \param size 段的大小,最大为2GB.使用大页时会向上取整到大页的大小.
+        \param flags Flags的组合.
+    */
+    explicit USharedMemoryManager(size_t size,unsigned int flags = 0);
+    //! 创建或打开命名共享内存.
+    /*!
+        \param name 共享内存的名字.Windows下可以加"Global\"或"Local\"前缀,
+        Linux下'/'会被替换为'_'.
+        \param size 创建时段的大小,打开已有的段时忽略.
+        \param mode 打开方式.
+        \param flags Flags的组合,Linux下命名共享内存只能建议内核使用透明大页.
+    */
+    USharedMemoryManager(const std::wstring &name,size_t size,OpenMode mode = CreateOrOpen,unsigned int flags = 0);
+#ifdef _WIN32
+    //! 映射其它进程创建并传递过来的文件映射句柄,析构时关闭句柄.
+    USharedMemoryManager(HANDLE hFileMapping);
+#endif
+    //! 解除映射.
+    /*!
+        Windows下所有句柄都关闭后共享内存被释放.
+        Linux下不会删除名字,所有进程都解除映射后共享内存仍然存在,不再使用时需要调用remove删除.
+        不按映射计数自动删除,是因为fork出的子进程复制了对象却没有增加计数,
+        计数变为0时也可能有进程正要打开.
+    */
+    virtual ~USharedMemoryManager();
+
+    //! 删除命名共享内存的名字,已经映射的进程不受影响.Windows下什么都不做.
+    static bool remove(const std::wstring &name);
+
+    //! 段的大小.
+    size_t size() const {return size_;}
+    //! 是否由这个对象创建.
+    bool created() const {return created_;}
+    //! 是否使用了大页.
+    bool hugePages() const {return hugePages_;}
+    //! 段中堆的统计信息.
+    USharedHeapStatistics statistics() {return heap_.statistics();}
+
+    //! 从段中的USharedHeap分配,多个进程可以同时分配和释放.
+    virtual long long allocMemory(int size)
     {
         if(size <= 0)
         {
             return 0;
         }
-        Block *block = getFreeBlock(size);
-        if(block)
-        {
-            Block *allocBlock = splitBlock(block,size);
-            if(allocBlock)
-            {
-                return (__int64)&allocBlock->buf[0];
-            }
-            else
-            {
-                return 0;
-            }
-        }
-        else
-        {
-            return 0;
-        }
+        return reinterpret_cast<long long>(heap_.alloc(size));
     }
-    virtual bool freeMemory(__int64 address)
+    virtual bool freeMemory(long long address)
     {
-        Block *blockToFree = (Block *)(address-sizeof(__int32)*2);
-        Block *block = getFirstBlock();
-        Block *prevBlock = 0;
-        Block *nextBlock = 0;
-        while(block)
-        {
-            if(block == blockToFree)
-            {
-                nextBlock = getNextBlock(block);
-                break;
-            }
-            prevBlock = block;
-            block = getNextBlock(block);
-        }
-        if(!block)
-        {
-            return false;
-        }
-        if(prevBlock && prevBlock->free)
-        {
-            prevBlock->size += block->size + sizeof(__int32)*2;
-            block = prevBlock;
-        }
-
-        if(nextBlock && nextBlock->free)
-        {
-            block->size += nextBlock->size + sizeof(__int32)*2;
-        }
-
-        block->free = true;
-        return true;
+        return heap_.free(reinterpret_cast<void *>(address));
     }
-    virtual __int64 fixedMemory()
+    virtual long long fixedMemory()
     {
-        return reinterpret_cast<__int64>(baseAddress_);
+        return reinterpret_cast<long long>(baseAddress_) + sizeof(USharedSegmentHeader);
     }
-    virtual __int64 fixedMemorySize()
+    virtual long long fixedMemorySize()
     {
         return sizeof(Commu);
     }
     virtual bool isValid()
     {
-        return hFileMapping_ != NULL && baseAddress_ != NULL;
+        return baseAddress_ != NULL;
     }
 private:
-    Block *getFreeBlock(int minimumSize)
-    {
-        Block *block = getFirstBlock();
-        while(block && block->size < minimumSize+sizeof(__int32)*2)
-        {
-            block = getNextBlock(block);
-        }
-        if(block)
-        {
-            return block;
-        }
-        else
-        {
-            return 0;
-        }
-    }
-    Block *getNextBlock(Block *block)
-    {
-        if(block)
-        {
-            __int64 nextBlockAddress = (__int64)&(block->buf[0]) + block->size;
-            if(nextBlockAddress >= (__int64)baseAddress_+SharedMemorySize)
-            {
-                return 0;
-            }
-            else
-            {
-                return reinterpret_cast<Block *>(nextBlockAddress);
-            }
-        }
-        return 0;
-    }
-    Block *getFirstBlock()
-    {
-        return reinterpret_cast<Block *>((__int64)baseAddress_ + sizeof(Commu));
-    }
-    Block *splitBlock(Block *block,__int64 size)
+    USharedMemoryManager(const USharedMemoryManager &);
+    USharedMemoryManager &operator = (const USharedMemoryManager &);
+
+    //! 创建匿名共享内存,失败时baseAddress_为0.
+    void createAnonymous(size_t size,unsigned int flags);
+    //! 创建者初始化头部和堆.
+    void initialize();
+    //! 打开已有的段后等待创建者初始化完成.
+    bool waitReady();
+    void detach();
+
+    USharedSegmentHeader *header() const
     {
-        __int32 remainBlockSize = block->size - size - sizeof(__int32)*2;
-        if(remainBlockSize >= 0x10)
-        {
-            block->size = size;
-            Block *remainBlock = (Block *)((__int64)&(block->buf[0]) + block->size);
-            remainBlock->size = remainBlockSize;
-            remainBlock->free = true;
-        }
-        else
-        {
-            block->free = false;
-        }
-        return block;
+        return static_cast<USharedSegmentHeader *>(baseAddress_);
     }
+
+#ifdef _WIN32
     HANDLE hFileMapping_;
+#endif
     void *baseAddress_;
+    size_t size_;
+    USharedHeap heap_;
+    std::string posixName_;     //!< Linux下shm_open使用的名字,匿名时为空.
+    bool created_;
+    bool hugePages_;
 };
 
 
 
+//! 哈希表中的一项.
 struct Pair
 {
-    __int32 keyOffset;
-    __int32 dataOffset;
-    __int32 nextOffset;
+    volatile unsigned int hash; //!< 键的哈希值,0表示空.其它字段写好后才写入.
+    volatile ULock::Word version;   //!< 写入值时加1,写入完成后再加1,奇数表示正在写入.
+    long long keyOffset;        //!< 键,格式见USharedMemory::newString,插入后不再改变.
+    long long valueOffset;      //!< 值的缓冲区.
+    int valueSize;              //!< 值的字节数.
+    int valueCapacity;          //!< 缓冲区的字节数,新的值放得下时原地写入.
+    volatile int type;          //!< USharedMemory::ValueType.
+    int reserved;
+};
+
+//! 共享内存中的事件.
+struct USharedEvent
+{
+    volatile ULock::Word state;     //!< 1表示有信号,等待者在这里挂起.
+    volatile ULock::Word waiters;   //!< 在state上挂起的等待者数,为0时通知不需要唤醒.
+    int mode;                       //!< USharedMemory::EventMode,创建后不再改变.
+    int reserved;
 };
 
-struct Event
+//! 开放定址的哈希表,线性探测.
+/*!
+    装满70%时分配两倍大的新表,旧表不释放,没有加锁的读者可能还在访问.
+    所有旧表的大小之和小于新表.
+*/
+struct PairTable
 {
-    __int32 keyOffset;
-    long __int32 event;
-    __int32 nextOffset;
+    unsigned int capacity;      //!< 2的幂.
+    unsigned int count;
+    long long previousOffset;   //!< 扩容前的表.
+    Pair pairs[1];
 };
 
 class USharedMemory
 {
 public:
+    //! 值的类型.
+    enum ValueType
+    {
+        NoValue,        //!< 键不存在.
+        StringValue,
+        IntValue,
+        DoubleValue,
+        BinaryValue,
+        EventValue      //!< 事件表中的值.
+    };
+
+    //! 事件的类型.
+    enum EventMode
+    {
+        AutoReset,      //!< 等待成功时清除信号,每次通知只唤醒一个等待者.
+        ManualReset     //!< 通知后唤醒所有等待者,直到ClearEvent.
+    };
+
+    //! snapshot中的一项.
+    struct Entry
+    {
+        std::wstring key;
+        ValueType type;
+        std::string data;   //!< 值的原始字节,用text转换为字符串.
+    };
+
+    //! 对共享内存中的锁字加锁,其他进程也可能在等待这个锁.
     class ScopedLock
     {
     public:
-        ScopedLock(volatile long __int32 *atomic)
+        ScopedLock(volatile ULock::Word *atomic)
             :atomic_(atomic)
         {
-            do 
-            {
-                long prev = InterlockedCompareExchange(atomic_,1,0);
-                if(*atomic_ == 1 && prev == 0)
-                {
-                    break;
-                }
-                if(!SwitchToThread())
-                {
-                    Sleep(1);
-                }
-            } while (true);
+            ULock::lockWord(atomic_,true);
         }
         ~ScopedLock()
         {
-            InterlockedCompareExchange(atomic_,0,1);
+            ULock::unlockWord(atomic_,true);
         }
-        volatile long __int32 *atomic_;
+        volatile ULock::Word *atomic_;
     };
     USharedMemory(UMemoryManager &memoryManager)
         :memoryManager_(memoryManager)
     {
         commu_ = reinterpret_cast<Commu *>(memoryManager.fixedMemory());
     }
-    void setData(const std::wstring &key, const std::wstring &data) 
-    {
-        ScopedLock lock(&commu_->lock);
-        Pair * pair = findPair(key);
-        if(pair)
-        {
-            setPair(pair,data);
-        }
-        else
-        {
-            addPair(key,data);
-        }
-    }
-    void setIntData(const std::wstring &key, int data) 
-    {
-        wchar_t buf[255] = L"";
-        _itow_s(data,buf,10);
-        setData(key,buf);
-    }
-    std::wstring data(const std::wstring &key) 
-    {
-        ScopedLock lock(&commu_->lock);
-        Pair *pair = findPair(key);
-        if(pair)
-        {
-            return getStringByAddress(((__int64)pair)+pair->dataOffset);
-        }
-        return std::wstring();
-    }
-    int intData(const std::wstring &key) 
-    {  
-        return _wtoi(data(key).c_str());
-    }
-    void WaitEvent(const std::wstring &event) 
-    {
-        volatile long *eventAtom = getEvent(event);
-        do 
-        {
-            long prev = InterlockedCompareExchange(eventAtom,0,1);
-            if(*eventAtom == 0 && prev == 1)
-            {
-                break;
-            }
-            if(!SwitchToThread())
-            {
-                Sleep(1);
-            }
-        } while (true);
-    }
+    //! 关闭等待用的信号量.
+    ~USharedMemory();
 
-    void NotifyEvent(const std::wstring &event) 
-    {
-        volatile long *eventAtom = getEvent(event);
-        InterlockedCompareExchange(eventAtom,1,0);
-    }
-    bool WaitEvent(const std::wstring &event, int waitTime)
-    {
-        volatile long *eventAtom = getEvent(event);
-        int startTime = GetTickCount();
-        do
-        {
-            long prev = InterlockedCompareExchange(eventAtom,0,1);
-            if(*eventAtom == 0 && prev == 1)
-            {
-                return true;
-            }
-            if(GetTickCount() - startTime >= waitTime)
-            {
-                return false;
-            }
-            if(!SwitchToThread())
-            {
-                Sleep(1);
-            }
-        } while (true);
-        return false;
-    }
-    bool WaitEvent(const std::wstring &event, bool(*canExit)()) 
-    {
-        volatile long *eventAtom = getEvent(event);
-        int startTime = GetTickCount();
-        do 
-        {
-            long prev = InterlockedCompareExchange(eventAtom,0,1);
-            if(*eventAtom == 0 && prev == 1)
-            {
-                return true;
-            }
-            if(canExit())
-            {
-                return false;
-            }
-            if(!SwitchToThread())
-            {
-                Sleep(1);
-            }
-        } while (true);
-        return false;
-    }
+    //! 写入字符串.
+    /*!
+        \return 共享内存不够时返回false.
+    */
+    bool setData(const std::wstring &key, const std::wstring &data);
+    //! 写入整数,data读取时转换为十进制.
+    bool setIntData(const std::wstring &key, int data);
+    //! 写入浮点数,data读取时转换为十进制.
+    bool setDoubleData(const std::wstring &key, double data);
+    //! 写入二进制数据.
+    bool setBinaryData(const std::wstring &key, const void *data, int size);
 
-    volatile long *getEvent(const std::wstring &key)
-    {
-        ScopedLock lock(&commu_->lock);
-        __int64 currentAddress = (__int64)&commu_->eventOffset;
-        __int32 nextOffset = commu_->eventOffset;
-        while(nextOffset)
-        {
-            currentAddress = currentAddress + nextOffset;
-            if(getStringByAddress(currentAddress + ((Event *)currentAddress)->keyOffset)
-                == key)
-            {
-                return &(((Event *)currentAddress)->event);
-            }
-            nextOffset = ((Event*)currentAddress)->nextOffset;
-        }
+    //! 读取字符串,整数和浮点数转换为十进制,键不存在或者是二进制数据时返回空字符串.
+    std::wstring data(const std::wstring &key);
+    //! 读取整数,字符串按十进制解析.
+    int intData(const std::wstring &key);
+    //! 读取浮点数,字符串按十进制解析.
+    double doubleData(const std::wstring &key);
+    //! 读取值的原始字节.
+    /*!
+        \return 键不存在时返回false.
+    */
+    bool binaryData(const std::wstring &key, std::string &data);
+    //! 值的类型,键不存在时返回NoValue.
+    ValueType valueType(const std::wstring &key);
+    //! 键的个数.
+    size_t size();
 
-        // Create a new event.
-        __int64 address = memoryManager_.allocMemory(sizeof(Event));
-        int keyAddress = newString(key);
-        ((Event *)address)->keyOffset = keyAddress - address;
-        ((Event *)address)->event = 0;
-        ((Event *)address)->nextOffset = 0;
-        if(currentAddress == (__int64)&commu_->eventOffset)
-        {
-            commu_->eventOffset = address - currentAddress;
-        }
-        else
-        {
-            ((Event *)currentAddress)->nextOffset = address - currentAddress;
-        }
-        return &(((Event *)address)->event);
+    //! 一次复制所有的键值对,结果是某一时刻的状态.
+    /*!
+        不加锁读取,期间有写入时重新读取,多次失败后加锁读取.
+    */
+    std::vector<Entry> snapshot();
 
-    }
+    //! 把值的原始字节转换为字符串,同data.
+    static std::wstring text(ValueType type,const std::string &data);
 
-    __int64 newString(const std::wstring &key) 
-    {
-        int allocSize = key.length()*sizeof(wchar_t)+sizeof(__int32);
-        __int64 address = memoryManager_.allocMemory(allocSize);
-        *(__int32 *)address = key.length();
-        memcpy_s(reinterpret_cast<void *>(address+sizeof(__int32)),allocSize-sizeof(__int32),key.c_str(),key.length()*sizeof(wchar_t));
-        return address;
-    }
-    std::wstring getStringByAddress(__int64 address)
+    //! 等待事件,直到有信号.
+    void WaitEvent(const std::wstring &event);
+    //! 通知事件.
+    void NotifyEvent(const std::wstring &event);
+    //! 等待事件,最多等待waitTime毫秒,waitTime小于0时一直等待.
+    /*!
+        \return 超时返回false.
+    */
+    bool WaitEvent(const std::wstring &event, int waitTime);
+    //! 等待事件,每隔PredicateInterval毫秒调用一次canExit.
+    /*!
+        \return canExit返回true时返回false.
+    */
+    bool WaitEvent(const std::wstring &event, bool(*canExit)());
+    //! 等待多个事件中的任何一个,最多等待waitTime毫秒,waitTime小于0时一直等待.
+    /*!
+        \return 有信号的事件的下标,自动重置的事件的信号已被清除.超时返回-1.
+    */
+    int WaitAnyEvent(const std::vector<std::wstring> &events, int waitTime);
+    //! 清除事件的信号,用于手动重置的事件.
+    void ClearEvent(const std::wstring &event);
+    //! 指定类型创建事件,getEvent创建的都是自动重置的事件.
+    /*!
+        \return 事件已经存在且类型不同,或者共享内存不够时返回false.
+    */
+    bool createEvent(const std::wstring &event, EventMode mode);
+
+    //! 带谓词的WaitEvent检查谓词的间隔.
+    enum {PredicateInterval = 10};
+
+    //! 事件的地址,不存在时创建.
+    volatile ULock::Word *getEvent(const std::wstring &key);
+
+    //! 事件,不存在时按mode创建.频繁使用的事件可以保存返回值,不用每次按名字查找.
+    USharedEvent *findOrCreateEvent(const std::wstring &key,EventMode mode);
+    //! 通知事件.
+    void notifyEvent(USharedEvent *event);
+    //! 等待一个事件,timeout为微秒,小于0时一直等待.canExit不为0时每隔PredicateInterval检查一次.
+    bool waitEvent(USharedEvent *event,long long timeout,bool(*canExit)() = 0);
+
+    //! 分配字符串,开头是int类型的长度,之后是不以0结尾的字符.
+    long long newString(const std::wstring &key);
+    std::wstring getStringByAddress(long long address)
     {
-        __int32 size = *(__int32 *)address;
+        int size = *(int *)address;
         std::wstring result;
-        result.assign((const wchar_t *)(address+sizeof(__int32)),size);
+        result.assign((const wchar_t *)(address+sizeof(int)),size);
         return result;
     }
-    Pair *findPair(const std::wstring &key)
-    {
-        __int64 currentAddress = (__int64)&commu_->pairOffset;
-        __int32 nextOffset = commu_->pairOffset;
-        while(nextOffset)
-        {
-            currentAddress = currentAddress + nextOffset;
-            if(getStringByAddress(currentAddress + ((Pair *)currentAddress)->keyOffset)
-                == key)
-            {
-                return (Pair *)currentAddress;
-            }
-            nextOffset = ((Pair*)currentAddress)->nextOffset;
-        }
+    //! 查找键,不存在时返回0.
+    Pair *findPair(const std::wstring &key);
 
-        return 0;
-    }
-    void addPair(const std::wstring &key, const std::wstring &data)
-    {
-        __int64 currentAddress = (__int64)&commu_->pairOffset;
-        __int64 newPair = memoryManager_.allocMemory(sizeof(Pair));
-        ((Pair *)newPair)->keyOffset = newString(key) - newPair;
-        ((Pair *)newPair)->dataOffset = newString(data) - newPair;
-        ((Pair *)newPair)->nextOffset = 0;
-        if(commu_->pairOffset)
-        {
-            ((Pair *)newPair)->nextOffset = currentAddress +commu_->pairOffset-newPair;
-        }
-        commu_->pairOffset = newPair - currentAddress;
-    }
-    void setPair(Pair *pair,const std::wstring &data)
-    {
-        memoryManager_.freeMemory((__int64)pair+pair->dataOffset);
-        pair->dataOffset = newString(data) - (__int64)pair;
-    }
     Commu *commu_;
     UMemoryManager &memoryManager_;
 private:
     USharedMemory(const USharedMemory &);
     USharedMemory &operator = (const USharedMemory &);
+
+    long long address(long long offset) const
+    {
+        return reinterpret_cast<long long>(commu_) + offset;
+    }
+    long long offset(long long address) const
+    {
+        return address - reinterpret_cast<long long>(commu_);
+    }
+    PairTable *table(long long tableOffset) const
+    {
+        return tableOffset ? reinterpret_cast<PairTable *>(address(tableOffset)) : 0;
+    }
+    //! 在tableOffset指向的表中查找.
+    Pair *findPair(long long tableOffset,const std::wstring &key,unsigned int hash) const;
+    //! 查找键,不存在时插入,需要加锁.
+    Pair *findOrInsertPair(long long &tableOffset,const std::wstring &key);
+    //! 扩容到capacity,需要加锁.
+    bool growTable(long long &tableOffset,unsigned int capacity);
+    //! 写入值,需要加锁.
+    bool setValue(const std::wstring &key,ValueType type,const void *data,int size);
+    //! 不加锁读取值的类型和原始字节.
+    ValueType value(const std::wstring &key,std::string &data);
+    //! 读取一项,读取期间有写入时返回false.
+    bool readPair(const Pair &pair,ValueType &type,std::string &data) const;
+    //! 复制表中所有的项,sequence为读取前的Commu::sequence.
+    bool readAll(std::vector<Entry> &entries,ULock::Word sequence);
+
+    //! 键的哈希值,不为0.
+    static unsigned int hashKey(const std::wstring &key);
+    //! 比较表中的键,不构造字符串.
+    bool keyEquals(const Pair &pair,const std::wstring &key) const;
+
+    //! 让出时间片.
+    static void yield();
+
+    //! word仍然是value时挂起,最多timeout微秒,小于0时不限时间.可能会无故返回.
+    /*!
+        \param waiters 挂起期间加1,通知者看到0时不需要唤醒.
+    */
+    void waitWord(volatile ULock::Word *word,volatile ULock::Word *waiters,ULock::Word value,long long timeout);
+    //! 唤醒在word上挂起的等待者,包括其它进程中的.waiters为通知者看到的等待者数.
+    void wakeWord(volatile ULock::Word *word,ULock::Word waiters,bool all);
+
+#ifdef _WIN32
+    //! word对应的命名信号量,第一次使用时创建或打开,析构时关闭.失败时返回NULL.
+    HANDLE waitObject(volatile ULock::Word *word);
+
+    std::map<long long,HANDLE> waitObjects_;   //!< 按word的偏移保存.
+    ULock waitObjectsLock_;
+#endif
 };
 
 }//namespace uni
 
-#endif//UNICORE_USHAREDMEMORY_H
\ No newline at end of file
+#endif//UNICORE_USHAREDMEMORY_H
@@ -0,0 +1,514 @@
+﻿#include "USharedRingBuffer.h"
+
+#include <string.h>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include "Windows.h"
+#else
+#include <sched.h>
+#include <time.h>
+#endif
+
+using namespace std;
+
+namespace uni
+{
+
+namespace
+{
+    const unsigned int USharedRingMagic = 0x474E5255;   // "URNG"
+    const unsigned int MinCapacity = 0x100;
+    const unsigned int MaxCapacity = 0x40000000;
+    //! 按顺序提交和释放时,让出时间片之前自旋的次数.
+    const int SpinCount = 100;
+    //! 一批记录不超过这么多条时,位置保存在栈上.
+    const int LocalRecords = 16;
+
+    static_assert(sizeof(USharedRingHeader) % USharedRingHeader::CacheLine == 0,"USharedRingHeader的大小必须是缓存行的倍数.");
+    static_assert(sizeof(USharedRecordHeader) == USharedRingBuffer::RecordAlignment,"记录头的大小必须是RecordAlignment.");
+
+    long long load64(const volatile long long *position)
+    {
+#if defined(_WIN64)
+        return *position;
+#elif defined(_WIN32)
+        return InterlockedCompareExchange64(const_cast<volatile LONGLONG *>(position),0,0);
+#else
+        return __atomic_load_n(position,__ATOMIC_ACQUIRE);
+#endif
+    }
+
+    //! 带完整的内存屏障,之后读取等待者数不会被提前.
+    void store64(volatile long long *position,long long value)
+    {
+#ifdef _WIN32
+        InterlockedExchange64(position,value);
+#else
+        __atomic_store_n(position,value,__ATOMIC_SEQ_CST);
+#endif
+    }
+
+    bool compareExchange64(volatile long long *position,long long value,long long comparand)
+    {
+#ifdef _WIN32
+        return InterlockedCompareExchange64(position,value,comparand) == comparand;
+#else
+        return __atomic_compare_exchange_n(position,&comparand,value,false,__ATOMIC_SEQ_CST,__ATOMIC_SEQ_CST);
+#endif
+    }
+
+    void addWaiters(volatile ULock::Word *waiters,ULock::Word delta)
+    {
+#ifdef _WIN32
+        InterlockedExchangeAdd(waiters,delta);
+#else
+        __atomic_add_fetch(waiters,delta,__ATOMIC_SEQ_CST);
+#endif
+    }
+
+    void cpuPause()
+    {
+#ifdef _WIN32
+        YieldProcessor();
+#elif defined(__i386__) || defined(__x86_64__)
+        __builtin_ia32_pause();
+#else
+        __asm__ __volatile__("" ::: "memory");
+#endif
+    }
+
+    void yieldThread()
+    {
+#ifdef _WIN32
+        if(!SwitchToThread())
+        {
+            Sleep(0);
+        }
+#else
+        sched_yield();
+#endif
+    }
+
+    long long microseconds()
+    {
+#ifdef _WIN32
+        LARGE_INTEGER frequency;
+        LARGE_INTEGER counter;
+        QueryPerformanceFrequency(&frequency);
+        QueryPerformanceCounter(&counter);
+        return counter.QuadPart / frequency.QuadPart * 1000000
+            + counter.QuadPart % frequency.QuadPart * 1000000 / frequency.QuadPart;
+#else
+        timespec now;
+        clock_gettime(CLOCK_MONOTONIC,&now);
+        return static_cast<long long>(now.tv_sec) * 1000000 + now.tv_nsec / 1000;
+#endif
+    }
+
+    //! waitTime毫秒后的时刻,小于0表示不限时间.
+    long long deadlineOf(int waitTime)
+    {
+        return waitTime < 0 ? -1 : microseconds() + waitTime * 1000LL;
+    }
+
+    //! 距离deadline的微秒数,不限时间时返回-1.
+    long long remainingTime(long long deadline)
+    {
+        if(deadline < 0)
+        {
+            return -1;
+        }
+        const long long remaining = deadline - microseconds();
+        return remaining > 0 ? remaining : 0;
+    }
+
+    //! 包括记录头,按RecordAlignment对齐的字节数.
+    long long recordBytes(int size)
+    {
+        return (sizeof(USharedRecordHeader) + size + USharedRingBuffer::RecordAlignment - 1)
+            & ~static_cast<long long>(USharedRingBuffer::RecordAlignment - 1);
+    }
+
+    wstring ringKey(const wstring &name)
+    {
+        return L"USharedRingBuffer/" + name;
+    }
+}
+
+USharedRingBuffer::USharedRingBuffer( USharedMemory &sharedMemory,const std::wstring &name,unsigned int capacity,Mode mode )
+    :sharedMemory_(sharedMemory)
+    ,header_(0)
+    ,dataEvent_(0)
+    ,spaceEvent_(0)
+    ,cachedRelease_(0)
+    ,cachedCommit_(0)
+{
+    if(open(name))
+    {
+        return;
+    }
+    if(capacity > MaxCapacity)
+    {
+        return;
+    }
+    unsigned int size = MinCapacity;
+    while(size < capacity)
+    {
+        size <<= 1;
+    }
+    //多分配一个缓存行,用来对齐.
+    const long long bytes = sizeof(USharedRingHeader) + size + USharedRingHeader::CacheLine;
+    if(bytes > 0x7FFFFFFF)
+    {
+        return;
+    }
+    UMemoryManager &memoryManager = sharedMemory_.memoryManager_;
+    const long long address = memoryManager.allocMemory(static_cast<int>(bytes));
+    if(!address)
+    {
+        return;
+    }
+    const long long aligned = (address + USharedRingHeader::CacheLine - 1) & ~static_cast<long long>(USharedRingHeader::CacheLine - 1);
+    USharedRingHeader *header = reinterpret_cast<USharedRingHeader *>(aligned);
+    memset(header,0,sizeof(*header));
+    header->magic = USharedRingMagic;
+    header->mode = mode;
+    header->capacity = size;
+
+    const long long offset = aligned - memoryManager.fixedMemory();
+    if(!sharedMemory_.setBinaryData(ringKey(name),&offset,sizeof(offset)))
+    {
+        memoryManager.freeMemory(address);
+        return;
+    }
+    header_ = header;
+    openEvents(name);
+}
+
+USharedRingBuffer::USharedRingBuffer( USharedMemory &sharedMemory,const std::wstring &name )
+    :sharedMemory_(sharedMemory)
+    ,header_(0)
+    ,dataEvent_(0)
+    ,spaceEvent_(0)
+    ,cachedRelease_(0)
+    ,cachedCommit_(0)
+{
+    open(name);
+}
+
+bool USharedRingBuffer::open( const std::wstring &name )
+{
+    string bytes;
+    long long offset = 0;
+    if(!sharedMemory_.binaryData(ringKey(name),bytes) || bytes.size() != sizeof(offset))
+    {
+        return false;
+    }
+    memcpy(&offset,bytes.data(),sizeof(offset));
+    USharedRingHeader *header = reinterpret_cast<USharedRingHeader *>(sharedMemory_.memoryManager_.fixedMemory() + offset);
+    if(header->magic != USharedRingMagic || header->capacity < MinCapacity
+        || (header->capacity & (header->capacity - 1)))
+    {
+        return false;
+    }
+    header_ = header;
+    openEvents(name);
+    return header_ != 0;
+}
+
+void USharedRingBuffer::openEvents( const std::wstring &name )
+{
+    dataEvent_ = sharedMemory_.findOrCreateEvent(ringKey(name) + L"/data",USharedMemory::AutoReset);
+    spaceEvent_ = sharedMemory_.findOrCreateEvent(ringKey(name) + L"/space",USharedMemory::AutoReset);
+    if(!dataEvent_ || !spaceEvent_)
+    {
+        header_ = 0;
+    }
+}
+
+int USharedRingBuffer::maxRecordSize() const
+{
+    //一条记录不超过一半,加上填充也不会超过整个环.
+    return static_cast<int>(header_->capacity / 2 - sizeof(USharedRecordHeader));
+}
+
+bool USharedRingBuffer::reserve( const int *sizes,int count,void **records,USharedRingRange &range,int waitTime )
+{
+    if(!header_ || count <= 0)
+    {
+        return false;
+    }
+    const int maxSize = maxRecordSize();
+    for(int i = 0; i < count; i++)
+    {
+        if(sizes[i] < 0 || sizes[i] > maxSize)
+        {
+            return false;
+        }
+    }
+    long long localPositions[LocalRecords];
+    vector<long long> positions;
+    long long *position = localPositions;
+    if(count > LocalRecords)
+    {
+        positions.resize(count);
+        position = &positions[0];
+    }
+
+    const bool single = header_->mode == Spsc;
+    const long long capacity = header_->capacity;
+    long long deadline = 0;
+    long long begin = 0;
+    long long end = 0;
+    for(int round = 0; ; round++)
+    {
+        begin = single ? header_->reservePos : load64(&header_->reservePos);
+        end = layout(begin,sizes,count,position);
+        if(end - begin > capacity)
+        {
+            return false;
+        }
+        if(single && end - cachedRelease_ > capacity)
+        {
+            cachedRelease_ = load64(&header_->releasePos);
+        }
+        const long long release = single ? cachedRelease_ : load64(&header_->releasePos);
+        if(end - release <= capacity)
+        {
+            if(single)
+            {
+                header_->reservePos = end;
+                break;
+            }
+            if(compareExchange64(&header_->reservePos,end,begin))
+            {
+                break;
+            }
+            continue;
+        }
+        if(!round)
+        {
+            deadline = deadlineOf(waitTime);
+        }
+        const long long remaining = remainingTime(deadline);
+        if(remaining == 0)
+        {
+            return false;
+        }
+        //先登记再检查,释放的一方先更新位置再检查等待者,不会漏掉通知.
+        addWaiters(&header_->spaceWaiters,1);
+        if(end - load64(&header_->releasePos) > capacity)
+        {
+            sharedMemory_.waitEvent(spaceEvent_,remaining);
+        }
+        addWaiters(&header_->spaceWaiters,-1);
+    }
+
+    long long previous = begin;
+    for(int i = 0; i < count; i++)
+    {
+        if(position[i] != previous)
+        {
+            USharedRecordHeader *padding = record(previous);
+            padding->size = static_cast<int>(position[i] - previous - sizeof(USharedRecordHeader));
+            padding->flags = PaddingFlag;
+        }
+        USharedRecordHeader *header = record(position[i]);
+        header->size = sizes[i];
+        header->flags = 0;
+        records[i] = header + 1;
+        previous = position[i] + recordBytes(sizes[i]);
+    }
+    range.begin = begin;
+    range.end = end;
+    //剩下的空间可能还够其它等待的生产者使用.
+    if(!single && header_->spaceWaiters)
+    {
+        sharedMemory_.notifyEvent(spaceEvent_);
+    }
+    return true;
+}
+
+void * USharedRingBuffer::reserve( int size,USharedRingRange &range,int waitTime )
+{
+    void *record = 0;
+    return reserve(&size,1,&record,range,waitTime) ? record : 0;
+}
+
+void USharedRingBuffer::commit( const USharedRingRange &range )
+{
+    waitTurn(&header_->commitPos,range.begin);
+    store64(&header_->commitPos,range.end);
+    if(header_->dataWaiters)
+    {
+        sharedMemory_.notifyEvent(dataEvent_);
+    }
+}
+
+int USharedRingBuffer::read( const void **records,int *sizes,int maxCount,USharedRingRange &range,int waitTime )
+{
+    if(!header_ || maxCount <= 0)
+    {
+        return 0;
+    }
+    const bool single = header_->mode == Spsc;
+    long long deadline = 0;
+    for(int round = 0; ; round++)
+    {
+        const long long begin = single ? header_->readPos : load64(&header_->readPos);
+        if(single && begin >= cachedCommit_)
+        {
+            cachedCommit_ = load64(&header_->commitPos);
+        }
+        const long long commit = single ? cachedCommit_ : load64(&header_->commitPos);
+        if(begin < commit)
+        {
+            int count = 0;
+            const long long end = scan(begin,commit,records,sizes,maxCount,count);
+            //其它消费者已经取走了begin,读到的记录头可能已经被覆盖.
+            if(end == begin)
+            {
+                continue;
+            }
+            if(single)
+            {
+                header_->readPos = end;
+            }
+            else if(!compareExchange64(&header_->readPos,end,begin))
+            {
+                continue;
+            }
+            range.begin = begin;
+            range.end = end;
+            if(!count)
+            {
+                //只有填充记录.
+                release(range);
+                continue;
+            }
+            if(!single && end < commit && header_->dataWaiters)
+            {
+                sharedMemory_.notifyEvent(dataEvent_);
+            }
+            return count;
+        }
+        if(!round)
+        {
+            deadline = deadlineOf(waitTime);
+        }
+        const long long remaining = remainingTime(deadline);
+        if(remaining == 0)
+        {
+            return 0;
+        }
+        addWaiters(&header_->dataWaiters,1);
+        if(load64(&header_->commitPos) <= load64(&header_->readPos))
+        {
+            sharedMemory_.waitEvent(dataEvent_,remaining);
+        }
+        addWaiters(&header_->dataWaiters,-1);
+    }
+}
+
+void USharedRingBuffer::release( const USharedRingRange &range )
+{
+    waitTurn(&header_->releasePos,range.begin);
+    store64(&header_->releasePos,range.end);
+    if(header_->spaceWaiters)
+    {
+        sharedMemory_.notifyEvent(spaceEvent_);
+    }
+}
+
+bool USharedRingBuffer::write( const void *data,int size,int waitTime )
+{
+    USharedRingRange range;
+    void *record = reserve(size,range,waitTime);
+    if(!record)
+    {
+        return false;
+    }
+    if(size)
+    {
+        memcpy(record,data,size);
+    }
+    commit(range);
+    return true;
+}
+
+bool USharedRingBuffer::read( std::string &record,int waitTime )
+{
+    const void *data = 0;
+    int size = 0;
+    USharedRingRange range;
+    if(!read(&data,&size,1,range,waitTime))
+    {
+        return false;
+    }
+    record.assign(static_cast<const char *>(data),size);
+    release(range);
+    return true;
+}
+
+long long USharedRingBuffer::layout( long long begin,const int *sizes,int count,long long *positions ) const
+{
+    const long long capacity = header_->capacity;
+    long long position = begin;
+    for(int i = 0; i < count; i++)
+    {
+        const long long bytes = recordBytes(sizes[i]);
+        const long long offset = position & (capacity - 1);
+        if(offset + bytes > capacity)
+        {
+            //放不下的部分用填充记录跳过.
+            position += capacity - offset;
+        }
+        positions[i] = position;
+        position += bytes;
+    }
+    return position;
+}
+
+long long USharedRingBuffer::scan( long long begin,long long end,const void **records,int *sizes,int maxCount,int &count ) const
+{
+    long long position = begin;
+    count = 0;
+    while(position < end && count < maxCount)
+    {
+        const USharedRecordHeader *header = record(position);
+        const int size = header->size;
+        const int flags = header->flags;
+        if(size < 0 || size > static_cast<int>(header_->capacity) || position + recordBytes(size) > end)
+        {
+            count = 0;
+            return begin;
+        }
+        if(!(flags & PaddingFlag))
+        {
+            records[count] = header + 1;
+            sizes[count] = size;
+            count++;
+        }
+        position += recordBytes(size);
+    }
+    return position;
+}
+
+void USharedRingBuffer::waitTurn( volatile long long *position,long long expected )
+{
+    for(int round = 0; load64(position) != expected; round++)
+    {
+        if(round < SpinCount)
+        {
+            cpuPause();
+        }
+        else
+        {
+            yieldThread();
+        }
+    }
+}
+
+}//namespace uni
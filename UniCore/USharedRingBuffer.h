@@ -0,0 +1,180 @@
+﻿/*! \file USharedRingBuffer.h
+    \brief 共享内存中的环形缓冲区,用于进程间大量传递数据.
+
+    环放在UMemoryManager分配的共享内存中,位置以相对fixedMemory的偏移按名字保存在USharedMemory里,
+    其它进程按名字打开.
+
+    - 记录是变长的,开头是8字节的USharedRecordHeader,整条记录按8字节对齐,不会跨过环的结尾,
+      放不下时先写一条填充记录.
+    - 生产者和消费者各有两个位置,都是只增不减的64位字节数,各占一个缓存行:
+      生产者先预留(reservePos),写完后提交(commitPos);消费者先取得(readPos),用完后释放(releasePos).
+      [releasePos,readPos)正在被消费者使用,[readPos,commitPos)可以读取,[commitPos,reservePos)正在写入.
+    - 预留和读取都可以一次处理多条记录,一批记录是连续的,只需要一次原子操作.
+      写入和读取都直接在共享内存中进行,不复制.
+    - Spsc模式只允许一个生产者和一个消费者,位置直接写入,还缓存了对方的位置.
+      Mpmc模式用比较交换预留和读取,提交和释放按位置的顺序进行,前面的批次没有提交(释放)时等待.
+    - 空的时候消费者在USharedMemory的事件上挂起,满的时候生产者也一样.
+      只有登记了等待者才通知,没有等待者时读写不需要系统调用.
+
+    \author unigauldoth@gmail.com
+    \date       2026-10-18
+*/
+#ifndef UNICORE_USHAREDRINGBUFFER_H
+#define UNICORE_USHAREDRINGBUFFER_H
+
+#include <string>
+
+#include "USharedMemory.h"
+
+namespace uni
+{
+
+//! 记录头.
+struct USharedRecordHeader
+{
+    int size;       //!< 数据的字节数,不包括记录头.
+    int flags;      //!< USharedRingBuffer::PaddingFlag表示填充记录.
+};
+
+//! 环的头部,放在数据前面,按缓存行对齐.
+struct USharedRingHeader
+{
+    enum {CacheLine = 64};
+
+    unsigned int magic;             //!< 固定为'URNG'.
+    int mode;                       //!< USharedRingBuffer::Mode.
+    unsigned int capacity;          //!< 数据的字节数,2的幂.
+    unsigned int reserved;
+    char pad0[CacheLine - 16];
+    volatile long long reservePos;  //!< 生产者预留到的位置.
+    char pad1[CacheLine - 8];
+    volatile long long commitPos;   //!< 之前的记录都已经提交.
+    char pad2[CacheLine - 8];
+    volatile long long readPos;     //!< 消费者取得到的位置.
+    char pad3[CacheLine - 8];
+    volatile long long releasePos;  //!< 之前的空间都已经释放.
+    char pad4[CacheLine - 8];
+    volatile ULock::Word dataWaiters;   //!< 等待数据的消费者数.
+    volatile ULock::Word spaceWaiters;  //!< 等待空间的生产者数.
+    char pad5[CacheLine - 2 * sizeof(ULock::Word)];
+};
+
+//! 一批连续的记录在环中的位置[begin,end).
+struct USharedRingRange
+{
+    long long begin;
+    long long end;
+};
+
+//! 共享内存中的环形缓冲区.
+/*!
+    \code
+    //生产者.
+    USharedRingBuffer ring(sharedMemory,L"capture",0x1000000,USharedRingBuffer::Spsc);
+    USharedRingRange range;
+    void *packet = ring.reserve(size,range,-1);
+    memcpy(packet,data,size);
+    ring.commit(range);
+
+    //消费者.
+    USharedRingBuffer ring(sharedMemory,L"capture");
+    const void *records[64];
+    int sizes[64];
+    const int count = ring.read(records,sizes,64,range,-1);
+    ...
+    ring.release(range);
+    \endcode
+
+    Mpmc模式下提交之前不能再预留,释放之前不能再读取,否则可能互相等待.
+    环占用的共享内存不会释放.
+*/
+class USharedRingBuffer
+{
+public:
+    //! 生产者和消费者的个数.
+    enum Mode
+    {
+        Spsc,   //!< 一个生产者,一个消费者.
+        Mpmc    //!< 多个生产者,多个消费者.
+    };
+    enum
+    {
+        PaddingFlag = 1,
+        RecordAlignment = 8
+    };
+
+    //! 打开名字为name的环,不存在时创建.
+    /*!
+        \param capacity 数据的字节数,向上取整为2的幂.打开已有的环时忽略capacity和mode.
+        同一个名字只能由一个进程创建.
+    */
+    USharedRingBuffer(USharedMemory &sharedMemory,const std::wstring &name,unsigned int capacity,Mode mode);
+    //! 打开已有的环,不存在时isValid返回false.
+    USharedRingBuffer(USharedMemory &sharedMemory,const std::wstring &name);
+
+    bool isValid() const {return header_ != 0;}
+    Mode mode() const {return static_cast<Mode>(header_->mode);}
+    unsigned int capacity() const {return header_->capacity;}
+    //! 一条记录最多的字节数.
+    int maxRecordSize() const;
+
+    //! 预留count条记录的空间,第i条sizes[i]字节,写入的位置保存在records[i]中.
+    /*!
+        \param waitTime 空间不够时最多等待的毫秒数,小于0时一直等待.
+        \return 超时,或者这批记录比环还大时返回false.
+    */
+    bool reserve(const int *sizes,int count,void **records,USharedRingRange &range,int waitTime = 0);
+    //! 预留一条记录,失败时返回0.
+    void *reserve(int size,USharedRingRange &range,int waitTime = 0);
+    //! 提交预留的记录,之后消费者可以读取.
+    void commit(const USharedRingRange &range);
+
+    //! 读取最多maxCount条记录,记录的位置和大小保存在records和sizes中.
+    /*!
+        \param waitTime 没有记录时最多等待的毫秒数,小于0时一直等待.
+        \return 读到的记录数,超时返回0.
+    */
+    int read(const void **records,int *sizes,int maxCount,USharedRingRange &range,int waitTime = 0);
+    //! 释放读取的记录,之后生产者可以重用这些空间.
+    void release(const USharedRingRange &range);
+
+    //! 复制写入一条记录.
+    bool write(const void *data,int size,int waitTime = 0);
+    //! 复制读取一条记录.
+    bool read(std::string &record,int waitTime = 0);
+
+private:
+    USharedRingBuffer(const USharedRingBuffer &);
+    USharedRingBuffer &operator=(const USharedRingBuffer &);
+
+    //! 按名字查找并检查环.
+    bool open(const std::wstring &name);
+    //! 打开环的事件.
+    void openEvents(const std::wstring &name);
+
+    char *data() const
+    {
+        return reinterpret_cast<char *>(header_ + 1);
+    }
+    USharedRecordHeader *record(long long position) const
+    {
+        return reinterpret_cast<USharedRecordHeader *>(data() + (position & (header_->capacity - 1)));
+    }
+    //! 从begin开始排列count条记录,返回结束的位置,positions保存每条记录的位置.
+    long long layout(long long begin,const int *sizes,int count,long long *positions) const;
+    //! 尝试在[begin,end)中取得最多maxCount条记录,返回结束的位置,没有可读的记录时返回begin.
+    long long scan(long long begin,long long end,const void **records,int *sizes,int maxCount,int &count) const;
+    //! 等待position变为expected,用于按顺序提交和释放.
+    static void waitTurn(volatile long long *position,long long expected);
+
+    USharedMemory &sharedMemory_;
+    USharedRingHeader *header_;
+    USharedEvent *dataEvent_;       //!< 提交后有消费者在等待时通知.
+    USharedEvent *spaceEvent_;      //!< 释放后有生产者在等待时通知.
+    long long cachedRelease_;       //!< Spsc模式下生产者看到的releasePos.
+    long long cachedCommit_;        //!< Spsc模式下消费者看到的commitPos.
+};
+
+}//namespace uni
+
+#endif//UNICORE_USHAREDRINGBUFFER_H
@@ -0,0 +1,247 @@
+﻿/*! \file UStringView.h
+    \brief 不拥有数据的字符串片段.
+
+    UStringView/UWStringView只保存指针和长度,复制和取子串都不分配内存,
+    适合在解析时代替临时的std::string/std::wstring.
+    片段不会延长原字符串的生命周期,原字符串被修改或销毁后片段就失效了.
+
+    \author unigauldoth@gmail.com
+    \date       2026-10-18
+*/
+#ifndef UNICORE_USTRINGVIEW_H
+#define UNICORE_USTRINGVIEW_H
+
+#include <algorithm>
+#include <iterator>
+#include <string>
+
+namespace uni
+{
+
+//! 字符串片段.
+template<typename Char>
+class UBasicStringView
+{
+public:
+    typedef Char value_type;
+    typedef const Char *const_iterator;
+    typedef std::basic_string<Char> string_type;
+    static const size_t npos = static_cast<size_t>(-1);
+
+    UBasicStringView():data_(0),size_(0) {}
+    UBasicStringView(const Char *data,size_t size):data_(data),size_(size) {}
+    //! 以0结尾的字符串.
+    UBasicStringView(const Char *s):data_(s),size_(s ? std::char_traits<Char>::length(s) : 0) {}
+    UBasicStringView(const string_type &s):data_(s.data()),size_(s.size()) {}
+
+    const Char *data() const {return data_;}
+    size_t size() const {return size_;}
+    size_t length() const {return size_;}
+    bool empty() const {return !size_;}
+    const_iterator begin() const {return data_;}
+    const_iterator end() const {return data_ + size_;}
+    Char operator[](size_t index) const {return data_[index];}
+    Char front() const {return data_[0];}
+    Char back() const {return data_[size_ - 1];}
+
+    //! 复制成std::basic_string.
+    string_type str() const {return string_type(data_,size_);}
+
+    //! 取子串,超出范围的部分会被截掉.
+    UBasicStringView substr(size_t pos,size_t count = npos) const
+    {
+        if(pos > size_)
+        {
+            pos = size_;
+        }
+        if(count > size_ - pos)
+        {
+            count = size_ - pos;
+        }
+        return UBasicStringView(data_ + pos,count);
+    }
+    void remove_prefix(size_t count) {data_ += count; size_ -= count;}
+    void remove_suffix(size_t count) {size_ -= count;}
+
+    bool starts_with(UBasicStringView s) const
+    {
+        return size_ >= s.size_ && std::char_traits<Char>::compare(data_,s.data_,s.size_) == 0;
+    }
+    bool ends_with(UBasicStringView s) const
+    {
+        return size_ >= s.size_
+            && std::char_traits<Char>::compare(data_ + size_ - s.size_,s.data_,s.size_) == 0;
+    }
+
+    //! 从pos开始查找s,找不到时返回npos.
+    size_t find(UBasicStringView s,size_t pos = 0) const
+    {
+        if(pos > size_ || s.size_ > size_ - pos)
+        {
+            return npos;
+        }
+        if(s.empty())
+        {
+            return pos;
+        }
+        const Char *last = data_ + size_ - s.size_;
+        for(const Char *p = data_ + pos; p <= last; p++)
+        {
+            //先用find定位第一个字符,它通常是memchr/wmemchr.
+            p = std::char_traits<Char>::find(p,last - p + 1,s.data_[0]);
+            if(!p)
+            {
+                return npos;
+            }
+            if(std::char_traits<Char>::compare(p + 1,s.data_ + 1,s.size_ - 1) == 0)
+            {
+                return p - data_;
+            }
+        }
+        return npos;
+    }
+    size_t find(Char c,size_t pos = 0) const
+    {
+        if(pos >= size_)
+        {
+            return npos;
+        }
+        const Char *p = std::char_traits<Char>::find(data_ + pos,size_ - pos,c);
+        return p ? p - data_ : npos;
+    }
+
+    int compare(UBasicStringView s) const
+    {
+        const int result = std::char_traits<Char>::compare(data_,s.data_,std::min(size_,s.size_));
+        if(result)
+        {
+            return result;
+        }
+        return size_ < s.size_ ? -1 : (size_ > s.size_ ? 1 : 0);
+    }
+    friend bool operator==(UBasicStringView a,UBasicStringView b)
+    {
+        return a.size_ == b.size_ && std::char_traits<Char>::compare(a.data_,b.data_,a.size_) == 0;
+    }
+    friend bool operator!=(UBasicStringView a,UBasicStringView b) {return !(a == b);}
+    friend bool operator<(UBasicStringView a,UBasicStringView b) {return a.compare(b) < 0;}
+private:
+    const Char *data_;
+    size_t size_;
+};
+
+template<typename Char>
+const size_t UBasicStringView<Char>::npos;
+
+typedef UBasicStringView<char> UStringView;
+typedef UBasicStringView<wchar_t> UWStringView;
+
+template<typename Char>
+std::basic_ostream<Char> &operator<<(std::basic_ostream<Char> &stm,UBasicStringView<Char> s)
+{
+    stm.write(s.data(),s.size());
+    return stm;
+}
+
+//! 按分隔符惰性分割字符串的范围.
+/*!
+    每次迭代只查找下一个分隔符,不分配内存.规则和split相同:
+    源字符串为空,分隔符为空,或者源字符串比分隔符短时,范围为空;
+    否则每遇到一个分隔符产生一个片段,空片段也会产生.
+    \code
+    USplitRange<char> range = split_view("a;b;;c",";");
+    for(USplitRange<char>::iterator it = range.begin(); it != range.end(); ++it)
+    {
+        //依次得到"a","b","","c".
+    }
+    \endcode
+*/
+template<typename Char>
+class USplitRange
+{
+public:
+    typedef UBasicStringView<Char> view_type;
+
+    class iterator : public std::iterator<std::forward_iterator_tag,view_type>
+    {
+    public:
+        iterator():position_(0),next_(view_type::npos),done_(true) {}
+        iterator(view_type source,view_type delim)
+            :source_(source),delim_(delim),position_(0),done_(false)
+        {
+            findPiece();
+        }
+        const view_type &operator*() const {return piece_;}
+        const view_type *operator->() const {return &piece_;}
+        iterator &operator++()
+        {
+            if(next_ == view_type::npos)
+            {
+                done_ = true;
+            }
+            else
+            {
+                position_ = next_;
+                findPiece();
+            }
+            return *this;
+        }
+        iterator operator++(int)
+        {
+            iterator old = *this;
+            ++*this;
+            return old;
+        }
+        friend bool operator==(const iterator &a,const iterator &b)
+        {
+            if(a.done_ || b.done_)
+            {
+                return a.done_ == b.done_;
+            }
+            return a.position_ == b.position_;
+        }
+        friend bool operator!=(const iterator &a,const iterator &b) {return !(a == b);}
+    private:
+        void findPiece()
+        {
+            const size_t delimPos = source_.find(delim_,position_);
+            if(delimPos == view_type::npos)
+            {
+                piece_ = source_.substr(position_);
+                next_ = view_type::npos;
+            }
+            else
+            {
+                piece_ = source_.substr(position_,delimPos - position_);
+                next_ = delimPos + delim_.size();
+            }
+        }
+        //! 迭代器自己保存源字符串和分隔符,范围对象是临时对象时迭代器仍然有效.
+        view_type source_;
+        view_type delim_;
+        size_t position_;   //!< 当前片段的起始位置.
+        size_t next_;       //!< 下一个片段的起始位置,没有下一个片段时为npos.
+        view_type piece_;
+        bool done_;
+    };
+    typedef iterator const_iterator;
+
+    USplitRange(view_type source,view_type delim):source_(source),delim_(delim) {}
+    iterator begin() const
+    {
+        if(source_.empty() || delim_.empty() || source_.size() < delim_.size())
+        {
+            return end();
+        }
+        return iterator(source_,delim_);
+    }
+    iterator end() const {return iterator();}
+    bool empty() const {return begin() == end();}
+private:
+    view_type source_;
+    view_type delim_;
+};
+
+}//namespace uni
+
+#endif//UNICORE_USTRINGVIEW_H
@@ -0,0 +1,526 @@
+﻿#include "UTranscode.h"
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define UNI_TRANSCODE_SSE2
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+namespace uni
+{
+
+namespace
+{
+    const UUtf32Unit InvalidCodePoint = 0xFFFFFFFF;
+
+    inline UUtf32Unit unitValue(char c) {return static_cast<unsigned char>(c);}
+    template<typename Unit>
+    inline UUtf32Unit unitValue(Unit c) {return static_cast<UUtf32Unit>(c);}
+
+    struct Utf8
+    {
+        //! 解码一个字符,p前进到下一个字符.无效时p只跳过最大的有效前缀,至少一个字节.
+        template<typename Unit>
+        static UUtf32Unit decode(const Unit *&p,const Unit *end)
+        {
+            const UUtf32Unit lead = unitValue(*p);
+            if(lead < 0x80)
+            {
+                p++;
+                return lead;
+            }
+            if(lead < 0xC2 || lead > 0xF4)
+            {
+                p++;
+                return InvalidCodePoint;
+            }
+            const int trailCount = lead < 0xE0 ? 1 : (lead < 0xF0 ? 2 : 3);
+            UUtf32Unit c = lead & (0x3F >> trailCount);
+            //第二个字节的范围受第一个字节限制,排除过长编码,代理项和超出U+10FFFF的值.
+            UUtf32Unit lower = 0x80;
+            UUtf32Unit upper = 0xBF;
+            if(lead == 0xE0)
+            {
+                lower = 0xA0;
+            }
+            else if(lead == 0xED)
+            {
+                upper = 0x9F;
+            }
+            else if(lead == 0xF0)
+            {
+                lower = 0x90;
+            }
+            else if(lead == 0xF4)
+            {
+                upper = 0x8F;
+            }
+            const Unit *q = p + 1;
+            for(int i = 0; i < trailCount; i++)
+            {
+                if(q == end)
+                {
+                    p = q;
+                    return InvalidCodePoint;
+                }
+                const UUtf32Unit trail = unitValue(*q);
+                if(trail < lower || trail > upper)
+                {
+                    p = q;
+                    return InvalidCodePoint;
+                }
+                c = (c << 6) | (trail & 0x3F);
+                lower = 0x80;
+                upper = 0xBF;
+                q++;
+            }
+            p = q;
+            return c;
+        }
+
+        static size_t encodedSize(UUtf32Unit c)
+        {
+            return c < 0x80 ? 1 : (c < 0x800 ? 2 : (c < 0x10000 ? 3 : 4));
+        }
+
+        template<typename Unit>
+        static void encode(UUtf32Unit c,Unit *out)
+        {
+            if(c < 0x80)
+            {
+                out[0] = static_cast<Unit>(c);
+            }
+            else if(c < 0x800)
+            {
+                out[0] = static_cast<Unit>(0xC0 | (c >> 6));
+                out[1] = static_cast<Unit>(0x80 | (c & 0x3F));
+            }
+            else if(c < 0x10000)
+            {
+                out[0] = static_cast<Unit>(0xE0 | (c >> 12));
+                out[1] = static_cast<Unit>(0x80 | ((c >> 6) & 0x3F));
+                out[2] = static_cast<Unit>(0x80 | (c & 0x3F));
+            }
+            else
+            {
+                out[0] = static_cast<Unit>(0xF0 | (c >> 18));
+                out[1] = static_cast<Unit>(0x80 | ((c >> 12) & 0x3F));
+                out[2] = static_cast<Unit>(0x80 | ((c >> 6) & 0x3F));
+                out[3] = static_cast<Unit>(0x80 | (c & 0x3F));
+            }
+        }
+    };
+
+    struct Utf16
+    {
+        template<typename Unit>
+        static UUtf32Unit decode(const Unit *&p,const Unit *end)
+        {
+            const UUtf32Unit high = unitValue(*p++);
+            if(high < 0xD800 || high > 0xDFFF)
+            {
+                return high;
+            }
+            if(high <= 0xDBFF && p != end)
+            {
+                const UUtf32Unit low = unitValue(*p);
+                if(low >= 0xDC00 && low <= 0xDFFF)
+                {
+                    p++;
+                    return 0x10000 + ((high - 0xD800) << 10) + (low - 0xDC00);
+                }
+            }
+            return InvalidCodePoint;
+        }
+
+        static size_t encodedSize(UUtf32Unit c)
+        {
+            return c < 0x10000 ? 1 : 2;
+        }
+
+        template<typename Unit>
+        static void encode(UUtf32Unit c,Unit *out)
+        {
+            if(c < 0x10000)
+            {
+                out[0] = static_cast<Unit>(c);
+            }
+            else
+            {
+                c -= 0x10000;
+                out[0] = static_cast<Unit>(0xD800 + (c >> 10));
+                out[1] = static_cast<Unit>(0xDC00 + (c & 0x3FF));
+            }
+        }
+    };
+
+    struct Utf32
+    {
+        template<typename Unit>
+        static UUtf32Unit decode(const Unit *&p,const Unit *)
+        {
+            const UUtf32Unit c = unitValue(*p++);
+            if(c > 0x10FFFF || (c >= 0xD800 && c <= 0xDFFF))
+            {
+                return InvalidCodePoint;
+            }
+            return c;
+        }
+
+        static size_t encodedSize(UUtf32Unit)
+        {
+            return 1;
+        }
+
+        template<typename Unit>
+        static void encode(UUtf32Unit c,Unit *out)
+        {
+            out[0] = static_cast<Unit>(c);
+        }
+    };
+
+    //! wchar_t对应的编码.
+    template<int Size>
+    struct WideEncoding;
+
+    template<>
+    struct WideEncoding<2>
+    {
+        typedef Utf16 Type;
+    };
+
+    template<>
+    struct WideEncoding<4>
+    {
+        typedef Utf32 Type;
+    };
+
+    typedef WideEncoding<sizeof(wchar_t)>::Type Wide;
+
+    template<int Size>
+    struct UnitSize
+    {
+    };
+
+#ifdef UNI_TRANSCODE_SSE2
+    inline int lowestBit(unsigned int mask)
+    {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanForward(&index,mask);
+        return static_cast<int>(index);
+#else
+        return __builtin_ctz(mask);
+#endif
+    }
+
+    inline __m128i load(const void *p)
+    {
+        return _mm_loadu_si128(static_cast<const __m128i *>(p));
+    }
+
+    inline void store(void *p,__m128i value)
+    {
+        _mm_storeu_si128(static_cast<__m128i *>(p),value);
+    }
+
+    //! 按16字节的块检查ASCII字符,返回检查过的单元数.
+    size_t asciiBlocks(const void *source,size_t size,UnitSize<1>)
+    {
+        const char *p = static_cast<const char *>(source);
+        size_t i = 0;
+        for(; i + 16 <= size; i += 16)
+        {
+            const unsigned int mask = _mm_movemask_epi8(load(p + i));
+            if(mask)
+            {
+                return i + lowestBit(mask);
+            }
+        }
+        return i;
+    }
+
+    size_t asciiBlocks(const void *source,size_t size,UnitSize<2>)
+    {
+        const char *p = static_cast<const char *>(source);
+        const __m128i nonAsciiBits = _mm_set1_epi16(static_cast<short>(0xFF80));
+        size_t i = 0;
+        for(; i + 8 <= size; i += 8)
+        {
+            const __m128i ascii = _mm_cmpeq_epi16(_mm_and_si128(load(p + i * 2),nonAsciiBits),_mm_setzero_si128());
+            const unsigned int mask = _mm_movemask_epi8(ascii) ^ 0xFFFF;
+            if(mask)
+            {
+                return i + lowestBit(mask) / 2;
+            }
+        }
+        return i;
+    }
+
+    size_t asciiBlocks(const void *source,size_t size,UnitSize<4>)
+    {
+        const char *p = static_cast<const char *>(source);
+        const __m128i nonAsciiBits = _mm_set1_epi32(static_cast<int>(0xFFFFFF80));
+        size_t i = 0;
+        for(; i + 4 <= size; i += 4)
+        {
+            const __m128i ascii = _mm_cmpeq_epi32(_mm_and_si128(load(p + i * 4),nonAsciiBits),_mm_setzero_si128());
+            const unsigned int mask = _mm_movemask_epi8(ascii) ^ 0xFFFF;
+            if(mask)
+            {
+                return i + lowestBit(mask) / 4;
+            }
+        }
+        return i;
+    }
+
+    //! 按16字节的块复制ASCII字符,返回复制的单元数.
+    size_t copyAsciiBlocks(const void *source,size_t size,void *dest,UnitSize<1>,UnitSize<2>)
+    {
+        const char *p = static_cast<const char *>(source);
+        char *out = static_cast<char *>(dest);
+        size_t i = 0;
+        for(; i + 16 <= size; i += 16)
+        {
+            const __m128i block = load(p + i);
+            store(out + i * 2,_mm_unpacklo_epi8(block,_mm_setzero_si128()));
+            store(out + i * 2 + 16,_mm_unpackhi_epi8(block,_mm_setzero_si128()));
+        }
+        return i;
+    }
+
+    size_t copyAsciiBlocks(const void *source,size_t size,void *dest,UnitSize<1>,UnitSize<4>)
+    {
+        const char *p = static_cast<const char *>(source);
+        char *out = static_cast<char *>(dest);
+        const __m128i zero = _mm_setzero_si128();
+        size_t i = 0;
+        for(; i + 16 <= size; i += 16)
+        {
+            const __m128i block = load(p + i);
+            const __m128i low = _mm_unpacklo_epi8(block,zero);
+            const __m128i high = _mm_unpackhi_epi8(block,zero);
+            store(out + i * 4,_mm_unpacklo_epi16(low,zero));
+            store(out + i * 4 + 16,_mm_unpackhi_epi16(low,zero));
+            store(out + i * 4 + 32,_mm_unpacklo_epi16(high,zero));
+            store(out + i * 4 + 48,_mm_unpackhi_epi16(high,zero));
+        }
+        return i;
+    }
+
+    size_t copyAsciiBlocks(const void *source,size_t size,void *dest,UnitSize<2>,UnitSize<1>)
+    {
+        const char *p = static_cast<const char *>(source);
+        char *out = static_cast<char *>(dest);
+        size_t i = 0;
+        for(; i + 16 <= size; i += 16)
+        {
+            store(out + i,_mm_packus_epi16(load(p + i * 2),load(p + i * 2 + 16)));
+        }
+        return i;
+    }
+
+    size_t copyAsciiBlocks(const void *source,size_t size,void *dest,UnitSize<4>,UnitSize<1>)
+    {
+        const char *p = static_cast<const char *>(source);
+        char *out = static_cast<char *>(dest);
+        size_t i = 0;
+        for(; i + 16 <= size; i += 16)
+        {
+            const __m128i low = _mm_packs_epi32(load(p + i * 4),load(p + i * 4 + 16));
+            const __m128i high = _mm_packs_epi32(load(p + i * 4 + 32),load(p + i * 4 + 48));
+            store(out + i,_mm_packus_epi16(low,high));
+        }
+        return i;
+    }
+#endif
+
+    //! 没有向量实现时交给逐个处理的循环.
+    template<typename Tag>
+    size_t asciiBlocks(const void *,size_t,Tag)
+    {
+        return 0;
+    }
+
+    template<typename SourceTag,typename DestTag>
+    size_t copyAsciiBlocks(const void *,size_t,void *,SourceTag,DestTag)
+    {
+        return 0;
+    }
+
+    template<typename Unit>
+    size_t asciiRun(const Unit *source,size_t size)
+    {
+        size_t i = asciiBlocks(source,size,UnitSize<sizeof(Unit)>());
+        while(i < size && unitValue(source[i]) < 0x80)
+        {
+            i++;
+        }
+        return i;
+    }
+
+    template<typename SourceUnit,typename DestUnit>
+    void copyAscii(const SourceUnit *source,size_t size,DestUnit *dest)
+    {
+        size_t i = copyAsciiBlocks(source,size,dest,UnitSize<sizeof(SourceUnit)>(),UnitSize<sizeof(DestUnit)>());
+        for(; i < size; i++)
+        {
+            dest[i] = static_cast<DestUnit>(source[i]);
+        }
+    }
+
+    //! 转换的主循环.
+    /*!
+        \param[out] errors 不为0时累加被替换的无效序列的个数.
+    */
+    template<typename From,typename To,typename SourceUnit,typename DestUnit>
+    size_t transcode(const SourceUnit *source,size_t size,DestUnit *dest,size_t destSize,size_t *errors)
+    {
+        const SourceUnit *p = source;
+        const SourceUnit *end = source + size;
+        size_t written = 0;
+        while(p != end)
+        {
+            if(unitValue(*p) < 0x80)
+            {
+                const size_t run = asciiRun(p,end - p);
+                if(dest)
+                {
+                    if(destSize - written < run)
+                    {
+                        return UTranscodeBufferTooSmall;
+                    }
+                    copyAscii(p,run,dest + written);
+                }
+                written += run;
+                p += run;
+                if(p == end)
+                {
+                    break;
+                }
+            }
+            UUtf32Unit c = From::decode(p,end);
+            if(c == InvalidCodePoint)
+            {
+                c = UReplacementCharacter;
+                if(errors)
+                {
+                    ++*errors;
+                }
+            }
+            const size_t encodedSize = To::encodedSize(c);
+            if(dest)
+            {
+                if(destSize - written < encodedSize)
+                {
+                    return UTranscodeBufferTooSmall;
+                }
+                To::encode(c,dest + written);
+            }
+            written += encodedSize;
+        }
+        return written;
+    }
+}
+
+size_t utf8ToUtf16( const char *source,size_t size,UUtf16Unit *dest,size_t destSize )
+{
+    return transcode<Utf8,Utf16>(source,size,dest,destSize,0);
+}
+
+size_t utf16ToUtf8( const UUtf16Unit *source,size_t size,char *dest,size_t destSize )
+{
+    return transcode<Utf16,Utf8>(source,size,dest,destSize,0);
+}
+
+size_t utf8ToUtf32( const char *source,size_t size,UUtf32Unit *dest,size_t destSize )
+{
+    return transcode<Utf8,Utf32>(source,size,dest,destSize,0);
+}
+
+size_t utf32ToUtf8( const UUtf32Unit *source,size_t size,char *dest,size_t destSize )
+{
+    return transcode<Utf32,Utf8>(source,size,dest,destSize,0);
+}
+
+size_t utf16ToUtf32( const UUtf16Unit *source,size_t size,UUtf32Unit *dest,size_t destSize )
+{
+    return transcode<Utf16,Utf32>(source,size,dest,destSize,0);
+}
+
+size_t utf32ToUtf16( const UUtf32Unit *source,size_t size,UUtf16Unit *dest,size_t destSize )
+{
+    return transcode<Utf32,Utf16>(source,size,dest,destSize,0);
+}
+
+size_t utf8ToWide( const char *source,size_t size,wchar_t *dest,size_t destSize )
+{
+    return transcode<Utf8,Wide>(source,size,dest,destSize,0);
+}
+
+size_t wideToUtf8( const wchar_t *source,size_t size,char *dest,size_t destSize )
+{
+    return transcode<Wide,Utf8>(source,size,dest,destSize,0);
+}
+
+std::wstring utf8ToWide( UStringView source )
+{
+    std::wstring result;
+    const size_t size = utf8ToWide(source.data(),source.size(),0,0);
+    if(size)
+    {
+        result.resize(size);
+        utf8ToWide(source.data(),source.size(),&result[0],size);
+    }
+    return result;
+}
+
+std::string wideToUtf8( UWStringView source )
+{
+    std::string result;
+    const size_t size = wideToUtf8(source.data(),source.size(),0,0);
+    if(size)
+    {
+        result.resize(size);
+        wideToUtf8(source.data(),source.size(),&result[0],size);
+    }
+    return result;
+}
+
+bool isValidUtf8( const char *source,size_t size )
+{
+    size_t errors = 0;
+    transcode<Utf8,Utf32>(source,size,static_cast<UUtf32Unit *>(0),0,&errors);
+    return !errors;
+}
+
+bool isValidUtf16( const UUtf16Unit *source,size_t size )
+{
+    size_t errors = 0;
+    transcode<Utf16,Utf32>(source,size,static_cast<UUtf32Unit *>(0),0,&errors);
+    return !errors;
+}
+
+size_t asciiPrefixLength( const char *source,size_t size )
+{
+    return asciiRun(source,size);
+}
+
+size_t asciiPrefixLength( const wchar_t *source,size_t size )
+{
+    return asciiRun(source,size);
+}
+
+void widenAscii( const char *source,size_t size,wchar_t *dest )
+{
+    copyAscii(source,size,dest);
+}
+
+void narrowAscii( const wchar_t *source,size_t size,char *dest )
+{
+    copyAscii(source,size,dest);
+}
+
+}//namespace uni
@@ -0,0 +1,99 @@
+﻿/*! \file UTranscode.h
+    \brief UTF-8,UTF-16,UTF-32之间的转换.
+
+    不依赖操作系统和CRT的locale,Windows和Linux下结果相同.
+    - 无效的序列(截断的多字节序列,过长编码,代理项,超出U+10FFFF的值)被替换为U+FFFD,
+      UTF-8中每个无效的最大子序列替换一次,和Unicode标准建议的做法以及WHATWG的编码标准一致.
+    - 支持SSE2时,连续的ASCII字符一次处理16个字节.
+    - 所有转换函数都可以只计算结果的长度,也可以写入调用者提供的缓冲区,都不分配内存.
+
+    wchar_t在Windows下是UTF-16,在Linux下是UTF-32,utf8ToWide和wideToUtf8会选择对应的编码.
+
+    \author unigauldoth@gmail.com
+    \date       2026-10-18
+*/
+#ifndef UNICORE_UTRANSCODE_H
+#define UNICORE_UTRANSCODE_H
+
+#include <string>
+
+#define AUTO_LINK_LIB_NAME "UniCore"
+#include "AutoLink.h"
+
+#include "UStringView.h"
+
+namespace uni
+{
+
+typedef unsigned short UUtf16Unit;  //!< UTF-16的代码单元.
+typedef unsigned int UUtf32Unit;    //!< UTF-32的代码单元.
+
+enum
+{
+    UReplacementCharacter = 0xFFFD  //!< 替换无效序列的字符.
+};
+
+//! 目标缓冲区不足时转换函数的返回值.
+const size_t UTranscodeBufferTooSmall = static_cast<size_t>(-1);
+
+//! UTF-8转换为UTF-16.
+/*!
+    \param source 源字符串,可以包含0.
+    \param size source的长度.
+    \param dest 目标缓冲区,为0时只计算转换结果的长度.
+    \param destSize dest能容纳的代码单元数.
+    \return 转换结果的代码单元数.dest不够大时返回UTranscodeBufferTooSmall,此时dest的内容不确定.
+*/
+size_t utf8ToUtf16(const char *source,size_t size,UUtf16Unit *dest,size_t destSize);
+
+//! UTF-16转换为UTF-8,参数和返回值同utf8ToUtf16.
+size_t utf16ToUtf8(const UUtf16Unit *source,size_t size,char *dest,size_t destSize);
+
+//! UTF-8转换为UTF-32,参数和返回值同utf8ToUtf16.
+size_t utf8ToUtf32(const char *source,size_t size,UUtf32Unit *dest,size_t destSize);
+
+//! UTF-32转换为UTF-8,参数和返回值同utf8ToUtf16.
+size_t utf32ToUtf8(const UUtf32Unit *source,size_t size,char *dest,size_t destSize);
+
+//! UTF-16转换为UTF-32,参数和返回值同utf8ToUtf16.
+size_t utf16ToUtf32(const UUtf16Unit *source,size_t size,UUtf32Unit *dest,size_t destSize);
+
+//! UTF-32转换为UTF-16,参数和返回值同utf8ToUtf16.
+size_t utf32ToUtf16(const UUtf32Unit *source,size_t size,UUtf16Unit *dest,size_t destSize);
+
+//! UTF-8转换为wchar_t字符串,参数和返回值同utf8ToUtf16.
+size_t utf8ToWide(const char *source,size_t size,wchar_t *dest,size_t destSize);
+
+//! wchar_t字符串转换为UTF-8,参数和返回值同utf8ToUtf16.
+size_t wideToUtf8(const wchar_t *source,size_t size,char *dest,size_t destSize);
+
+//! UTF-8转换为std::wstring.
+std::wstring utf8ToWide(UStringView source);
+
+//! std::wstring转换为UTF-8.
+std::string wideToUtf8(UWStringView source);
+
+//! source是否是有效的UTF-8.
+bool isValidUtf8(const char *source,size_t size);
+
+//! source是否是有效的UTF-16,即没有不成对的代理项.
+bool isValidUtf16(const UUtf16Unit *source,size_t size);
+
+//! 开头连续的ASCII字符的个数.
+/*!
+    支持SSE2时一次检查16个字节.
+*/
+size_t asciiPrefixLength(const char *source,size_t size);
+
+//! 开头连续的ASCII字符的个数.
+size_t asciiPrefixLength(const wchar_t *source,size_t size);
+
+//! 把size个ASCII字符扩展为wchar_t,source必须全部是ASCII字符.
+void widenAscii(const char *source,size_t size,wchar_t *dest);
+
+//! 把size个ASCII字符截断为char,source必须全部是ASCII字符.
+void narrowAscii(const wchar_t *source,size_t size,char *dest);
+
+}//namespace uni
+
+#endif//UNICORE_UTRANSCODE_H
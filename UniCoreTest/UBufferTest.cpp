@@ -3,6 +3,9 @@
 #include "gtest/gtest.h"
 #include "../UniCore/UBuffer.h"
 #include <iostream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <Windows.h>
 
 using namespace std;
 using namespace uni;
@@ -67,6 +70,23 @@ TEST_F(UBufferTest,data_StringContainsZero_DataRight)
     }
 }
 
+TEST_F(UBufferTest,data_AfterModifications_ZeroTerminated)
+{
+    EXPECT_STREQ("",buffer_->data());
+    buffer_->appendString("str",3);
+    EXPECT_STREQ("str",buffer_->data());
+    buffer_->appendString(string(UBuffer::InlineCapacity,'a').c_str(),UBuffer::InlineCapacity);
+    EXPECT_STREQ(("str" + string(UBuffer::InlineCapacity,'a')).c_str(),buffer_->data());
+    buffer_->skip(3);
+    buffer_->discardRead();
+    EXPECT_STREQ(string(UBuffer::InlineCapacity,'a').c_str(),buffer_->data());
+    memset(buffer_->prepare(10),'x',10);
+    buffer_->commit(2);
+    EXPECT_STREQ((string(UBuffer::InlineCapacity,'a') + "xx").c_str(),buffer_->data());
+    buffer_->clear();
+    EXPECT_STREQ("",buffer_->data());
+}
+
 
 
 TEST_F(UBufferTest,size_NoDataAppended_Returns0)
@@ -204,6 +224,122 @@ TEST_F(UBufferTest,appendHexPattern_LettersNotHexNumber_DataValid)
     }
 }
 
+namespace
+{
+    //! 原来逐个字符调用strtol的实现,用来验证新实现的结果.
+    string decodeHexPatternByStrtol(const string &pattern)
+    {
+        string result;
+        string word;
+        for(size_t i = 0; i < pattern.size(); i++)
+        {
+            if(isxdigit(static_cast<unsigned char>(pattern[i])))
+            {
+                word.push_back(pattern[i]);
+                if(word.size() == 2 || i == pattern.size() - 1)
+                {
+                    result.push_back(static_cast<char>(strtol(word.c_str(),0,16)));
+                    word.clear();
+                }
+            }
+            else if(!word.empty())
+            {
+                result.push_back(static_cast<char>(strtol(word.c_str(),0,16)));
+                word.clear();
+            }
+        }
+        return result;
+    }
+}
+
+TEST_F(UBufferTest,appendHexPattern_RandomPatterns_SameAsStrtol)
+{
+    const char characters[] = "0123456789abcdefABCDEF gG:|\n\x80\xFF";
+    srand(12345);
+    for(int i = 0; i < 10000; i++)
+    {
+        string pattern;
+        const int length = rand() % 80;
+        for(int j = 0; j < length; j++)
+        {
+            pattern.push_back(characters[rand() % (sizeof(characters) - 1)]);
+        }
+        UBuffer buffer;
+        buffer.appendHexPattern(pattern);
+        ASSERT_EQ(decodeHexPatternByStrtol(pattern),buffer.view().toString())<<pattern;
+    }
+}
+
+TEST_F(UBufferTest,appendHexPattern_LongDigitRun_DataRight)
+{
+    //超过16个字符的连续数字会走成块转换的路径.
+    buffer_->appendHexPattern("000102030405060708090A0B0C0D0E0F10 1");
+    ASSERT_EQ(18,buffer_->size());
+    for(int i = 0; i < 17; i++)
+    {
+        EXPECT_EQ(i,buffer_->data()[i]);
+    }
+    EXPECT_EQ(1,buffer_->data()[17]);
+}
+
+TEST(UBufferHexTest,toHexPattern_Grouping_DataRight)
+{
+    const UBufferView data("\x0C\x0B\x25\xBF",4);
+    EXPECT_EQ("0C 0B 25 BF",toHexPattern(data));
+    EXPECT_EQ("0C0B:25BF",toHexPattern(data,2,':'));
+    EXPECT_EQ("0c0b25bf",toHexPattern(data,0,' ',false));
+    EXPECT_EQ("",toHexPattern(UBufferView()));
+}
+
+TEST(UBufferHexTest,toHexPattern_RoundTrip_SameData)
+{
+    string data;
+    for(int i = 0; i < 1000; i++)
+    {
+        data.push_back(static_cast<char>(i * 7));
+    }
+    for(int groupSize = 0; groupSize < 5; groupSize++)
+    {
+        UBuffer buffer;
+        buffer.appendHexPattern(toHexPattern(UBufferView(data),groupSize));
+        EXPECT_EQ(data,buffer.view().toString());
+    }
+}
+
+TEST(UBufferHexTest,DISABLED_Benchmark_HexPattern)
+{
+    string data(16 * 1024 * 1024,'\0');
+    for(size_t i = 0; i < data.size(); i++)
+    {
+        data[i] = static_cast<char>(rand());
+    }
+    LARGE_INTEGER frequency,begin,end;
+    QueryPerformanceFrequency(&frequency);
+    const double megabytes = data.size() / (1024.0 * 1024.0);
+    for(int groupSize = 0; groupSize < 2; groupSize++)
+    {
+        QueryPerformanceCounter(&begin);
+        const string pattern = toHexPattern(UBufferView(data),groupSize);
+        QueryPerformanceCounter(&end);
+        printf("toHexPattern group %d: %.1f MB/s\n",groupSize,
+            megabytes * frequency.QuadPart / (end.QuadPart - begin.QuadPart));
+
+        UBuffer buffer(data.size());
+        QueryPerformanceCounter(&begin);
+        buffer.appendHexPattern(pattern);
+        QueryPerformanceCounter(&end);
+        printf("appendHexPattern group %d: %.1f MB/s\n",groupSize,
+            megabytes * frequency.QuadPart / (end.QuadPart - begin.QuadPart));
+
+        QueryPerformanceCounter(&begin);
+        const string expected = decodeHexPatternByStrtol(pattern);
+        QueryPerformanceCounter(&end);
+        printf("strtol group %d: %.1f MB/s\n",groupSize,
+            megabytes * frequency.QuadPart / (end.QuadPart - begin.QuadPart));
+        EXPECT_EQ(expected,buffer.view().toString());
+    }
+}
+
 TEST_F(UBufferTest,appendString_CStrDataContainsZero_DataRight)
 {
     char testData[] = {0x25,0x23,0x00,0x00,'C','B','A'};
@@ -228,3 +364,134 @@ TEST_F(UBufferTest,appendString_CStrDataContainsZero_DataRight)
     }
 }
 
+TEST_F(UBufferTest,reserve_SmallData_NoAllocation)
+{
+    EXPECT_EQ(UBuffer::InlineCapacity,buffer_->capacity());
+    buffer_->appendString("small",5);
+    EXPECT_EQ(UBuffer::InlineCapacity,buffer_->capacity());
+    buffer_->reserve(1000);
+    EXPECT_GE(buffer_->capacity(),1000);
+    const char *data = buffer_->data();
+    buffer_->appendString(string(900,'a').c_str(),900);
+    EXPECT_EQ(data,buffer_->data());
+    EXPECT_EQ(905,buffer_->size());
+}
+
+TEST_F(UBufferTest,append_ByteOrder_DataRight)
+{
+    buffer_->append<unsigned short>(0x1234,BigEndian);
+    buffer_->append<unsigned int>(0x01020304,LittleEndian);
+    ASSERT_EQ(6,buffer_->size());
+    const char *data = buffer_->data();
+    EXPECT_EQ('\x12',data[0]);
+    EXPECT_EQ('\x34',data[1]);
+    EXPECT_EQ('\x04',data[2]);
+    EXPECT_EQ('\x01',data[5]);
+}
+
+TEST_F(UBufferTest,read_AppendedValues_SameValues)
+{
+    buffer_->append<short>(-2,BigEndian);
+    buffer_->append(3.25,BigEndian);
+    buffer_->append<long long>(1LL << 40);
+    short shortNumber = 0;
+    double doubleNumber = 0;
+    long long longNumber = 0;
+    EXPECT_TRUE(buffer_->read(shortNumber,BigEndian));
+    EXPECT_TRUE(buffer_->read(doubleNumber,BigEndian));
+    EXPECT_TRUE(buffer_->read(longNumber));
+    EXPECT_EQ(-2,shortNumber);
+    EXPECT_EQ(3.25,doubleNumber);
+    EXPECT_EQ(1LL << 40,longNumber);
+    EXPECT_EQ(0,buffer_->readableSize());
+}
+
+TEST_F(UBufferTest,read_NotEnoughData_ReturnsFalse)
+{
+    buffer_->appendShort(1);
+    int number = 0;
+    EXPECT_FALSE(buffer_->read(number));
+    EXPECT_EQ(0,buffer_->readPosition());
+    EXPECT_FALSE(buffer_->skip(3));
+    EXPECT_TRUE(buffer_->skip(2));
+}
+
+TEST_F(UBufferTest,read_View_NoCopy)
+{
+    buffer_->appendString("headerbody",10);
+    UBufferView header;
+    ASSERT_TRUE(buffer_->read(6,header));
+    EXPECT_EQ(buffer_->data(),header.data());
+    EXPECT_EQ("header",header.toString());
+    EXPECT_EQ("body",buffer_->readableView().toString());
+    EXPECT_EQ("ad",header.slice(2,2).toString());
+    EXPECT_EQ("",header.slice(10).toString());
+}
+
+TEST_F(UBufferTest,prepare_Commit_DataAppended)
+{
+    char *data = buffer_->prepare(200);
+    memset(data,'x',200);
+    buffer_->commit(120);
+    EXPECT_EQ(120,buffer_->size());
+    EXPECT_EQ(string(120,'x'),buffer_->view().toString());
+}
+
+TEST_F(UBufferTest,discardRead_PartlyRead_RemainingMoved)
+{
+    buffer_->appendString("123456",6);
+    buffer_->skip(4);
+    buffer_->discardRead();
+    EXPECT_EQ(0,buffer_->readPosition());
+    EXPECT_EQ("56",buffer_->view().toString());
+}
+
+TEST_F(UBufferTest,copy_LargeBuffer_Independent)
+{
+    buffer_->appendString(string(100,'a').c_str(),100);
+    UBuffer copy(*buffer_);
+    buffer_->appendChar('b');
+    EXPECT_EQ(100,copy.size());
+    EXPECT_NE(buffer_->data(),copy.data());
+    UBuffer small;
+    small.appendChar('c');
+    small.swap(copy);
+    EXPECT_EQ(1,copy.size());
+    EXPECT_EQ(100,small.size());
+}
+
+TEST(UBufferChainTest,exportTo_Segments_DataRight)
+{
+    UBuffer header;
+    header.append<unsigned short>(5,BigEndian);
+    const string body = "hello";
+    UBufferChain chain;
+    chain.append(header);
+    chain.append(UBufferView());
+    chain.append(UBufferView(body));
+    EXPECT_EQ(2,chain.segmentCount());
+    EXPECT_EQ(7,chain.size());
+    UIoVec vectors[4];
+    ASSERT_EQ(2,chain.exportTo(vectors,4));
+    EXPECT_EQ(header.data(),vectors[0].buf);
+    EXPECT_EQ(2,vectors[0].len);
+    EXPECT_EQ(body.data(),vectors[1].buf);
+    EXPECT_EQ(1,chain.exportTo(vectors,1));
+}
+
+TEST(UBufferChainTest,consume_PartlySent_RemainingData)
+{
+    const string first = "abc";
+    const string second = "defg";
+    UBufferChain chain;
+    chain.append(UBufferView(first));
+    chain.append(UBufferView(second));
+    chain.consume(4);
+    EXPECT_EQ(1,chain.segmentCount());
+    EXPECT_EQ(3,chain.size());
+    UBuffer buffer;
+    chain.copyTo(buffer);
+    EXPECT_EQ("efg",buffer.view().toString());
+    chain.consume(3);
+    EXPECT_TRUE(chain.empty());
+}
@@ -1,7 +1,13 @@
 ﻿#include "stdafx.h"
 
 #include "gtest/gtest.h"
+#include <float.h>
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string>
+#include <Windows.h>
 #include "../UniCore/UCast.h"
 
 using namespace std;
@@ -199,6 +205,32 @@ TEST(UCastTest,s2ws_codepage_Utf8String_CodePageIsUtf8_ConvertSuccessfully)
 }
 
 
+TEST(UCastTest,s2ws_LongAsciiString_ConvertSuccessfully)
+{
+    const string s(1000,'a');
+    EXPECT_EQ(wstring(1000,L'a'),s2ws(s));
+    EXPECT_EQ(wstring(1000,L'a'),s2ws(s,CP_ACP));
+    EXPECT_EQ(s,ws2s(wstring(1000,L'a')));
+    EXPECT_EQ(s,ws2s(wstring(1000,L'a'),CP_ACP));
+}
+
+TEST(UCastTest,s2ws_AsciiStringContainsZero_ConvertUntilZero)
+{
+    string s;
+    s.assign("Contains\0Zero",sizeof("Contains\0Zero"));
+    EXPECT_EQ(L"Contains",s2ws(s));
+}
+
+TEST(UCastTest,s2ws_codepage_Utf8RoundTrip_SameAsWindows)
+{
+    const wstring ws = L"\x6211\x4eec ascii \xd83d\xde00";
+    const string utf8 = ws2s(ws,CP_UTF8);
+    char expected[64] = "";
+    const int size = WideCharToMultiByte(CP_UTF8,0,ws.c_str(),ws.size(),expected,sizeof(expected),0,0);
+    EXPECT_EQ(string(expected,size),utf8);
+    EXPECT_EQ(ws,s2ws(utf8,CP_UTF8));
+}
+
 TEST(UCastTest,i2s_0_Returns0)
 {
     ASSERT_EQ("0",i2s(0));
@@ -224,6 +256,275 @@ TEST(UCastTest,i2s_MinNegative_ReturnsMinNegative)
     ASSERT_EQ("-2147483648",i2s(-2147483647-1));
 }
 
+TEST(UCastTest,i2s_LongLongLimits_Converted)
+{
+    EXPECT_EQ("9223372036854775807",i2s(LLONG_MAX));
+    EXPECT_EQ("-9223372036854775808",i2s(LLONG_MIN));
+    EXPECT_EQ(L"-9223372036854775808",i2ws(LLONG_MIN));
+    EXPECT_EQ(L"4294967296",i2ws(4294967296LL));
+}
+
+TEST(UCastTest,format_int_AllDigitCounts_SameAsSprintf)
+{
+    unsigned long long value = 1;
+    for(int digits = 1; digits <= 20; digits++)
+    {
+        const unsigned long long samples[] = {value,value - 1,value + 7,value * 9 + value - 1};
+        for(int i = 0; i < 4; i++)
+        {
+            char expected[32];
+            sprintf_s(expected,sizeof(expected),"%llu",samples[i]);
+            char buffer[UIntegerMaxChars];
+            EXPECT_EQ(expected,string(buffer,format_uint(samples[i],buffer)));
+            wchar_t wbuffer[UIntegerMaxChars];
+            EXPECT_EQ(string(expected),ws2s(wstring(wbuffer,format_uint(samples[i],wbuffer))));
+        }
+        value *= 10;
+    }
+    char buffer[UIntegerMaxChars];
+    EXPECT_EQ("18446744073709551615",string(buffer,format_uint(ULLONG_MAX,buffer)));
+}
+
+TEST(UCastTest,d2s_KnownValues_ShortestRepresentation)
+{
+    EXPECT_EQ("0",d2s(0.0));
+    EXPECT_EQ("-0",d2s(-0.0));
+    EXPECT_EQ("0.1",d2s(0.1));
+    EXPECT_EQ("0.30000000000000004",d2s(0.1 + 0.2));
+    EXPECT_EQ("3",d2s(3.0));
+    EXPECT_EQ("-1.5",d2s(-1.5));
+    EXPECT_EQ("123456789012345680000",d2s(123456789012345678901.0));
+    EXPECT_EQ("1e+21",d2s(1e21));
+    EXPECT_EQ("0.000001",d2s(1e-6));
+    EXPECT_EQ("1e-7",d2s(1e-7));
+    EXPECT_EQ("1.7976931348623157e+308",d2s(DBL_MAX));
+    EXPECT_EQ("5e-324",d2s(4.9406564584124654e-324));
+    EXPECT_EQ("inf",d2s(HUGE_VAL));
+    EXPECT_EQ("-inf",d2s(-HUGE_VAL));
+    EXPECT_EQ(L"0.25",d2ws(0.25));
+}
+
+TEST(UCastTest,d2s_RandomDoubles_RoundTrip)
+{
+    srand(5);
+    char buffer[UDoubleMaxChars + 1];
+    for(int i = 0; i < 100000; i++)
+    {
+        unsigned long long bits = 0;
+        for(int j = 0; j < 4; j++)
+        {
+            bits = (bits << 16) ^ rand();
+        }
+        double value;
+        memcpy(&value,&bits,sizeof(value));
+        if(value != value)
+        {
+            continue;
+        }
+        const size_t size = format_double(value,buffer);
+        ASSERT_LE(size,static_cast<size_t>(UDoubleMaxChars));
+        buffer[size] = 0;
+        double parsed = 0;
+        ASSERT_EQ(ParseOk,parse_double(UStringView(buffer,size),parsed))<<buffer;
+        ASSERT_EQ(0,memcmp(&value,&parsed,sizeof(value)))<<buffer;
+        ASSERT_EQ(value,strtod(buffer,0))<<buffer;
+    }
+}
+
+TEST(UCastTest,parse_int_Valid_Parsed)
+{
+    int value = -1;
+    EXPECT_EQ(ParseOk,parse_int("0",value));
+    EXPECT_EQ(0,value);
+    EXPECT_EQ(ParseOk,parse_int("  -2147483648\t",value));
+    EXPECT_EQ(INT_MIN,value);
+    EXPECT_EQ(ParseOk,parse_int(L"+2147483647",value));
+    EXPECT_EQ(INT_MAX,value);
+    long long big = 0;
+    EXPECT_EQ(ParseOk,parse_int("-9223372036854775808",big));
+    EXPECT_EQ(LLONG_MIN,big);
+    EXPECT_EQ(ParseOk,parse_int("000000000000000000000000123456789012",big));
+    EXPECT_EQ(123456789012LL,big);
+    unsigned long long unsignedValue = 0;
+    EXPECT_EQ(ParseOk,parse_uint("18446744073709551615",unsignedValue));
+    EXPECT_EQ(ULLONG_MAX,unsignedValue);
+    EXPECT_EQ(ParseOk,parse_uint("-0",unsignedValue));
+    EXPECT_EQ(0,unsignedValue);
+}
+
+TEST(UCastTest,parse_int_Invalid_ReportsError)
+{
+    int value = -1;
+    EXPECT_EQ(ParseInvalid,parse_int("",value));
+    EXPECT_EQ(0,value);
+    EXPECT_EQ(ParseInvalid,parse_int("-",value));
+    EXPECT_EQ(ParseInvalid,parse_int("12abc",value));
+    EXPECT_EQ(ParseInvalid,parse_int("1 2",value));
+    EXPECT_EQ(ParseInvalid,parse_int(L"0x10",value));
+    EXPECT_EQ(ParseOutOfRange,parse_int("2147483648",value));
+    EXPECT_EQ(INT_MAX,value);
+    EXPECT_EQ(ParseOutOfRange,parse_int("-99999999999999999999999",value));
+    EXPECT_EQ(INT_MIN,value);
+    unsigned int unsignedValue = 1;
+    EXPECT_EQ(ParseOutOfRange,parse_uint("-1",unsignedValue));
+    EXPECT_EQ(0,unsignedValue);
+    unsigned long long longValue = 1;
+    EXPECT_EQ(ParseOutOfRange,parse_uint("-00000000000000000005",longValue));
+    EXPECT_EQ(0,longValue);
+}
+
+TEST(UCastTest,parse_int_Prefix_SameAsWtoi)
+{
+    const wchar_t *samples[] = {L"12abc",L"  -7 apples",L"abc",L"",L"+",L"123456789",L"1e5"};
+    for(int i = 0; i < sizeof(samples) / sizeof(samples[0]); i++)
+    {
+        int value = -1;
+        size_t parsed = 0;
+        parse_int(samples[i],value,&parsed);
+        EXPECT_EQ(_wtoi(samples[i]),value)<<samples[i];
+    }
+    int value = 0;
+    size_t parsed = 0;
+    EXPECT_EQ(ParseOk,parse_int(" 42;",value,&parsed));
+    EXPECT_EQ(3,parsed);
+    EXPECT_EQ(ParseInvalid,parse_int(";",value,&parsed));
+    EXPECT_EQ(0,parsed);
+}
+
+TEST(UCastTest,parse_int_RandomValues_SameAsFormat)
+{
+    srand(6);
+    for(int i = 0; i < 100000; i++)
+    {
+        unsigned long long bits = 0;
+        for(int j = 0; j < 4; j++)
+        {
+            bits = (bits << 16) ^ rand();
+        }
+        const long long expected = static_cast<long long>(bits) >> (rand() % 64);
+        char buffer[UIntegerMaxChars];
+        long long value = 0;
+        ASSERT_EQ(ParseOk,parse_int(UStringView(buffer,format_int(expected,buffer)),value));
+        ASSERT_EQ(expected,value);
+    }
+}
+
+TEST(UCastTest,parse_double_SameAsStrtod)
+{
+    const char *samples[] =
+    {
+        "0","-0","1","-1.5","3.14159","1e10",".5","5.","1E-5","123456789012345678901234567890",
+        "0.1","2.2250738585072014e-308","4.9e-324","1.7976931348623157e308","9007199254740993",
+        "0.000000000000000000000000000000000000001","1e23","8.98846567431158e307","  2.5  ",
+        "18446744073709551616","10000000000000000000000000000000000000000000000000000000000000000",
+        "1.0000000000000000000000000000000000000000000000000000000000000000000000",
+    };
+    for(int i = 0; i < sizeof(samples) / sizeof(samples[0]); i++)
+    {
+        double value = 0;
+        EXPECT_EQ(ParseOk,parse_double(samples[i],value))<<samples[i];
+        EXPECT_EQ(strtod(samples[i],0),value)<<samples[i];
+        EXPECT_EQ(ParseOk,parse_double(s2ws(samples[i]),value))<<samples[i];
+        EXPECT_EQ(strtod(samples[i],0),value)<<samples[i];
+    }
+    double value = 0;
+    EXPECT_EQ(ParseOk,parse_double("-Infinity",value));
+    EXPECT_EQ(-HUGE_VAL,value);
+    EXPECT_EQ(ParseOk,parse_double("nan",value));
+    EXPECT_TRUE(value != value);
+    EXPECT_EQ(ParseOutOfRange,parse_double("1e400",value));
+    EXPECT_EQ(HUGE_VAL,value);
+    EXPECT_EQ(ParseOutOfRange,parse_double("1e-400",value));
+    EXPECT_EQ(0.0,value);
+    EXPECT_EQ(ParseOutOfRange,parse_double(L"-1e-400",value));
+    EXPECT_EQ(0.0,value);
+    EXPECT_EQ(ParseOk,parse_double("0e-400",value));
+    EXPECT_EQ(0.0,value);
+    EXPECT_EQ(ParseInvalid,parse_double(".",value));
+    EXPECT_EQ(ParseInvalid,parse_double("1.5x",value));
+    size_t parsed = 0;
+    EXPECT_EQ(ParseOk,parse_double("1.5e",value,&parsed));
+    EXPECT_EQ(3,parsed);
+    EXPECT_EQ(1.5,value);
+}
+
+TEST(UCastTest,DISABLED_Benchmark_Numbers)
+{
+    const int count = 1000000;
+    LARGE_INTEGER frequency,begin,end;
+    QueryPerformanceFrequency(&frequency);
+    char buffer[64];
+    size_t total = 0;
+
+    QueryPerformanceCounter(&begin);
+    for(int i = 0; i < count; i++)
+    {
+        _i64toa_s(i * 7919LL,buffer,sizeof(buffer),10);
+        total += buffer[0];
+    }
+    QueryPerformanceCounter(&end);
+    printf("_i64toa_s: %.1f ns\n",1e9 * (end.QuadPart - begin.QuadPart) / frequency.QuadPart / count);
+    QueryPerformanceCounter(&begin);
+    for(int i = 0; i < count; i++)
+    {
+        total += format_int(i * 7919LL,buffer);
+    }
+    QueryPerformanceCounter(&end);
+    printf("format_int: %.1f ns\n",1e9 * (end.QuadPart - begin.QuadPart) / frequency.QuadPart / count);
+
+    QueryPerformanceCounter(&begin);
+    for(int i = 0; i < count; i++)
+    {
+        total += sprintf_s(buffer,"%.17g",i * 0.37);
+    }
+    QueryPerformanceCounter(&end);
+    printf("sprintf %%.17g: %.1f ns\n",1e9 * (end.QuadPart - begin.QuadPart) / frequency.QuadPart / count);
+    QueryPerformanceCounter(&begin);
+    for(int i = 0; i < count; i++)
+    {
+        total += format_double(i * 0.37,buffer);
+    }
+    QueryPerformanceCounter(&end);
+    printf("format_double: %.1f ns\n",1e9 * (end.QuadPart - begin.QuadPart) / frequency.QuadPart / count);
+
+    const wchar_t *text = L"1234567";
+    QueryPerformanceCounter(&begin);
+    for(int i = 0; i < count; i++)
+    {
+        total += _wtoi(text);
+    }
+    QueryPerformanceCounter(&end);
+    printf("_wtoi: %.1f ns\n",1e9 * (end.QuadPart - begin.QuadPart) / frequency.QuadPart / count);
+    QueryPerformanceCounter(&begin);
+    for(int i = 0; i < count; i++)
+    {
+        int value;
+        parse_int(text,value);
+        total += value;
+    }
+    QueryPerformanceCounter(&end);
+    printf("parse_int: %.1f ns\n",1e9 * (end.QuadPart - begin.QuadPart) / frequency.QuadPart / count);
+
+    const char *number = "3.1415926";
+    QueryPerformanceCounter(&begin);
+    for(int i = 0; i < count; i++)
+    {
+        total += static_cast<size_t>(strtod(number,0));
+    }
+    QueryPerformanceCounter(&end);
+    printf("strtod: %.1f ns\n",1e9 * (end.QuadPart - begin.QuadPart) / frequency.QuadPart / count);
+    QueryPerformanceCounter(&begin);
+    for(int i = 0; i < count; i++)
+    {
+        double value;
+        parse_double(number,value);
+        total += static_cast<size_t>(value);
+    }
+    QueryPerformanceCounter(&end);
+    printf("parse_double: %.1f ns\n",1e9 * (end.QuadPart - begin.QuadPart) / frequency.QuadPart / count);
+    EXPECT_NE(0,total);
+}
+
 TEST(UCastTest,stringOperatorAddInt_NormalInt_ConcatenateSuccess)
 {
     std::string s;
@@ -0,0 +1,95 @@
+﻿#include "stdafx.h"
+
+#include "gtest/gtest.h"
+#include <Windows.h>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include "../UniCore/UCompress.h"
+
+using namespace std;
+using namespace uni;
+
+namespace
+{
+    string compressAndDecompress(const string &data)
+    {
+        string compressed = lz4Compress(data.data(),data.size());
+        string result;
+        EXPECT_TRUE(lz4Decompress(compressed.data(),compressed.size(),data.size(),result));
+        return result;
+    }
+}
+
+TEST(UCompressTest,lz4Compress_EmptyData_RoundTrip)
+{
+    EXPECT_EQ("",compressAndDecompress(""));
+}
+
+TEST(UCompressTest,lz4Compress_ShortData_RoundTrip)
+{
+    EXPECT_EQ("abc",compressAndDecompress("abc"));
+}
+
+TEST(UCompressTest,lz4Compress_RepeatedText_Compressed)
+{
+    string data;
+    for(int i = 0; i < 1000; i++)
+    {
+        data += "Sat Oct 18 12:00:00 2026\n {group}[info][main] message <42>\n";
+    }
+    string compressed = lz4Compress(data.data(),data.size());
+    EXPECT_LT(compressed.size(),data.size() / 10);
+    EXPECT_EQ(data,compressAndDecompress(data));
+}
+
+TEST(UCompressTest,lz4Compress_RandomData_RoundTrip)
+{
+    string data(100000,'\0');
+    unsigned int seed = 12345;
+    for(size_t i = 0; i < data.size(); i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        data[i] = static_cast<char>(seed >> 16);
+    }
+    EXPECT_EQ(data,compressAndDecompress(data));
+}
+
+TEST(UCompressTest,lz4Decompress_WrongOriginalSize_ReturnsFalse)
+{
+    string data(1000,'a');
+    string compressed = lz4Compress(data.data(),data.size());
+    string result;
+    EXPECT_FALSE(lz4Decompress(compressed.data(),compressed.size(),data.size() - 1,result));
+    EXPECT_FALSE(lz4Decompress(compressed.data(),compressed.size(),data.size() + 1,result));
+}
+
+TEST(UCompressTest,compressFile_TextFile_RoundTrip)
+{
+    wchar_t tempPath[MAX_PATH] = L"";
+    GetTempPathW(MAX_PATH,tempPath);
+    const wstring source = wstring(tempPath) + L"ucompress_test.txt";
+    const wstring packed = source + L".ulz";
+    const wstring unpacked = source + L".out";
+    string data;
+    for(int i = 0; i < 100000; i++)
+    {
+        ostringstream line;
+        line<<"line "<<i<<"\n";
+        data += line.str();
+    }
+    {
+        ofstream file(source.c_str(),ios_base::out|ios_base::binary);
+        file<<data;
+    }
+    EXPECT_TRUE(compressFile(source.c_str(),packed.c_str()));
+    EXPECT_TRUE(decompressFile(packed.c_str(),unpacked.c_str()));
+    ifstream file(unpacked.c_str(),ios_base::in|ios_base::binary);
+    ostringstream result;
+    result<<file.rdbuf();
+    file.close();
+    EXPECT_EQ(data,result.str());
+    DeleteFileW(source.c_str());
+    DeleteFileW(packed.c_str());
+    DeleteFileW(unpacked.c_str());
+}
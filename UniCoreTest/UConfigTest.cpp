@@ -1,8 +1,16 @@
 ﻿#include "stdafx.h"
 
 #include <fstream>
+#include <map>
+#include <iterator>
+#include <process.h>
+#include <Windows.h>
 #include "gtest/gtest.h"
+#include "../UniCore/UBinaryConfig.h"
+#include "../UniCore/UCast.h"
 #include "../UniCore/UConfig.h"
+#include "../UniCore/UConfigKey.h"
+#include "../UniCore/UMemoryIniConfig.h"
 
 using namespace std;
 using namespace uni;
@@ -24,6 +32,37 @@ public:
     UIniConfig *iniConfig;
 };
 
+namespace
+{
+    //! 只实现了get和set的配置,用来测试UConfig的默认实现.
+    class UMapConfig : public UConfig
+    {
+    public:
+        virtual std::wstring get(std::wstring key,...)
+        {
+            va_list ap;
+            va_start(ap,key);
+            const wstring formattedKey = formatKey(key,ap);
+            va_end(ap);
+            return values[formattedKey];
+        }
+        virtual void set(std::wstring key,std::wstring value,...)
+        {
+            va_list ap;
+            va_start(ap,value);
+            const wstring formattedKey = formatKey(key,ap);
+            va_end(ap);
+            values[formattedKey] = value;
+        }
+        virtual std::vector<std::wstring> getArray(std::wstring,...) {return vector<wstring>();}
+        virtual void setArray(std::wstring,std::vector<std::wstring>,...) {}
+        virtual int getInt(std::wstring,...) {return 0;}
+        virtual void setInt(std::wstring,int,...) {}
+
+        map<wstring,wstring> values;
+    };
+}
+
 class URegConfigTest : public ::testing::Test
 {
 
@@ -51,4 +90,520 @@ TEST_F(UIniConfigTest,IniFileCreateTest)
 TEST_F(UIniConfigTest,getInt_KeyNoExists_ReturnsZero)
 {
     ASSERT_EQ(0,theConfig.getInt(L"tea"));
-}
\ No newline at end of file
+}
+TEST_F(UIniConfigTest,getArray_AfterSetArray_ReturnsSameElements)
+{
+    vector<wstring> servers;
+    servers.push_back(L"127.0.0.1");
+    servers.push_back(L"");
+    servers.push_back(L"192.168.0.%d");
+    theConfig.setArray(L"网络/服务器%d",servers,1);
+    EXPECT_EQ(servers,theConfig.getArray(L"网络/服务器1"));
+
+    servers.resize(1);
+    theConfig.setArray(L"网络/服务器1",servers);
+    EXPECT_EQ(servers,theConfig.getArray(L"网络/服务器1"));
+    EXPECT_TRUE(theConfig.get(L"网络/服务器1/1").empty());
+}
+
+TEST_F(UIniConfigTest,get_LongValue_NotTruncated)
+{
+    const wstring value(2000,L'v');
+    theConfig.set(L"long/value",value);
+    EXPECT_EQ(value,theConfig.get(L"long/value"));
+}
+
+class UMemoryIniConfigTest : public ::testing::Test
+{
+public:
+    virtual void SetUp() 
+    {
+        ::_wremove(L"./memory.ini");
+        config = new UMemoryIniConfig(L"./memory.ini");
+    }
+
+    virtual void TearDown() 
+    {
+        delete config;
+        ::_wremove(L"./memory.ini");
+    }
+
+    void writeFile(const char *content)
+    {
+        ofstream file("./memory.ini",ios::binary);
+        file<<content;
+    }
+
+    UMemoryIniConfig *config;
+};
+
+TEST_F(UMemoryIniConfigTest,get_KeyNotExists_ReturnsEmptyString)
+{
+    EXPECT_TRUE(config->get(L"section/key").empty());
+    EXPECT_TRUE(config->get(L"nokey").empty());
+    EXPECT_EQ(0,config->getInt(L"section/key"));
+    EXPECT_TRUE(config->getArray(L"section/key").empty());
+}
+
+TEST_F(UMemoryIniConfigTest,set_ThenFlush_PersistedToFile)
+{
+    config->set(L"窗口/宽",L"800");
+    config->setInt(L"窗口/高%d",600,2);
+    EXPECT_EQ(L"800",config->get(L"窗口/宽"));
+    EXPECT_EQ(600,config->getInt(L"窗口/高2"));
+    ASSERT_TRUE(config->flush());
+
+    UMemoryIniConfig reopened(L"./memory.ini");
+    EXPECT_EQ(L"800",reopened.get(L"窗口/宽"));
+    EXPECT_EQ(600,reopened.getInt(L"窗口/高2"));
+}
+
+TEST_F(UMemoryIniConfigTest,set_NonAsciiKeyArgument_Formatted)
+{
+    config->set(L"a/%s",L"v",L"用户");
+    EXPECT_EQ(L"v",config->get(L"a/用户"));
+    EXPECT_EQ(L"v",config->get(L"a/%s",L"用户"));
+}
+
+TEST_F(UMemoryIniConfigTest,reload_ParsesCommentsQuotesAndIgnoresCase)
+{
+    writeFile("; comment\r\n"
+        "ignored=1\r\n"
+        "[Main]\r\n"
+        "  Name = \" padded \" \r\n"
+        "# another comment\r\n"
+        "count=42abc\r\n"
+        "\r\n"
+        "[main]\r\n"
+        "name=duplicate section\r\n"
+        "[Other]\r\n"
+        "empty=\r\n");
+    ASSERT_TRUE(config->reload());
+    EXPECT_EQ(L" padded ",config->get(L"MAIN/name"));
+    EXPECT_EQ(42,config->getInt(L"main/COUNT"));
+    EXPECT_TRUE(config->get(L"other/empty").empty());
+
+    //修改后未修改的行原样保留.
+    config->set(L"main/count",L"7");
+    config->set(L"other/added",L"new");
+    ASSERT_TRUE(config->flush());
+    ifstream file("./memory.ini",ios::binary);
+    const string content((istreambuf_iterator<char>(file)),istreambuf_iterator<char>());
+    EXPECT_NE(string::npos,content.find("; comment\r\n"));
+    EXPECT_NE(string::npos,content.find("  Name = \" padded \" \r\n"));
+    EXPECT_NE(string::npos,content.find("count=7\r\n\r\n[main]"));
+    EXPECT_NE(string::npos,content.find("empty=\r\nadded=new\r\n"));
+}
+
+TEST_F(UMemoryIniConfigTest,set_ValueWithSpaces_QuotedAndRoundTrips)
+{
+    config->set(L"a/b",L"  spaces  ");
+    config->set(L"a/c",L"\"quoted\"");
+    ASSERT_TRUE(config->flush());
+    UMemoryIniConfig reopened(L"./memory.ini");
+    EXPECT_EQ(L"  spaces  ",reopened.get(L"a/b"));
+    EXPECT_EQ(L"\"quoted\"",reopened.get(L"a/c"));
+}
+
+TEST_F(UMemoryIniConfigTest,getArray_AfterSetArray_ReturnsSameElements)
+{
+    vector<wstring> values;
+    for(int i = 0; i < 5; i++)
+    {
+        values.push_back(i2ws(i * 10));
+    }
+    config->setArray(L"list/%d",values,3);
+    EXPECT_EQ(values,config->getArray(L"list/3"));
+    EXPECT_EQ(L"5",config->get(L"list/3/count"));
+
+    values.resize(2);
+    config->setArray(L"list/3",values);
+    EXPECT_EQ(values,config->getArray(L"list/3"));
+    EXPECT_TRUE(config->get(L"list/3/4").empty());
+}
+
+TEST_F(UMemoryIniConfigTest,endBatch_ChangesVisibleTogether)
+{
+    const unsigned int generation = config->generation();
+    config->beginBatch();
+    config->set(L"w/width",L"800");
+    config->beginBatch();
+    config->set(L"w/height",L"600");
+    config->endBatch();
+    EXPECT_TRUE(config->get(L"w/width").empty());
+    EXPECT_EQ(generation,config->generation());
+    config->endBatch();
+    EXPECT_EQ(L"800",config->get(L"w/width"));
+    EXPECT_EQ(L"600",config->get(L"w/height"));
+    EXPECT_EQ(generation + 1,config->generation());
+}
+
+TEST_F(UMemoryIniConfigTest,reload_KeepsUnflushedChanges)
+{
+    config->set(L"local/key",L"local");
+    writeFile("[remote]\nkey=remote\n");
+    ASSERT_TRUE(config->reload());
+    EXPECT_EQ(L"local",config->get(L"local/key"));
+    EXPECT_EQ(L"remote",config->get(L"remote/key"));
+}
+
+TEST_F(UMemoryIniConfigTest,startWatching_FileModified_Reloaded)
+{
+    config->set(L"s/k",L"1");
+    ASSERT_TRUE(config->flush());
+    ASSERT_TRUE(config->startWatching());
+    const unsigned int generation = config->generation();
+
+    writeFile("[s]\r\nk=2\r\n");
+    for(int i = 0; i < 200 && config->generation() == generation; i++)
+    {
+        Sleep(10);
+    }
+    EXPECT_EQ(L"2",config->get(L"s/k"));
+
+    //自己写入文件不会触发重新读取.
+    config->set(L"s/k",L"3");
+    const unsigned int afterSet = config->generation();
+    ASSERT_TRUE(config->flush());
+    Sleep(100);
+    EXPECT_EQ(afterSet,config->generation());
+    config->stopWatching();
+}
+
+TEST_F(UMemoryIniConfigTest,ReadersDuringWrites_SeeConsistentValues)
+{
+    struct Reader
+    {
+        static unsigned __stdcall run(void *param)
+        {
+            UMemoryIniConfig *config = static_cast<UMemoryIniConfig *>(param);
+            for(int i = 0; i < 20000; i++)
+            {
+                const vector<wstring> values = config->getArray(L"r/values");
+                for(size_t j = 1; j < values.size(); j++)
+                {
+                    if(values[j] != values[0])
+                    {
+                        return 1;
+                    }
+                }
+            }
+            return 0;
+        }
+    };
+    HANDLE threads[4];
+    for(int i = 0; i < 4; i++)
+    {
+        threads[i] = reinterpret_cast<HANDLE>(_beginthreadex(NULL,0,&Reader::run,config,0,NULL));
+    }
+    for(int i = 0; i < 500; i++)
+    {
+        config->setArray(L"r/values",vector<wstring>(3,i2ws(i)));
+    }
+    WaitForMultipleObjects(4,threads,TRUE,INFINITE);
+    for(int i = 0; i < 4; i++)
+    {
+        DWORD exitCode = 1;
+        GetExitCodeThread(threads[i],&exitCode);
+        EXPECT_EQ(0,exitCode);
+        CloseHandle(threads[i]);
+    }
+}
+
+TEST_F(UMemoryIniConfigTest,IniFileWrittenBy_UIniConfig_Readable)
+{
+    {
+        UIniConfig iniConfig(L"./memory.ini");
+        iniConfig.set(L"通用/账号",L"用户");
+    }
+    ASSERT_TRUE(config->reload());
+    EXPECT_EQ(L"用户",config->get(L"通用/账号"));
+
+    config->set(L"通用/密码",L"abc");
+    ASSERT_TRUE(config->flush());
+    UIniConfig iniConfig(L"./memory.ini");
+    EXPECT_EQ(L"abc",iniConfig.get(L"通用/密码"));
+    EXPECT_EQ(L"用户",iniConfig.get(L"通用/账号"));
+}
+
+TEST_F(UIniConfigTest,UConfigKey_Types_RoundTrip)
+{
+    UConfigKey<int> width(L"窗口/宽%d",2);
+    EXPECT_EQ(L"窗口/宽2",width.path());
+    EXPECT_EQ(L"窗口",width.sectionName());
+    EXPECT_EQ(L"宽2",width.keyName());
+    width.set(800);
+    EXPECT_EQ(800,width.get());
+    EXPECT_EQ(800,theConfig.getInt(L"窗口/宽2"));
+
+    UConfigKey<double> scale(L"窗口/缩放");
+    scale.set(1.25);
+    EXPECT_EQ(1.25,scale.get());
+
+    UConfigKey<bool> visible(L"窗口/可见");
+    EXPECT_FALSE(visible.get());
+    visible.set(true);
+    EXPECT_TRUE(visible.get());
+    theConfig.set(L"窗口/可见",L" Yes ");
+    EXPECT_TRUE(visible.get());
+
+    //参数中的'%'不会被再次格式化.
+    UConfigKey<wstring> title(L"窗口/%s",L"100%d");
+    title.set(L"标题");
+    EXPECT_EQ(L"标题",title.get());
+    EXPECT_EQ(L"标题",theConfig.get(L"窗口/%s",L"100%d"));
+
+    UConfigKey<vector<wstring> > servers(L"网络/服务器");
+    vector<wstring> values(2,L"10.0.0.1");
+    servers.set(values);
+    EXPECT_EQ(values,servers.get());
+}
+
+TEST(UConfigKeyTest,DefaultImplementation_EscapesPercent)
+{
+    UMapConfig config;
+    UConfigKey<wstring> key(L"a/%s",L"50%");
+    key.set(config,L"half");
+    EXPECT_EQ(L"half",config.values[L"a/50%"]);
+    EXPECT_EQ(L"half",key.get(config));
+    UConfigKey<bool> flag(L"a/flag");
+    flag.set(config,false);
+    EXPECT_EQ(L"0",config.values[L"a/flag"]);
+    config.values[L"a/flag"] = L"ON";
+    EXPECT_TRUE(flag.get(config));
+    config.values[L"a/flag"] = L"off";
+    EXPECT_FALSE(flag.get(config));
+}
+
+TEST_F(UMemoryIniConfigTest,UConfigKey_SlotFollowsChanges)
+{
+    UConfigKey<int> count(L"s/count%d",1);
+    EXPECT_EQ(0,count.get(*config));
+    config->setInt(L"s/count1",5);
+    EXPECT_EQ(5,count.get(*config));
+    count.set(*config,6);
+    EXPECT_EQ(6,count.get(*config));
+
+    //插入其它的键和section后行号变化,槽位仍然指向正确的行.
+    config->set(L"a/x",L"1");
+    config->set(L"s/before",L"2");
+    EXPECT_EQ(6,count.get(*config));
+    config->set(L"s/count1",L"");
+    EXPECT_EQ(0,count.get(*config));
+
+    ASSERT_TRUE(config->flush());
+    writeFile("[S]\r\nCOUNT1=9\r\n");
+    ASSERT_TRUE(config->reload());
+    EXPECT_EQ(9,count.get(*config));
+
+    //换成另一个配置对象后重新分配槽位.
+    UMemoryIniConfig other(L"./memory.ini");
+    other.setInt(L"other/key",1);
+    other.setInt(L"s/count1",3);
+    EXPECT_EQ(3,count.get(other));
+    EXPECT_EQ(9,count.get(*config));
+}
+
+TEST_F(UMemoryIniConfigTest,UConfigKey_ManyKeys_SlotsPublishedInBatches)
+{
+    config->beginBatch();
+    for(int i = 0; i < 100; i++)
+    {
+        config->setInt(L"s/key%d",i,i);
+    }
+    config->endBatch();
+    const unsigned int generation = config->generation();
+    vector<UConfigKey<int> *> keys;
+    for(int i = 0; i < 100; i++)
+    {
+        keys.push_back(new UConfigKey<int>(L"s/key%d",i));
+        EXPECT_EQ(i,keys.back()->get(*config));
+    }
+    //每个新槽位都发布的话要生成100个快照.
+    EXPECT_GE(8u,config->generation() - generation);
+    config->setInt(L"s/key0",7);
+    for(int i = 0; i < 100; i++)
+    {
+        EXPECT_EQ(i ? i : 7,keys[i]->get(*config));
+        delete keys[i];
+    }
+}
+
+TEST_F(UMemoryIniConfigTest,DISABLED_Benchmark_get)
+{
+    for(int i = 0; i < 200; i++)
+    {
+        config->setInt(L"bench/key%d",i,i);
+    }
+    config->flush();
+    UIniConfig iniConfig(L"./memory.ini");
+    const int count = 10000;
+    LARGE_INTEGER frequency,begin,end;
+    QueryPerformanceFrequency(&frequency);
+
+    QueryPerformanceCounter(&begin);
+    for(int i = 0; i < count; i++)
+    {
+        iniConfig.get(L"bench/key%d",i % 200);
+    }
+    QueryPerformanceCounter(&end);
+    printf("UIniConfig get: %.1f ns\n",1e9 * (end.QuadPart - begin.QuadPart) / frequency.QuadPart / count);
+
+    QueryPerformanceCounter(&begin);
+    for(int i = 0; i < count; i++)
+    {
+        config->get(L"bench/key%d",i % 200);
+    }
+    QueryPerformanceCounter(&end);
+    printf("UMemoryIniConfig get: %.1f ns\n",1e9 * (end.QuadPart - begin.QuadPart) / frequency.QuadPart / count);
+
+    vector<UConfigKey<int> *> keys;
+    for(int i = 0; i < 200; i++)
+    {
+        keys.push_back(new UConfigKey<int>(L"bench/key%d",i));
+    }
+    QueryPerformanceCounter(&begin);
+    for(int i = 0; i < count; i++)
+    {
+        keys[i % 200]->get(*config);
+    }
+    QueryPerformanceCounter(&end);
+    printf("UConfigKey<int> get: %.1f ns\n",1e9 * (end.QuadPart - begin.QuadPart) / frequency.QuadPart / count);
+    for(size_t i = 0; i < keys.size(); i++)
+    {
+        delete keys[i];
+    }
+}
+
+class UBinaryConfigTest : public UMemoryIniConfigTest
+{
+public:
+    virtual void TearDown() 
+    {
+        UMemoryIniConfigTest::TearDown();
+        ::_wremove(L"./memory.bin");
+        ::_wremove(L"./decompiled.ini");
+    }
+};
+
+TEST_F(UBinaryConfigTest,compileIni_ValuesReadable)
+{
+    writeFile("[Main]\r\nName=value\r\ncount=42\r\n[网络]\r\n服务器/count=2\r\n服务器/0=a\r\n服务器/1=b\r\n");
+    ASSERT_TRUE(config->reload());
+    ASSERT_TRUE(UBinaryConfig::compileIni(L"./memory.ini",L"./memory.bin"));
+
+    UBinaryConfig binary(L"./memory.bin");
+    ASSERT_TRUE(binary.isOpen());
+    EXPECT_EQ(5,binary.size());
+    EXPECT_EQ(L"value",binary.get(L"main/NAME"));
+    EXPECT_EQ(42,binary.getInt(L"Main/count"));
+    EXPECT_TRUE(binary.get(L"Main/missing").empty());
+    EXPECT_TRUE(binary.get(L"Other/name").empty());
+    vector<wstring> servers = binary.getArray(L"网络/服务器");
+    ASSERT_EQ(2,servers.size());
+    EXPECT_EQ(L"a",servers[0]);
+    EXPECT_EQ(L"b",servers[1]);
+
+    UConfigKey<int> count(L"main/count");
+    EXPECT_EQ(42,count.get(binary));
+    EXPECT_EQ(42,count.get(binary));
+
+    const vector<pair<wstring,wstring> > entries = binary.entries();
+    ASSERT_EQ(5,entries.size());
+    EXPECT_EQ(L"Main/Name",entries[0].first);
+    EXPECT_EQ(L"网络/服务器/1",entries[4].first);
+}
+
+TEST_F(UBinaryConfigTest,write_ManyKeys_AllFound)
+{
+    vector<pair<wstring,wstring> > entries;
+    for(int i = 0; i < 5000; i++)
+    {
+        entries.push_back(make_pair(L"section" + i2ws(i % 7) + L"/key" + i2ws(i),i2ws(i * 3)));
+    }
+    //重复的键只保留第一个.
+    entries.push_back(make_pair(wstring(L"SECTION0/KEY0"),wstring(L"duplicate")));
+    ASSERT_TRUE(UBinaryConfig::write(L"./memory.bin",entries));
+
+    UBinaryConfig binary(L"./memory.bin");
+    ASSERT_EQ(5000,binary.size());
+    for(int i = 0; i < 5000; i++)
+    {
+        ASSERT_EQ(i * 3,binary.getInt(L"section%d/key%d",i % 7,i))<<i;
+    }
+    EXPECT_TRUE(binary.get(L"section0/key5000").empty());
+}
+
+TEST_F(UBinaryConfigTest,decompileToIni_RoundTrip)
+{
+    vector<pair<wstring,wstring> > entries;
+    entries.push_back(make_pair(wstring(L"a/100%"),wstring(L"  spaced  ")));
+    entries.push_back(make_pair(wstring(L"b/key"),wstring(L"用户")));
+    entries.push_back(make_pair(wstring(L"nosection"),wstring(L"1")));
+    ASSERT_TRUE(UBinaryConfig::write(L"./memory.bin",entries));
+    ASSERT_TRUE(UBinaryConfig::decompileToIni(L"./memory.bin",L"./decompiled.ini"));
+
+    UMemoryIniConfig ini(L"./decompiled.ini");
+    EXPECT_EQ(entries,ini.entries());
+}
+
+TEST_F(UBinaryConfigTest,Open_InvalidFile_Empty)
+{
+    UBinaryConfig missing(L"./memory.bin");
+    EXPECT_FALSE(missing.isOpen());
+    EXPECT_TRUE(missing.get(L"a/b").empty());
+
+    writeFile("UCFGBIN1 but truncated");
+    UBinaryConfig truncated(L"./memory.ini");
+    EXPECT_FALSE(truncated.isOpen());
+    EXPECT_EQ(0,truncated.size());
+}
+
+TEST_F(UBinaryConfigTest,DISABLED_Benchmark_ColdStart10k)
+{
+    const int count = 10000;
+    for(int i = 0; i < count; i++)
+    {
+        config->set(L"section%d/key%d",i2ws(i),i % 20,i);
+    }
+    config->flush();
+    UBinaryConfig::compileIni(L"./memory.ini",L"./memory.bin");
+    LARGE_INTEGER frequency,begin,end;
+    QueryPerformanceFrequency(&frequency);
+
+    //GetPrivateProfileString每次都解析整个文件,只读取一部分再换算.
+    const int iniSamples = 200;
+    QueryPerformanceCounter(&begin);
+    {
+        UIniConfig ini(L"./memory.ini");
+        for(int i = 0; i < iniSamples; i++)
+        {
+            ini.get(L"section%d/key%d",i % 20,i);
+        }
+    }
+    QueryPerformanceCounter(&end);
+    printf("UIniConfig open + %d keys: %.1f ms (estimated)\n",count,
+        1e3 * (end.QuadPart - begin.QuadPart) / frequency.QuadPart * count / iniSamples);
+
+    QueryPerformanceCounter(&begin);
+    {
+        UMemoryIniConfig ini(L"./memory.ini");
+        for(int i = 0; i < count; i++)
+        {
+            ini.get(L"section%d/key%d",i % 20,i);
+        }
+    }
+    QueryPerformanceCounter(&end);
+    printf("UMemoryIniConfig open + %d keys: %.1f ms\n",count,1e3 * (end.QuadPart - begin.QuadPart) / frequency.QuadPart);
+
+    QueryPerformanceCounter(&begin);
+    {
+        UBinaryConfig binary(L"./memory.bin");
+        for(int i = 0; i < count; i++)
+        {
+            binary.get(L"section%d/key%d",i % 20,i);
+        }
+    }
+    QueryPerformanceCounter(&end);
+    printf("UBinaryConfig open + %d keys: %.1f ms\n",count,1e3 * (end.QuadPart - begin.QuadPart) / frequency.QuadPart);
+}
@@ -1,8 +1,12 @@
 ﻿#include "stdafx.h"
 
 #include "gtest/gtest.h"
+#include <vector>
 #include "../UniCore/UEnum.h"
 
+using namespace std;
+using namespace uni;
+
 enum RWBY
 {
     Ross,
@@ -47,4 +51,77 @@ TEST(UEnumTest,e2s_TwoEnums_ConvertSuccess)
     Fruit f;
     f = Apple;
     EXPECT_EQ(L"Apple",e2s(f));
-}
\ No newline at end of file
+}
+enum HttpStatus
+{
+    HttpOk = 200,
+    HttpMovedPermanently = 301,
+    HttpNotFound = 404,
+    HttpTeapot = 418,
+    HttpNotModified = 304,
+    HttpSuccess = HttpOk,
+};
+
+UENUM(HttpStatus)
+    UENUM_ENTRY(HttpOk)
+    UENUM_ENTRY(HttpMovedPermanently)
+    UENUM_ENTRY_VALUE(HttpNotFound,NotFound)
+    UENUM_ENTRY(HttpTeapot)
+    UENUM_ENTRY(HttpNotModified)
+    UENUM_ENTRY(HttpSuccess)
+UENUM_END
+
+TEST(UEnumTest,e2s_SparseValues_ConvertSuccess)
+{
+    EXPECT_EQ(L"HttpMovedPermanently",e2s(HttpMovedPermanently));
+    EXPECT_EQ(L"HttpNotModified",e2s(HttpNotModified));
+    EXPECT_EQ(L"NotFound",e2s(HttpNotFound));
+    //值相同时返回最先声明的.
+    EXPECT_EQ(L"HttpOk",e2s(HttpSuccess));
+}
+
+TEST(UEnumTest,e2s_UnknownValue_ReturnsEmpty)
+{
+    EXPECT_TRUE(e2s(static_cast<RWBY>(4)).empty());
+    EXPECT_TRUE(e2s(static_cast<RWBY>(-1)).empty());
+    EXPECT_TRUE(e2s(static_cast<HttpStatus>(305)).empty());
+    EXPECT_TRUE(e2s(static_cast<HttpStatus>(500)).empty());
+}
+
+TEST(UEnumTest,s2e_KnownName_ReturnsValue)
+{
+    RWBY rwby = Ross;
+    EXPECT_TRUE(s2e(L"Yang",rwby));
+    EXPECT_EQ(Yang,rwby);
+    HttpStatus status = HttpOk;
+    EXPECT_TRUE(s2e(L"NotFound",status));
+    EXPECT_EQ(HttpNotFound,status);
+    EXPECT_TRUE(s2e(L"HttpSuccess",status));
+    EXPECT_EQ(HttpOk,status);
+}
+
+TEST(UEnumTest,s2e_UnknownName_ReturnsFalse)
+{
+    RWBY rwby = Blake;
+    EXPECT_FALSE(s2e(L"yang",rwby));
+    EXPECT_FALSE(s2e(L"",rwby));
+    EXPECT_EQ(Blake,rwby);
+    HttpStatus status = HttpTeapot;
+    EXPECT_FALSE(s2e(L"HttpNotFound",status));
+    EXPECT_EQ(HttpTeapot,status);
+}
+
+TEST(UEnumTest,uenum_entries_DeclarationOrder)
+{
+    const UEnumTable &entries = uenum_entries<RWBY>();
+    ASSERT_EQ(4,entries.size());
+    vector<wstring> names;
+    for(const UEnumEntry *it = entries.begin(); it != entries.end(); ++it)
+    {
+        EXPECT_EQ(it - entries.begin(),it->value);
+        names.push_back(it->name().str());
+    }
+    EXPECT_EQ(L"Ross",names[0]);
+    EXPECT_EQ(L"Blake",names[3]);
+    EXPECT_EQ(&uenum_entries<RWBY>(),&entries);
+}
@@ -0,0 +1,179 @@
+﻿#include "stdafx.h"
+
+#include "gtest/gtest.h"
+#include <Windows.h>
+#include <process.h>
+#include <stdio.h>
+#include "../UniCore/ULock.h"
+
+using namespace uni;
+
+namespace
+{
+    const int ThreadCount = 4;
+
+    struct Counter
+    {
+        Counter():value(0),shared(0),iterations(0) {}
+        ULock lock;
+        volatile ULock::Word shared;
+        int value;
+        int iterations;
+    };
+
+    unsigned int __stdcall increaseWithLock(void *param)
+    {
+        Counter *counter = static_cast<Counter *>(param);
+        for(int i = 0; i < counter->iterations; i++)
+        {
+            UScopedLock lock(counter->lock);
+            counter->value++;
+        }
+        return 0;
+    }
+
+    unsigned int __stdcall increaseWithSharedWord(void *param)
+    {
+        Counter *counter = static_cast<Counter *>(param);
+        for(int i = 0; i < counter->iterations; i++)
+        {
+            ULock::lockWord(&counter->shared,true);
+            counter->value++;
+            ULock::unlockWord(&counter->shared,true);
+        }
+        return 0;
+    }
+
+    //! 读者检查两个值是否一致,写者同时修改它们.
+    template<typename Lock>
+    struct Pair
+    {
+        Pair():first(0),second(0),mismatchCount(0) {}
+        Lock lock;
+        int first;
+        int second;
+        volatile long mismatchCount;
+    };
+
+    template<typename Lock>
+    unsigned int __stdcall readAndWrite(void *param)
+    {
+        Pair<Lock> *pair = static_cast<Pair<Lock> *>(param);
+        for(int i = 0; i < 100000; i++)
+        {
+            if(i % 100 == 0)
+            {
+                UScopedWriteLock<Lock> lock(pair->lock);
+                pair->first++;
+                pair->second++;
+            }
+            else
+            {
+                UScopedReadLock<Lock> lock(pair->lock);
+                if(pair->first != pair->second)
+                {
+                    InterlockedIncrement(&pair->mismatchCount);
+                }
+            }
+        }
+        return 0;
+    }
+
+    template<typename Param>
+    void runThreads(unsigned int (__stdcall *function)(void *),Param &param)
+    {
+        HANDLE threads[ThreadCount] = {0};
+        for(int i = 0; i < ThreadCount; i++)
+        {
+            threads[i] = reinterpret_cast<HANDLE>(_beginthreadex(NULL,0,function,&param,0,NULL));
+        }
+        WaitForMultipleObjects(ThreadCount,threads,TRUE,INFINITE);
+        for(int i = 0; i < ThreadCount; i++)
+        {
+            CloseHandle(threads[i]);
+        }
+    }
+}
+
+TEST(ULockTest,tryLock_Locked_ReturnsFalse)
+{
+    ULock lock;
+    EXPECT_TRUE(lock.tryLock());
+    EXPECT_FALSE(lock.tryLock());
+    lock.unlock();
+    EXPECT_TRUE(lock.tryLock());
+    lock.unlock();
+}
+
+TEST(ULockTest,lock_MultipleThreads_DataValid)
+{
+    Counter counter;
+    counter.iterations = 100000;
+    runThreads(increaseWithLock,counter);
+    EXPECT_EQ(ThreadCount * counter.iterations,counter.value);
+}
+
+TEST(ULockTest,lockWord_ProcessShared_DataValid)
+{
+    Counter counter;
+    counter.iterations = 20000;
+    runThreads(increaseWithSharedWord,counter);
+    EXPECT_EQ(ThreadCount * counter.iterations,counter.value);
+    EXPECT_EQ(0,counter.shared);
+}
+
+TEST(ULockTest,stats_Enabled_CountsAcquisitions)
+{
+    Counter counter;
+    counter.iterations = 100000;
+    EXPECT_EQ(0,counter.lock.stats().acquisitions);
+    counter.lock.lock();
+    counter.lock.unlock();
+    EXPECT_EQ(0,counter.lock.stats().acquisitions);
+
+    counter.lock.enableStats(true);
+    EXPECT_TRUE(counter.lock.tryLock());
+    counter.lock.unlock();
+    EXPECT_EQ(1,counter.lock.stats().acquisitions);
+    runThreads(increaseWithLock,counter);
+    ULockStats stats = counter.lock.stats();
+    EXPECT_EQ(1 + ThreadCount * counter.iterations,stats.acquisitions);
+    EXPECT_LE(stats.contentions,stats.acquisitions);
+    EXPECT_GE(stats.waitTime,0);
+
+    counter.lock.resetStats();
+    EXPECT_EQ(0,counter.lock.stats().acquisitions);
+    EXPECT_EQ(0,counter.lock.stats().contentions);
+}
+
+TEST(ULockTest,URWLock_ReadersAndWriters_DataValid)
+{
+    Pair<URWLock> pair;
+    runThreads(readAndWrite<URWLock>,pair);
+    EXPECT_EQ(0,pair.mismatchCount);
+    EXPECT_EQ(ThreadCount * 1000,pair.first);
+}
+
+TEST(ULockTest,UShardedLock_ReadersAndWriters_DataValid)
+{
+    Pair<UShardedLock<4> > pair;
+    runThreads(readAndWrite<UShardedLock<4> >,pair);
+    EXPECT_EQ(0,pair.mismatchCount);
+    EXPECT_EQ(ThreadCount * 1000,pair.first);
+}
+
+TEST(ULockTest,DISABLED_Benchmark_Contention)
+{
+    Counter counter;
+    counter.iterations = 1000000;
+    counter.lock.enableStats(true);
+    LARGE_INTEGER frequency,begin,end;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&begin);
+    runThreads(increaseWithLock,counter);
+    QueryPerformanceCounter(&end);
+    ULockStats stats = counter.lock.stats();
+    printf("%d threads: %.1f ns/lock, %lld contended, %lld us waiting\n",ThreadCount,
+        (end.QuadPart - begin.QuadPart) * 1e9 / frequency.QuadPart / (ThreadCount * counter.iterations),
+        stats.contentions,stats.waitTime);
+}
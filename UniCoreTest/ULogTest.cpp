@@ -2,9 +2,13 @@
 
 #include "gtest/gtest.h"
 #include "gmock/gmock.h"
+#include <crtdbg.h>
+#include <process.h>
 #include <vector>
 #include <string>
 #include "../UniCore/ULog.h"
+#include "../UniCore/ULogBinary.h"
+#include "../UniCore/UCompress.h"
 #include "../UniCore/UMiniLog.h"
 
 using namespace std;
@@ -23,6 +27,38 @@ public:
     int appendCount_;
 };
 
+//! 在gate_被打开之前,append会一直阻塞.
+class GatedAppender : public ULog::Appender
+{
+public:
+    GatedAppender() :appendCount_(0) {gate_ = CreateEventW(NULL,TRUE,FALSE,NULL);}
+    virtual ~GatedAppender() {CloseHandle(gate_);}
+    virtual void append(ULog::Message *message)
+    {
+        WaitForSingleObject(gate_,INFINITE);
+        InterlockedIncrement(&appendCount_);
+    }
+    void open() {SetEvent(gate_);}
+    HANDLE gate_;
+    volatile long appendCount_;
+};
+
+//! append中调用ULog::flush.
+class FlushingAppender : public ULog::Appender
+{
+public:
+    FlushingAppender() :flushCount_(0) {}
+    virtual void append(ULog::Message *message)
+    {
+        ULog::flush();
+    }
+    virtual void flush()
+    {
+        InterlockedIncrement(&flushCount_);
+    }
+    volatile long flushCount_;
+};
+
 class StubAppender : public ULog::Appender
 {
 public:
@@ -32,6 +68,37 @@ public:
     }
 };
 
+TEST(ULogMessageTest,reset_UsedMessage_StateCleared)
+{
+    ULog::Message message(ULog::DebugType,"file",56,"TestFunction");
+    message.name_ = "name";
+    message.delim_ = L",";
+    message.delimEnabled_ = false;
+    message.stm_<<std::hex<<std::setw(8)<<std::setfill(L'0')<<255;
+    message.reset(ULog::InfoType,"file2",57,"TestFunction2");
+    EXPECT_EQ(ULog::InfoType,message.type_);
+    EXPECT_EQ("",message.name_);
+    EXPECT_STREQ("file2",message.file_);
+    EXPECT_STREQ("TestFunction2",message.func_);
+    EXPECT_EQ(57,message.line_);
+    EXPECT_TRUE(message.delim_.empty());
+    EXPECT_TRUE(message.delimEnabled_);
+    EXPECT_EQ(L"",message.stm_.str());
+    message.stm_<<std::setw(0)<<255;
+    EXPECT_EQ(L"255",message.stm_.str());
+}
+
+TEST(ULogMessageTest,stm_LongMessage_DataValid)
+{
+    ULog::Message message(ULog::DebugType,"file",56,"TestFunction");
+    std::wstring expected(1000,L'a');
+    message.stm_<<expected<<L'b';
+    expected += L'b';
+    EXPECT_EQ(expected,message.stm_.str());
+    message.stm_.truncate(3);
+    EXPECT_EQ(L"aaa",message.stm_.str());
+}
+
 class ULogTest : public ::testing::Test
 {
 public:
@@ -53,8 +120,8 @@ TEST(ULogMessageTest,Ctor_Valid)
     EXPECT_EQ(1,message.ref_);
     EXPECT_EQ(ULog::DebugType,message.type_);
     EXPECT_EQ("",message.name_);
-    EXPECT_EQ("file",message.file_);
-    EXPECT_EQ("TestFunction",message.func_);
+    EXPECT_STREQ("file",message.file_);
+    EXPECT_STREQ("TestFunction",message.func_);
     EXPECT_EQ(56,message.line_);
     EXPECT_TRUE(message.delim_.empty());
     EXPECT_TRUE(message.delimEnabled_);
@@ -499,4 +566,535 @@ TEST_F(ULogTest,delim_EmptyStringDelim_TwoInput_DataValid)
     ULog::setAppenders("","mock");
     UINFO<<delim(L"")<<"butter"<<"fly";
     ASSERT_EQ(L"butterfly",mockAppender->message_);
-}
\ No newline at end of file
+}
+
+TEST_F(ULogTest,enableAsyncOutput_IsAsyncOutputEnabled_ReturnsTrue)
+{
+    EXPECT_FALSE(ULog::isAsyncOutputEnabled());
+    ULog::enableAsyncOutput();
+    EXPECT_TRUE(ULog::isAsyncOutputEnabled());
+    ULog::disableAsyncOutput();
+    EXPECT_FALSE(ULog::isAsyncOutputEnabled());
+}
+
+TEST_F(ULogTest,asyncOutput_Flush_MessageAppended)
+{
+    MockAppender *mockAppender = new MockAppender;
+    ULog::registerAppender("mock",mockAppender);
+    ULog::setAppenders("","mock");
+    ULog::enableAsyncOutput();
+    UINFO<<"async"<<1;
+    ULog::flush();
+    EXPECT_EQ(1,mockAppender->appendCount_);
+    EXPECT_EQ(L"async1",mockAppender->message_);
+}
+
+TEST_F(ULogTest,asyncOutput_DisableAsyncOutput_QueueDrained)
+{
+    MockAppender *mockAppender = new MockAppender;
+    ULog::registerAppender("mock",mockAppender);
+    ULog::setAppenders("","mock");
+    ULog::enableAsyncOutput(16,ULog::BlockWhenFull);
+    for(int i = 0; i < 100; i++)
+    {
+        UINFO<<i;
+    }
+    ULog::disableAsyncOutput();
+    EXPECT_EQ(100,mockAppender->appendCount_);
+    EXPECT_EQ(L"99",mockAppender->message_);
+    EXPECT_EQ(0,ULog::droppedMessageCount());
+}
+
+TEST_F(ULogTest,asyncOutput_DropNewestWhenFull_MessagesDropped)
+{
+    GatedAppender *gatedAppender = new GatedAppender;
+    ULog::registerAppender("gated",gatedAppender);
+    ULog::setAppenders("","gated");
+    ULog::enableAsyncOutput(4,ULog::DropNewest);
+    for(int i = 0; i < 20; i++)
+    {
+        UINFO<<i;
+    }
+    gatedAppender->open();
+    ULog::flush();
+    EXPECT_LT(0,ULog::droppedMessageCount());
+    EXPECT_EQ(20,gatedAppender->appendCount_ + ULog::droppedMessageCount());
+}
+
+TEST_F(ULogTest,asyncOutput_DropOldestWhenFull_LatestMessageKept)
+{
+    MockAppender *mockAppender = new MockAppender;
+    GatedAppender *gatedAppender = new GatedAppender;
+    ULog::registerAppender("gated",gatedAppender);
+    ULog::registerAppender("mock",mockAppender);
+    ULog::setAppenders("","gated mock");
+    ULog::enableAsyncOutput(4,ULog::DropOldest);
+    for(int i = 0; i < 20; i++)
+    {
+        UINFO<<i;
+    }
+    gatedAppender->open();
+    ULog::flush();
+    EXPECT_LT(0,ULog::droppedMessageCount());
+    EXPECT_EQ(L"19",mockAppender->message_);
+}
+
+TEST_F(ULogTest,flush_CalledInAppend_NoDeadlock)
+{
+    FlushingAppender *flushingAppender = new FlushingAppender;
+    MockAppender *mockAppender = new MockAppender;
+    ULog::registerAppender("flushing",flushingAppender);
+    ULog::registerAppender("mock",mockAppender);
+    ULog::setAppenders("","flushing mock");
+    UINFO<<"sync";
+    EXPECT_EQ(1,flushingAppender->flushCount_);
+    EXPECT_EQ(L"sync",mockAppender->message_);
+
+    ULog::enableAsyncOutput();
+    UINFO<<"async";
+    ULog::flush();
+    EXPECT_EQ(3,flushingAppender->flushCount_);
+    EXPECT_EQ(L"async",mockAppender->message_);
+}
+
+namespace
+{
+    int evaluateCount = 0;
+    int countEvaluation()
+    {
+        return ++evaluateCount;
+    }
+}
+
+TEST_F(ULogTest,enableOutput_TypeDisabled_ArgumentsNotEvaluated)
+{
+    MockAppender *mockAppender = new MockAppender;
+    ULog::registerAppender("mock",mockAppender);
+    ULog::setAppenders("","mock");
+    evaluateCount = 0;
+    ULog::enableOutput(ULog::DebugType,false);
+    EXPECT_FALSE(ULog::isOutputEnabled(ULog::DebugType));
+    EXPECT_TRUE(ULog::isOutputEnabled(ULog::InfoType));
+    UDEBUG<<countEvaluation();
+    EXPECT_EQ(0,evaluateCount);
+    EXPECT_EQ(0,mockAppender->appendCount_);
+    ULog::enableOutput(ULog::DebugType,true);
+    UDEBUG<<countEvaluation();
+    EXPECT_EQ(1,evaluateCount);
+    EXPECT_EQ(L"1",mockAppender->message_);
+}
+
+namespace
+{
+    void logToConstantGroup()
+    {
+        UINFO("group")<<countEvaluation();
+    }
+
+    void logToGroup(const char *group)
+    {
+        UINFO(group)<<countEvaluation();
+    }
+}
+
+TEST_F(ULogTest,enableOutput_ConstantGroupDisabled_SiteSkipsArguments)
+{
+    MockAppender *mockAppender = new MockAppender;
+    ULog::registerAppender("mock",mockAppender);
+    ULog::setAppenders("","mock");
+    ULog::enableOutput("group",false);
+    evaluateCount = 0;
+    for(int i = 0; i < 3; i++)
+    {
+        logToConstantGroup();
+    }
+    //第一次执行时才知道分组被过滤,之后直接跳过.
+    EXPECT_EQ(1,evaluateCount);
+    EXPECT_EQ(0,mockAppender->appendCount_);
+    ULog::enableOutput("group",true);
+    logToConstantGroup();
+    EXPECT_EQ(2,evaluateCount);
+    EXPECT_EQ(L"2",mockAppender->message_);
+}
+
+TEST_F(ULogTest,enableOutput_GroupPointerChanges_NotCached)
+{
+    MockAppender *mockAppender = new MockAppender;
+    ULog::registerAppender("mock",mockAppender);
+    ULog::setAppenders("","mock");
+    ULog::enableOutput("group",false);
+    evaluateCount = 0;
+    logToGroup("group");
+    logToGroup("group");
+    EXPECT_EQ(0,mockAppender->appendCount_);
+    logToGroup("other");
+    EXPECT_EQ(1,mockAppender->appendCount_);
+    EXPECT_EQ(i2ws(evaluateCount),mockAppender->message_);
+}
+
+TEST_F(ULogTest,enableOutput_NameDisabled_NotAppended)
+{
+    MockAppender *mockAppender = new MockAppender;
+    ULog::registerAppender("mock",mockAppender);
+    ULog::setAppenders("","mock");
+    ULog::setAppenders("group","mock");
+    ULog::enableOutput("group",false);
+    EXPECT_FALSE(ULog::isOutputEnabled("group"));
+    EXPECT_TRUE(ULog::isOutputEnabled("other"));
+    UINFO("group")<<"filtered";
+    EXPECT_EQ(0,mockAppender->appendCount_);
+    UINFO("other")<<"other";
+    EXPECT_EQ(L"other",mockAppender->message_);
+    ULog::enableOutput("group",true);
+    UINFO("group")<<"group";
+    EXPECT_EQ(L"group",mockAppender->message_);
+}
+
+TEST_F(ULogTest,restoreDefaultSettings_FiltersCleared)
+{
+    ULog::enableOutput(ULog::TraceType,false);
+    ULog::enableOutput("group",false);
+    ULog::restoreDefaultSettings();
+    EXPECT_TRUE(ULog::isOutputEnabled(ULog::TraceType));
+    EXPECT_TRUE(ULog::isOutputEnabled("group"));
+}
+
+TEST_F(ULogTest,BinaryFileAppender_ReadBack_DataValid)
+{
+    wchar_t tempPath[MAX_PATH] = L"";
+    GetTempPathW(MAX_PATH,tempPath);
+    wstringstream baseName;
+    baseName<<tempPath<<L"ulog_binary_test_"<<GetCurrentProcessId();
+    //分段很小,保证会写多个分段.
+    ULog::registerAppender("binary",new ULog::BinaryFileAppender(baseName.str().c_str(),4096));
+    ULog::setAppenders("","binary");
+    const int line = __LINE__ + 1;
+    UWARN("group")<<L"中文"<<1;
+    for(int i = 0; i < 200; i++)
+    {
+        UINFO<<i;
+    }
+    ULog::unregisterAppender("binary");
+
+    int count = 0;
+    for(int segment = 0; ; segment++)
+    {
+        wchar_t suffix[32] = L"";
+        swprintf_s(suffix,L".%06d.ulb",segment);
+        const wstring fileName = baseName.str() + suffix;
+        ULogBinaryReader reader;
+        if(!reader.open(fileName.c_str()))
+        {
+            break;
+        }
+        ULogBinaryReader::Entry entry;
+        while(reader.next(entry))
+        {
+            if(!count)
+            {
+                EXPECT_EQ(ULog::WarnType,entry.type_);
+                EXPECT_EQ("group",entry.name_);
+                EXPECT_EQ(__FILE__,entry.file_);
+                EXPECT_EQ(__FUNCTION__,entry.func_);
+                EXPECT_EQ(line,entry.line_);
+                EXPECT_EQ(L"中文1",s2ws(entry.message_,CP_UTF8));
+                EXPECT_LE(entry.time_,time(0));
+            }
+            else
+            {
+                EXPECT_EQ(ULog::InfoType,entry.type_);
+                EXPECT_EQ("",entry.name_);
+                EXPECT_EQ(i2s(count - 1),entry.message_);
+            }
+            count++;
+        }
+        EXPECT_FALSE(reader.isCorrupted());
+        DeleteFileW(fileName.c_str());
+    }
+    EXPECT_EQ(201,count);
+}
+
+TEST_F(ULogTest,BinaryFileReader_TruncatedRecord_Corrupted)
+{
+    wchar_t tempPath[MAX_PATH] = L"";
+    GetTempPathW(MAX_PATH,tempPath);
+    wstringstream fileName;
+    fileName<<tempPath<<L"ulog_binary_truncated_"<<GetCurrentProcessId()<<L".ulb";
+    const ULogBinaryRecordKind kinds[] = {ULogBinaryNameKind,ULogBinarySiteKind,ULogBinaryMessageKind};
+    for(int i = 0; i < sizeof(kinds) / sizeof(kinds[0]); i++)
+    {
+        //文件以一个只有记录头的记录结尾,读取记录的固定部分会越过文件末尾.
+        ULogBinaryFileHeader fileHeader = {{'U','L','O','G','B','I','N','1'},1,sizeof(ULogBinaryFileHeader),1};
+        ULogBinaryRecordHeader recordHeader = {sizeof(ULogBinaryRecordHeader),
+            static_cast<unsigned short>(kinds[i]),0};
+        {
+            ofstream file(fileName.str().c_str(),ios_base::out|ios_base::binary|ios_base::trunc);
+            file.write(reinterpret_cast<const char *>(&fileHeader),sizeof(fileHeader));
+            file.write(reinterpret_cast<const char *>(&recordHeader),sizeof(recordHeader));
+        }
+        ULogBinaryReader reader;
+        ASSERT_TRUE(reader.open(fileName.str().c_str()));
+        ULogBinaryReader::Entry entry;
+        EXPECT_FALSE(reader.next(entry))<<kinds[i];
+        EXPECT_TRUE(reader.isCorrupted())<<kinds[i];
+    }
+    DeleteFileW(fileName.str().c_str());
+}
+
+TEST_F(ULogTest,RollingFileAppender_MaxSize_OldGenerationsCompressedAndRemoved)
+{
+    wchar_t tempPath[MAX_PATH] = L"";
+    GetTempPathW(MAX_PATH,tempPath);
+    wstringstream directory;
+    directory<<tempPath<<L"ulog_rolling_test_"<<GetCurrentProcessId()<<L"\\";
+    CreateDirectoryW(directory.str().c_str(),NULL);
+    const wstring fileName = directory.str() + L"app.log";
+    ULog::registerAppender("rolling",new ULog::RollingFileAppender(fileName.c_str(),1024,0,2));
+    ULog::setAppenders("","rolling");
+    for(int i = 0; i < 200; i++)
+    {
+        UINFO<<L"rolling file appender test line "<<i;
+    }
+    //析构时等待后台线程压缩完.
+    ULog::unregisterAppender("rolling");
+
+    vector<wstring> files;
+    WIN32_FIND_DATAW findData;
+    HANDLE find = FindFirstFileW((directory.str() + L"*").c_str(),&findData);
+    ASSERT_NE(INVALID_HANDLE_VALUE,find);
+    do
+    {
+        if(!(findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+        {
+            files.push_back(directory.str() + findData.cFileName);
+        }
+    }while(FindNextFileW(find,&findData));
+    FindClose(find);
+
+    //当前文件加上保留的两个压缩文件.
+    EXPECT_EQ(3u,files.size());
+    int compressedCount = 0;
+    for(vector<wstring>::const_iterator it = files.begin(); it != files.end(); ++it)
+    {
+        if(it->size() > 4 && it->substr(it->size() - 4) == L".ulz")
+        {
+            compressedCount++;
+            const wstring unpacked = *it + L".txt";
+            EXPECT_TRUE(decompressFile(it->c_str(),unpacked.c_str()));
+            ifstream file(unpacked.c_str());
+            string content((istreambuf_iterator<char>(file)),istreambuf_iterator<char>());
+            file.close();
+            EXPECT_NE(string::npos,content.find("rolling file appender test line"));
+            DeleteFileW(unpacked.c_str());
+        }
+        DeleteFileW(it->c_str());
+    }
+    EXPECT_EQ(2,compressedCount);
+    RemoveDirectoryW(directory.str().c_str());
+}
+
+TEST_F(ULogTest,RollingFileAppender_UnrelatedFilesBesideLog_Kept)
+{
+    wchar_t tempPath[MAX_PATH] = L"";
+    GetTempPathW(MAX_PATH,tempPath);
+    wstringstream directory;
+    directory<<tempPath<<L"ulog_rolling_unrelated_"<<GetCurrentProcessId()<<L"\\";
+    CreateDirectoryW(directory.str().c_str(),NULL);
+    const wstring fileName = directory.str() + L"app.log";
+    //一个之前滚动出来还没有压缩的文件,和两个能被通配符匹配到的无关文件.
+    const wstring rolled = directory.str() + L"app.20000101_000000.log";
+    const wstring unrelated[] = {directory.str() + L"app.backup.log.old",directory.str() + L"app.old.log"};
+    {
+        ofstream file(rolled.c_str());
+        file<<"rolled";
+    }
+    for(int i = 0; i < 2; i++)
+    {
+        ofstream file(unrelated[i].c_str());
+        file<<"unrelated";
+    }
+    delete new ULog::RollingFileAppender(fileName.c_str(),1024,0,1);
+
+    EXPECT_EQ(INVALID_FILE_ATTRIBUTES,GetFileAttributesW(rolled.c_str()));
+    EXPECT_NE(INVALID_FILE_ATTRIBUTES,GetFileAttributesW((rolled + L".ulz").c_str()));
+    for(int i = 0; i < 2; i++)
+    {
+        ifstream file(unrelated[i].c_str());
+        string content((istreambuf_iterator<char>(file)),istreambuf_iterator<char>());
+        file.close();
+        EXPECT_EQ("unrelated",content);
+        EXPECT_EQ(INVALID_FILE_ATTRIBUTES,GetFileAttributesW((unrelated[i] + L".ulz").c_str()));
+        DeleteFileW(unrelated[i].c_str());
+    }
+    DeleteFileW((rolled + L".ulz").c_str());
+    DeleteFileW(fileName.c_str());
+    RemoveDirectoryW(directory.str().c_str());
+}
+
+namespace
+{
+    unsigned int __stdcall logLines(void *)
+    {
+        for(int i = 0; i < 10000; i++)
+        {
+            UINFO("group")<<i;
+        }
+        return 0;
+    }
+}
+
+TEST_F(ULogTest,uLog_MultipleThreads_AllAppended)
+{
+    MockAppender *mockAppender = new MockAppender;
+    ULog::registerAppender("mock",mockAppender);
+    ULog::setAppenders("","mock");
+    HANDLE threads[4] = {0};
+    for(int i = 0; i < 4; i++)
+    {
+        threads[i] = reinterpret_cast<HANDLE>(_beginthreadex(NULL,0,logLines,NULL,0,NULL));
+    }
+    WaitForMultipleObjects(4,threads,TRUE,INFINITE);
+    for(int i = 0; i < 4; i++)
+    {
+        CloseHandle(threads[i]);
+    }
+    EXPECT_EQ(40000,mockAppender->appendCount_);
+    EXPECT_EQ(1,ULog::names().count("group"));
+}
+
+TEST_F(ULogTest,ULOGF_AllArgumentTypes_DataValid)
+{
+    MockAppender *mockAppender = new MockAppender;
+    ULog::registerAppender("mock",mockAppender);
+    ULog::setAppenders("","mock");
+    ULOGF(ULog::InfoType,"","{} {} {} {} {} {}",true,'c',L'w',-1,42u,2.5);
+    EXPECT_EQ(L"1 c w -1 42 2.5",mockAppender->message_);
+    const std::string s = "string";
+    const char *null = 0;
+    UINFOF("","{},{},{},{}",s,std::wstring(L"wstring"),"narrow",null);
+    EXPECT_EQ(L"string,wstring,narrow,(null)",mockAppender->message_);
+    UINFOF("","no arguments");
+    EXPECT_EQ(L"no arguments",mockAppender->message_);
+    UINFOF("","{{{}}}",1);
+    EXPECT_EQ(L"{1}",mockAppender->message_);
+}
+
+TEST_F(ULogTest,ULOGF_Filtered_ArgumentsNotCaptured)
+{
+    MockAppender *mockAppender = new MockAppender;
+    ULog::registerAppender("mock",mockAppender);
+    ULog::setAppenders("","mock");
+    ULog::setAppenders("group","mock");
+    evaluateCount = 0;
+    ULog::enableOutput(ULog::DebugType,false);
+    UDEBUGF("","{}",countEvaluation());
+    EXPECT_EQ(0,evaluateCount);
+    ULog::enableOutput("group",false);
+    UINFOF("group","{}",1);
+    EXPECT_EQ(0,mockAppender->appendCount_);
+    UINFOF("","{}",2);
+    EXPECT_EQ(L"2",mockAppender->message_);
+}
+
+namespace
+{
+    void logfToConstantGroup()
+    {
+        UINFOF("group","{}",countEvaluation());
+    }
+}
+
+TEST_F(ULogTest,ULOGF_ConstantGroupDisabled_SiteSkipsArguments)
+{
+    MockAppender *mockAppender = new MockAppender;
+    ULog::registerAppender("mock",mockAppender);
+    ULog::setAppenders("","mock");
+    ULog::enableOutput("group",false);
+    evaluateCount = 0;
+    for(int i = 0; i < 3; i++)
+    {
+        logfToConstantGroup();
+    }
+    EXPECT_EQ(1,evaluateCount);
+    EXPECT_EQ(0,mockAppender->appendCount_);
+    ULog::enableOutput("group",true);
+    logfToConstantGroup();
+    EXPECT_EQ(2,evaluateCount);
+    EXPECT_EQ(L"2",mockAppender->message_);
+}
+
+TEST_F(ULogTest,ULOGF_AsyncOutput_FormattedBeforeAppend)
+{
+    MockAppender *mockAppender = new MockAppender;
+    ULog::registerAppender("mock",mockAppender);
+    ULog::setAppenders("","mock");
+    ULog::enableAsyncOutput();
+    {
+        std::string temporary = "temporary";
+        UINFOF("","{} {}",temporary,3);
+    }
+    ULog::flush();
+    EXPECT_EQ(L"temporary 3",mockAppender->message_);
+}
+
+TEST_F(ULogTest,setMessageCacheSize_Zero_DataValid)
+{
+    MockAppender *mockAppender = new MockAppender;
+    ULog::registerAppender("mock",mockAppender);
+    ULog::setAppenders("","mock");
+    ULog::setMessageCacheSize(0);
+    UINFO<<L"first";
+    EXPECT_EQ(L"first",mockAppender->message_);
+    ULog::setMessageCacheSize(32);
+    UINFO<<L"second"<<2;
+    EXPECT_EQ(L"second2",mockAppender->message_);
+}
+
+#ifdef _DEBUG
+namespace
+{
+    volatile long allocationCount = 0;
+    int countAllocations(int allocType,void *,size_t,int,long,const unsigned char *,int)
+    {
+        if(allocType == _HOOK_ALLOC || allocType == _HOOK_REALLOC)
+        {
+            InterlockedIncrement(&allocationCount);
+        }
+        return TRUE;
+    }
+}
+#endif
+
+//! 比较每行日志的耗时和堆分配次数(只有Debug版能统计分配次数).
+TEST_F(ULogTest,DISABLED_Benchmark_MessageCache)
+{
+    const int lineCount = 100000;
+    ULog::registerAppender("stub",new StubAppender);
+    ULog::setAppenders("","stub");
+
+    LARGE_INTEGER frequency,begin,end;
+    QueryPerformanceFrequency(&frequency);
+    const int cacheSizes[] = {0,32};
+    for(int i = 0; i < sizeof(cacheSizes) / sizeof(cacheSizes[0]); i++)
+    {
+        ULog::setMessageCacheSize(cacheSizes[i]);
+        UINFO<<"warm up";
+#ifdef _DEBUG
+        allocationCount = 0;
+        _CRT_ALLOC_HOOK oldHook = _CrtSetAllocHook(countAllocations);
+#endif
+        QueryPerformanceCounter(&begin);
+        for(int j = 0; j < lineCount; j++)
+        {
+            UINFO<<L"benchmark line "<<j<<L" value "<<3.5;
+        }
+        QueryPerformanceCounter(&end);
+#ifdef _DEBUG
+        _CrtSetAllocHook(oldHook);
+        printf("cache size %d: %.3f allocations/line\n",cacheSizes[i],
+            (double)allocationCount / lineCount);
+#endif
+        printf("cache size %d: %.1f ns/line\n",cacheSizes[i],
+            (end.QuadPart - begin.QuadPart) * 1e9 / frequency.QuadPart / lineCount);
+    }
+}
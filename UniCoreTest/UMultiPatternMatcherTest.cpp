@@ -0,0 +1,230 @@
+﻿#include "stdafx.h"
+
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include <Windows.h>
+#include "../UniCore/UMultiPatternMatcher.h"
+
+using namespace std;
+using namespace uni;
+
+namespace
+{
+    bool earlierMatch(const UPatternMatch &a,const UPatternMatch &b)
+    {
+        const size_t endA = a.offset + a.size;
+        const size_t endB = b.offset + b.size;
+        if(endA != endB)
+        {
+            return endA < endB;
+        }
+        if(a.size != b.size)
+        {
+            return a.size > b.size;
+        }
+        return a.pattern < b.pattern;
+    }
+
+    //! 逐个pattern查找,作为对照.
+    vector<UPatternMatch> findAllByFind(const string &text,const vector<string> &patterns,
+        CaseSensitivity caseSensitivity)
+    {
+        vector<UPatternMatch> matches;
+        for(size_t i = 0; i < patterns.size(); i++)
+        {
+            if(patterns[i].empty())
+            {
+                continue;
+            }
+            for(size_t offset = 0; offset + patterns[i].size() <= text.size(); offset++)
+            {
+                const bool found = caseSensitivity == CaseSensitive
+                    ? text.compare(offset,patterns[i].size(),patterns[i]) == 0
+                    : find_case_insensitive(UStringView(text).substr(offset,patterns[i].size()),patterns[i]) == 0;
+                if(found)
+                {
+                    UPatternMatch match = {i,offset,patterns[i].size()};
+                    matches.push_back(match);
+                }
+            }
+        }
+        sort(matches.begin(),matches.end(),earlierMatch);
+        return matches;
+    }
+
+    string randomString(const char *alphabet,size_t alphabetSize,size_t size)
+    {
+        string result(size,'\0');
+        for(size_t i = 0; i < size; i++)
+        {
+            result[i] = alphabet[rand() % alphabetSize];
+        }
+        return result;
+    }
+}
+
+TEST(UMultiPatternMatcherTest,findAll_Overlapping_AllReported)
+{
+    UMultiPatternMatcher matcher;
+    matcher.addPattern("he");
+    matcher.addPattern("she");
+    matcher.addPattern("his");
+    matcher.addPattern("hers");
+    matcher.build();
+    vector<UPatternMatch> matches;
+    EXPECT_EQ(3,matcher.findAll("ushers",matches));
+    ASSERT_EQ(3,matches.size());
+    EXPECT_EQ(1,matches[0].pattern);
+    EXPECT_EQ(1,matches[0].offset);
+    EXPECT_EQ(0,matches[1].pattern);
+    EXPECT_EQ(2,matches[1].offset);
+    EXPECT_EQ(3,matches[2].pattern);
+    EXPECT_EQ(2,matches[2].offset);
+    EXPECT_EQ(4,matches[2].size);
+}
+
+TEST(UMultiPatternMatcherTest,findAll_SameAsFind)
+{
+    const char alphabet[] = "abAB\x80\xff";
+    srand(2);
+    for(int round = 0; round < 300; round++)
+    {
+        const CaseSensitivity caseSensitivity = (round % 2) ? CaseSensitive : CaseInsensitive;
+        UMultiPatternMatcher matcher(caseSensitivity);
+        vector<string> patterns;
+        const int patternCount = 1 + rand() % 10;
+        for(int i = 0; i < patternCount; i++)
+        {
+            patterns.push_back(randomString(alphabet,6,rand() % 5));
+            EXPECT_EQ(i,matcher.addPattern(patterns.back()));
+        }
+        matcher.build();
+        const string text = randomString(alphabet,6,rand() % 100);
+        vector<UPatternMatch> matches;
+        matcher.findAll(text,matches);
+        const vector<UPatternMatch> expected = findAllByFind(text,patterns,caseSensitivity);
+        ASSERT_EQ(expected.size(),matches.size())<<text;
+        for(size_t i = 0; i < matches.size(); i++)
+        {
+            EXPECT_EQ(expected[i].pattern,matches[i].pattern);
+            EXPECT_EQ(expected[i].offset,matches[i].offset);
+            EXPECT_EQ(expected[i].size,matches[i].size);
+        }
+        EXPECT_EQ(!expected.empty(),matcher.matchesAny(text));
+    }
+}
+
+TEST(UMultiPatternMatcherTest,findFirst_ReturnsEarliestEnd)
+{
+    UMultiPatternMatcher matcher(CaseInsensitive);
+    matcher.addPattern("timeout");
+    matcher.addPattern("OUT");
+    matcher.build();
+    UPatternMatch match;
+    ASSERT_TRUE(matcher.findFirst("connection TIMEOUT",match));
+    EXPECT_EQ(0,match.pattern);
+    EXPECT_EQ(11,match.offset);
+    EXPECT_FALSE(matcher.findFirst("connected",match));
+}
+
+TEST(UMultiPatternMatcherTest,EmptyOrNotBuilt_NothingMatches)
+{
+    UMultiPatternMatcher matcher;
+    EXPECT_FALSE(matcher.matchesAny("abc"));
+    matcher.addPattern("");
+    matcher.build();
+    EXPECT_FALSE(matcher.matchesAny("abc"));
+    EXPECT_FALSE(matcher.matchesAny(""));
+    matcher.addPattern("b");
+    EXPECT_FALSE(matcher.matchesAny("abc"));
+    matcher.build();
+    EXPECT_TRUE(matcher.matchesAny("abc"));
+    matcher.clear();
+    EXPECT_EQ(0,matcher.patternCount());
+    EXPECT_FALSE(matcher.matchesAny("abc"));
+}
+
+TEST(UMultiPatternMatcherTest,BinaryData_Works)
+{
+    UMultiPatternMatcher matcher;
+    matcher.addPattern(UStringView("\x00\x01",2));
+    matcher.build();
+    const char data[] = {0x05,0x00,0x01,0x00,0x01};
+    vector<UPatternMatch> matches;
+    EXPECT_EQ(2,matcher.findAll(UStringView(data,sizeof(data)),matches));
+    EXPECT_EQ(1,matches[0].offset);
+    EXPECT_EQ(3,matches[1].offset);
+}
+
+TEST(UMultiPatternMatcherTest,Wide_CaseInsensitive_Works)
+{
+    UWMultiPatternMatcher matcher(CaseInsensitive);
+    matcher.addPattern(L"\x9519\x8bef");
+    matcher.addPattern(L"Error");
+    matcher.build();
+    vector<UPatternMatch> matches;
+    EXPECT_EQ(2,matcher.findAll(L"[ERROR]\x53d1\x751f\x9519\x8bef",matches));
+    EXPECT_EQ(1,matches[0].pattern);
+    EXPECT_EQ(1,matches[0].offset);
+    EXPECT_EQ(0,matches[1].pattern);
+    EXPECT_EQ(9,matches[1].offset);
+    EXPECT_FALSE(matcher.matchesAny(L"\x9519 warning"));
+}
+
+TEST(UMultiPatternMatcherTest,DISABLED_Benchmark_ManyKeywords)
+{
+    srand(3);
+    vector<string> keywords;
+    UMultiPatternMatcher matcher(CaseInsensitive);
+    for(int i = 0; i < 2000; i++)
+    {
+        keywords.push_back(randomString("abcdefghijklmnopqrstuvwxyz",26,6 + rand() % 6));
+        matcher.addPattern(keywords.back());
+    }
+    LARGE_INTEGER frequency,begin,end;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&begin);
+    matcher.build();
+    QueryPerformanceCounter(&end);
+    printf("build: %d states, %.2f ms\n",static_cast<int>(matcher.stateCount()),
+        1000.0 * (end.QuadPart - begin.QuadPart) / frequency.QuadPart);
+
+    vector<string> lines;
+    size_t total = 0;
+    while(total < 1024 * 1024)
+    {
+        lines.push_back(randomString("abcdefghijklmnopqrstuvwxyz ",27,100));
+        total += lines.back().size();
+    }
+    const double megabytes = total / (1024.0 * 1024.0);
+
+    QueryPerformanceCounter(&begin);
+    size_t expected = 0;
+    for(size_t i = 0; i < lines.size(); i++)
+    {
+        for(size_t j = 0; j < keywords.size(); j++)
+        {
+            if(contains(lines[i],keywords[j],CaseInsensitive))
+            {
+                expected++;
+                break;
+            }
+        }
+    }
+    QueryPerformanceCounter(&end);
+    printf("contains loop: %.2f MB/s\n",megabytes * frequency.QuadPart / (end.QuadPart - begin.QuadPart));
+
+    QueryPerformanceCounter(&begin);
+    size_t count = 0;
+    for(size_t i = 0; i < lines.size(); i++)
+    {
+        count += matcher.matchesAny(lines[i]);
+    }
+    QueryPerformanceCounter(&end);
+    printf("UMultiPatternMatcher: %.2f MB/s\n",megabytes * frequency.QuadPart / (end.QuadPart - begin.QuadPart));
+    EXPECT_EQ(expected,count);
+}
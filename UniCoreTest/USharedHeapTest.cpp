@@ -0,0 +1,277 @@
+﻿#include "stdafx.h"
+
+#include "gtest/gtest.h"
+#include <Windows.h>
+#include <process.h>
+#include <stdio.h>
+#include <vector>
+
+#include "../UniCore/USharedHeap.h"
+#include "../UniCore/USharedMemory.h"
+
+using namespace std;
+using namespace uni;
+
+class USharedHeapTest : public ::testing::Test
+{
+public:
+    enum {HeapOffset = 64,SegmentSize = 0x10000};
+
+    virtual void SetUp()
+    {
+        memory_.assign(SegmentSize / sizeof(long long),0);
+        ASSERT_TRUE(USharedHeap::format(&memory_[0],HeapOffset,SegmentSize));
+        heap_.attach(&memory_[0],HeapOffset);
+        initial_ = heap_.statistics();
+    }
+
+    vector<long long> memory_;  //按8字节对齐.
+    USharedHeap heap_;
+    USharedHeapStatistics initial_;
+};
+
+TEST_F(USharedHeapTest,Format_OneFreeBlock)
+{
+    EXPECT_EQ(1,initial_.freeBlocks);
+    EXPECT_EQ(0,initial_.usedBlocks);
+    EXPECT_EQ(initial_.totalBytes,initial_.freeBytes);
+    EXPECT_LT(SegmentSize - 0x800,initial_.largestFreeBlock);
+    EXPECT_EQ(0.0,initial_.fragmentation());
+}
+
+TEST_F(USharedHeapTest,Format_TooSmall_Fails)
+{
+    EXPECT_FALSE(USharedHeap::format(&memory_[0],HeapOffset,HeapOffset + sizeof(USharedHeapHeader)));
+}
+
+TEST_F(USharedHeapTest,Alloc_AlignedAndDisjoint)
+{
+    char *a = static_cast<char *>(heap_.alloc(1));
+    char *b = static_cast<char *>(heap_.alloc(100));
+    char *c = static_cast<char *>(heap_.alloc(3000));
+    ASSERT_TRUE(a && b && c);
+    EXPECT_EQ(0,reinterpret_cast<size_t>(a) % 8);
+    EXPECT_EQ(0,reinterpret_cast<size_t>(b) % 8);
+    EXPECT_EQ(0,reinterpret_cast<size_t>(c) % 8);
+    EXPECT_LE(1,heap_.usableSize(a));
+    EXPECT_LE(100,heap_.usableSize(b));
+    EXPECT_LE(3000,heap_.usableSize(c));
+    EXPECT_LE(a + heap_.usableSize(a),b);
+    EXPECT_LE(b + heap_.usableSize(b),c);
+    memset(a,1,heap_.usableSize(a));
+    memset(b,2,heap_.usableSize(b));
+    memset(c,3,heap_.usableSize(c));
+    EXPECT_EQ(1,a[0]);
+    EXPECT_EQ(2,b[99]);
+    EXPECT_EQ(3,c[2999]);
+}
+
+TEST_F(USharedHeapTest,Alloc_ZeroOrTooLarge_ReturnsZero)
+{
+    EXPECT_TRUE(heap_.alloc(0) == 0);
+    EXPECT_TRUE(heap_.alloc(SegmentSize) == 0);
+    EXPECT_EQ(1,heap_.statistics().failedAllocations);
+}
+
+TEST_F(USharedHeapTest,Alloc_Exhausted_ReturnsZero)
+{
+    vector<void *> blocks;
+    while(void *p = heap_.alloc(1000))
+    {
+        blocks.push_back(p);
+    }
+    EXPECT_LT(50u,blocks.size());
+    for(size_t i = 0; i < blocks.size(); i++)
+    {
+        EXPECT_TRUE(heap_.free(blocks[i]));
+    }
+    EXPECT_EQ(1,heap_.statistics().freeBlocks);
+}
+
+TEST_F(USharedHeapTest,Free_CoalescesWithBothNeighbours)
+{
+    void *a = heap_.alloc(64);
+    void *b = heap_.alloc(64);
+    void *c = heap_.alloc(64);
+    void *guard = heap_.alloc(64);
+    EXPECT_TRUE(heap_.free(a));
+    EXPECT_TRUE(heap_.free(c));
+    EXPECT_EQ(3,heap_.statistics().freeBlocks);
+    EXPECT_TRUE(heap_.free(b));
+    USharedHeapStatistics statistics = heap_.statistics();
+    EXPECT_EQ(2,statistics.freeBlocks);
+    EXPECT_EQ(1,statistics.usedBlocks);
+    //a,b,c合并后可以一次分配出来.
+    void *merged = heap_.alloc(64 * 3);
+    EXPECT_EQ(a,merged);
+    EXPECT_TRUE(heap_.free(merged));
+    EXPECT_TRUE(heap_.free(guard));
+    statistics = heap_.statistics();
+    EXPECT_EQ(1,statistics.freeBlocks);
+    EXPECT_EQ(0,statistics.usedBytes);
+    EXPECT_EQ(initial_.largestFreeBlock,statistics.largestFreeBlock);
+}
+
+TEST_F(USharedHeapTest,Free_InvalidOrTwice_ReturnsFalse)
+{
+    char *a = static_cast<char *>(heap_.alloc(32));
+    char *b = static_cast<char *>(heap_.alloc(32));
+    char *c = static_cast<char *>(heap_.alloc(100));
+    int local = 0;
+    EXPECT_FALSE(heap_.free(&local));
+    EXPECT_FALSE(heap_.free(a + 8));
+    EXPECT_FALSE(heap_.free(a + 1));
+    EXPECT_TRUE(heap_.free(a));
+    EXPECT_FALSE(heap_.free(a));
+    //b和前面空闲的a合并了,不能再释放.
+    EXPECT_TRUE(heap_.free(b));
+    EXPECT_FALSE(heap_.free(b));
+    EXPECT_EQ(initial_.usedBlocks + 1,heap_.statistics().usedBlocks);
+    char *d = static_cast<char *>(heap_.alloc(150));
+    ASSERT_TRUE(d != 0);
+    EXPECT_TRUE(d + 150 <= c || d >= c + 100);
+}
+
+TEST_F(USharedHeapTest,Alloc_SameSize_ReusesFreedBlock)
+{
+    heap_.alloc(200);
+    void *b = heap_.alloc(200);
+    heap_.alloc(200);
+    heap_.free(b);
+    EXPECT_EQ(b,heap_.alloc(200));
+    heap_.free(b);
+    EXPECT_EQ(b,heap_.alloc(150));
+}
+
+TEST_F(USharedHeapTest,Statistics_Fragmentation)
+{
+    vector<void *> blocks;
+    for(int i = 0; i < 200; i++)
+    {
+        blocks.push_back(heap_.alloc(256));
+    }
+    for(size_t i = 0; i < blocks.size(); i += 2)
+    {
+        heap_.free(blocks[i]);
+    }
+    USharedHeapStatistics statistics = heap_.statistics();
+    EXPECT_EQ(100,statistics.usedBlocks);
+    EXPECT_EQ(101,statistics.freeBlocks);
+    EXPECT_EQ(statistics.totalBytes,statistics.usedBytes + statistics.freeBytes);
+    EXPECT_LT(0.3,statistics.fragmentation());
+}
+
+TEST_F(USharedHeapTest,Threads_AllocAndFree)
+{
+    struct Worker
+    {
+        static unsigned __stdcall run(void *param)
+        {
+            USharedHeap *heap = static_cast<USharedHeap *>(param);
+            void *blocks[16] = {0};
+            unsigned int seed = GetCurrentThreadId();
+            for(int i = 0; i < 20000; i++)
+            {
+                seed = seed * 1103515245 + 12345;
+                const int slot = (seed >> 16) % 16;
+                if(blocks[slot])
+                {
+                    if(*static_cast<int *>(blocks[slot]) != slot || !heap->free(blocks[slot]))
+                    {
+                        return 1;
+                    }
+                    blocks[slot] = 0;
+                }
+                else
+                {
+                    blocks[slot] = heap->alloc(8 + (seed >> 8) % 300);
+                    if(blocks[slot])
+                    {
+                        *static_cast<int *>(blocks[slot]) = slot;
+                    }
+                }
+            }
+            for(int i = 0; i < 16; i++)
+            {
+                if(blocks[i])
+                {
+                    heap->free(blocks[i]);
+                }
+            }
+            return 0;
+        }
+    };
+    HANDLE threads[4];
+    for(int i = 0; i < 4; i++)
+    {
+        threads[i] = reinterpret_cast<HANDLE>(_beginthreadex(NULL,0,&Worker::run,&heap_,0,NULL));
+    }
+    WaitForMultipleObjects(4,threads,TRUE,INFINITE);
+    for(int i = 0; i < 4; i++)
+    {
+        DWORD exitCode = 1;
+        GetExitCodeThread(threads[i],&exitCode);
+        EXPECT_EQ(0,exitCode);
+        CloseHandle(threads[i]);
+    }
+    USharedHeapStatistics statistics = heap_.statistics();
+    EXPECT_EQ(0,statistics.usedBlocks);
+    EXPECT_EQ(1,statistics.freeBlocks);
+    EXPECT_EQ(initial_.largestFreeBlock,statistics.largestFreeBlock);
+}
+
+TEST_F(USharedHeapTest,SharedMemoryManager_UsesHeap)
+{
+    USharedMemoryManager manager(0x10000);
+    ASSERT_TRUE(manager.isValid());
+    const USharedHeapStatistics before = manager.statistics();
+    USharedMemory sharedMemory(manager);
+    for(int i = 0; i < 100; i++)
+    {
+        sharedMemory.setIntData(L"key",i);
+    }
+    EXPECT_EQ(99,sharedMemory.intData(L"key"));
+    const USharedHeapStatistics after = manager.statistics();
+    //旧的值都已经释放,只剩下键,值和Pair.
+    EXPECT_EQ(3,after.usedBlocks);
+    EXPECT_GT(before.freeBytes,after.freeBytes);
+    EXPECT_EQ(1,after.freeBlocks);
+}
+
+TEST_F(USharedHeapTest,DISABLED_Benchmark_AllocFree)
+{
+    USharedMemoryManager manager(0x1000000);
+    const int count = 1000;
+    const int rounds = 100;
+    vector<long long> blocks(count);
+    LARGE_INTEGER frequency,begin,end;
+    QueryPerformanceFrequency(&frequency);
+
+    //先交错释放一半,制造大量的空闲块,旧的分配器每次都要遍历.
+    for(int i = 0; i < count; i++)
+    {
+        blocks[i] = manager.allocMemory(16 + i % 200);
+    }
+    for(int i = 0; i < count; i += 2)
+    {
+        manager.freeMemory(blocks[i]);
+        blocks[i] = 0;
+    }
+    QueryPerformanceCounter(&begin);
+    for(int round = 0; round < rounds; round++)
+    {
+        for(int i = 0; i < count; i += 2)
+        {
+            blocks[i] = manager.allocMemory(16 + (i + round) % 200);
+        }
+        for(int i = 0; i < count; i += 2)
+        {
+            manager.freeMemory(blocks[i]);
+        }
+    }
+    QueryPerformanceCounter(&end);
+    printf("alloc+free: %.1f ns\n",1e9 * (end.QuadPart - begin.QuadPart) / frequency.QuadPart / (rounds * count / 2));
+    const USharedHeapStatistics statistics = manager.statistics();
+    printf("used blocks: %u, free blocks: %u, fragmentation: %.3f\n",
+        static_cast<unsigned int>(statistics.usedBlocks),static_cast<unsigned int>(statistics.freeBlocks),statistics.fragmentation());
+}
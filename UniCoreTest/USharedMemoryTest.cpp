@@ -6,13 +6,24 @@
 #include "../UniCore/USharedMemory.h"
 #include "../UniCore/UDebug.h"
 
+#include <map>
+#include <vector>
+
+#ifdef _WIN32
+#include <Windows.h>
+#include <process.h>
+#else
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
 using namespace std;
 using namespace uni;
 
 class StubMemoryManager : public UMemoryManager
 {
 public:
-    enum {BufSize = 30};
+    enum {BufSize = sizeof(Commu)};
     StubMemoryManager() {memset(buf,0,sizeof(buf));}
     virtual __int64 allocMemory(int size)
     {
@@ -187,6 +198,398 @@ TEST_F(USharedMemoryTest,WaitEvent_WithNormalEventNameAndPredicate_ReturnsFalse)
     ASSERT_FALSE(waitSuccess);
 }
 
+TEST_F(USharedMemoryTest,TypedValues_RoundTrip)
+{
+    USharedMemoryManager manager(0x10000);
+    USharedMemory sharedMemory(manager);
+    EXPECT_EQ(USharedMemory::NoValue,sharedMemory.valueType(L"int"));
+
+    EXPECT_TRUE(sharedMemory.setIntData(L"int",-22));
+    EXPECT_EQ(USharedMemory::IntValue,sharedMemory.valueType(L"int"));
+    EXPECT_EQ(-22,sharedMemory.intData(L"int"));
+    EXPECT_EQ(L"-22",sharedMemory.data(L"int"));
+    EXPECT_EQ(-22.0,sharedMemory.doubleData(L"int"));
+
+    EXPECT_TRUE(sharedMemory.setDoubleData(L"double",1.5));
+    EXPECT_EQ(USharedMemory::DoubleValue,sharedMemory.valueType(L"double"));
+    EXPECT_EQ(1.5,sharedMemory.doubleData(L"double"));
+    EXPECT_EQ(L"1.5",sharedMemory.data(L"double"));
+    EXPECT_EQ(1,sharedMemory.intData(L"double"));
+
+    EXPECT_TRUE(sharedMemory.setData(L"text",L"2.25"));
+    EXPECT_EQ(2,sharedMemory.intData(L"text"));
+    EXPECT_EQ(2.25,sharedMemory.doubleData(L"text"));
+
+    const char bytes[] = {1,0,2,0,3};
+    EXPECT_TRUE(sharedMemory.setBinaryData(L"binary",bytes,sizeof(bytes)));
+    EXPECT_EQ(USharedMemory::BinaryValue,sharedMemory.valueType(L"binary"));
+    std::string read;
+    EXPECT_TRUE(sharedMemory.binaryData(L"binary",read));
+    EXPECT_EQ(std::string(bytes,sizeof(bytes)),read);
+    EXPECT_TRUE(sharedMemory.data(L"binary").empty());
+    EXPECT_FALSE(sharedMemory.binaryData(L"missing",read));
+
+    //类型可以改变.
+    EXPECT_TRUE(sharedMemory.setData(L"int",L""));
+    EXPECT_EQ(USharedMemory::StringValue,sharedMemory.valueType(L"int"));
+    EXPECT_TRUE(sharedMemory.data(L"int").empty());
+    EXPECT_EQ(4,sharedMemory.size());
+}
+
+TEST_F(USharedMemoryTest,ManyKeys_TableGrows)
+{
+    USharedMemoryManager manager(0x100000);
+    USharedMemory sharedMemory(manager);
+    const int count = 2000;
+    for(int i = 0; i < count; i++)
+    {
+        ASSERT_TRUE(sharedMemory.setIntData(L"key" + i2ws(i),i));
+    }
+    EXPECT_EQ(count,sharedMemory.size());
+    for(int i = 0; i < count; i++)
+    {
+        EXPECT_EQ(i,sharedMemory.intData(L"key" + i2ws(i)));
+    }
+    EXPECT_TRUE(sharedMemory.findPair(L"key1999") != 0);
+    EXPECT_TRUE(sharedMemory.findPair(L"key2000") == 0);
+}
+
+TEST_F(USharedMemoryTest,SetData_FitsInBuffer_NoAllocation)
+{
+    USharedMemoryManager manager(0x10000);
+    USharedMemory sharedMemory(manager);
+    sharedMemory.setData(L"key",L"a longer value");
+    const size_t usedBlocks = manager.statistics().usedBlocks;
+    sharedMemory.setData(L"key",L"short");
+    EXPECT_EQ(usedBlocks,manager.statistics().usedBlocks);
+    EXPECT_EQ(L"short",sharedMemory.data(L"key"));
+    sharedMemory.setData(L"key",std::wstring(100,L'x'));
+    EXPECT_EQ(usedBlocks,manager.statistics().usedBlocks);
+    EXPECT_EQ(std::wstring(100,L'x'),sharedMemory.data(L"key"));
+}
+
+TEST_F(USharedMemoryTest,SetData_SegmentFull_ReturnsFalse)
+{
+    USharedMemoryManager manager(0x2000);
+    USharedMemory sharedMemory(manager);
+    EXPECT_TRUE(sharedMemory.setData(L"small",L"value"));
+    EXPECT_FALSE(sharedMemory.setData(L"large",std::wstring(0x2000,L'x')));
+    EXPECT_EQ(L"value",sharedMemory.data(L"small"));
+}
+
+TEST_F(USharedMemoryTest,Snapshot_ReturnsAllValues)
+{
+    USharedMemoryManager manager(0x10000);
+    USharedMemory sharedMemory(manager);
+    EXPECT_TRUE(sharedMemory.snapshot().empty());
+    sharedMemory.setData(L"string",L"value");
+    sharedMemory.setIntData(L"int",42);
+    sharedMemory.setDoubleData(L"double",0.5);
+    sharedMemory.setBinaryData(L"binary","\0\1",2);
+    sharedMemory.getEvent(L"event");
+
+    std::vector<USharedMemory::Entry> entries = sharedMemory.snapshot();
+    ASSERT_EQ(4,entries.size());
+    std::map<std::wstring,USharedMemory::Entry> values;
+    for(size_t i = 0; i < entries.size(); i++)
+    {
+        values[entries[i].key] = entries[i];
+    }
+    EXPECT_EQ(USharedMemory::StringValue,values[L"string"].type);
+    EXPECT_EQ(L"value",USharedMemory::text(values[L"string"].type,values[L"string"].data));
+    EXPECT_EQ(USharedMemory::IntValue,values[L"int"].type);
+    EXPECT_EQ(L"42",USharedMemory::text(values[L"int"].type,values[L"int"].data));
+    EXPECT_EQ(USharedMemory::DoubleValue,values[L"double"].type);
+    EXPECT_EQ(USharedMemory::BinaryValue,values[L"binary"].type);
+    EXPECT_EQ(std::string("\0\1",2),values[L"binary"].data);
+}
+
+namespace
+{
+    //! 写者不停地修改值,读者检查读到的值是完整的.
+    struct ConcurrentAccess
+    {
+        enum {Writes = 20000,Readers = 3};
+
+        //! 值的每个字节都是同一个数,长度也随之变化,缓冲区会被重新分配.
+        static std::string pattern(int i)
+        {
+            return std::string(1 + i % 1000,static_cast<char>(i));
+        }
+        static bool isPattern(const std::string &data)
+        {
+            return !data.empty() && data.find_first_not_of(data[0]) == std::string::npos;
+        }
+
+        static void write(USharedMemory &sharedMemory)
+        {
+            //等读者开始读取.
+            sharedMemory.WaitEvent(L"reading",5000);
+            for(int i = 1; i <= Writes; i++)
+            {
+                const std::string value = pattern(i);
+                sharedMemory.setBinaryData(L"value",value.data(),static_cast<int>(value.size()));
+                //a总是先于b写入,同一时刻0 <= a - b <= 1.
+                sharedMemory.setIntData(L"a",i);
+                sharedMemory.setIntData(L"b",i);
+                if(i % 64 == 0)
+                {
+                    //插入新的键,表会被替换.
+                    sharedMemory.setIntData(L"key" + i2ws(i),i);
+                }
+            }
+            sharedMemory.setIntData(L"done",1);
+        }
+
+        //! 返回发现的错误数.
+        static int read(USharedMemory &sharedMemory)
+        {
+            int errors = 0;
+            int last = 0;
+            int rounds = 0;
+            sharedMemory.NotifyEvent(L"reading");
+            while(!sharedMemory.intData(L"done") || rounds < 2)
+            {
+                if(sharedMemory.intData(L"done"))
+                {
+                    rounds++;
+                }
+                std::string value;
+                if(sharedMemory.binaryData(L"value",value) && !isPattern(value))
+                {
+                    errors++;
+                }
+                const int b = sharedMemory.intData(L"b");
+                if(b < last)
+                {
+                    errors++;
+                }
+                last = b;
+
+                const std::vector<USharedMemory::Entry> entries = sharedMemory.snapshot();
+                int a = 0;
+                int bInSnapshot = 0;
+                for(size_t i = 0; i < entries.size(); i++)
+                {
+                    if(entries[i].key == L"a")
+                    {
+                        memcpy(&a,entries[i].data.data(),sizeof(a));
+                    }
+                    else if(entries[i].key == L"b")
+                    {
+                        memcpy(&bInSnapshot,entries[i].data.data(),sizeof(bInSnapshot));
+                    }
+                    else if(entries[i].key == L"value" && !isPattern(entries[i].data))
+                    {
+                        errors++;
+                    }
+                }
+                if(a - bInSnapshot < 0 || a - bInSnapshot > 1)
+                {
+                    errors++;
+                }
+            }
+            return errors;
+        }
+
+        static unsigned __stdcall runReader(void *param)
+        {
+            return read(*static_cast<USharedMemory *>(param));
+        }
+    };
+}
+
+TEST_F(USharedMemoryTest,Threads_LockFreeReadsAreConsistent)
+{
+    USharedMemoryManager manager(0x200000);
+    USharedMemory writer(manager);
+    USharedMemory reader(manager);
+    HANDLE threads[ConcurrentAccess::Readers];
+    for(int i = 0; i < ConcurrentAccess::Readers; i++)
+    {
+        threads[i] = reinterpret_cast<HANDLE>(_beginthreadex(NULL,0,&ConcurrentAccess::runReader,&reader,0,NULL));
+    }
+    ConcurrentAccess::write(writer);
+    WaitForMultipleObjects(ConcurrentAccess::Readers,threads,TRUE,INFINITE);
+    for(int i = 0; i < ConcurrentAccess::Readers; i++)
+    {
+        DWORD exitCode = 1;
+        GetExitCodeThread(threads[i],&exitCode);
+        EXPECT_EQ(0,exitCode);
+        CloseHandle(threads[i]);
+    }
+    EXPECT_EQ(ConcurrentAccess::Writes,reader.intData(L"b"));
+    std::string value;
+    EXPECT_TRUE(reader.binaryData(L"value",value));
+    EXPECT_EQ(ConcurrentAccess::pattern(ConcurrentAccess::Writes),value);
+}
+
+TEST_F(USharedMemoryTest,ManualResetEvent_StaysSignaledUntilCleared)
+{
+    USharedMemoryManager manager(0x10000);
+    USharedMemory sharedMemory(manager);
+    ASSERT_TRUE(sharedMemory.createEvent(L"manual",USharedMemory::ManualReset));
+    EXPECT_FALSE(sharedMemory.WaitEvent(L"manual",0));
+    sharedMemory.NotifyEvent(L"manual");
+    EXPECT_TRUE(sharedMemory.WaitEvent(L"manual",0));
+    EXPECT_TRUE(sharedMemory.WaitEvent(L"manual",0));
+    sharedMemory.ClearEvent(L"manual");
+    EXPECT_FALSE(sharedMemory.WaitEvent(L"manual",0));
+}
+
+TEST_F(USharedMemoryTest,CreateEvent_ExistsWithOtherMode_ReturnsFalse)
+{
+    USharedMemoryManager manager(0x10000);
+    USharedMemory sharedMemory(manager);
+    sharedMemory.getEvent(L"auto");
+    EXPECT_TRUE(sharedMemory.createEvent(L"auto",USharedMemory::AutoReset));
+    EXPECT_FALSE(sharedMemory.createEvent(L"auto",USharedMemory::ManualReset));
+}
+
+TEST_F(USharedMemoryTest,WaitAnyEvent_ReturnsSignaledIndex)
+{
+    USharedMemoryManager manager(0x10000);
+    USharedMemory sharedMemory(manager);
+    std::vector<std::wstring> events;
+    events.push_back(L"a");
+    events.push_back(L"b");
+    events.push_back(L"c");
+    EXPECT_EQ(-1,sharedMemory.WaitAnyEvent(events,0));
+    sharedMemory.NotifyEvent(L"c");
+    EXPECT_EQ(2,sharedMemory.WaitAnyEvent(events,0));
+    //自动重置的事件已被清除.
+    EXPECT_EQ(-1,sharedMemory.WaitAnyEvent(events,10));
+}
+
+TEST_F(USharedMemoryTest,WaitEvent_Timeout_WaitsRequestedTime)
+{
+    USharedMemoryManager manager(0x10000);
+    USharedMemory sharedMemory(manager);
+    LARGE_INTEGER frequency,begin,end;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&begin);
+    EXPECT_FALSE(sharedMemory.WaitEvent(L"never",50));
+    QueryPerformanceCounter(&end);
+    const double elapsed = 1000.0 * (end.QuadPart - begin.QuadPart) / frequency.QuadPart;
+    EXPECT_LE(50.0,elapsed);
+    EXPECT_GT(150.0,elapsed);
+}
+
+namespace
+{
+    //! 等待start,然后通知done.
+    unsigned __stdcall waitAndReply(void *param)
+    {
+        USharedMemory *sharedMemory = static_cast<USharedMemory *>(param);
+        sharedMemory->WaitEvent(L"start");
+        sharedMemory->NotifyEvent(L"done");
+        return 0;
+    }
+}
+
+TEST_F(USharedMemoryTest,Threads_NotifyWakesBlockedWaiters)
+{
+    USharedMemoryManager manager(0x10000);
+    USharedMemory sharedMemory(manager);
+    HANDLE thread = reinterpret_cast<HANDLE>(_beginthreadex(NULL,0,&waitAndReply,&sharedMemory,0,NULL));
+    sharedMemory.NotifyEvent(L"start");
+    EXPECT_TRUE(sharedMemory.WaitEvent(L"done",5000));
+    WaitForMultipleObjects(1,&thread,TRUE,INFINITE);
+    CloseHandle(thread);
+
+    //waitTime小于0时一直等待.
+    thread = reinterpret_cast<HANDLE>(_beginthreadex(NULL,0,&waitAndReply,&sharedMemory,0,NULL));
+    sharedMemory.NotifyEvent(L"start");
+    EXPECT_TRUE(sharedMemory.WaitEvent(L"done",-1));
+    WaitForMultipleObjects(1,&thread,TRUE,INFINITE);
+    CloseHandle(thread);
+
+    //手动重置的事件唤醒所有的等待者.
+    ASSERT_TRUE(sharedMemory.createEvent(L"all",USharedMemory::ManualReset));
+    struct Waiter
+    {
+        static unsigned __stdcall run(void *param)
+        {
+            return static_cast<USharedMemory *>(param)->WaitEvent(L"all",5000) ? 0 : 1;
+        }
+    };
+    HANDLE threads[3];
+    for(int i = 0; i < 3; i++)
+    {
+        threads[i] = reinterpret_cast<HANDLE>(_beginthreadex(NULL,0,&Waiter::run,&sharedMemory,0,NULL));
+    }
+    sharedMemory.NotifyEvent(L"all");
+    WaitForMultipleObjects(3,threads,TRUE,INFINITE);
+    for(int i = 0; i < 3; i++)
+    {
+        DWORD exitCode = 1;
+        GetExitCodeThread(threads[i],&exitCode);
+        EXPECT_EQ(0,exitCode);
+        CloseHandle(threads[i]);
+    }
+}
+
+TEST_F(USharedMemoryTest,DISABLED_Benchmark_EventPingPong)
+{
+    USharedMemoryManager manager(0x10000);
+    USharedMemory sharedMemory(manager);
+    struct Echo
+    {
+        static unsigned __stdcall run(void *param)
+        {
+            USharedMemory *sharedMemory = static_cast<USharedMemory *>(param);
+            for(int i = 0; i < 10000; i++)
+            {
+                sharedMemory->WaitEvent(L"ping");
+                sharedMemory->NotifyEvent(L"pong");
+            }
+            return 0;
+        }
+    };
+    HANDLE thread = reinterpret_cast<HANDLE>(_beginthreadex(NULL,0,&Echo::run,&sharedMemory,0,NULL));
+    LARGE_INTEGER frequency,begin,end;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&begin);
+    for(int i = 0; i < 10000; i++)
+    {
+        sharedMemory.NotifyEvent(L"ping");
+        sharedMemory.WaitEvent(L"pong");
+    }
+    QueryPerformanceCounter(&end);
+    WaitForMultipleObjects(1,&thread,TRUE,INFINITE);
+    CloseHandle(thread);
+    printf("round trip: %.1f us\n",1e6 * (end.QuadPart - begin.QuadPart) / frequency.QuadPart / 10000);
+}
+
+TEST_F(USharedMemoryTest,DISABLED_Benchmark_Data)
+{
+    USharedMemoryManager manager(0x400000);
+    USharedMemory sharedMemory(manager);
+    const int keys = 1000;
+    const int count = 100000;
+    for(int i = 0; i < keys; i++)
+    {
+        sharedMemory.setIntData(L"monitor/key" + i2ws(i),i);
+    }
+    LARGE_INTEGER frequency,begin,end;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&begin);
+    int sum = 0;
+    for(int i = 0; i < count; i++)
+    {
+        sum += sharedMemory.intData(L"monitor/key" + i2ws(i % keys));
+    }
+    QueryPerformanceCounter(&end);
+    printf("intData: %.1f ns (%d)\n",1e9 * (end.QuadPart - begin.QuadPart) / frequency.QuadPart / count,sum);
+    QueryPerformanceCounter(&begin);
+    for(int i = 0; i < count; i++)
+    {
+        sharedMemory.setIntData(L"monitor/key" + i2ws(i % keys),i);
+    }
+    QueryPerformanceCounter(&end);
+    printf("setIntData: %.1f ns\n",1e9 * (end.QuadPart - begin.QuadPart) / frequency.QuadPart / count);
+}
+
 class USharedMemoryManagerTest : public ::testing::Test
 {
 public:
@@ -292,4 +695,227 @@ TEST_F(USharedMemoryManagerTest,allocMemory_SizeEqualsOne_DataIsZeroInitialized)
 TEST_F(USharedMemoryManagerTest,CTor_ConstructedObjectIsValid)
 {
     ASSERT_TRUE(sharedMemoryManager_->isValid());
-}
\ No newline at end of file
+}
+TEST_F(USharedMemoryManagerTest,CTor_WithSize_WholeSegmentCanBeAllocated)
+{
+    USharedMemoryManager manager(0x100000);
+    ASSERT_TRUE(manager.isValid());
+    EXPECT_EQ(0x100000,manager.size());
+    EXPECT_TRUE(manager.created());
+    char *data = reinterpret_cast<char *>(manager.allocMemory(0x80000));
+    ASSERT_TRUE(data != 0);
+    data[0x80000 - 1] = 1;
+    EXPECT_EQ(0,manager.allocMemory(0x80000));
+}
+
+TEST_F(USharedMemoryManagerTest,CTor_TooSmall_Invalid)
+{
+    USharedMemoryManager manager(16);
+    EXPECT_FALSE(manager.isValid());
+}
+
+TEST_F(USharedMemoryManagerTest,CTor_UseHugePages_FallsBackWhenUnavailable)
+{
+    USharedMemoryManager manager(0x10000,USharedMemoryManager::UseHugePages);
+    ASSERT_TRUE(manager.isValid());
+    EXPECT_LE(0x10000,manager.size());
+    EXPECT_TRUE(manager.allocMemory(0x1000) != 0);
+}
+
+class USharedMemoryNamedTest : public ::testing::Test
+{
+public:
+    USharedMemoryNamedTest()
+        :name_(L"UniCoreTest_USharedMemory")
+    {
+    }
+    virtual void SetUp()
+    {
+        USharedMemoryManager::remove(name_);
+    }
+    virtual void TearDown()
+    {
+        USharedMemoryManager::remove(name_);
+    }
+    std::wstring name_;
+};
+
+TEST_F(USharedMemoryNamedTest,OpenOnly_NotExists_Invalid)
+{
+    USharedMemoryManager manager(name_,0,USharedMemoryManager::OpenOnly);
+    EXPECT_FALSE(manager.isValid());
+}
+
+TEST_F(USharedMemoryNamedTest,CreateOnly_AlreadyExists_Invalid)
+{
+    USharedMemoryManager creator(name_,0x10000,USharedMemoryManager::CreateOnly);
+    ASSERT_TRUE(creator.isValid());
+    EXPECT_TRUE(creator.created());
+    USharedMemoryManager second(name_,0x10000,USharedMemoryManager::CreateOnly);
+    EXPECT_FALSE(second.isValid());
+}
+
+TEST_F(USharedMemoryNamedTest,OpenByName_SharesDataAndEvents)
+{
+    USharedMemoryManager creator(name_,0x10000);
+    ASSERT_TRUE(creator.isValid());
+    EXPECT_TRUE(creator.created());
+    USharedMemoryManager opener(name_,0,USharedMemoryManager::OpenOnly);
+    ASSERT_TRUE(opener.isValid());
+    EXPECT_FALSE(opener.created());
+    EXPECT_EQ(creator.size(),opener.size());
+
+    USharedMemory first(creator);
+    USharedMemory second(opener);
+    first.setData(L"key",L"value");
+    second.setIntData(L"count",42);
+    EXPECT_EQ(L"value",second.data(L"key"));
+    EXPECT_EQ(42,first.intData(L"count"));
+
+    first.NotifyEvent(L"ready");
+    EXPECT_TRUE(second.WaitEvent(L"ready",0));
+    EXPECT_FALSE(second.WaitEvent(L"ready",0));
+}
+
+#ifndef _WIN32
+TEST_F(USharedMemoryNamedTest,AllDetached_NameKeptUntilRemove)
+{
+    {
+        USharedMemoryManager creator(name_,0x10000,USharedMemoryManager::CreateOnly);
+        ASSERT_TRUE(creator.isValid());
+        USharedMemory memory(creator);
+        memory.setData(L"key",L"value");
+    }
+    {
+        USharedMemoryManager opener(name_,0,USharedMemoryManager::OpenOnly);
+        ASSERT_TRUE(opener.isValid());
+        USharedMemory memory(opener);
+        EXPECT_EQ(L"value",memory.data(L"key"));
+    }
+    EXPECT_TRUE(USharedMemoryManager::remove(name_));
+    USharedMemoryManager removed(name_,0,USharedMemoryManager::OpenOnly);
+    EXPECT_FALSE(removed.isValid());
+}
+
+TEST_F(USharedMemoryNamedTest,TwoProcesses_DataAndEvents)
+{
+    USharedMemoryManager creator(name_,0x10000,USharedMemoryManager::CreateOnly);
+    ASSERT_TRUE(creator.isValid());
+    USharedMemory parent(creator);
+    parent.setData(L"request",L"ping");
+
+    pid_t pid = fork();
+    ASSERT_NE(-1,pid);
+    if(pid == 0)
+    {
+        //子进程按名字打开,不析构从父进程复制的对象.
+        int result = 1;
+        {
+            USharedMemoryManager opener(name_,0,USharedMemoryManager::OpenOnly);
+            if(opener.isValid())
+            {
+                USharedMemory child(opener);
+                if(child.WaitEvent(L"request",5000) && child.data(L"request") == L"ping")
+                {
+                    child.setData(L"response",L"pong");
+                    child.NotifyEvent(L"response");
+                    result = 0;
+                }
+            }
+        }
+        _exit(result);
+    }
+
+    parent.NotifyEvent(L"request");
+    EXPECT_TRUE(parent.WaitEvent(L"response",5000));
+    EXPECT_EQ(L"pong",parent.data(L"response"));
+    int status = 0;
+    ASSERT_EQ(pid,waitpid(pid,&status,0));
+    EXPECT_TRUE(WIFEXITED(status));
+    EXPECT_EQ(0,WEXITSTATUS(status));
+}
+
+TEST_F(USharedMemoryNamedTest,TwoProcesses_WaitAnyEventBlocksWithoutSpinning)
+{
+    USharedMemoryManager creator(name_,0x10000,USharedMemoryManager::CreateOnly);
+    ASSERT_TRUE(creator.isValid());
+    USharedMemory parent(creator);
+    parent.getEvent(L"ready");
+
+    pid_t pid = fork();
+    ASSERT_NE(-1,pid);
+    if(pid == 0)
+    {
+        int result = 1;
+        {
+            USharedMemoryManager opener(name_,0,USharedMemoryManager::OpenOnly);
+            if(opener.isValid())
+            {
+                USharedMemory child(opener);
+                std::vector<std::wstring> events;
+                events.push_back(L"a");
+                events.push_back(L"b");
+                timespec begin,end;
+                clock_gettime(CLOCK_PROCESS_CPUTIME_ID,&begin);
+                child.NotifyEvent(L"ready");
+                const int index = child.WaitAnyEvent(events,5000);
+                clock_gettime(CLOCK_PROCESS_CPUTIME_ID,&end);
+                //等待期间挂起,几乎不占用CPU.
+                const long long cpu = (end.tv_sec - begin.tv_sec) * 1000LL + (end.tv_nsec - begin.tv_nsec) / 1000000;
+                if(index == 1 && cpu < 50)
+                {
+                    child.NotifyEvent(L"done");
+                    result = 0;
+                }
+            }
+        }
+        _exit(result);
+    }
+
+    ASSERT_TRUE(parent.WaitEvent(L"ready",5000));
+    usleep(200 * 1000);
+    parent.NotifyEvent(L"b");
+    EXPECT_TRUE(parent.WaitEvent(L"done",5000));
+    int status = 0;
+    ASSERT_EQ(pid,waitpid(pid,&status,0));
+    EXPECT_TRUE(WIFEXITED(status));
+    EXPECT_EQ(0,WEXITSTATUS(status));
+}
+
+TEST_F(USharedMemoryNamedTest,TwoProcesses_LockFreeReadsAreConsistent)
+{
+    USharedMemoryManager creator(name_,0x200000,USharedMemoryManager::CreateOnly);
+    ASSERT_TRUE(creator.isValid());
+    USharedMemory writer(creator);
+
+    pid_t pids[ConcurrentAccess::Readers];
+    for(int i = 0; i < ConcurrentAccess::Readers; i++)
+    {
+        pids[i] = fork();
+        ASSERT_NE(-1,pids[i]);
+        if(pids[i] == 0)
+        {
+            int result = 1;
+            {
+                USharedMemoryManager opener(name_,0,USharedMemoryManager::OpenOnly);
+                if(opener.isValid())
+                {
+                    USharedMemory reader(opener);
+                    result = ConcurrentAccess::read(reader) ? 1 : 0;
+                }
+            }
+            _exit(result);
+        }
+    }
+    //读者不加锁,不会阻塞写者.
+    ConcurrentAccess::write(writer);
+    EXPECT_EQ(ConcurrentAccess::Writes,writer.intData(L"a"));
+    for(int i = 0; i < ConcurrentAccess::Readers; i++)
+    {
+        int status = 0;
+        ASSERT_EQ(pids[i],waitpid(pids[i],&status,0));
+        EXPECT_TRUE(WIFEXITED(status));
+        EXPECT_EQ(0,WEXITSTATUS(status));
+    }
+}
+#endif
@@ -0,0 +1,386 @@
+﻿#include "stdafx.h"
+
+#include "gtest/gtest.h"
+#include <Windows.h>
+#include <process.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include "../UniCore/USharedRingBuffer.h"
+
+using namespace std;
+using namespace uni;
+
+class USharedRingBufferTest : public ::testing::Test
+{
+public:
+    USharedRingBufferTest()
+        :manager_(0x100000)
+        ,sharedMemory_(manager_)
+    {
+    }
+
+    USharedMemoryManager manager_;
+    USharedMemory sharedMemory_;
+};
+
+TEST_F(USharedRingBufferTest,Create_CapacityRoundedUp)
+{
+    USharedRingBuffer ring(sharedMemory_,L"ring",1000,USharedRingBuffer::Spsc);
+    ASSERT_TRUE(ring.isValid());
+    EXPECT_EQ(1024,ring.capacity());
+    EXPECT_EQ(USharedRingBuffer::Spsc,ring.mode());
+    USharedRingRange range;
+    EXPECT_EQ(0,reinterpret_cast<size_t>(ring.reserve(1,range)) % 8);
+}
+
+TEST_F(USharedRingBufferTest,Open_NotExists_Invalid)
+{
+    USharedRingBuffer ring(sharedMemory_,L"missing");
+    EXPECT_FALSE(ring.isValid());
+}
+
+TEST_F(USharedRingBufferTest,OpenByName_SharesRecords)
+{
+    USharedRingBuffer producer(sharedMemory_,L"ring",0x1000,USharedRingBuffer::Spsc);
+    USharedMemory other(manager_);
+    USharedRingBuffer consumer(other,L"ring");
+    ASSERT_TRUE(consumer.isValid());
+    EXPECT_EQ(producer.capacity(),consumer.capacity());
+    EXPECT_TRUE(producer.write("hello",5));
+    string record;
+    EXPECT_TRUE(consumer.read(record));
+    EXPECT_EQ("hello",record);
+    EXPECT_FALSE(consumer.read(record));
+}
+
+TEST_F(USharedRingBufferTest,WriteRead_WrapsAroundManyTimes)
+{
+    USharedRingBuffer ring(sharedMemory_,L"ring",0x400,USharedRingBuffer::Spsc);
+    string record;
+    for(int i = 0; i < 1000; i++)
+    {
+        //长度不是8的倍数,环的结尾经常放不下,需要填充.
+        const string data(1 + i % 200,static_cast<char>(i));
+        ASSERT_TRUE(ring.write(data.data(),static_cast<int>(data.size())));
+        ASSERT_TRUE(ring.read(record));
+        ASSERT_EQ(data,record);
+    }
+    EXPECT_FALSE(ring.read(record));
+}
+
+TEST_F(USharedRingBufferTest,Reserve_TooLarge_ReturnsFalse)
+{
+    USharedRingBuffer ring(sharedMemory_,L"ring",0x400,USharedRingBuffer::Spsc);
+    USharedRingRange range;
+    EXPECT_TRUE(ring.reserve(ring.maxRecordSize() + 1,range) == 0);
+    EXPECT_TRUE(ring.reserve(-1,range) == 0);
+    const int sizes[3] = {400,400,400};
+    void *records[3];
+    EXPECT_FALSE(ring.reserve(sizes,3,records,range));
+}
+
+TEST_F(USharedRingBufferTest,Full_ReserveTimesOut)
+{
+    USharedRingBuffer ring(sharedMemory_,L"ring",0x400,USharedRingBuffer::Spsc);
+    char data[100] = {0};
+    int written = 0;
+    while(ring.write(data,sizeof(data)))
+    {
+        written++;
+    }
+    //每条记录加上记录头占112字节.
+    EXPECT_EQ(9,written);
+    EXPECT_FALSE(ring.write(data,sizeof(data),20));
+    string record;
+    EXPECT_TRUE(ring.read(record));
+    EXPECT_TRUE(ring.write(data,sizeof(data)));
+}
+
+TEST_F(USharedRingBufferTest,Empty_ReadTimesOut)
+{
+    USharedRingBuffer ring(sharedMemory_,L"ring",0x400,USharedRingBuffer::Mpmc);
+    string record;
+    EXPECT_FALSE(ring.read(record,20));
+}
+
+TEST_F(USharedRingBufferTest,Batch_ReserveCommitReadRelease)
+{
+    USharedRingBuffer ring(sharedMemory_,L"ring",0x1000,USharedRingBuffer::Mpmc);
+    const int sizes[3] = {10,0,100};
+    void *records[3];
+    USharedRingRange range;
+    ASSERT_TRUE(ring.reserve(sizes,3,records,range));
+    memset(records[0],'a',10);
+    memset(records[2],'c',100);
+
+    //提交之前读不到.
+    const void *read[4];
+    int readSizes[4];
+    USharedRingRange readRange;
+    EXPECT_EQ(0,ring.read(read,readSizes,4,readRange));
+    ring.commit(range);
+
+    ASSERT_EQ(3,ring.read(read,readSizes,4,readRange));
+    EXPECT_EQ(records[0],read[0]);
+    EXPECT_EQ(10,readSizes[0]);
+    EXPECT_EQ(0,readSizes[1]);
+    EXPECT_EQ(100,readSizes[2]);
+    EXPECT_EQ('c',static_cast<const char *>(read[2])[99]);
+    EXPECT_EQ(range.begin,readRange.begin);
+    EXPECT_EQ(range.end,readRange.end);
+    ring.release(readRange);
+    EXPECT_EQ(0,ring.read(read,readSizes,4,readRange));
+}
+
+namespace
+{
+    //! 记录的开头是生产者编号和序号,之后的字节都等于序号.
+    struct RingTraffic
+    {
+        enum {Records = 20000};
+
+        struct Producer
+        {
+            USharedRingBuffer *ring;
+            int id;
+        };
+
+        static unsigned __stdcall produce(void *param)
+        {
+            Producer *producer = static_cast<Producer *>(param);
+            char data[300];
+            for(int i = 0; i < Records; i++)
+            {
+                const int size = 8 + i % 250;
+                memcpy(data,&producer->id,sizeof(int));
+                memcpy(data + sizeof(int),&i,sizeof(int));
+                memset(data + 8,static_cast<char>(i),size - 8);
+                if(!producer->ring->write(data,size,5000))
+                {
+                    return 1;
+                }
+            }
+            return 0;
+        }
+
+        //! 读取记录直到remaining减为0,检查每个生产者的记录是按顺序的.
+        /*!
+            多个消费者共享remaining,每个消费者读到多少条是不确定的.
+            5秒没有读到记录时返回false.
+        */
+        static bool consume(USharedRingBuffer &ring,volatile long &remaining,vector<int> &next)
+        {
+            const void *records[16];
+            int sizes[16];
+            USharedRingRange range;
+            int idle = 0;
+            while(remaining > 0)
+            {
+                //等待的时间不能太长,最后的记录被别的消费者读走后要及时退出.
+                const int read = ring.read(records,sizes,16,range,100);
+                if(!read)
+                {
+                    if(++idle == 50)
+                    {
+                        return false;
+                    }
+                    continue;
+                }
+                idle = 0;
+                for(int i = 0; i < read; i++)
+                {
+                    const char *data = static_cast<const char *>(records[i]);
+                    int id = 0;
+                    int sequence = 0;
+                    memcpy(&id,data,sizeof(int));
+                    memcpy(&sequence,data + sizeof(int),sizeof(int));
+                    if(id < 0 || id >= static_cast<int>(next.size()) || sequence < next[id]
+                        || sizes[i] != 8 + sequence % 250
+                        || (sizes[i] > 8 && data[sizes[i] - 1] != static_cast<char>(sequence)))
+                    {
+                        return false;
+                    }
+                    next[id] = sequence + 1;
+                }
+                ring.release(range);
+                InterlockedExchangeAdd(&remaining,-read);
+            }
+            return true;
+        }
+        static bool consume(USharedRingBuffer &ring,int count,vector<int> &next)
+        {
+            volatile long remaining = count;
+            return consume(ring,remaining,next);
+        }
+
+        struct Consumer
+        {
+            USharedRingBuffer *ring;
+            volatile long *remaining;   //!< 所有消费者还要读取的记录数.
+            int producers;
+        };
+
+        static unsigned __stdcall runConsumer(void *param)
+        {
+            Consumer *consumer = static_cast<Consumer *>(param);
+            vector<int> next(consumer->producers,0);
+            return consume(*consumer->ring,*consumer->remaining,next) ? 0 : 1;
+        }
+    };
+}
+
+TEST_F(USharedRingBufferTest,Threads_Spsc_RecordsInOrder)
+{
+    USharedRingBuffer ring(sharedMemory_,L"ring",0x4000,USharedRingBuffer::Spsc);
+    RingTraffic::Producer producer = {&ring,0};
+    HANDLE thread = reinterpret_cast<HANDLE>(_beginthreadex(NULL,0,&RingTraffic::produce,&producer,0,NULL));
+    vector<int> next(1,0);
+    EXPECT_TRUE(RingTraffic::consume(ring,RingTraffic::Records,next));
+    EXPECT_EQ(RingTraffic::Records,next[0]);
+    WaitForMultipleObjects(1,&thread,TRUE,INFINITE);
+    DWORD exitCode = 1;
+    GetExitCodeThread(thread,&exitCode);
+    EXPECT_EQ(0,exitCode);
+    CloseHandle(thread);
+}
+
+TEST_F(USharedRingBufferTest,Threads_Mpmc_AllRecordsDelivered)
+{
+    USharedRingBuffer ring(sharedMemory_,L"ring",0x4000,USharedRingBuffer::Mpmc);
+    RingTraffic::Producer producers[2] = {{&ring,0},{&ring,1}};
+    //每个消费者读到的同一个生产者的记录也是按顺序的.
+    volatile long remaining = 2 * RingTraffic::Records;
+    RingTraffic::Consumer consumers[2] = {{&ring,&remaining,2},{&ring,&remaining,2}};
+    HANDLE threads[4];
+    for(int i = 0; i < 2; i++)
+    {
+        threads[i] = reinterpret_cast<HANDLE>(_beginthreadex(NULL,0,&RingTraffic::produce,&producers[i],0,NULL));
+        threads[i + 2] = reinterpret_cast<HANDLE>(_beginthreadex(NULL,0,&RingTraffic::runConsumer,&consumers[i],0,NULL));
+    }
+    WaitForMultipleObjects(4,threads,TRUE,INFINITE);
+    for(int i = 0; i < 4; i++)
+    {
+        DWORD exitCode = 1;
+        GetExitCodeThread(threads[i],&exitCode);
+        EXPECT_EQ(0,exitCode);
+        CloseHandle(threads[i]);
+    }
+    EXPECT_EQ(0,remaining);
+    string record;
+    EXPECT_FALSE(ring.read(record));
+}
+
+#ifndef _WIN32
+TEST_F(USharedRingBufferTest,TwoProcesses_CaptureToViewer)
+{
+    const wstring name = L"UniCoreTest_USharedRingBuffer";
+    USharedMemoryManager::remove(name);
+    USharedMemoryManager creator(name,0x100000,USharedMemoryManager::CreateOnly);
+    ASSERT_TRUE(creator.isValid());
+    USharedMemory capture(creator);
+    USharedRingBuffer ring(capture,L"packets",0x4000,USharedRingBuffer::Spsc);
+    ASSERT_TRUE(ring.isValid());
+
+    pid_t pid = fork();
+    ASSERT_NE(-1,pid);
+    if(pid == 0)
+    {
+        int result = 1;
+        {
+            USharedMemoryManager opener(name,0,USharedMemoryManager::OpenOnly);
+            if(opener.isValid())
+            {
+                USharedMemory viewer(opener);
+                USharedRingBuffer packets(viewer,L"packets");
+                vector<int> next(1,0);
+                //消费者没有数据时在futex上挂起.
+                if(packets.isValid() && RingTraffic::consume(packets,RingTraffic::Records,next))
+                {
+                    result = 0;
+                }
+            }
+        }
+        _exit(result);
+    }
+
+    RingTraffic::Producer producer = {&ring,0};
+    EXPECT_EQ(0,RingTraffic::produce(&producer));
+    int status = 0;
+    ASSERT_EQ(pid,waitpid(pid,&status,0));
+    EXPECT_TRUE(WIFEXITED(status));
+    EXPECT_EQ(0,WEXITSTATUS(status));
+    USharedMemoryManager::remove(name);
+}
+#endif
+
+TEST_F(USharedRingBufferTest,DISABLED_Benchmark_SpscThroughput)
+{
+    USharedMemoryManager manager(0x4000000);
+    USharedMemory sharedMemory(manager);
+    USharedRingBuffer ring(sharedMemory,L"ring",0x1000000,USharedRingBuffer::Spsc);
+    const int recordSizes[3] = {64,1500,0x10000};
+    for(int r = 0; r < 3; r++)
+    {
+        const int size = recordSizes[r];
+        const long long total = 0x40000000;
+        const int count = static_cast<int>(total / size);
+        struct Producer
+        {
+            USharedRingBuffer *ring;
+            int size;
+            int count;
+            static unsigned __stdcall run(void *param)
+            {
+                Producer *producer = static_cast<Producer *>(param);
+                int sizes[16];
+                void *records[16];
+                for(int i = 0; i < 16; i++)
+                {
+                    sizes[i] = producer->size;
+                }
+                USharedRingRange range;
+                for(int i = 0; i < producer->count; i += 16)
+                {
+                    producer->ring->reserve(sizes,16,records,range,-1);
+                    for(int j = 0; j < 16; j++)
+                    {
+                        memset(records[j],j,producer->size);
+                    }
+                    producer->ring->commit(range);
+                }
+                return 0;
+            }
+        };
+        Producer producer = {&ring,size,count};
+        LARGE_INTEGER frequency,begin,end;
+        QueryPerformanceFrequency(&frequency);
+        QueryPerformanceCounter(&begin);
+        HANDLE thread = reinterpret_cast<HANDLE>(_beginthreadex(NULL,0,&Producer::run,&producer,0,NULL));
+        const void *records[64];
+        int sizes[64];
+        USharedRingRange range;
+        long long bytes = 0;
+        for(int read = 0; read < (count + 15) / 16 * 16; )
+        {
+            const int n = ring.read(records,sizes,64,range,-1);
+            for(int i = 0; i < n; i++)
+            {
+                bytes += static_cast<const char *>(records[i])[sizes[i] - 1];
+            }
+            ring.release(range);
+            read += n;
+        }
+        QueryPerformanceCounter(&end);
+        WaitForMultipleObjects(1,&thread,TRUE,INFINITE);
+        CloseHandle(thread);
+        const double seconds = static_cast<double>(end.QuadPart - begin.QuadPart) / frequency.QuadPart;
+        printf("record %d bytes: %.2f GB/s, %.1f M records/s (%lld)\n",size,total / seconds / 1e9,count / seconds / 1e6,bytes);
+    }
+}
@@ -5,6 +5,9 @@
 #include <vector>
 #include <string>
 #include "../UniCore/UCommon.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <Windows.h>
 
 using namespace std;
 using namespace uni;
@@ -327,4 +330,277 @@ TEST(UStringTest,to_upper_Works)
 	{
 		FAIL();
 	}
-}
\ No newline at end of file
+}
+
+TEST(UStringTest,starts_with_PatternLongerThanSource_ReturnsFalse)
+{
+    EXPECT_FALSE(starts_with("he","hello"));
+    EXPECT_FALSE(starts_with(L"HE",L"hello",CaseInsensitive));
+    EXPECT_TRUE(starts_with("hello",""));
+    EXPECT_TRUE(starts_with(L"",L"",CaseInsensitive));
+}
+
+TEST(UStringTest,ascii_to_lower_OnlyAsciiLettersChanged)
+{
+    string data;
+    for(int i = 0; i < 256; i++)
+    {
+        data.push_back(static_cast<char>(i));
+    }
+    string lower = data;
+    ascii_to_lower(&lower[0],lower.size());
+    string upper = data;
+    ascii_to_upper(&upper[0],upper.size());
+    for(int i = 0; i < 256; i++)
+    {
+        EXPECT_EQ((i >= 'A' && i <= 'Z') ? i + 32 : i,static_cast<unsigned char>(lower[i]))<<i;
+        EXPECT_EQ((i >= 'a' && i <= 'z') ? i - 32 : i,static_cast<unsigned char>(upper[i]))<<i;
+    }
+}
+
+TEST(UStringTest,find_case_insensitive_SameAsLowerAndFind)
+{
+    //用很小的字母表制造大量部分匹配,覆盖SSE2的块和结尾的逐个比较.
+    const char alphabet[] = "aAbB\xC4\xE4";
+    srand(1);
+    for(int round = 0; round < 2000; round++)
+    {
+        string src(rand() % 80,'\0');
+        for(size_t i = 0; i < src.size(); i++)
+        {
+            src[i] = alphabet[rand() % 6];
+        }
+        string pattern(1 + rand() % 5,'\0');
+        for(size_t i = 0; i < pattern.size(); i++)
+        {
+            pattern[i] = alphabet[rand() % 6];
+        }
+        const size_t pos = src.empty() ? 0 : rand() % src.size();
+        const size_t expected = to_lower(src).find(to_lower(pattern),pos);
+        ASSERT_EQ(expected,find_case_insensitive(src,pattern,pos))<<src<<" "<<pattern;
+        ASSERT_EQ(expected,UCaseInsensitiveMatcher(pattern).find(src,pos))<<src<<" "<<pattern;
+    }
+}
+
+TEST(UStringTest,find_case_insensitive_EdgeCases)
+{
+    EXPECT_EQ(0,find_case_insensitive("",""));
+    EXPECT_EQ(3,find_case_insensitive("abc","",3));
+    EXPECT_EQ(UStringView::npos,find_case_insensitive("abc","",4));
+    EXPECT_EQ(UStringView::npos,find_case_insensitive("ab","abc"));
+    EXPECT_EQ(40,find_case_insensitive(string(40,'x') + "NeEdLe",UStringView("needle")));
+    EXPECT_EQ(UStringView::npos,find_case_insensitive(string(40,'x') + "NeEdL","needle"));
+}
+
+TEST(UStringTest,find_case_insensitive_w_Works)
+{
+    EXPECT_EQ(3,find_case_insensitive(L"\x4e2d\x6587 HeLLo",L"hello"));
+    EXPECT_EQ(0,find_case_insensitive(L"\x4e2d\x6587",L"\x4e2d"));
+    EXPECT_EQ(UWStringView::npos,find_case_insensitive(L"hello",L"HELP"));
+}
+
+TEST(UStringTest,UCaseInsensitiveMatcher_Works)
+{
+    UCaseInsensitiveMatcher matcher("ERROR");
+    EXPECT_EQ("error",matcher.pattern());
+    EXPECT_TRUE(matcher.matches("[main] Error: disk full"));
+    EXPECT_FALSE(matcher.matches("[main] warning"));
+    EXPECT_TRUE(matcher.isPrefixOf("errors"));
+    EXPECT_FALSE(matcher.isPrefixOf(" error"));
+
+    UWCaseInsensitiveMatcher wmatcher(L"Warn");
+    EXPECT_TRUE(wmatcher.matches(L"[main] WARNING"));
+    EXPECT_TRUE(wmatcher.isPrefixOf(L"warning"));
+    EXPECT_FALSE(wmatcher.matches(L"[main] error"));
+}
+
+TEST(UStringTest,split_view_SameRulesAsSplit)
+{
+    const char *cases[][2] = {
+        {"",""},{"apple"," "},{"apple  banana"," "},{"cup","    "},
+        {";apple;",";"},{";",";"},{"**cup inside***next;***;*","**"}
+    };
+    for(size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+    {
+        const vector<string> expected = split(cases[i][0],cases[i][1]);
+        vector<string> result;
+        USplitRange<char> range = split_view(cases[i][0],cases[i][1]);
+        for(USplitRange<char>::iterator it = range.begin(); it != range.end(); ++it)
+        {
+            result.push_back(it->str());
+        }
+        EXPECT_EQ(expected,result)<<cases[i][0];
+    }
+}
+
+TEST(UStringTest,split_view_PiecesPointIntoSource)
+{
+    const string source = "a,bc,,d";
+    USplitRange<char> range = split_view(source,",");
+    USplitRange<char>::iterator it = range.begin();
+    ASSERT_TRUE(it != range.end());
+    EXPECT_EQ(source.data(),it->data());
+    ++it;
+    ASSERT_TRUE(it != range.end());
+    EXPECT_EQ(source.data() + 2,it->data());
+    EXPECT_EQ(UStringView("bc"),*it);
+}
+
+TEST(UStringTest,split_view_w_Works)
+{
+    vector<wstring> result;
+    USplitRange<wchar_t> range = split_view(L"apple  banana");
+    for(USplitRange<wchar_t>::iterator it = range.begin(); it != range.end(); ++it)
+    {
+        result.push_back(it->str());
+    }
+    ASSERT_EQ(3,result.size());
+    EXPECT_EQ(L"apple",result[0]);
+    EXPECT_EQ(L"",result[1]);
+    EXPECT_EQ(L"banana",result[2]);
+}
+
+TEST(UStringTest,split_into_ReusesStrings)
+{
+    vector<string> result;
+    EXPECT_EQ(3,split_into("a long first piece,b,c",",",result));
+    const char *firstBuffer = result[0].data();
+    EXPECT_EQ(2,split_into("x,y",",",result));
+    ASSERT_EQ(2,result.size());
+    EXPECT_EQ("x",result[0]);
+    EXPECT_EQ("y",result[1]);
+    EXPECT_EQ(firstBuffer,result[0].data());
+    EXPECT_EQ(0,split_into("",",",result));
+    EXPECT_TRUE(result.empty());
+}
+
+TEST(UStringTest,split_into_Views_Works)
+{
+    vector<UStringView> result;
+    EXPECT_EQ(4,split_into("**cup inside***next;***;*","**",result));
+    EXPECT_EQ("",result[0].str());
+    EXPECT_EQ("cup inside",result[1].str());
+    EXPECT_EQ("*next;",result[2].str());
+    EXPECT_EQ("*;*",result[3].str());
+    EXPECT_EQ("-cup inside-*next;-*;*",join(result,"-"));
+
+    vector<UWStringView> wresult;
+    EXPECT_EQ(2,split_into(L"a b",L" ",wresult));
+    EXPECT_EQ(L"a+b",join(wresult,L"+"));
+}
+
+TEST(UStringTest,trim_view_ReturnsPieceOfSource)
+{
+    const string source = "  apple ";
+    UStringView trimmed = trim_view(source);
+    EXPECT_EQ("apple",trimmed.str());
+    EXPECT_EQ(source.data() + 2,trimmed.data());
+    EXPECT_EQ("apple ",ltrim_view(source).str());
+    EXPECT_EQ("  apple",rtrim_view(source).str());
+    EXPECT_EQ("ppa",trim_view("appappa","appa").str());
+    EXPECT_EQ("apple",trim_view("apple","").str());
+    EXPECT_EQ(L"ppa",trim_view(L"appappa",L"appa").str());
+}
+
+TEST(UStringTest,DISABLED_Benchmark_Split)
+{
+    string data;
+    for(int i = 0; data.size() < 8 * 1024 * 1024; i++)
+    {
+        data += "field";
+        data += static_cast<char>('a' + i % 26);
+        data += (i % 16 == 15) ? "\n" : ",";
+    }
+    LARGE_INTEGER frequency,begin,end;
+    QueryPerformanceFrequency(&frequency);
+    const double megabytes = data.size() / (1024.0 * 1024.0);
+    const vector<string> lines = split(data,"\n");
+
+    QueryPerformanceCounter(&begin);
+    size_t count = 0;
+    for(size_t i = 0; i < lines.size(); i++)
+    {
+        count += split(lines[i],",").size();
+    }
+    QueryPerformanceCounter(&end);
+    printf("split: %.1f MB/s\n",megabytes * frequency.QuadPart / (end.QuadPart - begin.QuadPart));
+
+    QueryPerformanceCounter(&begin);
+    size_t countInto = 0;
+    vector<string> fields;
+    for(size_t i = 0; i < lines.size(); i++)
+    {
+        countInto += split_into(lines[i],",",fields);
+    }
+    QueryPerformanceCounter(&end);
+    printf("split_into strings: %.1f MB/s\n",megabytes * frequency.QuadPart / (end.QuadPart - begin.QuadPart));
+    EXPECT_EQ(count,countInto);
+
+    QueryPerformanceCounter(&begin);
+    size_t countView = 0;
+    USplitRange<char> lineRange = split_view(data,"\n");
+    for(USplitRange<char>::iterator line = lineRange.begin(); line != lineRange.end(); ++line)
+    {
+        USplitRange<char> fieldRange = split_view(*line,",");
+        for(USplitRange<char>::iterator field = fieldRange.begin(); field != fieldRange.end(); ++field)
+        {
+            countView++;
+        }
+    }
+    QueryPerformanceCounter(&end);
+    printf("split_view: %.1f MB/s\n",megabytes * frequency.QuadPart / (end.QuadPart - begin.QuadPart));
+    EXPECT_EQ(count,countView);
+
+    const string padded = string(4 * 1024 * 1024,' ') + "x" + string(4 * 1024 * 1024,' ');
+    QueryPerformanceCounter(&begin);
+    EXPECT_EQ("x",trim(padded));
+    QueryPerformanceCounter(&end);
+    printf("trim: %.1f MB/s\n",padded.size() / (1024.0 * 1024.0) * frequency.QuadPart / (end.QuadPart - begin.QuadPart));
+}
+
+TEST(UStringTest,DISABLED_Benchmark_CaseInsensitive)
+{
+    vector<string> lines;
+    size_t total = 0;
+    for(int i = 0; total < 8 * 1024 * 1024; i++)
+    {
+        char line[128];
+        sprintf_s(line,"Sat Oct 18 12:00:%02d 2026 {Group%d}[Info][main] Packet %d Received From Server",
+            i % 60,i % 7,i);
+        lines.push_back(line);
+        total += lines.back().size();
+    }
+    LARGE_INTEGER frequency,begin,end;
+    QueryPerformanceFrequency(&frequency);
+    const double megabytes = total / (1024.0 * 1024.0);
+
+    QueryPerformanceCounter(&begin);
+    size_t expected = 0;
+    for(size_t i = 0; i < lines.size(); i++)
+    {
+        expected += to_lower(lines[i]).find(to_lower("received from client")) != string::npos;
+    }
+    QueryPerformanceCounter(&end);
+    printf("to_lower + find: %.1f MB/s\n",megabytes * frequency.QuadPart / (end.QuadPart - begin.QuadPart));
+
+    QueryPerformanceCounter(&begin);
+    size_t count = 0;
+    for(size_t i = 0; i < lines.size(); i++)
+    {
+        count += contains(lines[i],"received from client",CaseInsensitive);
+    }
+    QueryPerformanceCounter(&end);
+    printf("contains: %.1f MB/s\n",megabytes * frequency.QuadPart / (end.QuadPart - begin.QuadPart));
+    EXPECT_EQ(expected,count);
+
+    UCaseInsensitiveMatcher matcher("received from client");
+    QueryPerformanceCounter(&begin);
+    count = 0;
+    for(size_t i = 0; i < lines.size(); i++)
+    {
+        count += matcher.matches(lines[i]);
+    }
+    QueryPerformanceCounter(&end);
+    printf("UCaseInsensitiveMatcher: %.1f MB/s\n",megabytes * frequency.QuadPart / (end.QuadPart - begin.QuadPart));
+    EXPECT_EQ(expected,count);
+}
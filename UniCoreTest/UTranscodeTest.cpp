@@ -0,0 +1,234 @@
+﻿#include "stdafx.h"
+
+#include "gtest/gtest.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include <Windows.h>
+#include "../UniCore/UCast.h"
+#include "../UniCore/UTranscode.h"
+
+using namespace std;
+using namespace uni;
+
+namespace
+{
+    vector<UUtf32Unit> decodeUtf8(const string &s)
+    {
+        vector<UUtf32Unit> result(s.size() + 1);
+        const size_t size = utf8ToUtf32(s.data(),s.size(),&result[0],result.size());
+        result.resize(size);
+        return result;
+    }
+
+    //! 随机的码点,各种长度的UTF-8编码都有.
+    UUtf32Unit randomCodePoint()
+    {
+        const UUtf32Unit limits[] = {0x80,0x800,0x10000,0x110000};
+        for(;;)
+        {
+            const UUtf32Unit limit = limits[rand() % 4];
+            const UUtf32Unit c = ((static_cast<UUtf32Unit>(rand()) << 15) ^ rand()) % limit;
+            if(c < 0xD800 || c > 0xDFFF)
+            {
+                return c;
+            }
+        }
+    }
+}
+
+TEST(UTranscodeTest,utf8ToUtf16_KnownString_Converted)
+{
+    //"我们じゃない향찰/鄕札"和U+1F600.
+    const string utf8 = "\xe6\x88\x91\xe4\xbb\xac\xe3\x81\x98\xe3\x82\x83\xe3\x81\xaa\xe3\x81\x84"
+        "\xed\x96\xa5\xec\xb0\xb0\x2f\xe9\x84\x95\xe6\x9c\xad\xf0\x9f\x98\x80";
+    const UUtf16Unit expected[] = {0x6211,0x4eec,0x3058,0x3083,0x306a,0x3044,0xd5a5,0xcc30,0x2f,
+        0x9115,0x672d,0xd83d,0xde00};
+    const size_t expectedSize = sizeof(expected) / sizeof(expected[0]);
+    ASSERT_EQ(expectedSize,utf8ToUtf16(utf8.data(),utf8.size(),0,0));
+    UUtf16Unit converted[expectedSize];
+    ASSERT_EQ(expectedSize,utf8ToUtf16(utf8.data(),utf8.size(),converted,expectedSize));
+    for(size_t i = 0; i < expectedSize; i++)
+    {
+        EXPECT_EQ(expected[i],converted[i])<<i;
+    }
+    char back[64];
+    ASSERT_EQ(utf8.size(),utf16ToUtf8(converted,expectedSize,back,sizeof(back)));
+    EXPECT_EQ(utf8,string(back,utf8.size()));
+}
+
+TEST(UTranscodeTest,utf8ToUtf32_InvalidSequences_ReplacedPerMaximalSubpart)
+{
+    const UUtf32Unit r = UReplacementCharacter;
+    //过长编码.
+    vector<UUtf32Unit> decoded = decodeUtf8("\xc0\xaf" "A");
+    ASSERT_EQ(3,decoded.size());
+    EXPECT_EQ(r,decoded[0]);
+    EXPECT_EQ(r,decoded[1]);
+    EXPECT_EQ('A',decoded[2]);
+    //代码单元为代理项.
+    decoded = decodeUtf8("\xed\xa0\x80");
+    ASSERT_EQ(3,decoded.size());
+    //截断的序列只替换一次.
+    decoded = decodeUtf8("\xe6\x88" "A\xf0\x9f\x98");
+    ASSERT_EQ(3,decoded.size());
+    EXPECT_EQ(r,decoded[0]);
+    EXPECT_EQ('A',decoded[1]);
+    EXPECT_EQ(r,decoded[2]);
+    //超出U+10FFFF.
+    decoded = decodeUtf8("\xf4\x90\x80\x80");
+    ASSERT_EQ(4,decoded.size());
+    //单独的后续字节.
+    decoded = decodeUtf8("\x80\xbf");
+    ASSERT_EQ(2,decoded.size());
+
+    EXPECT_FALSE(isValidUtf8("\xc0\xaf",2));
+    EXPECT_TRUE(isValidUtf8("\xf4\x8f\xbf\xbf",4));
+    EXPECT_TRUE(isValidUtf8("",0));
+}
+
+TEST(UTranscodeTest,utf16ToUtf8_UnpairedSurrogate_Replaced)
+{
+    const UUtf16Unit source[] = {'a',0xd800,'b',0xdc00,0xd83d};
+    char converted[16];
+    const size_t size = utf16ToUtf8(source,5,converted,sizeof(converted));
+    EXPECT_EQ("a\xef\xbf\xbd" "b\xef\xbf\xbd\xef\xbf\xbd",string(converted,size));
+    EXPECT_FALSE(isValidUtf16(source,5));
+    EXPECT_TRUE(isValidUtf16(source,1));
+}
+
+TEST(UTranscodeTest,DestTooSmall_ReturnsBufferTooSmall)
+{
+    const string utf8(100,'a');
+    UUtf16Unit converted[99];
+    EXPECT_EQ(UTranscodeBufferTooSmall,utf8ToUtf16(utf8.data(),utf8.size(),converted,99));
+    char narrow[2];
+    const UUtf32Unit smile = 0x1f600;
+    EXPECT_EQ(UTranscodeBufferTooSmall,utf32ToUtf8(&smile,1,narrow,2));
+}
+
+TEST(UTranscodeTest,RandomCodePoints_RoundTrip)
+{
+    srand(4);
+    for(int round = 0; round < 200; round++)
+    {
+        vector<UUtf32Unit> codePoints(rand() % 200 + 1);
+        for(size_t i = 0; i < codePoints.size(); i++)
+        {
+            //夹杂较长的ASCII串,覆盖SSE2的块.
+            codePoints[i] = (rand() % 3) ? rand() % 0x80 : randomCodePoint();
+        }
+        vector<char> utf8(codePoints.size() * 4);
+        const size_t utf8Size = utf32ToUtf8(&codePoints[0],codePoints.size(),&utf8[0],utf8.size());
+        ASSERT_EQ(utf8Size,utf32ToUtf8(&codePoints[0],codePoints.size(),0,0));
+        ASSERT_TRUE(isValidUtf8(&utf8[0],utf8Size));
+
+        vector<UUtf16Unit> utf16(codePoints.size() * 2);
+        const size_t utf16Size = utf8ToUtf16(&utf8[0],utf8Size,&utf16[0],utf16.size());
+        ASSERT_NE(UTranscodeBufferTooSmall,utf16Size);
+        ASSERT_TRUE(isValidUtf16(&utf16[0],utf16Size));
+
+        vector<UUtf32Unit> utf32(codePoints.size());
+        ASSERT_EQ(codePoints.size(),utf16ToUtf32(&utf16[0],utf16Size,&utf32[0],utf32.size()));
+        EXPECT_EQ(codePoints,utf32);
+
+        vector<UUtf16Unit> utf16Again(utf16Size);
+        ASSERT_EQ(utf16Size,utf32ToUtf16(&utf32[0],utf32.size(),&utf16Again[0],utf16Size));
+        utf16.resize(utf16Size);
+        EXPECT_EQ(utf16,utf16Again);
+
+        const wstring wide = utf8ToWide(UStringView(&utf8[0],utf8Size));
+        EXPECT_EQ(string(&utf8[0],utf8Size),wideToUtf8(wide));
+    }
+}
+
+TEST(UTranscodeTest,asciiPrefixLength_StopsAtFirstNonAscii)
+{
+    for(size_t position = 0; position < 40; position++)
+    {
+        string s(40,'x');
+        s[position] = '\x80';
+        EXPECT_EQ(position,asciiPrefixLength(s.data(),s.size()));
+        wstring ws(40,L'x');
+        ws[position] = 0x100;
+        EXPECT_EQ(position,asciiPrefixLength(ws.data(),ws.size()));
+    }
+    wstring widened(37,L'\0');
+    widenAscii("abcdefghijklmnopqrstuvwxyz0123456789!",37,&widened[0]);
+    EXPECT_EQ(L"abcdefghijklmnopqrstuvwxyz0123456789!",widened);
+    string narrowed(37,'\0');
+    narrowAscii(widened.data(),37,&narrowed[0]);
+    EXPECT_EQ("abcdefghijklmnopqrstuvwxyz0123456789!",narrowed);
+}
+
+TEST(UTranscodeTest,DISABLED_Benchmark_s2ws)
+{
+    string ascii;
+    while(ascii.size() < 200)
+    {
+        ascii += "Sat Oct 18 12:00:00 2026 {Group}[Info][main] ";
+    }
+    const string chinese = ws2s(L"我们的日志信息,包含一些中文字符。",CP_ACP);
+    const int count = 100000;
+    LARGE_INTEGER frequency,begin,end;
+    QueryPerformanceFrequency(&frequency);
+
+    _locale_t loc = _create_locale(LC_CTYPE,"");
+    const string *samples[] = {&ascii,&chinese};
+    const char *names[] = {"ascii","chinese"};
+    for(int sample = 0; sample < 2; sample++)
+    {
+        const string &s = *samples[sample];
+        QueryPerformanceCounter(&begin);
+        for(int i = 0; i < count; i++)
+        {
+            //原来的实现:每次创建locale,转换到临时缓冲区再复制.
+            _locale_t oldLoc = _create_locale(LC_CTYPE,"");
+            wchar_t *dest = new wchar_t[s.size() + 1];
+            size_t converted = 0;
+            _mbstowcs_s_l(&converted,dest,s.size() + 1,s.c_str(),_TRUNCATE,oldLoc);
+            _free_locale(oldLoc);
+            wstring result = dest;
+            delete[] dest;
+        }
+        QueryPerformanceCounter(&end);
+        printf("%s old s2ws: %.1f ns\n",names[sample],
+            1e9 * (end.QuadPart - begin.QuadPart) / frequency.QuadPart / count);
+
+        QueryPerformanceCounter(&begin);
+        for(int i = 0; i < count; i++)
+        {
+            s2ws(s);
+        }
+        QueryPerformanceCounter(&end);
+        printf("%s s2ws: %.1f ns\n",names[sample],
+            1e9 * (end.QuadPart - begin.QuadPart) / frequency.QuadPart / count);
+
+        QueryPerformanceCounter(&begin);
+        for(int i = 0; i < count; i++)
+        {
+            s2ws(s,loc);
+        }
+        QueryPerformanceCounter(&end);
+        printf("%s s2ws(_locale_t): %.1f ns\n",names[sample],
+            1e9 * (end.QuadPart - begin.QuadPart) / frequency.QuadPart / count);
+    }
+    _free_locale(loc);
+
+    const string utf8 = ws2s(L"我们的日志信息,包含一些中文字符。Some ASCII text too.",CP_UTF8);
+    QueryPerformanceCounter(&begin);
+    for(int i = 0; i < count; i++)
+    {
+        MultiByteToWideChar(CP_UTF8,0,utf8.data(),utf8.size(),0,0);
+    }
+    QueryPerformanceCounter(&end);
+    printf("MultiByteToWideChar size query: %.1f ns\n",1e9 * (end.QuadPart - begin.QuadPart) / frequency.QuadPart / count);
+    QueryPerformanceCounter(&begin);
+    for(int i = 0; i < count; i++)
+    {
+        utf8ToWide(utf8.data(),utf8.size(),0,0);
+    }
+    QueryPerformanceCounter(&end);
+    printf("utf8ToWide size query: %.1f ns\n",1e9 * (end.QuadPart - begin.QuadPart) / frequency.QuadPart / count);
+}
@@ -9,9 +9,12 @@
 #define WIN32_LEAN_AND_MEAN
 #include "windows.h"
 
+#include <new>
+
 #include "../UniCore/UCast.h"
 #include "../UniCore/ULog.h"
 #include "../UniCore/UMemory.h"
+#include "../UniCore/UMultiPatternMatcher.h"
 
 
 namespace uni
@@ -127,15 +130,102 @@ static int lua_print(lua_State *L)
     return 0;
 }
 
+static const char *g_matcherTypeName = "unilua.multi_pattern_matcher";
+
+//! multi_pattern_matcher(patterns[,ignore_case])
+/*!
+    用patterns数组中的字符串构造UMultiPatternMatcher,返回的对象有两个方法:
+    - matcher:matches(text) text中是否包含任意一个pattern.
+    - matcher:find_all(text) 返回所有匹配组成的数组,每个元素是{pattern=编号,offset=起始位置},
+      编号和位置都从1开始.
+*/
+static int lua_multi_pattern_matcher(lua_State *L)
+{
+    luaL_checktype(L,1,LUA_TTABLE);
+    const CaseSensitivity caseSensitivity = lua_toboolean(L,2) ? CaseInsensitive : CaseSensitive;
+    void *memory = lua_newuserdata(L,sizeof(UMultiPatternMatcher));
+    UMultiPatternMatcher *matcher = new(memory) UMultiPatternMatcher(caseSensitivity);
+    //先设置元表,之后出错时__gc也能析构matcher.
+    luaL_setmetatable(L,g_matcherTypeName);
+    const int count = luaL_len(L,1);
+    for(int i = 1; i <= count; i++)
+    {
+        lua_rawgeti(L,1,i);
+        size_t size = 0;
+        const char *pattern = lua_tolstring(L,-1,&size);
+        if(!pattern)
+        {
+            luaL_argerror(L,1,"patterns must be strings");
+        }
+        matcher->addPattern(UStringView(pattern,size));
+        lua_pop(L,1);
+    }
+    matcher->build();
+    return 1;
+}
+
+static UMultiPatternMatcher *checkMatcher(lua_State *L)
+{
+    return static_cast<UMultiPatternMatcher *>(luaL_checkudata(L,1,g_matcherTypeName));
+}
+
+static int lua_matcher_matches(lua_State *L)
+{
+    UMultiPatternMatcher *matcher = checkMatcher(L);
+    size_t size = 0;
+    const char *text = luaL_checklstring(L,2,&size);
+    lua_pushboolean(L,matcher->matchesAny(UStringView(text,size)));
+    return 1;
+}
+
+static int lua_matcher_find_all(lua_State *L)
+{
+    UMultiPatternMatcher *matcher = checkMatcher(L);
+    size_t size = 0;
+    const char *text = luaL_checklstring(L,2,&size);
+    std::vector<UPatternMatch> matches;
+    matcher->findAll(UStringView(text,size),matches);
+    lua_createtable(L,static_cast<int>(matches.size()),0);
+    for(size_t i = 0; i < matches.size(); i++)
+    {
+        lua_createtable(L,0,2);
+        lua_pushinteger(L,static_cast<lua_Integer>(matches[i].pattern + 1));
+        lua_setfield(L,-2,"pattern");
+        lua_pushinteger(L,static_cast<lua_Integer>(matches[i].offset + 1));
+        lua_setfield(L,-2,"offset");
+        lua_rawseti(L,-2,static_cast<int>(i + 1));
+    }
+    return 1;
+}
+
+static int lua_matcher_gc(lua_State *L)
+{
+    checkMatcher(L)->~UMultiPatternMatcher();
+    return 0;
+}
+
+static const struct luaL_Reg g_matcherMethods[] = {
+    {"matches",lua_matcher_matches},
+    {"find_all",lua_matcher_find_all},
+    {"__gc",lua_matcher_gc},
+    {NULL, NULL}  /* sentinel */
+};
+
 static const struct luaL_Reg g_luaFunctions[] = {
     {"sleep",lua_sleep},
     {"get_at", lua_get_at},
     {"debug_message",lua_print},
+    {"multi_pattern_matcher",lua_multi_pattern_matcher},
     {NULL, NULL}  /* sentinel */
 };
 
 extern "C" __declspec(dllexport) int luaopen_unilua( lua_State *L )
 {
+    luaL_newmetatable(L,g_matcherTypeName);
+    lua_pushvalue(L,-1);
+    lua_setfield(L,-2,"__index");
+    luaL_setfuncs(L,g_matcherMethods,0);
+    lua_pop(L,1);
     for(int i = 0; g_luaFunctions[i].func; i++)
     {
         lua_pushcfunction(L,g_luaFunctions[i].func);
@@ -41,7 +41,11 @@ QVariant UPacketMonitorModel::data( const QModelIndex &index,int role /*= Qt::Di
 //     UTRACE("性能")<<"row:"<<index.row()<<" column:"<<index.column()<<" role:"<<role;
 //     }
     Q_ASSERT(index.isValid());
-    if(role == Qt::DisplayRole || role == Qt::EditRole)
+    if(role == ContentRole)
+    {
+        return packetDatas_->at(index.row()).content;
+    }
+    else if(role == Qt::DisplayRole || role == Qt::EditRole)
     {
         int column = index.column();
         int row = index.row();
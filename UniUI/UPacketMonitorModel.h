@@ -24,6 +24,10 @@ class UPacketMonitorModel : public QAbstractTableModel
     Q_OBJECT
 
 public:
+    enum
+    {
+        ContentRole = Qt::UserRole  //!< 封包的原始内容,QByteArray。
+    };
     //! 构造函数。
     /*!
         \param packetDatas 所有封包数据的指针。
@@ -1,6 +1,7 @@
 ﻿#include "UPacketMonitorProxyModel.h"
 
 #include "../UniCore/ULog.h"
+#include "UPacketMonitorModel.h"
 
 namespace uni
 {
@@ -42,35 +43,31 @@ bool UPacketMonitorProxyModel::filterAcceptsRow( int sourceRow, const QModelInde
     QModelIndex indexForType = sourceModel()->index(sourceRow, 1, sourceParent);
     QModelIndex indexForData = sourceModel()->index(sourceRow, 2, sourceParent);
 
+    UPacketView::PacketType type;
     if(indexForType.data().toString() == "Send")
     {
-        int id = indexForData.data().toString().toInt(0,16);
-        //查看是否在显示ID列表中。
-        if(filters_[UPacketView::SendType].contains(id))
-        {
-            return true;
-        }
-        else
-        {
-            return false;
-        }
+        type = UPacketView::SendType;
     }
     else if(indexForType.data().toString() == "Recv")
     {
-        int id = indexForData.data().toString().toInt(0,16);
-        if(filters_[UPacketView::RecvType].contains(id))
-        {
-            return true;
-        }
-        else
-        {
-            return false;
-        }
+        type = UPacketView::RecvType;
     }
     else
     {
         return false;
     }
+    int id = indexForData.data().toString().toInt(0,16);
+    //查看是否在显示ID列表中。
+    if(!filters_[type].contains(id))
+    {
+        return false;
+    }
+    if(contentMatcher_.patternCount() == 0)
+    {
+        return true;
+    }
+    QByteArray content = indexForType.data(UPacketMonitorModel::ContentRole).toByteArray();
+    return contentMatcher_.matchesAny(UStringView(content.constData(),content.size()));
 }
 
 void UPacketMonitorProxyModel::setFilters( QMap<UPacketView::PacketType,QSet<int> > filters )
@@ -79,4 +76,18 @@ void UPacketMonitorProxyModel::setFilters( QMap<UPacketView::PacketType,QSet<int
     invalidateFilter();
 }
 
+void UPacketMonitorProxyModel::setContentPatterns( const QList<QByteArray> &patterns )
+{
+    contentMatcher_.clear();
+    for(int i = 0; i < patterns.size(); i++)
+    {
+        if(!patterns[i].isEmpty())
+        {
+            contentMatcher_.addPattern(UStringView(patterns[i].constData(),patterns[i].size()));
+        }
+    }
+    contentMatcher_.build();
+    invalidateFilter();
+}
+
 }//namespace uni
\ No newline at end of file
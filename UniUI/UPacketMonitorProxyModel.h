@@ -7,6 +7,8 @@
 #ifndef UNIUI_UPACKET_MONITOR_PROXY_MODEL_H
 #define UNIUI_UPACKET_MONITOR_PROXY_MODEL_H
 
+#include <QByteArray>
+#include <QList>
 #include <QMap>
 #include <QSet>
 #include <QSortFilterProxyModel>
@@ -15,6 +17,7 @@
 #include "../UniCore/AutoLink.h"
 
 #include "UPacketView.h"
+#include "../UniCore/UMultiPatternMatcher.h"
 
 namespace uni
 {
@@ -27,11 +30,17 @@ public:
     explicit UPacketMonitorProxyModel(QObject *parent = 0);
     virtual ~UPacketMonitorProxyModel();
     void setFilters(QMap<UPacketView::PacketType,QSet<int> > filters);
+    //! 设置封包内容的过滤条件。
+    /*!
+        \param patterns 封包内容中要查找的数据，包含其中任意一个的封包才显示。为空时不按内容过滤。
+    */
+    void setContentPatterns(const QList<QByteArray> &patterns);
 public slots:
 protected:
     virtual bool filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const;
 private:
     QMap<UPacketView::PacketType,QSet<int> > filters_; 
+    UMultiPatternMatcher contentMatcher_;  //!< 所有过滤内容构造成的自动机，每个封包只需扫描一遍。
 };
 
 }//namespace uni
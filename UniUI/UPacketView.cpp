@@ -7,6 +7,7 @@
 #include <QGridLayout>
 #include <QHBoxLayout>
 #include <QLabel>
+#include <QLineEdit>
 #include <QMessageBox>
 #include <QGroupBox>
 #include <QPushButton>
@@ -15,6 +16,7 @@
 #include <QTime>
 
 #include "..//UniCore//UDebug.h"
+#include "../UniCore/UBuffer.h"
 #include "../UniCore/ULog.h"
 #include "../UniCore/UMemory.h"
 #include "UFlowLayout.h"
@@ -116,6 +118,8 @@ void UPacketView::createPacketMonitorGroupBox()
     autoScrollPushButton_ = new QPushButton(tr("Auto Scroll"),this);
     autoScrollPushButton_->setCheckable(true);
     clearPacketsButton_ = new QPushButton(tr("Clear Packets"),this);
+    contentFilterEdit_ = new QLineEdit(this);
+    contentFilterEdit_->setToolTip(tr("Show only packets containing any of these hex patterns, separated by ','"));
     packetCountLabel_ = new QLabel(tr("Packet Count:0"),this);
 
     QVBoxLayout *layout = new QVBoxLayout;
@@ -124,10 +128,13 @@ void UPacketView::createPacketMonitorGroupBox()
     UFlowLayout *layout2 = new UFlowLayout;
     layout2->addWidget(autoScrollPushButton_);
     layout2->addWidget(clearPacketsButton_);
+    layout2->addWidget(new QLabel(tr("Content Filter:"),this));
+    layout2->addWidget(contentFilterEdit_);
     layout->addLayout(layout2);
     packetMonitorGroupBox_->setLayout(layout);
 
     connect(autoScrollPushButton_,SIGNAL(toggled(bool)),this,SLOT(setAutoScroll(bool)));
+    connect(contentFilterEdit_,SIGNAL(editingFinished()),this,SLOT(updateContentFilter()));
     connect(clearPacketsButton_,SIGNAL(clicked()),this,SLOT(clearPackets()));
     
 }
@@ -344,6 +351,22 @@ void UPacketView::clearPackets()
     packetMonitorModel_->removeRows(0,packetMonitorModel_->rowCount());
 }
 
+void UPacketView::updateContentFilter()
+{
+    QList<QByteArray> patterns;
+    QStringList hexPatterns = contentFilterEdit_->text().split(',',QString::SkipEmptyParts);
+    for(int i = 0; i < hexPatterns.size(); i++)
+    {
+        UBuffer buffer;
+        buffer.appendHexPattern(hexPatterns[i].toStdString());
+        if(!buffer.empty())
+        {
+            patterns.append(QByteArray(buffer.data(),buffer.size()));
+        }
+    }
+    packetMonitorProxyModel_->setContentPatterns(patterns);
+}
+
 QDataStream & operator<<( QDataStream &s, const UPacketView::PacketInfo &packetInfo )
 {
     s<<packetInfo.id;
@@ -18,6 +18,7 @@
 class QCheckBox;
 class QGroupBox;
 class QLabel;
+class QLineEdit;
 class QModelIndex;
 class QPushButton;
 
@@ -184,6 +185,11 @@ private slots:
         清空封包监视器中的封包。
     */
     void clearPackets();
+    //! 按内容过滤编辑框中的内容更新封包内容的过滤条件。
+    /*!
+        编辑框中是以逗号分隔的16进制数据，例如"0C 0B,25 34"，封包内容包含其中任意一段数据时才显示。
+    */
+    void updateContentFilter();
 private:
     //! 创建封包信息列表处的组合框。
     void createPacketListGroupBox();
@@ -214,6 +220,7 @@ private:
     QGroupBox *packetMonitorGroupBox_;
     QPushButton *autoScrollPushButton_;
     QPushButton *clearPacketsButton_;
+    QLineEdit *contentFilterEdit_;  //!< 按内容过滤。
     QLabel *packetCountLabel_;
     uni::UPacketMonitor *packetMonitor_;
     UPacketMonitorProxyModel *packetMonitorProxyModel_;